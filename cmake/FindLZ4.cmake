@@ -0,0 +1,27 @@
+# - Find LZ4
+# Find the LZ4 compression library
+#
+# LZ4_INCLUDE_DIR - where to find lz4.h
+# LZ4_LIBRARY     - the LZ4 library
+# LZ4_FOUND       - True if LZ4 is found
+
+if (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+  # already in cache, be silent
+  set (LZ4_FIND_QUIETLY TRUE)
+endif (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+
+find_path (LZ4_INCLUDE_DIR lz4.h
+  PATHS
+  ${CMAKE_SOURCE_DIR}/include
+  ${CMAKE_INSTALL_PREFIX}/include
+  )
+
+find_library (LZ4_LIBRARY NAMES lz4
+  PATHS
+  ${CMAKE_INSTALL_PREFIX}/lib
+  )
+
+include (FindPackageHandleStandardArgs)
+find_package_handle_standard_args (LZ4 DEFAULT_MSG LZ4_INCLUDE_DIR LZ4_LIBRARY)
+
+mark_as_advanced (LZ4_INCLUDE_DIR LZ4_LIBRARY)
@@ -0,0 +1,27 @@
+# - Find Zstandard
+# Find the Zstandard compression library
+#
+# ZSTD_INCLUDE_DIR - where to find zstd.h
+# ZSTD_LIBRARY     - the Zstandard library
+# ZSTD_FOUND       - True if Zstandard is found
+
+if (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+  # already in cache, be silent
+  set (ZSTD_FIND_QUIETLY TRUE)
+endif (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+
+find_path (ZSTD_INCLUDE_DIR zstd.h
+  PATHS
+  ${CMAKE_SOURCE_DIR}/include
+  ${CMAKE_INSTALL_PREFIX}/include
+  )
+
+find_library (ZSTD_LIBRARY NAMES zstd
+  PATHS
+  ${CMAKE_INSTALL_PREFIX}/lib
+  )
+
+include (FindPackageHandleStandardArgs)
+find_package_handle_standard_args (ZSTD DEFAULT_MSG ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
+
+mark_as_advanced (ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
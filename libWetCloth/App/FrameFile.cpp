@@ -0,0 +1,547 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "FrameFile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace framefile
+{
+static const char magic[8] = { 'W', 'C', 'F', 'R', 'A', 'M', 'E', '\0' };
+
+static const int zstd_level = 3;
+
+Options::Options()
+	: precision(64)
+	, compression(C_NONE)
+{}
+
+Record::Record()
+	: num_channels(3)
+	, integer_channels(3, false)
+	, arity(3)
+	, index_base(1)
+{}
+
+Record::Record( const std::string& name_, int num_channels_, int arity_, int index_base_ )
+	: name(name_)
+	, num_channels(num_channels_)
+	, integer_channels(num_channels_, false)
+	, arity(arity_)
+	, index_base(index_base_)
+{}
+
+int Record::getNumVertices() const
+{
+	return num_channels > 0 ? (int) (values.size() / num_channels) : 0;
+}
+
+int Record::getNumElements() const
+{
+	return arity > 0 ? (int) (indices.size() / arity) : 0;
+}
+
+uint16_t floatToHalf( float f )
+{
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(float));
+
+	const uint16_t sign = (uint16_t) ((x >> 16) & 0x8000);
+	const int exponent = (int) ((x >> 23) & 0xff);
+	uint32_t mantissa = x & 0x7fffff;
+
+	// infinity and NaN
+	if (exponent == 0xff) return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+	const int e = exponent - 127 + 15;
+	if (e >= 0x1f) return sign | 0x7c00;
+
+	if (e <= 0) {
+		// subnormal, rounded to the nearest even
+		if (e < -10) return sign;
+		mantissa |= 0x800000;
+		const int shift = 14 - e;
+		uint32_t half = mantissa >> shift;
+		const uint32_t rem = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if (rem > halfway || (rem == halfway && (half & 1))) ++half;
+		return sign | (uint16_t) half;
+	}
+
+	// a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = ((uint32_t) e << 10) | (mantissa >> 13);
+	const uint32_t rem = mantissa & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) ++half;
+	return sign | (uint16_t) half;
+}
+
+float halfToFloat( uint16_t h )
+{
+	const uint32_t sign = ((uint32_t) h & 0x8000) << 16;
+	const uint32_t exponent = ((uint32_t) h >> 10) & 0x1f;
+	const uint32_t mantissa = (uint32_t) h & 0x3ff;
+
+	if (exponent == 0) {
+		const float f = std::ldexp((float) mantissa, -24);
+		return sign ? -f : f;
+	}
+
+	uint32_t x;
+	if (exponent == 0x1f) {
+		x = sign | 0x7f800000 | (mantissa << 13);
+	} else {
+		x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	std::memcpy(&f, &x, sizeof(float));
+	return f;
+}
+
+bool parseCompression( const std::string& str, Compression& compression )
+{
+	if (str == "none") compression = C_NONE;
+	else if (str == "lz4") compression = C_LZ4;
+	else if (str == "zstd") compression = C_ZSTD;
+	else return false;
+
+	return true;
+}
+
+bool isCompressionAvailable( Compression compression )
+{
+	switch (compression) {
+	case C_NONE:
+		return true;
+#ifdef USE_LZ4
+	case C_LZ4:
+		return true;
+#endif
+#ifdef USE_ZSTD
+	case C_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+static int channelSize( uint8_t type )
+{
+	switch (type) {
+	case CT_F64:
+		return 8;
+	case CT_F32:
+	case CT_I32:
+		return 4;
+	case CT_F16:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+// groups the bytes of equal significance of the elements, which makes the
+// slowly varying high bytes of the floats compress much better
+static void shuffle( const char* in, char* out, size_t count, int elem_size )
+{
+	for (size_t i = 0; i < count; ++i) {
+		for (int b = 0; b < elem_size; ++b) {
+			out[b * count + i] = in[i * elem_size + b];
+		}
+	}
+}
+
+static void unshuffle( const char* in, char* out, size_t count, int elem_size )
+{
+	for (size_t i = 0; i < count; ++i) {
+		for (int b = 0; b < elem_size; ++b) {
+			out[i * elem_size + b] = in[b * count + i];
+		}
+	}
+}
+
+static void encodeColumn( const Record& record, int channel, uint8_t type, char* out )
+{
+	const int num_vertices = record.getNumVertices();
+	for (int i = 0; i < num_vertices; ++i) {
+		const scalar value = record.values[i * record.num_channels + channel];
+		switch (type) {
+		case CT_F64: {
+			const double v = (double) value;
+			std::memcpy(out + i * 8, &v, 8);
+			break;
+		}
+		case CT_F32: {
+			const float v = (float) value;
+			std::memcpy(out + i * 4, &v, 4);
+			break;
+		}
+		case CT_F16: {
+			const uint16_t v = floatToHalf((float) value);
+			std::memcpy(out + i * 2, &v, 2);
+			break;
+		}
+		case CT_I32: {
+			const int32_t v = (int32_t) value;
+			std::memcpy(out + i * 4, &v, 4);
+			break;
+		}
+		}
+	}
+}
+
+static void decodeColumn( const char* in, uint8_t type, int channel, Record& record )
+{
+	const int num_vertices = record.getNumVertices();
+	for (int i = 0; i < num_vertices; ++i) {
+		scalar& value = record.values[i * record.num_channels + channel];
+		switch (type) {
+		case CT_F64: {
+			double v;
+			std::memcpy(&v, in + i * 8, 8);
+			value = (scalar) v;
+			break;
+		}
+		case CT_F32: {
+			float v;
+			std::memcpy(&v, in + i * 4, 4);
+			value = (scalar) v;
+			break;
+		}
+		case CT_F16: {
+			uint16_t v;
+			std::memcpy(&v, in + i * 2, 2);
+			value = (scalar) halfToFloat(v);
+			break;
+		}
+		case CT_I32: {
+			int32_t v;
+			std::memcpy(&v, in + i * 4, 4);
+			value = (scalar) v;
+			break;
+		}
+		}
+	}
+}
+
+static bool compress( Compression compression, const std::vector<char>& raw, std::vector<char>& stored )
+{
+	switch (compression) {
+#ifdef USE_LZ4
+	case C_LZ4: {
+		if (raw.size() > (size_t) LZ4_MAX_INPUT_SIZE) return false;
+		stored.resize(LZ4_compressBound((int) raw.size()));
+		const int size = LZ4_compress_default(raw.data(), stored.data(), (int) raw.size(), (int) stored.size());
+		if (size <= 0) return false;
+		stored.resize(size);
+		return true;
+	}
+#endif
+#ifdef USE_ZSTD
+	case C_ZSTD: {
+		stored.resize(ZSTD_compressBound(raw.size()));
+		const size_t size = ZSTD_compress(stored.data(), stored.size(), raw.data(), raw.size(), zstd_level);
+		if (ZSTD_isError(size)) return false;
+		stored.resize(size);
+		return true;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+static bool decompress( Compression compression, const std::vector<char>& stored, std::vector<char>& raw )
+{
+	switch (compression) {
+#ifdef USE_LZ4
+	case C_LZ4: {
+		const int size = LZ4_decompress_safe(stored.data(), raw.data(), (int) stored.size(), (int) raw.size());
+		return size == (int) raw.size();
+	}
+#endif
+#ifdef USE_ZSTD
+	case C_ZSTD: {
+		const size_t size = ZSTD_decompress(raw.data(), raw.size(), stored.data(), stored.size());
+		return !ZSTD_isError(size) && size == raw.size();
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+bool write( const std::string& filename, const std::vector<Record>& records, const Options& options )
+{
+	for (const Record& record : records) {
+		if (record.name.size() >= sizeof(RecordHeader::name)) {
+			std::cerr << "Frame record name " << record.name << " is too long." << std::endl;
+			return false;
+		}
+	}
+
+	// written aside and renamed on success, so that no truncated frame is left behind
+	const std::string tmp_filename = filename + ".tmp";
+	std::ofstream ofs(tmp_filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!ofs.good()) {
+		std::cerr << "Failed to open frame " << tmp_filename << " for writing." << std::endl;
+		return false;
+	}
+
+	uint8_t real_type = CT_F64;
+	if (options.precision == 32) real_type = CT_F32;
+	else if (options.precision == 16) real_type = CT_F16;
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.num_records = (uint32_t) records.size();
+	ofs.write((const char*) &header, sizeof(FileHeader));
+
+	std::vector<char> raw;
+	std::vector<char> shuffled;
+	std::vector<char> stored;
+
+	for (const Record& record : records) {
+		RecordHeader rh;
+		std::memset(&rh, 0, sizeof(RecordHeader));
+		std::strncpy(rh.name, record.name.c_str(), sizeof(rh.name) - 1);
+
+		const int num_vertices = record.getNumVertices();
+		rh.num_vertices = num_vertices;
+		rh.num_channels = record.num_channels;
+		rh.arity = record.arity;
+		rh.index_base = record.index_base;
+		rh.num_elements = record.getNumElements();
+
+		std::vector<uint8_t> types(record.num_channels);
+		size_t raw_size = (size_t) rh.num_elements * rh.arity * sizeof(int32_t);
+		for (int c = 0; c < record.num_channels; ++c) {
+			types[c] = record.integer_channels[c] ? (uint8_t) CT_I32 : real_type;
+			raw_size += (size_t) num_vertices * channelSize(types[c]);
+		}
+
+		raw.resize(raw_size);
+		size_t offset = 0;
+		for (int c = 0; c < record.num_channels; ++c) {
+			encodeColumn(record, c, types[c], raw.data() + offset);
+			offset += (size_t) num_vertices * channelSize(types[c]);
+		}
+
+		const size_t num_indices = (size_t) rh.num_elements * rh.arity;
+		if (num_indices) std::memcpy(raw.data() + offset, record.indices.data(), num_indices * sizeof(int32_t));
+
+		// small or incompressible records are stored as they are
+		const std::vector<char>* payload = &raw;
+		rh.compression = C_NONE;
+		if (options.compression != C_NONE) {
+			shuffled.resize(raw_size);
+			offset = 0;
+			for (int c = 0; c < record.num_channels; ++c) {
+				const int size = channelSize(types[c]);
+				shuffle(raw.data() + offset, shuffled.data() + offset, num_vertices, size);
+				offset += (size_t) num_vertices * size;
+			}
+			if (num_indices) shuffle(raw.data() + offset, shuffled.data() + offset, num_indices, sizeof(int32_t));
+
+			if (compress(options.compression, shuffled, stored) && stored.size() < raw.size()) {
+				payload = &stored;
+				rh.compression = options.compression;
+			}
+		}
+
+		rh.raw_size = raw.size();
+		rh.stored_size = payload->size();
+
+		ofs.write((const char*) &rh, sizeof(RecordHeader));
+		if (!types.empty()) ofs.write((const char*) types.data(), types.size());
+		if (!payload->empty()) ofs.write(payload->data(), payload->size());
+	}
+
+	ofs.close();
+	if (!ofs.good()) {
+		std::cerr << "Failed to write frame " << filename << "." << std::endl;
+		std::remove(tmp_filename.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	std::remove(filename.c_str());
+#endif
+	if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		std::cerr << "Failed to move frame " << tmp_filename << " to " << filename << "." << std::endl;
+		std::remove(tmp_filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool read( const std::string& filename, std::vector<Record>& records )
+{
+	records.clear();
+
+	std::ifstream ifs(filename.c_str(), std::ios::binary);
+	if (!ifs.good()) {
+		std::cerr << "Failed to open frame " << filename << "." << std::endl;
+		return false;
+	}
+
+	FileHeader header;
+	ifs.read((char*) &header, sizeof(FileHeader));
+	if (!ifs.good() || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+		std::cerr << filename << " is not a frame file." << std::endl;
+		return false;
+	}
+
+	if (header.version > version) {
+		std::cerr << "Frame " << filename << " has version " << header.version << ", only versions up to " << version << " are supported." << std::endl;
+		return false;
+	}
+
+	std::vector<char> raw;
+	std::vector<char> stored;
+	std::vector<char> column;
+
+	records.resize(header.num_records);
+	for (uint32_t r = 0; r < header.num_records; ++r) {
+		RecordHeader rh;
+		ifs.read((char*) &rh, sizeof(RecordHeader));
+		if (!ifs.good() || rh.num_vertices < 0 || rh.num_channels < 0 || rh.arity < 0 || rh.num_elements < 0) {
+			std::cerr << "Frame " << filename << " is truncated or corrupted." << std::endl;
+			return false;
+		}
+		rh.name[sizeof(rh.name) - 1] = '\0';
+
+		std::vector<uint8_t> types(rh.num_channels);
+		if (rh.num_channels) ifs.read((char*) types.data(), types.size());
+
+		size_t raw_size = (size_t) rh.num_elements * rh.arity * sizeof(int32_t);
+		for (int c = 0; c < rh.num_channels; ++c) {
+			const int size = channelSize(types[c]);
+			if (size == 0) {
+				std::cerr << "Frame " << filename << " has an unknown channel type." << std::endl;
+				return false;
+			}
+			raw_size += (size_t) rh.num_vertices * size;
+		}
+
+		if (raw_size != rh.raw_size || (rh.compression == C_NONE && rh.stored_size != rh.raw_size)) {
+			std::cerr << "Frame " << filename << " is truncated or corrupted." << std::endl;
+			return false;
+		}
+
+		if (!isCompressionAvailable((Compression) rh.compression)) {
+			std::cerr << "Frame " << filename << " is compressed with a method this build does not support." << std::endl;
+			return false;
+		}
+
+		raw.resize(raw_size);
+		if (rh.compression == C_NONE) {
+			if (raw_size) ifs.read(raw.data(), raw_size);
+		} else {
+			stored.resize(rh.stored_size);
+			if (rh.stored_size) ifs.read(stored.data(), stored.size());
+			if (!ifs.good() || !decompress((Compression) rh.compression, stored, raw)) {
+				std::cerr << "Frame " << filename << " failed to decompress." << std::endl;
+				return false;
+			}
+		}
+
+		if (!ifs.good()) {
+			std::cerr << "Frame " << filename << " is truncated." << std::endl;
+			return false;
+		}
+
+		Record& record = records[r];
+		record.name = rh.name;
+		record.num_channels = rh.num_channels;
+		record.integer_channels.resize(rh.num_channels);
+		record.values.resize((size_t) rh.num_vertices * rh.num_channels);
+		record.arity = rh.arity;
+		record.index_base = rh.index_base;
+		record.indices.resize((size_t) rh.num_elements * rh.arity);
+
+		const bool shuffled = rh.compression != C_NONE;
+
+		size_t offset = 0;
+		for (int c = 0; c < rh.num_channels; ++c) {
+			const int size = channelSize(types[c]);
+			record.integer_channels[c] = types[c] == CT_I32;
+			if (shuffled) {
+				column.resize((size_t) rh.num_vertices * size);
+				unshuffle(raw.data() + offset, column.data(), rh.num_vertices, size);
+				decodeColumn(column.data(), types[c], c, record);
+			} else {
+				decodeColumn(raw.data() + offset, types[c], c, record);
+			}
+			offset += (size_t) rh.num_vertices * size;
+		}
+
+		if (!record.indices.empty()) {
+			if (shuffled) {
+				unshuffle(raw.data() + offset, (char*) record.indices.data(), record.indices.size(), sizeof(int32_t));
+			} else {
+				std::memcpy(record.indices.data(), raw.data() + offset, record.indices.size() * sizeof(int32_t));
+			}
+		}
+	}
+
+	return true;
+}
+
+bool writeOBJ( const std::string& filename, const Record& record )
+{
+	std::ofstream ofs(filename.c_str());
+	if (!ofs.good()) {
+		std::cerr << "Failed to open " << filename << " for writing." << std::endl;
+		return false;
+	}
+
+	ofs << std::setprecision(8);
+
+	const int num_vertices = record.getNumVertices();
+	for (int i = 0; i < num_vertices; ++i) {
+		ofs << "v";
+		for (int c = 0; c < record.num_channels; ++c) {
+			const scalar value = record.values[i * record.num_channels + c];
+			if (record.integer_channels[c]) ofs << " " << (int) value;
+			else ofs << " " << value;
+		}
+		ofs << "\n";
+	}
+
+	const char* element = record.arity == 2 ? "l" : "f";
+	const int num_elements = record.getNumElements();
+	for (int i = 0; i < num_elements; ++i) {
+		ofs << element;
+		for (int k = 0; k < record.arity; ++k) {
+			ofs << " " << (record.indices[i * record.arity + k] + record.index_base);
+		}
+		ofs << "\n";
+	}
+
+	ofs.close();
+	return !ofs.fail();
+}
+}
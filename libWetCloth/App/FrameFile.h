@@ -0,0 +1,112 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef FRAME_FILE_H
+#define FRAME_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "MathDefs.h"
+
+// Binary format of the frames written by the serializer, one file per frame
+// holding every mesh and point set of the scene:
+//
+//   FileHeader
+//   per record: RecordHeader, one type byte per channel, payload
+//
+// The payload stores the vertex attributes column by column, followed by
+// the element indices. Real columns may be narrowed to 32 or 16-bit floats,
+// and the payload may be byte-shuffled and compressed with LZ4 or zstd,
+// when the build has found them.
+namespace framefile
+{
+const uint32_t version = 1;
+
+enum Compression
+{
+	C_NONE = 0,
+	C_LZ4 = 1,
+	C_ZSTD = 2
+};
+
+enum ChannelType
+{
+	CT_F64 = 0,
+	CT_F32 = 1,
+	CT_F16 = 2,
+	CT_I32 = 3
+};
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t num_records;
+};
+
+struct RecordHeader
+{
+	char name[16];
+	int32_t num_vertices;
+	int32_t num_channels;
+	int32_t arity; // vertices per element, 2 for lines and 3 for faces
+	int32_t index_base; // added to the indices in OBJ files
+	int32_t num_elements;
+	uint32_t compression;
+	uint64_t raw_size;
+	uint64_t stored_size;
+};
+
+struct Options
+{
+	Options();
+
+	int precision; // bits of the real channels: 64, 32 or 16
+	Compression compression;
+};
+
+// A mesh or point set with num_channels attributes per vertex, stored row
+// by row in values. The first three channels are the positions.
+struct Record
+{
+	Record();
+	Record( const std::string& name, int num_channels, int arity, int index_base );
+
+	int getNumVertices() const;
+	int getNumElements() const;
+
+	std::string name;
+	int num_channels;
+	std::vector<bool> integer_channels;
+	std::vector<scalar> values;
+
+	int arity;
+	int index_base;
+	std::vector<int> indices;
+};
+
+bool write( const std::string& filename, const std::vector<Record>& records, const Options& options );
+
+bool read( const std::string& filename, std::vector<Record>& records );
+
+// same text as the OBJ files of the serializer
+bool writeOBJ( const std::string& filename, const Record& record );
+
+bool parseCompression( const std::string& str, Compression& compression );
+
+bool isCompressionAvailable( Compression compression );
+
+uint16_t floatToHalf( float f );
+
+float halfToFloat( uint16_t h );
+}
+
+#endif
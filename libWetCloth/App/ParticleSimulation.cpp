@@ -8,32 +8,13 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "ParticleSimulation.h"
-#include "TimingUtilities.h"
+#include "Profiler.h"
 #include "MemUtilities.h"
 
 #ifdef RENDER_ENABLED
 #include <AntTweakBar.h>
 #endif
 
-const static char* g_timing_labels[] = {
-    "Sample, Merge and Split Particles",
-    "Build Sparse MAC Grid",
-    "Compute Weight, Solid Stress, and Distance Field",
-    "APIC Particle/Vertex-to-Grid Transfer",
-    "Force Integration and Velocity Prediction",
-    "Solve Poisson Equation",
-    "Solve Solid Velocity",
-    "Solve Liquid Velocity",
-    "Particle Correction",
-    "APIC Grid-to-Particle/Vertex Transfer",
-    "Particle/Vertex Advection",
-    "Liquid Capturing",
-    "Liquid Dripping",
-    "Solve Quasi-Static Equation",
-    "Update Deformation Gradient and Plasticity"
-};
-const static int num_timing_labels = sizeof(g_timing_labels) / sizeof(const char*);
-
 ParticleSimulation::ParticleSimulation( const std::shared_ptr<TwoDScene>& scene, const std::shared_ptr<SceneStepper>& scene_stepper, const std::shared_ptr<TwoDSceneRenderer>& scene_renderer )
     : m_core(std::make_shared<WetClothCore>( scene, scene_stepper ))
     , m_scene_renderer(scene_renderer)
@@ -49,21 +30,16 @@ int ParticleSimulation::currentCameraIndex() const
     return m_display_controller->currentCameraIndex();
 }
 
-void ParticleSimulation::stepSystem(const scalar &dt)
+bool ParticleSimulation::stepSystem(const scalar &dt)
 {
-    m_core->stepSystem(dt);
-
-    const std::vector<scalar>& timing_buffer = m_core->getTimingStatistics();
+    if (!m_core->stepSystem(dt)) return false;
 
-    scalar total_time = 0.0;
-    for (scalar t : timing_buffer) total_time += t;
+    const profiler::Profiler& prof = profiler::Profiler::instance();
+    const scalar total_time = prof.getTotalTime("stepSystem");
 
     std::cout << "---------------------------------" << std::endl;
-    for (int i = 0; i < num_timing_labels; ++i) {
-        scalar avg_time = (timing_buffer[i] / (scalar) (m_core->getCurrentTime() + 1));
-        scalar prop = timing_buffer[i] / total_time * 100.0;
-        std::cout << g_timing_labels[i] << ", " << avg_time << ", " << prop << "%" << std::endl;
-    }
+    std::cout << "Phase, Last Frame, Avg. (per Frame), Proportion" << std::endl;
+    prof.printSummary(std::cout);
 
     const scalar divisor = (scalar) (m_core->getCurrentTime() + 1);
 
@@ -94,6 +70,13 @@ void ParticleSimulation::stepSystem(const scalar &dt)
     std::cout << "Peak Mem Usage, " << peak_mem << mem_units[peak_idx] << ", Avg Mem Usage, " << avg_mem << mem_units[cur_idx] << std::endl;
 
     std::cout << "---------------------------------" << std::endl;
+
+    return true;
+}
+
+void ParticleSimulation::setTimestepController( const std::shared_ptr<TimestepController>& controller )
+{
+    m_core->setTimestepController(controller);
 }
 
 void ParticleSimulation::initializeOpenGLRenderer() {
@@ -268,6 +251,29 @@ void ParticleSimulation::readPos( const std::string& fn_pos )
     ifs.close();
 }
 
+bool ParticleSimulation::saveCheckpoint( const std::string& fn_checkpoint )
+{
+    return m_core->saveCheckpoint(fn_checkpoint);
+}
+
+bool ParticleSimulation::loadCheckpoint( const std::string& fn_checkpoint )
+{
+    if (!m_core->loadCheckpoint(fn_checkpoint)) return false;
+
+    if (m_scene_renderer) m_scene_renderer->updateParticleSimulationState(*m_core->getScene());
+    return true;
+}
+
+int ParticleSimulation::getCurrentStep() const
+{
+    return m_core->getCurrentTime();
+}
+
+const std::shared_ptr<WetClothCore>& ParticleSimulation::getCore() const
+{
+    return m_core;
+}
+
 void ParticleSimulation::serializePositionOnly( const std::string& fn_pos )
 {
     m_scene_serializer.serializePositionOnly(*m_core->getScene(), fn_pos);
@@ -282,6 +288,16 @@ void ParticleSimulation::serializeScene(const std::string& fn_clothes,
     m_scene_serializer.serializeScene( *m_core->getScene(), fn_clothes, fn_hairs, fn_fluid, fn_internal_boundaries, fn_external_boundaries, fn_spring );
 }
 
+void ParticleSimulation::serializeFrame( const std::string& fn_frame, const framefile::Options& options )
+{
+    m_scene_serializer.serializeFrame( *m_core->getScene(), fn_frame, options );
+}
+
+void ParticleSimulation::setSerializeQueueCapacity( int capacity )
+{
+    m_scene_serializer.setQueueCapacity(capacity);
+}
+
 void ParticleSimulation::centerCamera(bool b_reshape)
 {
     renderingutils::Viewport view;
@@ -30,7 +30,9 @@ public:
 	/////////////////////////////////////////////////////////////////////////////
 	// Simulation Control Functions
 
-	void stepSystem( const scalar& dt );
+	bool stepSystem( const scalar& dt );
+
+	void setTimestepController( const std::shared_ptr<TimestepController>& controller );
 
 	/////////////////////////////////////////////////////////////////////////////
 	// Rendering Functions
@@ -50,9 +52,22 @@ public:
 	                     const std::string& fn_external_boundaries,
 	                     const std::string& fn_spring);
 
+	void serializeFrame( const std::string& fn_frame, const framefile::Options& options );
+
+	void setSerializeQueueCapacity( int capacity );
+
 	void serializePositionOnly( const std::string& fn_pos );
 
 	void readPos( const std::string& fn_pos );
+
+	bool saveCheckpoint( const std::string& fn_checkpoint );
+
+	bool loadCheckpoint( const std::string& fn_checkpoint );
+
+	int getCurrentStep() const;
+
+	// the simulation alone, to step it without the per-frame report
+	const std::shared_ptr<WetClothCore>& getCore() const;
 	/////////////////////////////////////////////////////////////////////////////
 	// Status Functions
 
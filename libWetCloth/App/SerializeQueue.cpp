@@ -0,0 +1,86 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "SerializeQueue.h"
+
+#include <algorithm>
+
+SerializeQueue::SerializeQueue( int capacity )
+	: m_capacity(std::max(1, capacity))
+	, m_busy(false)
+	, m_stop(false)
+{}
+
+SerializeQueue::~SerializeQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_job_pushed.notify_all();
+
+	if (m_thread.joinable()) m_thread.join();
+}
+
+void SerializeQueue::push( const std::function<void()>& job )
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_job_done.wait(lock, [&] { return (int) m_jobs.size() < m_capacity; });
+
+	m_jobs.push_back(job);
+	if (!m_thread.joinable()) m_thread = std::thread(&SerializeQueue::run, this);
+
+	lock.unlock();
+	m_job_pushed.notify_one();
+}
+
+void SerializeQueue::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_job_done.wait(lock, [&] { return m_jobs.empty() && !m_busy; });
+}
+
+void SerializeQueue::setCapacity( int capacity )
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = std::max(1, capacity);
+	}
+	m_job_done.notify_all();
+}
+
+int SerializeQueue::getCapacity() const
+{
+	return m_capacity;
+}
+
+void SerializeQueue::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true) {
+		m_job_pushed.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+
+		// the jobs left at a stop are still run
+		if (m_jobs.empty()) break;
+
+		std::function<void()> job = m_jobs.front();
+		m_jobs.pop_front();
+		m_busy = true;
+
+		lock.unlock();
+		m_job_done.notify_all();
+		job();
+		lock.lock();
+
+		m_busy = false;
+		m_job_done.notify_all();
+	}
+}
@@ -0,0 +1,59 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef SERIALIZE_QUEUE_H
+#define SERIALIZE_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs the jobs of the serializer in order on a single writer thread. At
+// most capacity jobs wait to be run; push() blocks while the queue is full,
+// so a simulation running ahead of the disk is held back instead of piling
+// up frames in memory.
+class SerializeQueue
+{
+public:
+	explicit SerializeQueue( int capacity = 2 );
+
+	// finishes the queued jobs
+	~SerializeQueue();
+
+	void push( const std::function<void()>& job );
+
+	// waits until the queued jobs are done
+	void flush();
+
+	void setCapacity( int capacity );
+
+	int getCapacity() const;
+
+	SerializeQueue( const SerializeQueue& ) = delete;
+	SerializeQueue& operator=( const SerializeQueue& ) = delete;
+
+private:
+	void run();
+
+	std::deque< std::function<void()> > m_jobs;
+	int m_capacity;
+	bool m_busy;
+	bool m_stop;
+
+	std::mutex m_mutex;
+	std::condition_variable m_job_pushed;
+	std::condition_variable m_job_done;
+
+	// started with the first job
+	std::thread m_thread;
+};
+
+#endif
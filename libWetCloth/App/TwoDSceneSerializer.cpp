@@ -11,7 +11,6 @@
 #include "AttachForce.h"
 #include <igl/boundary_loop.h>
 #include <fstream>
-#include <iomanip>
 #include <numeric>
 
 const int num_cloth_edge_discretization = 6;
@@ -33,88 +32,120 @@ void serialize_pos_subprog( SerializePosPacket* packet )
     delete packet;
 }
 
-void serialize_subprog( SerializePacket* packet )
+static void make_frame_records( const SerializePacket* packet, std::vector<framefile::Record>& records )
 {
-    std::ofstream ofs_fluid(packet->fn_fluid.c_str());
-    const int num_fp = packet->m_fluid_vertices.size();
-    for (int i = 0; i < num_fp; ++i)
+    records.clear();
+
+    framefile::Record cloth("cloth", 12, 3, 1);
+    cloth.integer_channels[4] = true;
+    cloth.integer_channels[5] = true;
+    const int num_cloth_vtx = packet->m_dbl_face_cloth_vertices.size();
+    cloth.values.resize(num_cloth_vtx * cloth.num_channels);
+    for (int i = 0; i < num_cloth_vtx; ++i)
     {
-        ofs_fluid << "v " << std::setprecision(8) << packet->m_fluid_vertices[i](0) << " " << packet->m_fluid_vertices[i](1) << " " << packet->m_fluid_vertices[i](2) << " " << packet->m_fluid_radii[i] << std::endl;
+        scalar* v = &cloth.values[i * cloth.num_channels];
+        Vector3s::Map(v) = packet->m_dbl_face_cloth_vertices[i];
+        v[3] = packet->m_dbl_face_cloth_sat[i];
+        v[4] = packet->m_dbl_face_cloth_dir[i];
+        v[5] = packet->m_dbl_face_cloth_group[i];
+        Vector3s::Map(v + 6) = packet->m_dbl_face_cloth_vertices_rest[i];
+        Vector3s::Map(v + 9) = packet->m_dbl_face_cloth_vertices_central[i];
     }
+    for (auto& f : packet->m_dbl_face_cloth_indices)
+    {
+        cloth.indices.insert(cloth.indices.end(), f.data(), f.data() + 3);
+    }
+    records.push_back(cloth);
 
-    std::ofstream ofs_hair(packet->fn_hairs.c_str());
+    framefile::Record hair("hair", 10, 2, 1);
+    hair.integer_channels[6] = true;
     const int num_hair_vtx = packet->m_hair_vertices.size();
+    hair.values.resize(num_hair_vtx * hair.num_channels);
     for (int i = 0; i < num_hair_vtx; ++i)
     {
-        ofs_hair << "v " << std::setprecision(8) << packet->m_hair_vertices[i](0) << " " << packet->m_hair_vertices[i](1) << " " << packet->m_hair_vertices[i](2) << " " << packet->m_hair_radii[i](0) << " " << packet->m_hair_radii[i](1) << " " << packet->m_hair_sat[i] << " " << packet->m_hair_group[i] << " " << packet->m_hair_vertices_rest[i](0) << " " << packet->m_hair_vertices_rest[i](1) << " " << packet->m_hair_vertices_rest[i](2) << std::endl;
+        scalar* v = &hair.values[i * hair.num_channels];
+        Vector3s::Map(v) = packet->m_hair_vertices[i];
+        v[3] = packet->m_hair_radii[i](0);
+        v[4] = packet->m_hair_radii[i](1);
+        v[5] = packet->m_hair_sat[i];
+        v[6] = packet->m_hair_group[i];
+        Vector3s::Map(v + 7) = packet->m_hair_vertices_rest[i];
     }
     for (auto& e : packet->m_hair_indices)
     {
-        ofs_hair << "l " << (e(0) + 1) << " " << (e(1) + 1) << std::endl;
-    }
-
-
-    std::ofstream ofs_cloth(packet->fn_clothes.c_str());
-    const int num_cloth_vtx = packet->m_dbl_face_cloth_vertices.size();
-    for (int i = 0; i < num_cloth_vtx; ++i)
-    {
-        ofs_cloth << "v " << std::setprecision(8) << packet->m_dbl_face_cloth_vertices[i](0) << " " << packet->m_dbl_face_cloth_vertices[i](1) << " " << packet->m_dbl_face_cloth_vertices[i](2) << " "
-                  << packet->m_dbl_face_cloth_sat[i] << " " << packet->m_dbl_face_cloth_dir[i] << " " << packet->m_dbl_face_cloth_group[i] << " " << packet->m_dbl_face_cloth_vertices_rest[i](0) << " " << packet->m_dbl_face_cloth_vertices_rest[i](1) << " " << packet->m_dbl_face_cloth_vertices_rest[i](2) << " " << packet->m_dbl_face_cloth_vertices_central[i](0) << " " << packet->m_dbl_face_cloth_vertices_central[i](1) << " " << packet->m_dbl_face_cloth_vertices_central[i](2) << std::endl;
+        hair.indices.insert(hair.indices.end(), e.data(), e.data() + 2);
     }
+    records.push_back(hair);
 
-    for (auto& f : packet->m_dbl_face_cloth_indices)
+    framefile::Record fluid("fluid", 4, 0, 1);
+    const int num_fp = packet->m_fluid_vertices.size();
+    fluid.values.resize(num_fp * fluid.num_channels);
+    for (int i = 0; i < num_fp; ++i)
     {
-        ofs_cloth << "f " << (f(0) + 1) << " " << (f(1) + 1) << " " << (f(2) + 1) << std::endl;
+        scalar* v = &fluid.values[i * fluid.num_channels];
+        Vector3s::Map(v) = packet->m_fluid_vertices[i];
+        v[3] = packet->m_fluid_radii[i];
     }
+    records.push_back(fluid);
 
-
-    std::ofstream ofs_internal(packet->fn_internal_boundaries.c_str());
+    framefile::Record internal("internal", 3, 3, 1);
     for (auto& v : packet->m_internal_vertices)
     {
-        ofs_internal << "v " << std::setprecision(8) << v(0) << " " << v(1) << " " << v(2) << std::endl;
+        internal.values.insert(internal.values.end(), v.data(), v.data() + 3);
     }
     for (auto& f : packet->m_internal_indices)
     {
-        ofs_internal << "f " << (f(0) + 1) << " " << (f(1) + 1) << " " << (f(2) + 1) << std::endl;
+        internal.indices.insert(internal.indices.end(), f.data(), f.data() + 3);
     }
+    records.push_back(internal);
 
-
-    std::ofstream ofs_external(packet->fn_external_boundaries.c_str());
+    framefile::Record external("external", 3, 3, 1);
     for (auto& v : packet->m_external_vertices)
     {
-        ofs_external << "v " << std::setprecision(8) << v(0) << " " << v(1) << " " << v(2) << std::endl;
+        external.values.insert(external.values.end(), v.data(), v.data() + 3);
     }
     for (auto& f : packet->m_external_indices)
     {
-        ofs_external << "f " << (f(0) + 1) << " " << (f(1) + 1) << " " << (f(2) + 1) << std::endl;
+        external.indices.insert(external.indices.end(), f.data(), f.data() + 3);
     }
+    records.push_back(external);
 
-    std::ofstream ofs_spring(packet->fn_springs.c_str());
+    // the spring lines have always been written with zero-based indices
+    framefile::Record spring("spring", 3, 2, 0);
     for (auto& v : packet->m_attach_spring_vertices)
     {
-        ofs_spring << "v " << std::setprecision(8) << v(0) << " " << v(1) << " " << v(2) << std::endl;
+        spring.values.insert(spring.values.end(), v.data(), v.data() + 3);
     }
     const int num_springs = packet->m_attach_spring_vertices.size() / 2;
     for (int i = 0; i < num_springs; ++i)
     {
-        ofs_spring << "l " << (i * 2) << " " << (i * 2 + 1) << std::endl;
+        spring.indices.push_back(i * 2);
+        spring.indices.push_back(i * 2 + 1);
     }
+    records.push_back(spring);
+}
 
-    ofs_fluid.flush();
-    ofs_hair.flush();
-    ofs_cloth.flush();
-    ofs_internal.flush();
-    ofs_external.flush();
-    ofs_spring.flush();
+void serialize_subprog( SerializePacket* packet )
+{
+    std::vector<framefile::Record> records;
+    make_frame_records(packet, records);
 
-    ofs_fluid.close();
-    ofs_hair.close();
-    ofs_cloth.close();
-    ofs_internal.close();
-    ofs_external.close();
-    ofs_spring.close();
+    if (!packet->fn_frame.empty())
+    {
+        framefile::write(packet->fn_frame, records, packet->frame_options);
 
-    std::cout << "[Frame with " << packet->fn_fluid << " written]" << std::endl;
+        std::cout << "[Frame " << packet->fn_frame << " written]" << std::endl;
+    }
+    else
+    {
+        const std::string* filenames[] = { &packet->fn_clothes, &packet->fn_hairs, &packet->fn_fluid, &packet->fn_internal_boundaries, &packet->fn_external_boundaries, &packet->fn_springs };
+        for (int i = 0; i < (int) records.size(); ++i)
+        {
+            framefile::writeOBJ(*filenames[i], records[i]);
+        }
+
+        std::cout << "[Frame with " << packet->fn_fluid << " written]" << std::endl;
+    }
 
     delete packet;
 }
@@ -142,8 +173,25 @@ void TwoDSceneSerializer::serializeScene( TwoDScene& scene,
     data->fn_internal_boundaries = fn_internal_boundaries.c_str();
     data->fn_springs = fn_springs.c_str();
 
-    std::thread t(std::bind(serialize_subprog, data));
-    t.detach();
+    m_queue.push(std::bind(serialize_subprog, data));
+}
+
+void TwoDSceneSerializer::serializeFrame( TwoDScene& scene,
+        const std::string& fn_frame,
+        const framefile::Options& options )
+{
+    SerializePacket* data = new SerializePacket;
+
+    updateDoubleFaceCloth(scene, data);
+    updateHairs(scene, data);
+    updateFluid(scene, data);
+    updateMesh(scene, data);
+    updateAttachSprings(scene, data);
+
+    data->fn_frame = fn_frame;
+    data->frame_options = options;
+
+    m_queue.push(std::bind(serialize_subprog, data));
 }
 
 void TwoDSceneSerializer::serializePositionOnly( TwoDScene& scene, const std::string& fn_pos )
@@ -153,8 +201,7 @@ void TwoDSceneSerializer::serializePositionOnly( TwoDScene& scene, const std::st
     data->m_pos = scene.getX();
     data->m_d_gauss = scene.getGaussd();
 
-    std::thread t(std::bind(serialize_pos_subprog, data));
-    t.detach();
+    m_queue.push(std::bind(serialize_pos_subprog, data));
 }
 
 void TwoDSceneSerializer::loadPosOnly( TwoDScene& scene, std::ifstream& inputstream )
@@ -304,6 +351,16 @@ void TwoDSceneSerializer::initializeFaceLoops(const TwoDScene& scene)
     igl::boundary_loop(faces, m_face_loops);
 }
 
+void TwoDSceneSerializer::setQueueCapacity( int capacity )
+{
+    m_queue.setCapacity(capacity);
+}
+
+void TwoDSceneSerializer::flush()
+{
+    m_queue.flush();
+}
+
 void TwoDSceneSerializer::updateAttachSprings(const TwoDScene& scene, SerializePacket* data)
 {
     const VectorXs& x = scene.getX();
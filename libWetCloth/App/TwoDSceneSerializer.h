@@ -15,6 +15,8 @@
 
 #include "TwoDScene.h"
 #include "StringUtilities.h"
+#include "FrameFile.h"
+#include "SerializeQueue.h"
 
 struct SerializePosPacket
 {
@@ -31,6 +33,8 @@ struct SerializePacket
     std::string fn_internal_boundaries;
     std::string fn_external_boundaries;
     std::string fn_springs;
+    std::string fn_frame;
+    framefile::Options frame_options;
 
     std::vector< Vector3i > m_dbl_face_cloth_indices;
     std::vector< Vector3s > m_dbl_face_cloth_vertices;
@@ -64,6 +68,7 @@ struct SerializePacket
 class TwoDSceneSerializer
 {
     std::vector< std::vector<int> > m_face_loops;
+    SerializeQueue m_queue;
 public:
     void serializeScene( TwoDScene& scene,
                          const std::string& fn_clothes,
@@ -73,6 +78,11 @@ public:
                          const std::string& fn_external_boundaries,
                          const std::string& fn_springs);
 
+    // all the meshes of the frame in one file of the binary frame format
+    void serializeFrame( TwoDScene& scene,
+                         const std::string& fn_frame,
+                         const framefile::Options& options );
+
     void serializePositionOnly( TwoDScene& scene,
                                 const std::string& fn_pos );
 
@@ -80,6 +90,12 @@ public:
 
     void initializeFaceLoops(const TwoDScene& scene);
 
+    // frames that may wait to be written before serializing blocks
+    void setQueueCapacity( int capacity );
+
+    // waits until the queued frames are written
+    void flush();
+
     void updateDoubleFaceCloth(const TwoDScene& scene, SerializePacket* data);
     void updateHairs(const TwoDScene& scene, SerializePacket* data);
     void updateFluid(const TwoDScene& scene, SerializePacket* data);
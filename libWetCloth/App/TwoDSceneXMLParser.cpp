@@ -590,6 +590,7 @@ void TwoDSceneXMLParser::loadParticleSimulation(bool rendering_enabled, std::sha
 
 	scene->updateSolidPhi();
 	scene->updateSolidWeights();
+	scene->updateElementBVH();
 	scene->updateLiquidPhi(0.0);
 	scene->updateIntersection();
 	scene->mapParticleNodesAPIC();
@@ -619,6 +620,10 @@ void TwoDSceneXMLParser::loadParticleSimulation(bool rendering_enabled, std::sha
 
 	execsim = std::make_shared< ParticleSimulation >(scene, scene_stepper, scene_renderer);
 
+	std::shared_ptr<TimestepController> timestep_controller;
+	loadTimestepController( node, timestep_controller );
+	if ( timestep_controller ) execsim->setTimestepController(timestep_controller);
+
 	if (!input_bin.empty())
 	{
 		execsim->readPos(input_bin);
@@ -1648,6 +1653,17 @@ void TwoDSceneXMLParser::loadLiquidInfo(rapidxml::xml_node<>* node, const std::s
 	info.use_group_precondition = false;
 	info.use_lagrangian_mpm = false;
 	info.use_cosolve_angular = false;
+	info.use_scatter_p2g = true;
+	info.use_geometric_mg = false;
+	info.use_warm_start = true;
+	info.use_mixed_precision_pressure = false;
+	info.use_mixed_precision_elasto = false;
+	info.use_pipelined_pcg = false;
+	info.use_parallel_viscosity_precondition = false;
+	info.use_strand_batch = true;
+	info.particle_reorder_interval = 0;
+	info.elasto_subcycles = 1;
+	info.elasto_subcycle_tolerance = 0.05;
 	info.levelset_thickness = 0.25;
 	info.iteration_print_step = 0;
 	info.elasto_capture_rate = 1.0;
@@ -1767,6 +1783,116 @@ void TwoDSceneXMLParser::loadLiquidInfo(rapidxml::xml_node<>* node, const std::s
 			}
 		}
 
+		if ( ( subnd = nd->first_node("useScatterP2G") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_scatter_p2g) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useScatterP2G attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useGeometricMG") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_geometric_mg) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useGeometricMG attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useWarmStart") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_warm_start) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useWarmStart attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useMixedPrecisionPressure") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_mixed_precision_pressure) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useMixedPrecisionPressure attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useMixedPrecisionElasto") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_mixed_precision_elasto) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useMixedPrecisionElasto attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("usePipelinedPCG") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_pipelined_pcg) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of usePipelinedPCG attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useParallelViscosityPrecondition") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_parallel_viscosity_precondition) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useParallelViscosityPrecondition attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("useStrandBatch") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.use_strand_batch) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of useStrandBatch attribute for LiquidInfo. Value must be boolean. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("particleReorderInterval") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.particle_reorder_interval) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of particleReorderInterval attribute for LiquidInfo. Value must be integer. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("elastoSubcycles") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.elasto_subcycles) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of elastoSubcycles attribute for LiquidInfo. Value must be integer. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		if ( ( subnd = nd->first_node("elastoSubcycleTolerance") ) )
+		{
+			std::string attribute( subnd->first_attribute("value")->value() );
+			if ( !stringutils::extractFromString(attribute, info.elasto_subcycle_tolerance) )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse value of elastoSubcycleTolerance attribute for LiquidInfo. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
 		if ( ( subnd = nd->first_node("initNonuniformFraction") ) )
 		{
 			std::string attribute( subnd->first_attribute("value")->value() );
@@ -2198,6 +2324,24 @@ void TwoDSceneXMLParser::loadLiquidInfo(rapidxml::xml_node<>* node, const std::s
 				exit(1);
 			}
 		}
+
+		// the pipelined PCG only replaces the diagonal PCG of the separate linear solve
+		if ( info.use_pipelined_pcg )
+		{
+			if ( info.use_cosolve_angular )
+			{
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " usePipelinedPCG cannot be combined with useCosolveAngular. Exiting." << std::endl;
+				exit(1);
+			}
+
+			if ( info.use_amgpcg_solid )
+				std::cerr << "WARNING: usePipelinedPCG is ignored, as useAMGPCGSolid is set." << std::endl;
+			else if ( nd->first_node("usePCR") && info.use_pcr )
+				std::cerr << "WARNING: usePCR is ignored, as usePipelinedPCG is set." << std::endl;
+
+			if ( info.use_group_precondition && !info.use_amgpcg_solid )
+				std::cerr << "WARNING: useGroupPrecondition is ignored by the pipelined PCG, which preconditions with the diagonal only." << std::endl;
+		}
 	}
 
 	twodscene->setLiquidInfo(info);
@@ -2812,6 +2956,111 @@ void TwoDSceneXMLParser::loadIntegrator( rapidxml::xml_node<>* node, std::shared
 	//std::cout << "Integrator: " << (*scenestepper)->getName() << "   dt: " << dt << std::endl;
 }
 
+void TwoDSceneXMLParser::loadTimestepController( rapidxml::xml_node<>* node, std::shared_ptr<TimestepController>& controller )
+{
+	assert( node != NULL );
+
+	// Without the node the sub-steps are bounded by the CFL condition only
+	rapidxml::xml_node<>* nd = node->first_node("timestepcontroller");
+	if ( nd == NULL ) return;
+
+	rapidxml::xml_attribute<>* typend = nd->first_attribute("type");
+	if ( typend == NULL )
+	{
+		std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " No timestepcontroller 'type' attribute specified. Exiting." << std::endl;
+		exit(1);
+	}
+	std::string controllertype(typend->value());
+
+	if ( controllertype == "cfl" ) {
+		controller = std::make_shared< CFLTimestepController >();
+	}
+	else if ( controllertype == "adaptive" ) {
+		rapidxml::xml_attribute<>* subnd;
+
+		AdaptiveTimestepController::Parameters params;
+
+		subnd = nd->first_attribute("elastocfl");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.elasto_cfl)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'elastocfl' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("fluidcfl");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.fluid_cfl)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'fluidcfl' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("maxdt");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.max_dt)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'maxdt' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("maxgrowth");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.max_growth)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'maxgrowth' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("rejecterror");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.reject_error)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'rejecterror' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("targetiterations");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.target_iterations)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'targetiterations' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("targetdivergence");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.target_divergence_ratio)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'targetdivergence' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("targetdeformation");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.target_deformation_change)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'targetdeformation' attribute for timestepcontroller. Value must be numeric. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		subnd = nd->first_attribute("maxrejects");
+		if ( subnd ) {
+			if ( !stringutils::extractFromString(std::string(subnd->value()), params.max_rejects)) {
+				std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Failed to parse 'maxrejects' attribute for timestepcontroller. Value must be integer. Exiting." << std::endl;
+				exit(1);
+			}
+		}
+
+		controller = std::make_shared< AdaptiveTimestepController >(params);
+	}
+	else
+	{
+		std::cerr << outputmod::startred << "ERROR IN XMLSCENEPARSER:" << outputmod::endred << " Invalid timestepcontroller 'type' attribute specified. Exiting." << std::endl;
+		exit(1);
+	}
+}
+
 void TwoDSceneXMLParser::loadMaxTime( rapidxml::xml_node<>* node, scalar& max_t )
 {
 	assert( node != NULL );
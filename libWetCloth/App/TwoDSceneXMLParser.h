@@ -21,6 +21,7 @@
 #include "TwoDScene.h"
 
 #include "LinearizedImplicitEuler.h"
+#include "TimestepController.h"
 #include "LevelSetForce.h"
 
 #include "SpringForce.h"
@@ -95,6 +96,8 @@ private:
 
 	void loadIntegrator( rapidxml::xml_node<>* node, std::shared_ptr<SceneStepper>& scenestepper, scalar& dt );
 
+	void loadTimestepController( rapidxml::xml_node<>* node, std::shared_ptr<TimestepController>& controller );
+
 	void loadScripts( rapidxml::xml_node<>* node, const std::shared_ptr<TwoDScene>& twodscene );
 
 	bool loadCamera( rapidxml::xml_node<>* node, Camera& camera );
@@ -37,6 +37,7 @@
 #include "StringUtilities.h"
 #include "MathDefs.h"
 #include "TimingUtilities.h"
+#include "Profiler.h"
 #include "Camera.h"
 
 #ifdef RENDER_ENABLED
@@ -82,6 +83,12 @@ int g_save_to_binary = 0;
 std::string g_binary_file_name;
 std::ofstream g_binary_output;
 std::string g_short_file_name;
+int g_dump_profile = 0;
+int g_save_checkpoint = 0;
+std::string g_checkpoint_file_name;
+bool g_binary_frames = false;
+framefile::Options g_frame_options;
+int g_output_queue = 2;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -101,7 +108,10 @@ void dumpPNG(const std::string &filename);
 
 void stepSystem()
 {
-	g_executable_simulation->stepSystem(g_dt);
+	if (!g_executable_simulation->stepSystem(g_dt)) {
+		std::cerr << outputmod::startred << "ERROR IN SIMULATION:" << outputmod::endred << " Failed to step frame " << g_current_step << ". Exiting." << std::endl;
+		exit(1);
+	}
 	g_current_step++;
 
 	// Execute the user-customized output callback
@@ -444,6 +454,19 @@ void loadScene( const std::string& file_name )
 	g_num_steps = ceil(max_time / g_dt);
 	// We begin at the 0th timestep
 	g_current_step = 0;
+
+	// Or where the checkpoint left off
+	if ( !g_checkpoint_file_name.empty() )
+	{
+		if ( !g_executable_simulation->loadCheckpoint(g_checkpoint_file_name) )
+		{
+			std::cerr << outputmod::startred << "ERROR IN LOADING CHECKPOINT:" << outputmod::endred << " Failed to restore " << g_checkpoint_file_name << ". Exiting." << std::endl;
+			exit(1);
+		}
+
+		g_current_step = g_executable_simulation->getCurrentStep();
+		std::cout << "Restarted from " << g_checkpoint_file_name << " at step " << g_current_step << std::endl;
+	}
 }
 
 void parseCommandLine( int argc, char** argv )
@@ -470,6 +493,18 @@ void parseCommandLine( int argc, char** argv )
 		// File to load for comparisons
 		TCLAP::ValueArg<std::string> input("i", "inputfile", "Binary file to load simulation pos from", false, "", "string", cmd);
 
+		// Dump per-phase timings and solver statistics
+		TCLAP::ValueArg<int> profile("f", "profile", "Save profiling statistics (JSON and Chrome trace) every N steps, not if 0", false, 0, "integer", cmd);
+
+		// Checkpoint the full simulation state, and resume from a checkpoint
+		TCLAP::ValueArg<int> checkpoint("c", "checkpoint", "Save a checkpoint of the full simulation state every N steps, not if 0", false, 0, "integer", cmd);
+		TCLAP::ValueArg<std::string> restart("r", "restart", "Checkpoint file to resume the simulation from", false, "", "string", cmd);
+
+		// Format of the saved frames, and how many may wait to be written
+		TCLAP::ValueArg<int> binaryframes("b", "binaryframes", "Save the frames in the binary frame format with 64, 32 or 16-bit floats instead of OBJ, OBJ if 0", false, 0, "integer", cmd);
+		TCLAP::ValueArg<std::string> compression("z", "compression", "Compression of the binary frames: none, lz4 or zstd", false, "none", "string", cmd);
+		TCLAP::ValueArg<int> outputqueue("q", "outputqueue", "Frames that may wait to be written before the simulation waits for the disk", false, 2, "integer", cmd);
+
 		cmd.parse(argc, argv);
 
 		assert( scene.isSet() );
@@ -479,6 +514,31 @@ void parseCommandLine( int argc, char** argv )
 		g_dump_png = dumppng.getValue();
 		g_save_to_binary = output.getValue();
 		g_binary_file_name = input.getValue();
+		g_dump_profile = profile.getValue();
+		g_save_checkpoint = checkpoint.getValue();
+		g_checkpoint_file_name = restart.getValue();
+
+		const int precision = binaryframes.getValue();
+		if ( precision != 0 && precision != 64 && precision != 32 && precision != 16 )
+		{
+			std::cerr << "error: binary frames must have 64, 32 or 16-bit floats" << std::endl;
+			exit(1);
+		}
+		g_binary_frames = precision != 0;
+		if ( g_binary_frames ) g_frame_options.precision = precision;
+
+		if ( !framefile::parseCompression(compression.getValue(), g_frame_options.compression) )
+		{
+			std::cerr << "error: unknown compression " << compression.getValue() << std::endl;
+			exit(1);
+		}
+		if ( !framefile::isCompressionAvailable(g_frame_options.compression) )
+		{
+			std::cerr << "error: this build has no support for " << compression.getValue() << " compression" << std::endl;
+			exit(1);
+		}
+
+		g_output_queue = outputqueue.getValue();
 	}
 	catch (TCLAP::ArgException& e)
 	{
@@ -513,25 +573,54 @@ void miscOutputCallback()
 	// If the user wants to save output to a binary
 	if ( g_save_to_binary && !(g_current_step % g_save_to_binary) && g_current_step <= g_num_steps )
 	{
-		std::stringstream oss_cloth;
-		oss_cloth << g_short_file_name << "/cloth" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+		if ( g_binary_frames )
+		{
+			std::stringstream oss_frame;
+			oss_frame << g_short_file_name << "/frame" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".wcf";
 
-		std::stringstream oss_hairs;
-		oss_hairs << g_short_file_name << "/hair" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+			g_executable_simulation->serializeFrame(oss_frame.str(), g_frame_options);
+		}
+		else
+		{
+			std::stringstream oss_cloth;
+			oss_cloth << g_short_file_name << "/cloth" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
 
-		std::stringstream oss_fluid;
-		oss_fluid << g_short_file_name << "/fluid" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+			std::stringstream oss_hairs;
+			oss_hairs << g_short_file_name << "/hair" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
 
-		std::stringstream oss_inbd;
-		oss_inbd << g_short_file_name << "/internal" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+			std::stringstream oss_fluid;
+			oss_fluid << g_short_file_name << "/fluid" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
 
-		std::stringstream oss_exbd;
-		oss_exbd << g_short_file_name << "/external" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+			std::stringstream oss_inbd;
+			oss_inbd << g_short_file_name << "/internal" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+
+			std::stringstream oss_exbd;
+			oss_exbd << g_short_file_name << "/external" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+
+			std::stringstream oss_spring;
+			oss_spring << g_short_file_name << "/spring" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+
+			g_executable_simulation->serializeScene(oss_cloth.str(), oss_hairs.str(), oss_fluid.str(), oss_inbd.str(), oss_exbd.str(), oss_spring.str());
+		}
+	}
 
-		std::stringstream oss_spring;
-		oss_spring << g_short_file_name << "/spring" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_to_binary) << ".obj";
+	// If the user wants to checkpoint the simulation
+	if ( g_save_checkpoint && !(g_current_step % g_save_checkpoint) )
+	{
+		std::stringstream oss;
+		oss << g_short_file_name << "/checkpoint" << std::setw(5) << std::setfill('0') << (g_current_step / g_save_checkpoint) << ".bin";
+		if ( !g_executable_simulation->saveCheckpoint(oss.str()) )
+		{
+			std::cerr << "WARNING: failed to save checkpoint " << oss.str() << std::endl;
+		}
+	}
 
-		g_executable_simulation->serializeScene(oss_cloth.str(), oss_hairs.str(), oss_fluid.str(), oss_inbd.str(), oss_exbd.str(), oss_spring.str());
+	// If the user wants to save the profiling statistics
+	if ( g_dump_profile && !(g_current_step % g_dump_profile) )
+	{
+		const profiler::Profiler& prof = profiler::Profiler::instance();
+		prof.writeJSON(g_short_file_name + "/profile.json");
+		prof.writeChromeTrace(g_short_file_name + "/trace.json");
 	}
 
 	// Update the state of the renderers
@@ -555,7 +644,7 @@ int main( int argc, char** argv )
 	Eigen::initParallel();
 	Eigen::setNbThreads(std::thread::hardware_concurrency());
 
-	srand(0x0108170F);
+	mathutils::randomEngine().seed(0x0108170F);
 
 	// Parse command line arguments
 	parseCommandLine( argc, argv );
@@ -577,12 +666,16 @@ int main( int argc, char** argv )
 	mkdir(g_short_file_name.c_str(), 0777);
 #endif
 
+	if (g_dump_profile) profiler::Profiler::instance().setTraceEnabled(true);
+
 	// Function to cleanup at progarm exit
 	atexit(cleanupAtExit);
 
 	// Load the user-specified scene
 	loadScene(g_xml_scene_file);
 
+	g_executable_simulation->setSerializeQueueCapacity(g_output_queue);
+
 	// If requested, open the input file for the scene to benchmark
 #ifdef RENDER_ENABLED
 	// Initialization for OpenGL and GLUT
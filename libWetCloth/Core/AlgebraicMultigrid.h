@@ -292,139 +292,365 @@ void amgPrecondCompressed(vector< std::shared_ptr< FixedSparseMatrix<T> > > &A_L
 	//printf("preconditioning finished\n");
 }
 
+/*
+AMG-preconditioned CG that keeps its level hierarchy between solves.
+R_L, P_L and the smoothing patterns only depend on the layout of the
+unknowns, so they are rebuilt only when Dof_ijk (or the grid size)
+changes; otherwise only the Galerkin products are refreshed from the
+new matrix values.
+
+In mixed-precision mode the hierarchy and the inner PCG iterations are
+kept in single precision, while the residual is recomputed in T and the
+solution is improved by iterative refinement until it meets the
+tolerance in T.
+*/
 template<class T>
-bool AMGPCGSolveSparse(const SparseMatrix<T> &matrix,
-                       const std::vector<T> &rhs,
-                       std::vector<T> &result,
-                       vector<Vector3i> &Dof_ijk,
-                       T tolerance_factor,
-                       int max_iterations,
-                       T &residual_out,
-                       int &iterations_out,
-                       int ni, int nj, int nk)
+class AMGPCGSolver
 {
-	static std::shared_ptr< FixedSparseMatrix<T> > fixed_matrix = std::make_shared< FixedSparseMatrix<T> >();
-	fixed_matrix->construct_from_matrix(matrix);
-	static vector< std::shared_ptr< FixedSparseMatrix<T> > > A_L;
-	static vector<FixedSparseMatrix<T> > R_L;
-	static vector<FixedSparseMatrix<T> > P_L;
-	static vector<vector<bool> >          p_L;
-	vector<T>                      m, z, s, r;
-	int total_level;
-	levelGen<T> amg_levelGen;
-#ifdef AMG_VERBOSE
-	std::cout << "[AMG: generate levels]" << std::endl;
-#endif
-	amg_levelGen.generateLevelsGalerkinCoarseningSparse
-	(A_L, R_L, P_L, p_L, total_level, fixed_matrix, Dof_ijk, ni, nj, nk);
-
-	unsigned int n = matrix.n;
-	if (m.size() != n) { m.resize(n); s.resize(n); z.resize(n); r.resize(n); }
-	zero(result);
-	r = rhs;
-	residual_out = BLAS::abs_max(r);
-	if (residual_out == 0) {
-		iterations_out = 0;
+public:
+	AMGPCGSolver()
+		: fixed_matrix(std::make_shared< FixedSparseMatrix<T> >())
+		, fixed_matrix_f(std::make_shared< FixedSparseMatrix<float> >())
+		, total_level(0)
+		, total_level_f(0)
+		, ni(0), nj(0), nk(0)
+		, num_rebuilds(0)
+		, mixed_precision(false)
+		, inner_tolerance_factor(1e-4f)
+	{}
+
+	// switching the precision releases the current hierarchy
+	void setMixedPrecision(bool mixed)
+	{
+		if (mixed != mixed_precision) {
+			clear();
+			mixed_precision = mixed;
+		}
+	}
 
+	bool isMixedPrecision() const
+	{
+		return mixed_precision;
+	}
 
-		for (int i = 0; i < total_level; i++)
-		{
-			A_L[i]->clear();
-		}
-		for (int i = 0; i < total_level - 1; i++)
-		{
+	bool solve(const SparseMatrix<T> &matrix,
+	           const std::vector<T> &rhs,
+	           std::vector<T> &result,
+	           vector<Vector3i> &Dof_ijk,
+	           T tolerance_factor,
+	           int max_iterations,
+	           T &residual_out,
+	           int &iterations_out,
+	           int ni_, int nj_, int nk_,
+	           bool use_initial_guess = false)
+	{
+		fixed_matrix->construct_from_matrix(matrix);
+
+		return solveFixed(rhs, result, Dof_ijk, tolerance_factor, max_iterations,
+		                  residual_out, iterations_out, ni_, nj_, nk_, use_initial_guess);
+	}
+
+	// same as above for a matrix already assembled in compressed row form;
+	// the columns of each row must be sorted
+	bool solve(const FixedSparseMatrix<T> &matrix,
+	           const std::vector<T> &rhs,
+	           std::vector<T> &result,
+	           vector<Vector3i> &Dof_ijk,
+	           T tolerance_factor,
+	           int max_iterations,
+	           T &residual_out,
+	           int &iterations_out,
+	           int ni_, int nj_, int nk_,
+	           bool use_initial_guess = false)
+	{
+		*fixed_matrix = matrix;
+
+		return solveFixed(rhs, result, Dof_ijk, tolerance_factor, max_iterations,
+		                  residual_out, iterations_out, ni_, nj_, nk_, use_initial_guess);
+	}
 
+	// release the hierarchy, forcing a rebuild on the next solve
+	void clear()
+	{
+		for (int i = 0; i < (int) A_L.size(); i++) A_L[i]->clear();
+		for (int i = 0; i < (int) R_L.size(); i++) {
 			R_L[i].clear();
 			P_L[i].clear();
-
 		}
+		A_L.resize(0);
+		R_L.resize(0);
+		P_L.resize(0);
+		p_L.resize(0);
+		total_level = 0;
+
+		for (int i = 0; i < (int) A_L_f.size(); i++) A_L_f[i]->clear();
+		for (int i = 0; i < (int) R_L_f.size(); i++) {
+			R_L_f[i].clear();
+			P_L_f[i].clear();
+		}
+		A_L_f.resize(0);
+		R_L_f.resize(0);
+		P_L_f.resize(0);
+		p_L_f.resize(0);
+		total_level_f = 0;
+
+		dof_ijk.resize(0);
+		dof_ijk.shrink_to_fit();
+	}
 
-		return true;
+	int getNumRebuilds() const
+	{
+		return num_rebuilds;
 	}
-	double tol = tolerance_factor * residual_out;
+
+private:
+	bool solveFixed(const std::vector<T> &rhs,
+	                std::vector<T> &result,
+	                vector<Vector3i> &Dof_ijk,
+	                T tolerance_factor,
+	                int max_iterations,
+	                T &residual_out,
+	                int &iterations_out,
+	                int ni_, int nj_, int nk_,
+	                bool use_initial_guess)
+	{
+		if (mixed_precision) {
+			return solveMixed(rhs, result, Dof_ijk, tolerance_factor, max_iterations,
+			                  residual_out, iterations_out, ni_, nj_, nk_, use_initial_guess);
+		}
+
+		levelGen<T> amg_levelGen;
+		if (total_level == 0 || ni_ != ni || nj_ != nj || nk_ != nk || Dof_ijk != dof_ijk) {
 #ifdef AMG_VERBOSE
-	std::cout << "[AMG: preconditioning]" << std::endl;
+			std::cout << "[AMG: generate levels]" << std::endl;
 #endif
-	amgPrecondCompressed(A_L, R_L, P_L, p_L, z, r);
+			amg_levelGen.generateLevelsGalerkinCoarseningSparse
+			(A_L, R_L, P_L, p_L, total_level, fixed_matrix, Dof_ijk, ni_, nj_, nk_);
+
+			dof_ijk = Dof_ijk;
+			ni = ni_; nj = nj_; nk = nk_;
+			++num_rebuilds;
+		} else {
 #ifdef AMG_VERBOSE
-	std::cout << "[AMG: first precond done]" << std::endl;
+			std::cout << "[AMG: update levels]" << std::endl;
 #endif
-	double rho = BLAS::dot(z, r);
-	if (rho == 0 || rho != rho) {
-		for (int i = 0; i < total_level; i++)
-		{
-			A_L[i]->clear();
-
+			amg_levelGen.updateLevelsGalerkinCoarseningSparse(A_L, R_L, P_L, total_level);
 		}
-		for (int i = 0; i < total_level - 1; i++)
-		{
 
-			R_L[i].clear();
-			P_L[i].clear();
+		unsigned int n = fixed_matrix->n;
+		if (m.size() != n) { m.resize(n); s.resize(n); z.resize(n); r.resize(n); }
+		r = rhs;
+		double tol = tolerance_factor * BLAS::abs_max(rhs);
+		if (use_initial_guess && result.size() == n) {
+			// start from the given iterate; the tolerance stays relative to rhs
+			multiply_and_subtract(*fixed_matrix, result, r);
+		} else {
+			result.resize(n);
+			zero(result);
+		}
+		residual_out = BLAS::abs_max(r);
+		if (residual_out == 0 || residual_out <= tol) {
+			iterations_out = 0;
+			return true;
+		}
+#ifdef AMG_VERBOSE
+		std::cout << "[AMG: preconditioning]" << std::endl;
+#endif
+		amgPrecondCompressed(A_L, R_L, P_L, p_L, z, r);
+#ifdef AMG_VERBOSE
+		std::cout << "[AMG: first precond done]" << std::endl;
+#endif
+		double rho = BLAS::dot(z, r);
+		if (rho == 0 || rho != rho) {
+			iterations_out = 0;
+			return false;
+		}
 
+		s = z;
+#ifdef AMG_VERBOSE
+		std::cout << "[AMG: iterative solve]" << std::endl;
+#endif
+		int iteration;
+		for (iteration = 0; iteration < max_iterations; ++iteration) {
+			multiply(*fixed_matrix, s, z);
+			double alpha = rho / BLAS::dot(s, z);
+			BLAS::add_scaled(alpha, s, result);
+			BLAS::add_scaled(-alpha, z, r);
+			residual_out = BLAS::abs_max(r);
+
+			if (residual_out <= tol) {
+				iterations_out = iteration + 1;
+				return true;
+			}
+#ifdef AMG_VERBOSE
+			std::cout << "[AMG: iterative preconditioning]" << std::endl;
+#endif
+			amgPrecondCompressed(A_L, R_L, P_L, p_L, z, r);
+#ifdef AMG_VERBOSE
+			std::cout << "[AMG: second precond done]" << std::endl;
+#endif
+			double rho_new = BLAS::dot(z, r);
+			double beta = rho_new / rho;
+			BLAS::add_scaled(beta, s, z); s.swap(z); // s=beta*s+z
+			rho = rho_new;
 		}
-		iterations_out = 0;
+		iterations_out = iteration;
 		return false;
 	}
 
-	s = z;
-#ifdef AMG_VERBOSE
-	std::cout << "[AMG: iterative solve]" << std::endl;
-#endif
-	int iteration;
-	for (iteration = 0; iteration < max_iterations; ++iteration) {
-		multiply(*fixed_matrix, s, z);
-		//printf("multiply done\n");
-		double alpha = rho / BLAS::dot(s, z);
-		//printf("%d,%d,%d,%d\n",s.size(),z.size(),r.size(),result.size());
-		BLAS::add_scaled(alpha, s, result);
-		BLAS::add_scaled(-alpha, z, r);
+	bool solveMixed(const std::vector<T> &rhs,
+	                std::vector<T> &result,
+	                vector<Vector3i> &Dof_ijk,
+	                T tolerance_factor,
+	                int max_iterations,
+	                T &residual_out,
+	                int &iterations_out,
+	                int ni_, int nj_, int nk_,
+	                bool use_initial_guess)
+	{
+		// single precision copy of the matrix, which is also the finest level
+		fixed_matrix_f->n = fixed_matrix->n;
+		fixed_matrix_f->rowstart = fixed_matrix->rowstart;
+		fixed_matrix_f->colindex = fixed_matrix->colindex;
+		fixed_matrix_f->value.resize(fixed_matrix->value.size());
+		for (size_t i = 0; i < fixed_matrix->value.size(); ++i) {
+			fixed_matrix_f->value[i] = (float) fixed_matrix->value[i];
+		}
+
+		levelGen<float> amg_levelGen;
+		if (total_level_f == 0 || ni_ != ni || nj_ != nj || nk_ != nk || Dof_ijk != dof_ijk) {
+			amg_levelGen.generateLevelsGalerkinCoarseningSparse
+			(A_L_f, R_L_f, P_L_f, p_L_f, total_level_f, fixed_matrix_f, Dof_ijk, ni_, nj_, nk_);
+
+			dof_ijk = Dof_ijk;
+			ni = ni_; nj = nj_; nk = nk_;
+			++num_rebuilds;
+		} else {
+			amg_levelGen.updateLevelsGalerkinCoarseningSparse(A_L_f, R_L_f, P_L_f, total_level_f);
+		}
+
+		unsigned int n = fixed_matrix->n;
+		if (r.size() != n) { r.resize(n); }
+		if (r_f.size() != n) { r_f.resize(n); d_f.resize(n); z_f.resize(n); s_f.resize(n); }
+
+		r = rhs;
+		double tol = tolerance_factor * BLAS::abs_max(rhs);
+		if (use_initial_guess && result.size() == n) {
+			multiply_and_subtract(*fixed_matrix, result, r);
+		} else {
+			result.resize(n);
+			zero(result);
+		}
 		residual_out = BLAS::abs_max(r);
+		iterations_out = 0;
+		if (residual_out == 0 || residual_out <= tol) {
+			return true;
+		}
 
-		if (residual_out <= tol) {
-			iterations_out = iteration + 1;
+		// iterative refinement: solve A d = r in single precision, update the
+		// solution and recompute the residual in T
+		while (iterations_out < max_iterations) {
+			for (unsigned int i = 0; i < n; ++i) r_f[i] = (float) r[i];
 
-			for (int i = 0; i < total_level; i++)
-			{
-				A_L[i]->clear();
+			const double inner_tol = std::max(tol / residual_out, (double) inner_tolerance_factor) * residual_out;
+			const int inner_iterations = solveInner(inner_tol, max_iterations - iterations_out);
+			if (inner_iterations < 0) return false;
 
-			}
-			for (int i = 0; i < total_level - 1; i++)
-			{
+			iterations_out += inner_iterations;
+
+			for (unsigned int i = 0; i < n; ++i) result[i] += (T) d_f[i];
 
-				R_L[i].clear();
-				P_L[i].clear();
+			r = rhs;
+			multiply_and_subtract(*fixed_matrix, result, r);
 
+			const T last_residual = residual_out;
+			residual_out = BLAS::abs_max(r);
+			if (residual_out <= tol) {
+				return true;
 			}
 
-			return true;
+			// no further progress possible in single precision
+			if (inner_iterations == 0 || residual_out >= last_residual) break;
 		}
-#ifdef AMG_VERBOSE
-		std::cout << "[AMG: iterative preconditioning]" << std::endl;
-#endif
-		amgPrecondCompressed(A_L, R_L, P_L, p_L, z, r);
-#ifdef AMG_VERBOSE
-		std::cout << "[AMG: second precond done]" << std::endl;
-#endif
-		double rho_new = BLAS::dot(z, r);
-		double beta = rho_new / rho;
-		BLAS::add_scaled(beta, s, z); s.swap(z); // s=beta*s+z
-		rho = rho_new;
-	}
-	iterations_out = iteration;
-	for (int i = 0; i < total_level; i++)
-	{
-		A_L[i]->clear();
 
+		return false;
 	}
-	for (int i = 0; i < total_level - 1; i++)
+
+	// PCG on A_f d_f = r_f starting from zero; returns the number of
+	// iterations, or -1 on breakdown
+	int solveInner(double tol, int max_iterations)
 	{
+		zero(d_f);
+
+		amgPrecondCompressed(A_L_f, R_L_f, P_L_f, p_L_f, z_f, r_f);
+
+		double rho = BLAS::dot(z_f, r_f);
+		if (rho == 0 || rho != rho) {
+			return -1;
+		}
+
+		s_f = z_f;
+
+		int iteration;
+		for (iteration = 0; iteration < max_iterations; ++iteration) {
+			multiply(*fixed_matrix_f, s_f, z_f);
+			double alpha = rho / BLAS::dot(s_f, z_f);
+			BLAS::add_scaled(alpha, s_f, d_f);
+			BLAS::add_scaled(-alpha, z_f, r_f);
 
-		R_L[i].clear();
-		P_L[i].clear();
+			if (BLAS::abs_max(r_f) <= tol) {
+				return iteration + 1;
+			}
+
+			amgPrecondCompressed(A_L_f, R_L_f, P_L_f, p_L_f, z_f, r_f);
+
+			double rho_new = BLAS::dot(z_f, r_f);
+			double beta = rho_new / rho;
+			BLAS::add_scaled(beta, s_f, z_f); s_f.swap(z_f); // s=beta*s+z
+			rho = rho_new;
+		}
 
+		return iteration;
 	}
-	return false;
+
+	std::shared_ptr< FixedSparseMatrix<T> > fixed_matrix;
+	vector< std::shared_ptr< FixedSparseMatrix<T> > > A_L;
+	vector<FixedSparseMatrix<T> > R_L;
+	vector<FixedSparseMatrix<T> > P_L;
+	vector<vector<bool> >          p_L;
+	vector<Vector3i>               dof_ijk;
+	vector<T>                      m, z, s, r;
+
+	// single precision hierarchy and work vectors of the mixed-precision mode
+	std::shared_ptr< FixedSparseMatrix<float> > fixed_matrix_f;
+	vector< std::shared_ptr< FixedSparseMatrix<float> > > A_L_f;
+	vector<FixedSparseMatrix<float> > R_L_f;
+	vector<FixedSparseMatrix<float> > P_L_f;
+	vector<vector<bool> >              p_L_f;
+	vector<float>                      r_f, d_f, z_f, s_f;
+
+	int total_level;
+	int total_level_f;
+	int ni, nj, nk;
+	int num_rebuilds;
+	bool mixed_precision;
+	float inner_tolerance_factor;
+};
+
+template<class T>
+bool AMGPCGSolveSparse(const SparseMatrix<T> &matrix,
+                       const std::vector<T> &rhs,
+                       std::vector<T> &result,
+                       vector<Vector3i> &Dof_ijk,
+                       T tolerance_factor,
+                       int max_iterations,
+                       T &residual_out,
+                       int &iterations_out,
+                       int ni, int nj, int nk)
+{
+	AMGPCGSolver<T> solver;
+	return solver.solve(matrix, rhs, result, Dof_ijk, tolerance_factor, max_iterations,
+	                    residual_out, iterations_out, ni, nj, nk);
 }
 
 #endif
@@ -0,0 +1,92 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "BlockSparseMatrix.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+
+BlockSparseMatrix4::BlockSparseMatrix4()
+	: m_num_block_rows(0)
+{}
+
+void BlockSparseMatrix4::build( int num_block_rows, const TripletXs& tri, const std::vector< std::pair<int, int> >& row_ranges )
+{
+	m_num_block_rows = num_block_rows;
+	m_row_start.assign(num_block_rows + 1, 0);
+
+	if ((int) m_block_ranges.size() != num_block_rows) m_block_ranges.resize(num_block_rows);
+	if (m_cols.size() != tri.size()) m_cols.resize(tri.size());
+
+	threadutils::for_each(0, num_block_rows, [&] (int b) {
+		// since tri is sorted by row, the triplets of a block row are contiguous
+		int first = -1;
+		int second = -1;
+		for (int r = 0; r < 4; ++r) {
+			const std::pair<int, int>& range = row_ranges[b * 4 + r];
+			if (range.first == range.second) continue;
+			if (first < 0) first = range.first;
+			second = range.second;
+		}
+		if (first < 0) first = second = 0;
+		m_block_ranges[b] = std::pair<int, int>(first, second);
+
+		// sort and unique the block columns of the row in place
+		for (int j = first; j < second; ++j) m_cols[j] = tri[j].col() / 4;
+
+		std::sort(m_cols.begin() + first, m_cols.begin() + second);
+		m_row_start[b + 1] = (int) (std::unique(m_cols.begin() + first, m_cols.begin() + second) - (m_cols.begin() + first));
+	});
+
+	for (int b = 0; b < num_block_rows; ++b) m_row_start[b + 1] += m_row_start[b];
+
+	const int num_blocks = m_row_start[num_block_rows];
+	m_block_cols.resize(num_blocks);
+	m_blocks.resize(num_blocks);
+
+	threadutils::for_each(0, num_block_rows, [&] (int b) {
+		const int first = m_block_ranges[b].first;
+		const int row_start = m_row_start[b];
+		const int row_end = m_row_start[b + 1];
+
+		std::copy(m_cols.begin() + first, m_cols.begin() + first + (row_end - row_start), m_block_cols.begin() + row_start);
+		for (int k = row_start; k < row_end; ++k) m_blocks[k].setZero();
+
+		for (int j = first; j < m_block_ranges[b].second; ++j) {
+			const Triplets& t = tri[j];
+			const int bcol = t.col() / 4;
+			const int k = (int) (std::lower_bound(m_block_cols.begin() + row_start, m_block_cols.begin() + row_end, bcol) - m_block_cols.begin());
+			m_blocks[k](t.row() - b * 4, t.col() - bcol * 4) += t.value();
+		}
+	});
+}
+
+void BlockSparseMatrix4::multiply( const VectorXs& x, VectorXs& y ) const
+{
+	if (y.size() != m_num_block_rows * 4) y.resize(m_num_block_rows * 4);
+
+	// fixed-size 4x4 products, vectorized by Eigen
+	threadutils::for_each(0, m_num_block_rows, [&] (int b) {
+		Vector4s val = Vector4s::Zero();
+		for (int k = m_row_start[b]; k < m_row_start[b + 1]; ++k) {
+			val.noalias() += m_blocks[k] * x.segment<4>(m_block_cols[k] * 4);
+		}
+		y.segment<4>(b * 4) = val;
+	});
+}
+
+int BlockSparseMatrix4::getNumBlockRows() const
+{
+	return m_num_block_rows;
+}
+
+int BlockSparseMatrix4::getNumBlocks() const
+{
+	return (int) m_blocks.size();
+}
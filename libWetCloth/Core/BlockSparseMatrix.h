@@ -0,0 +1,48 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef BLOCK_SPARSE_MATRIX_H
+#define BLOCK_SPARSE_MATRIX_H
+
+#include <vector>
+
+#include "MathDefs.h"
+
+// Square sparse matrix of 4x4 blocks in block compressed row storage, one
+// block row per elastic particle (x, y, z and twist, matching the stride of
+// the particle arrays). Duplicated triplets, as accumulated by the forces,
+// are merged into their block, and the block columns of a row are sorted.
+class BlockSparseMatrix4
+{
+public:
+	BlockSparseMatrix4();
+
+	// tri: triplets sorted by row
+	// row_ranges: [first, second) range of tri for each scalar row, 4 * num_block_rows in total
+	void build( int num_block_rows, const TripletXs& tri, const std::vector< std::pair<int, int> >& row_ranges );
+
+	// y = A * x
+	void multiply( const VectorXs& x, VectorXs& y ) const;
+
+	int getNumBlockRows() const;
+
+	int getNumBlocks() const;
+
+private:
+	int m_num_block_rows;
+	std::vector<int> m_row_start;
+	std::vector<int> m_block_cols;
+	std::vector<Matrix4s> m_blocks;
+
+	// build buffers
+	std::vector< std::pair<int, int> > m_block_ranges;
+	std::vector<int> m_cols;
+};
+
+#endif
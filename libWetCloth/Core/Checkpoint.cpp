@@ -0,0 +1,209 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace checkpoint
+{
+static const char magic[8] = { 'W', 'C', 'C', 'H', 'K', 'P', 'T', '\0' };
+
+static void pad( std::ostream& os )
+{
+	static const char zeros[alignment] = {};
+	const uint64_t pos = (uint64_t) os.tellp();
+	const uint64_t rem = pos % alignment;
+	if (rem) os.write(zeros, alignment - rem);
+}
+
+Writer::Writer()
+	: m_stream(&m_file)
+{}
+
+bool Writer::open( const std::string& filename )
+{
+	m_sections.clear();
+	m_stream = &m_file;
+	m_file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!m_file.good()) {
+		std::cerr << "Failed to open checkpoint " << filename << " for writing." << std::endl;
+		return false;
+	}
+
+	// the header is rewritten with the table offset on close
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	m_stream->write((const char*) &header, sizeof(FileHeader));
+	return m_stream->good();
+}
+
+void Writer::openBuffer()
+{
+	m_sections.clear();
+	m_stream = &m_buffer;
+	m_buffer.str(std::string());
+	m_buffer.clear();
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	m_stream->write((const char*) &header, sizeof(FileHeader));
+}
+
+std::string Writer::takeBuffer()
+{
+	std::string buffer = m_buffer.str();
+	m_buffer.str(std::string());
+	return buffer;
+}
+
+void Writer::write( const std::string& name, const void* data, size_t elem_size, size_t count )
+{
+	SectionEntry entry;
+	std::memset(&entry, 0, sizeof(SectionEntry));
+	if (name.size() >= sizeof(entry.name)) {
+		std::cerr << "Checkpoint section name " << name << " is too long." << std::endl;
+		m_stream->setstate(std::ios::failbit);
+		return;
+	}
+	std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+
+	pad(*m_stream);
+	entry.elem_size = (uint32_t) elem_size;
+	entry.offset = (uint64_t) m_stream->tellp();
+	entry.count = (uint64_t) count;
+	if (count) m_stream->write((const char*) data, elem_size * count);
+
+	m_sections.push_back(entry);
+}
+
+bool Writer::close()
+{
+	pad(*m_stream);
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.num_sections = (uint32_t) m_sections.size();
+	header.table_offset = (uint64_t) m_stream->tellp();
+
+	if (!m_sections.empty()) m_stream->write((const char*) &m_sections[0], sizeof(SectionEntry) * m_sections.size());
+
+	m_stream->seekp(0);
+	m_stream->write((const char*) &header, sizeof(FileHeader));
+
+	const bool success = m_stream->good();
+	if (m_stream == &m_file) m_file.close();
+	m_sections.clear();
+	return success;
+}
+
+Reader::Reader()
+	: m_stream(&m_file)
+{}
+
+bool Reader::open( const std::string& filename )
+{
+	m_stream = &m_file;
+	m_file.open(filename, std::ios::binary);
+	if (!m_file.good()) {
+		std::cerr << "Failed to open checkpoint " << filename << "." << std::endl;
+		return false;
+	}
+
+	return readHeader(filename);
+}
+
+bool Reader::openBuffer( const std::string& buffer )
+{
+	m_stream = &m_buffer;
+	m_buffer.str(buffer);
+	m_buffer.clear();
+
+	return readHeader("buffer");
+}
+
+bool Reader::readHeader( const std::string& name )
+{
+	m_sections.clear();
+	m_index.clear();
+
+	m_stream->read((char*) &m_header, sizeof(FileHeader));
+	if (!m_stream->good() || std::memcmp(m_header.magic, magic, sizeof(magic)) != 0) {
+		std::cerr << name << " is not a checkpoint." << std::endl;
+		return false;
+	}
+
+	if (m_header.version > version) {
+		std::cerr << "Checkpoint " << name << " has version " << m_header.version << ", only versions up to " << version << " are supported." << std::endl;
+		return false;
+	}
+
+	m_sections.resize(m_header.num_sections);
+	m_stream->seekg(m_header.table_offset);
+	if (m_header.num_sections) m_stream->read((char*) &m_sections[0], sizeof(SectionEntry) * m_header.num_sections);
+	if (!m_stream->good()) {
+		std::cerr << "Checkpoint " << name << " is truncated." << std::endl;
+		return false;
+	}
+
+	for (int i = 0; i < (int) m_sections.size(); ++i) {
+		m_sections[i].name[sizeof(m_sections[i].name) - 1] = '\0';
+		m_index[std::string(m_sections[i].name)] = i;
+	}
+
+	return true;
+}
+
+uint32_t Reader::getVersion() const
+{
+	return m_header.version;
+}
+
+const SectionEntry* Reader::find( const std::string& name ) const
+{
+	auto itr = m_index.find(name);
+	if (itr == m_index.end()) return NULL;
+	return &m_sections[itr->second];
+}
+
+bool Reader::has( const std::string& name ) const
+{
+	return find(name) != NULL;
+}
+
+size_t Reader::count( const std::string& name ) const
+{
+	const SectionEntry* entry = find(name);
+	return entry ? (size_t) entry->count : 0;
+}
+
+bool Reader::read( const std::string& name, void* data, size_t elem_size, size_t count )
+{
+	const SectionEntry* entry = find(name);
+	if (!entry) {
+		std::cerr << "Checkpoint section " << name << " is missing." << std::endl;
+		return false;
+	}
+
+	if (entry->elem_size != elem_size || entry->count != count) {
+		std::cerr << "Checkpoint section " << name << " has " << entry->count << " elements of " << entry->elem_size
+		          << " bytes, expected " << count << " elements of " << elem_size << " bytes." << std::endl;
+		return false;
+	}
+
+	if (!count) return true;
+
+	m_stream->seekg(entry->offset);
+	m_stream->read((char*) data, elem_size * count);
+	return m_stream->good();
+}
+}
@@ -0,0 +1,182 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MathDefs.h"
+
+/*
+Binary checkpoint of the simulation state.
+
+Layout (native byte order):
+  FileHeader
+  section payloads, each starting on a 64-byte boundary
+  SectionEntry[num_sections], at FileHeader::table_offset
+
+A payload is a raw array of fixed-size elements (Eigen objects in their
+column-major storage order), so the file may as well be mapped and its
+sections used in place. Sections are looked up by name: readers ignore
+sections they do not know and report the ones they miss. Layout changes
+that old readers cannot skip over bump the version.
+
+The same layout is also written to memory, e.g. to roll back a sub-step.
+*/
+namespace checkpoint
+{
+const uint32_t version = 1;
+const uint64_t alignment = 64;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t num_sections;
+	uint64_t table_offset;
+	uint64_t reserved;
+};
+
+struct SectionEntry
+{
+	char name[48];
+	uint32_t elem_size;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t count;
+};
+
+class Writer
+{
+public:
+	Writer();
+
+	bool open( const std::string& filename );
+
+	// writes into a memory buffer, taken with takeBuffer() after close()
+	void openBuffer();
+
+	// writes the section table and the header; false if any write failed
+	bool close();
+
+	std::string takeBuffer();
+
+	void write( const std::string& name, const void* data, size_t elem_size, size_t count );
+
+	template<typename T>
+	void writeValue( const std::string& name, const T& value )
+	{
+		write( name, &value, sizeof(T), 1 );
+	}
+
+	template<typename T, typename A>
+	void writeVector( const std::string& name, const std::vector<T, A>& v )
+	{
+		write( name, v.data(), sizeof(T), v.size() );
+	}
+
+	template<typename Derived>
+	void writeMatrix( const std::string& name, const Eigen::PlainObjectBase<Derived>& m )
+	{
+		write( name, m.data(), sizeof(typename Derived::Scalar), (size_t) m.size() );
+	}
+
+private:
+	std::ofstream m_file;
+	std::ostringstream m_buffer;
+	std::ostream* m_stream;
+	std::vector< SectionEntry > m_sections;
+};
+
+class Reader
+{
+public:
+	Reader();
+
+	bool open( const std::string& filename );
+
+	// reads a buffer written by Writer::openBuffer()
+	bool openBuffer( const std::string& buffer );
+
+	uint32_t getVersion() const;
+
+	bool has( const std::string& name ) const;
+
+	// number of elements in the section, 0 if it does not exist
+	size_t count( const std::string& name ) const;
+
+	// reads exactly count elements of elem_size bytes
+	bool read( const std::string& name, void* data, size_t elem_size, size_t count );
+
+	template<typename T>
+	bool readValue( const std::string& name, T& value )
+	{
+		return read( name, &value, sizeof(T), 1 );
+	}
+
+	template<typename T, typename A>
+	bool readVector( const std::string& name, std::vector<T, A>& v )
+	{
+		v.resize( count( name ) );
+		return read( name, v.data(), sizeof(T), v.size() );
+	}
+
+	// resizes m to the number of rows stored, keeping its number of columns
+	template<typename Derived>
+	bool readMatrix( const std::string& name, Eigen::PlainObjectBase<Derived>& m )
+	{
+		const size_t n = count( name );
+		const size_t cols = m.cols() > 0 ? (size_t) m.cols() : 1;
+		if (n % cols != 0) return false;
+
+		m.resize( n / cols, cols );
+		return read( name, m.data(), sizeof(typename Derived::Scalar), n );
+	}
+
+	// reads exactly n elements, leaving v alone if the section holds any other number
+	template<typename T, typename A>
+	bool readVector( const std::string& name, std::vector<T, A>& v, size_t n )
+	{
+		if (count( name ) != n) return read( name, NULL, sizeof(T), n );
+
+		v.resize( n );
+		return read( name, v.data(), sizeof(T), n );
+	}
+
+	// reads exactly rows x cols elements, leaving m alone if the section holds any other number
+	template<typename Derived>
+	bool readMatrix( const std::string& name, Eigen::PlainObjectBase<Derived>& m, size_t rows, size_t cols )
+	{
+		if (count( name ) != rows * cols) return read( name, NULL, sizeof(typename Derived::Scalar), rows * cols );
+
+		m.resize( rows, cols );
+		return read( name, m.data(), sizeof(typename Derived::Scalar), rows * cols );
+	}
+
+private:
+	const SectionEntry* find( const std::string& name ) const;
+
+	bool readHeader( const std::string& name );
+
+	std::ifstream m_file;
+	std::istringstream m_buffer;
+	std::istream* m_stream;
+	FileHeader m_header;
+	std::vector< SectionEntry > m_sections;
+	std::unordered_map< std::string, int > m_index;
+};
+}
+
+#endif
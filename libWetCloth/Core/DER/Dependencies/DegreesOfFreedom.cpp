@@ -71,38 +71,40 @@ void CurvatureBinormals::compute()
 
     for ( IndexType vtx = m_firstValidIndex; vtx < size(); ++vtx )
     {
-        const Vec3& t1 = tangents[vtx - 1];
-        const Vec3& t2 = tangents[vtx];
+        computeLocal( m_value[vtx], tangents[vtx - 1], tangents[vtx], vtx );
+    }
+
+    setDependentsDirty();
+}
 
-        scalar denominator = 1. + t1.dot( t2 );
+void CurvatureBinormals::computeLocal( Vec3& kb, const Vec3& t1, const Vec3& t2, IndexType vtx )
+{
+    scalar denominator = 1. + t1.dot( t2 );
+
+    if ( denominator <= 0. || isSmall( denominator ) )
+    {
+        if ( denominator <= 0. )
+        {
+            denominator = 1. + t1.normalized().dot( t2.normalized() );
+        }
 
-        if ( denominator <= 0. || isSmall( denominator ) )
+        if ( denominator <= 0. )
         {
-            if ( denominator <= 0. )
-            {
-                denominator = 1. + t1.normalized().dot( t2.normalized() );
-            }
-
-            if ( denominator <= 0. )
-            {
-                std::cerr << "CurvatureBinormals::compute() denominator == " << denominator
-                          << " at vertex " << vtx << " t1 = " << t1 << " t2 = " << t2 << std::endl;
-
-                m_value[vtx] = Vec3::Constant( std::numeric_limits<scalar>::infinity() ); // Should not be accepted.
-            }
-            else
-            {
-                m_value[vtx] = 4. * std::tan( .5 * std::acos( denominator - 1. ) )
-                               * findNormal( t1 ).segment<3>(0);
-            }
+            std::cerr << "CurvatureBinormals::compute() denominator == " << denominator
+                      << " at vertex " << vtx << " t1 = " << t1 << " t2 = " << t2 << std::endl;
+
+            kb = Vec3::Constant( std::numeric_limits<scalar>::infinity() ); // Should not be accepted.
         }
         else
         {
-            m_value[vtx] = 2.0 * t1.cross( t2 ) / denominator;
+            kb = 4. * std::tan( .5 * std::acos( denominator - 1. ) )
+                 * findNormal( t1 ).segment<3>(0);
         }
     }
-
-    setDependentsDirty();
+    else
+    {
+        kb = 2.0 * t1.cross( t2 ) / denominator;
+    }
 }
 
 // Probably not as fast as MKL, but portable.
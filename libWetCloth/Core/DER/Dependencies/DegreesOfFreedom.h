@@ -205,6 +205,11 @@ public:
         return "CurvatureBinormals";
     }
 
+    /**
+     * \brief Curvature binormal at vertex vtx, between the edges of tangents t1 and t2.
+     */
+    static void computeLocal( Vec3& kb, const Vec3& t1, const Vec3& t2, IndexType vtx );
+
 protected:
     virtual void compute();
 
@@ -36,6 +36,9 @@ public:
         return "Kappas";
     }
 
+    static Vec2 computeLocal( const Vec3& kb, const Vec3& m1e, const Vec3& m2e, const Vec3& m1f,
+                              const Vec3& m2f );
+
 protected:
     virtual void compute();
 
@@ -76,6 +79,14 @@ public:
         return "GradKappas";
     }
 
+    /**
+     * \brief Gradient of the curvature at an interior vertex, from the quantities of its
+     * edges e and f.
+     */
+    static void computeLocal( GradKType& gradKappa, scalar norm_e, scalar norm_f,
+                              const Vec3& te, const Vec3& tf, const Vec3& m1e, const Vec3& m2e,
+                              const Vec3& m1f, const Vec3& m2f, const Vec2& kappa, const Vec3& kb );
+
 protected:
     virtual void compute();
 
@@ -127,6 +138,10 @@ public:
         return "HessKappas";
     }
 
+    static void computeLocal( HessKType& HessKappa, scalar norm_e, scalar norm_f,
+                              const Vec3& te, const Vec3& tf, const Vec3& m1e, const Vec3& m2e,
+                              const Vec3& m1f, const Vec3& m2f, const Vec2& kappa, const Vec3& kb );
+
 protected:
     virtual void compute();
 
@@ -26,13 +26,13 @@ const char* MaterialFrames<2>::name() const
 //void MaterialFrames<FrameN>::compute()
 
 template<>
-inline Vec3 MaterialFrames<1>::linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c )
+Vec3 MaterialFrames<1>::linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c )
 {
     return c * u + s * v;
 }
 
 template<>
-inline Vec3 MaterialFrames<2>::linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c )
+Vec3 MaterialFrames<2>::linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c )
 {
     return -s * u + c * v;
 }
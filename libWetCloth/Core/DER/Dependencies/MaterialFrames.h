@@ -31,9 +31,14 @@ public:
 
     virtual const char* name() const;
 
+    /**
+     * \brief Material frame vector of an edge, from its reference frames u, v and the sine
+     * and cosine of its twist angle.
+     */
+    static Vec3 linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c );
+
 protected:
     virtual void compute();
-    Vec3 linearMix( const Vec3& u, const Vec3& v, scalar s, scalar c );
 
     TrigThetas& m_trigThetas;
     ReferenceFrames1& m_referenceFrames1;
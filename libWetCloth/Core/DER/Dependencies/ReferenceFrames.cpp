@@ -116,20 +116,22 @@ void ReferenceTwists::compute()
     }
     for ( IndexType vtx = m_firstValidIndex; vtx < size(); ++vtx )
     {
-        const Vec3& u0 = referenceFrames1[vtx - 1];
-        const Vec3& u1 = referenceFrames1[vtx];
-        const Vec3& tangent = tangents[vtx];
+        m_value[vtx] = computeLocal( referenceFrames1[vtx - 1], referenceFrames1[vtx],
+                                     tangents[vtx - 1], tangents[vtx], m_value[vtx] );
+    }
 
-        // transport reference frame to next edge
-        Vec3 ut = orthonormalParallelTransport( u0, tangents[vtx - 1], tangent );
+    setDependentsDirty();
+}
 
-        // rotate by current value of reference twist
-        const scalar beforeTwist = m_value[vtx];
-        rotateAxisAngle( ut, tangent, beforeTwist );
+scalar ReferenceTwists::computeLocal( const Vec3& u0, const Vec3& u1, const Vec3& t0, const Vec3& t1,
+                                      scalar beforeTwist )
+{
+    // transport reference frame to next edge
+    Vec3 ut = orthonormalParallelTransport( u0, t0, t1 );
 
-        // compute increment to reference twist to align reference frames
-        m_value[vtx] = beforeTwist + signedAngle( ut, u1, tangent );
-    }
+    // rotate by current value of reference twist
+    rotateAxisAngle( ut, t1, beforeTwist );
 
-    setDependentsDirty();
+    // compute increment to reference twist to align reference frames
+    return beforeTwist + signedAngle( ut, u1, t1 );
 }
@@ -62,6 +62,26 @@ public:
         m_previousTangents = deserialPrevTangents;
     }
 
+    /**
+     * \brief Access to the frames as of the last time-parallel transportation, without
+     * triggering a new one. Together with m_previousTangents this is the state to serialize.
+     */
+    const Vec3Array& getStoredFrames() const
+    {
+        return m_value;
+    }
+
+    /**
+     * \brief Restores serialized frames and previous tangents. The frames are transported
+     * to the current tangents on the next access, as they would have been without serialization.
+     */
+    void restoreFrames( const Vec3Array& deserialFrames, const Vec3Array& deserialPrevTangents )
+    {
+        m_value = deserialFrames;
+        m_previousTangents = deserialPrevTangents;
+        setDirty();
+    }
+
     bool checkNormality();
 
 protected:
@@ -121,6 +141,13 @@ public:
         return "ReferenceTwists";
     }
 
+    /**
+     * \brief Updates the reference twist beforeTwist between the edges of reference frames
+     * u0, u1 and tangents t0, t1.
+     */
+    static scalar computeLocal( const Vec3& u0, const Vec3& u1, const Vec3& t0, const Vec3& t1,
+                                scalar beforeTwist );
+
 protected:
     virtual void compute();
 
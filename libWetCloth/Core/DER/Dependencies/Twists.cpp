@@ -32,21 +32,23 @@ void GradTwists::compute()
 
     for ( IndexType vtx = m_firstValidIndex; vtx < size(); ++vtx )
     {
-        Vec11& Dtwist = m_value[vtx];
-        Dtwist.setZero();
-
-        const Vec3& kb = curvatureBinormals[vtx];
-
-        Dtwist.segment<3>( 0 ) = -0.5 / lengths[vtx - 1] * kb;
-        Dtwist.segment<3>( 8 ) = 0.5 / lengths[vtx] * kb;
-        Dtwist.segment<3>( 4 ) = -( Dtwist.segment<3>( 0 ) + Dtwist.segment<3>( 8 ) );
-        Dtwist( 3 ) = -1;
-        Dtwist( 7 ) = 1;
+        computeLocal( m_value[vtx], lengths[vtx - 1], lengths[vtx], curvatureBinormals[vtx] );
     }
 
     setDependentsDirty();
 }
 
+void GradTwists::computeLocal( Vec11& Dtwist, scalar norm_e, scalar norm_f, const Vec3& kb )
+{
+    Dtwist.setZero();
+
+    Dtwist.segment<3>( 0 ) = -0.5 / norm_e * kb;
+    Dtwist.segment<3>( 8 ) = 0.5 / norm_f * kb;
+    Dtwist.segment<3>( 4 ) = -( Dtwist.segment<3>( 0 ) + Dtwist.segment<3>( 8 ) );
+    Dtwist( 3 ) = -1;
+    Dtwist( 7 ) = 1;
+}
+
 void GradTwistsSquared::compute()
 {
     m_value.resize( m_size );
@@ -70,48 +72,47 @@ void HessTwists::compute()
 
     for ( IndexType vtx = m_firstValidIndex; vtx < size(); ++vtx )
     {
-        Mat11& DDtwist = m_value[vtx];
-
-        DDtwist.setZero();
-
-        const Vec3& te = tangents[vtx - 1];
-        const Vec3& tf = tangents[vtx];
-        const scalar norm_e = lengths[vtx - 1];
-        const scalar norm_f = lengths[vtx];
-        const Vec3& kb = curvatureBinormals[vtx];
-
-        scalar chi = 1 + te.dot( tf );
-
-        //    assert( chi>0 );
-        if ( chi <= 0 )
-        {
-            std::cerr << "StrandState::computeHessTwist for state " << this
-                      << " chi = " << chi << " te = " << te << " tf = " << tf << std::endl;
-            chi = 1e-12;
-        }
-
-        const Vec3& tilde_t = 1.0 / chi * ( te + tf );
-
-        const Mat3& D2mDe2 = -0.25 / square( norm_e )
-                             * ( outerProd<3>( kb, te + tilde_t ) + outerProd<3>( te + tilde_t, kb ) );
-        const Mat3& D2mDf2 = -0.25 / square( norm_f )
-                             * ( outerProd<3>( kb, tf + tilde_t ) + outerProd<3>( tf + tilde_t, kb ) );
-        const Mat3& D2mDeDf = 0.5 / ( norm_e * norm_f )
-                              * ( 2.0 / chi * crossMat( te ) - outerProd<3>( kb, tilde_t ) );
-        const Mat3& D2mDfDe = D2mDeDf.transpose();
-
-        DDtwist.block<3, 3>( 0, 0 ) = D2mDe2;
-        DDtwist.block<3, 3>( 0, 4 ) = -D2mDe2 + D2mDeDf;
-        DDtwist.block<3, 3>( 4, 0 ) = -D2mDe2 + D2mDfDe;
-        DDtwist.block<3, 3>( 4, 4 ) = D2mDe2 - ( D2mDeDf + D2mDfDe ) + D2mDf2;
-        DDtwist.block<3, 3>( 0, 8 ) = -D2mDeDf;
-        DDtwist.block<3, 3>( 8, 0 ) = -D2mDfDe;
-        DDtwist.block<3, 3>( 8, 4 ) = D2mDfDe - D2mDf2;
-        DDtwist.block<3, 3>( 4, 8 ) = D2mDeDf - D2mDf2;
-        DDtwist.block<3, 3>( 8, 8 ) = D2mDf2;
-
-        assert( isSymmetric( DDtwist ) );
+        computeLocal( m_value[vtx], lengths[vtx - 1], lengths[vtx], tangents[vtx - 1], tangents[vtx],
+                      curvatureBinormals[vtx] );
     }
 
     setDependentsDirty();
 }
+
+void HessTwists::computeLocal( Mat11& DDtwist, scalar norm_e, scalar norm_f, const Vec3& te,
+                               const Vec3& tf, const Vec3& kb )
+{
+    DDtwist.setZero();
+
+    scalar chi = 1 + te.dot( tf );
+
+    //    assert( chi>0 );
+    if ( chi <= 0 )
+    {
+        std::cerr << "StrandState::computeHessTwist chi = " << chi << " te = " << te
+                  << " tf = " << tf << std::endl;
+        chi = 1e-12;
+    }
+
+    const Vec3& tilde_t = 1.0 / chi * ( te + tf );
+
+    const Mat3& D2mDe2 = -0.25 / square( norm_e )
+                         * ( outerProd<3>( kb, te + tilde_t ) + outerProd<3>( te + tilde_t, kb ) );
+    const Mat3& D2mDf2 = -0.25 / square( norm_f )
+                         * ( outerProd<3>( kb, tf + tilde_t ) + outerProd<3>( tf + tilde_t, kb ) );
+    const Mat3& D2mDeDf = 0.5 / ( norm_e * norm_f )
+                          * ( 2.0 / chi * crossMat( te ) - outerProd<3>( kb, tilde_t ) );
+    const Mat3& D2mDfDe = D2mDeDf.transpose();
+
+    DDtwist.block<3, 3>( 0, 0 ) = D2mDe2;
+    DDtwist.block<3, 3>( 0, 4 ) = -D2mDe2 + D2mDeDf;
+    DDtwist.block<3, 3>( 4, 0 ) = -D2mDe2 + D2mDfDe;
+    DDtwist.block<3, 3>( 4, 4 ) = D2mDe2 - ( D2mDeDf + D2mDfDe ) + D2mDf2;
+    DDtwist.block<3, 3>( 0, 8 ) = -D2mDeDf;
+    DDtwist.block<3, 3>( 8, 0 ) = -D2mDfDe;
+    DDtwist.block<3, 3>( 8, 4 ) = D2mDfDe - D2mDf2;
+    DDtwist.block<3, 3>( 4, 8 ) = D2mDeDf - D2mDf2;
+    DDtwist.block<3, 3>( 8, 8 ) = D2mDf2;
+
+    assert( isSymmetric( DDtwist ) );
+}
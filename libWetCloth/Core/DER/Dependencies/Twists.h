@@ -59,6 +59,8 @@ public:
         return "GradTwists";
     }
 
+    static void computeLocal( Vec11& Dtwist, scalar norm_e, scalar norm_f, const Vec3& kb );
+
 protected:
     virtual void compute();
 
@@ -109,6 +111,9 @@ public:
         return "HessTwists";
     }
 
+    static void computeLocal( Mat11& DDtwist, scalar norm_e, scalar norm_f, const Vec3& te,
+                              const Vec3& tf, const Vec3& kb );
+
 protected:
     virtual void compute();
 
@@ -0,0 +1,837 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "StrandBatch.h"
+
+#include <algorithm>
+
+#include "StrandForce.h"
+#include "Dependencies/ElasticStrandUtils.h"
+#include "../ThreadUtils.h"
+
+// Strands are handed to the tasks in blocks of at least this many vertices
+static const int s_block_vertices = 256;
+
+// Entries of the local Jacobians kept per element, cf. ForceAccumulator::accumulate
+static const int s_stretch_entries = 36;
+static const int s_element_entries = 81;
+static const int s_element_angular_entries = 4;
+
+static void storeStretchJacobian( const Mat3& M, scalar* hess )
+{
+    Eigen::Matrix<scalar, 6, 6> localJ;
+    localJ.block<3, 3>( 0, 0 ) = localJ.block<3, 3>( 3, 3 ) = -M;
+    localJ.block<3, 3>( 0, 3 ) = localJ.block<3, 3>( 3, 0 ) = M;
+
+    for ( int r = 0; r < 6; ++r )
+    {
+        for ( int c = 0; c < 6; ++c )
+        {
+            *hess++ = isSmall( localJ( r, c ) ) ? 0. : localJ( r, c );
+        }
+    }
+}
+
+static void storeElementJacobian( const Mat11& localJ, scalar* hess, scalar* angular_hess )
+{
+    for ( int r = 0; r < 11; ++r )
+    {
+        for ( int c = 0; c < 11; ++c )
+        {
+            if ( ( r % 4 == 3 ) != ( c % 4 == 3 ) ) continue;
+            scalar*& slot = ( r % 4 == 3 ) ? angular_hess : hess;
+            *slot++ = isSmall( localJ( r, c ) ) ? 0. : localJ( r, c );
+        }
+    }
+}
+
+void StrandBatch::State::resize( int num_verts )
+{
+    x.setZero( num_verts );
+    y.setZero( num_verts );
+    z.setZero( num_verts );
+    theta.setZero( num_verts );
+    lengths.setZero( num_verts );
+    tx.setZero( num_verts );
+    ty.setZero( num_verts );
+    tz.setZero( num_verts );
+    sinTheta.setZero( num_verts );
+    cosTheta.setZero( num_verts );
+    referenceFrames1.assign( num_verts, Vec3::Zero() );
+    previousTangents.assign( num_verts, Vec3::Zero() );
+    materialFrames1.assign( num_verts, Vec3::Zero() );
+    materialFrames2.assign( num_verts, Vec3::Zero() );
+    curvatureBinormals.assign( num_verts, Vec3::Zero() );
+    kappas.assign( num_verts, Vec2::Zero() );
+    referenceTwists.assign( num_verts, 0. );
+    twists.assign( num_verts, 0. );
+}
+
+void StrandBatch::Coefficients::resize( int num_verts, int num_strands )
+{
+    ks.setZero( num_verts );
+    kt.setZero( num_verts );
+    bendingCoefficient.assign( num_strands, 0. );
+    ellBar = NULL;
+    thetaBar = NULL;
+    kappaBar = NULL;
+    stretchingMultipliers.setZero( num_verts );
+    twistingMultipliers.setZero( num_verts );
+    bendingMultipliers.setZero( num_verts * 2 );
+}
+
+StrandBatch::StrandBatch( TwoDScene& scene, const std::vector< std::shared_ptr<Force> >& forces ) :
+    m_scene( scene ),
+    m_force_begin( 0 ),
+    m_num_scene_forces( (int) forces.size() )
+{
+    const int num_forces = (int) forces.size();
+    while ( m_force_begin < num_forces && !dynamic_cast<StrandForce*>( forces[m_force_begin].get() ) ) ++m_force_begin;
+
+    // The run ends at the first other force, or at a strand sharing a vertex with an earlier one,
+    // so that the batch can write the gradient of each vertex independently
+    std::vector<char> taken( scene.getNumParticles(), 0 );
+    for ( int i = m_force_begin; i < num_forces; ++i )
+    {
+        StrandForce* strand = dynamic_cast<StrandForce*>( forces[i].get() );
+        if ( !strand || strand->m_batch ) break;
+
+        bool shared = false;
+        for ( int vert : strand->m_verts ) shared = shared || taken[vert];
+        if ( shared ) break;
+
+        for ( int vert : strand->m_verts ) taken[vert] = 1;
+        m_strands.push_back( strand );
+    }
+
+    const int num_strands = getNumStrands();
+    if ( !num_strands ) return;
+
+    m_params.resize( num_strands );
+    m_vert_begin.resize( num_strands + 1 );
+    m_vert_begin[0] = 0;
+    m_block_begin.assign( 1, 0 );
+    for ( int s = 0; s < num_strands; ++s )
+    {
+        m_params[s] = m_strands[s]->m_strandParams;
+        m_vert_begin[s + 1] = m_vert_begin[s] + m_strands[s]->getNumVertices();
+
+        if ( s == num_strands - 1 || m_vert_begin[s + 1] - m_vert_begin[m_block_begin.back()] >= s_block_vertices )
+            m_block_begin.push_back( s + 1 );
+    }
+    const int num_verts = m_vert_begin[num_strands];
+
+    m_global_verts.resize( num_verts );
+    m_is_tip.resize( num_verts );
+    m_restLengths.assign( num_verts, 0. );
+    m_restTwists.assign( num_verts, 0. );
+    m_invVoronoiLengths.assign( num_verts, 0. );
+    m_restKappas.assign( num_verts, Vec2::Zero() );
+    m_bendingMatrixBase.assign( num_verts, Mat2::Zero() );
+
+    m_current.resize( num_verts );
+    m_start.resize( num_verts );
+    m_start_dirty.assign( num_strands, 1 );
+    m_gradKappas.assign( num_verts, GradKType::Zero() );
+    m_gradTwists.assign( num_verts, Vec11::Zero() );
+
+    m_elastic.resize( num_verts, num_strands );
+    m_elastic.ellBar = m_restLengths.data();
+    m_elastic.thetaBar = m_restTwists.data();
+    m_elastic.kappaBar = m_restKappas.data();
+
+    m_viscous.resize( num_verts, num_strands );
+    m_viscous.ellBar = m_start.lengths.data();
+    m_viscous.thetaBar = m_start.twists.data();
+    m_viscous.kappaBar = m_start.kappas.data();
+
+    m_packing_fraction.setOnes( num_verts );
+    m_v_plus.setZero( num_verts * 4 );
+    m_force.setZero( num_verts * 4 );
+    m_energy.assign( num_strands, 0. );
+
+    m_hess_begin.resize( num_strands + 1 );
+    m_angular_hess_begin.resize( num_strands + 1 );
+    m_hess_begin[0] = m_angular_hess_begin[0] = 0;
+    for ( int s = 0; s < num_strands; ++s )
+    {
+        const int num_edges = numVerts( s ) - 1;
+        const int num_inner = numVerts( s ) - 2;
+        const int num_parts = accumulateViscous( s ) ? 2 : 1;
+        const int num_stretch = accumulateViscousStretch( s ) ? num_parts : 1;
+
+        m_hess_begin[s + 1] = m_hess_begin[s] + num_stretch * s_stretch_entries * num_edges
+                              + num_parts * 2 * s_element_entries * num_inner;
+        m_angular_hess_begin[s + 1] = m_angular_hess_begin[s] + num_parts * 2 * s_element_angular_entries * num_inner;
+    }
+    m_hess.assign( m_hess_begin[num_strands], 0. );
+    m_angular_hess.assign( m_angular_hess_begin[num_strands], 0. );
+
+    threadutils::for_each( 0, num_strands, [&] ( int s ) {
+        StrandForce* strand = m_strands[s];
+        const int vb = vertBegin( s );
+        const int nv = numVerts( s );
+
+        for ( int v = 0; v < nv; ++v )
+        {
+            m_global_verts[vb + v] = strand->m_verts[v];
+            m_is_tip[vb + v] = m_scene.isTip( strand->m_verts[v] );
+            m_invVoronoiLengths[vb + v] = strand->m_invVoronoiLengths[v];
+            m_packing_fraction[vb + v] = strand->m_packing_fraction[v];
+        }
+        for ( int v = 0; v < nv - 1; ++v )
+        {
+            m_restLengths[vb + v] = strand->m_restLengths[v];
+            m_restTwists[vb + v] = strand->m_restTwists[v];
+            m_restKappas[vb + v] = strand->m_restKappas[v];
+        }
+        for ( int v = 1; v < nv - 1; ++v )
+        {
+            m_bendingMatrixBase[vb + v] = m_params[s]->bendingMatrixBase( v );
+        }
+
+        // The start state as of the last updateStartState, which is only
+        // evaluated when the viscous forces first need it
+        StartState& start = *strand->m_startState;
+        const VecX& start_dofs = start.m_dofs.get();
+        for ( int v = 0; v < nv; ++v )
+        {
+            m_start.x[vb + v] = start_dofs[4 * v];
+            m_start.y[vb + v] = start_dofs[4 * v + 1];
+            m_start.z[vb + v] = start_dofs[4 * v + 2];
+            m_start.theta[vb + v] = 4 * v + 3 < start_dofs.size() ? start_dofs[4 * v + 3] : 0.;
+        }
+        m_start_dirty[s] = start.m_referenceFrames1.isDirty() || start.m_twists.isDirty() || start.m_kappas.isDirty();
+        if ( !m_start_dirty[s] )
+        {
+            std::copy( start.m_lengths.getDirty().begin(), start.m_lengths.getDirty().end(), m_start.lengths.data() + vb );
+            std::copy( start.m_twists.getDirty().begin(), start.m_twists.getDirty().end(), m_start.twists.begin() + vb );
+            std::copy( start.m_kappas.getDirty().begin(), start.m_kappas.getDirty().end(), m_start.kappas.begin() + vb );
+        }
+
+        // the reference twists are updated incrementally, like the frames
+        const std::vector<scalar>& twists = strand->m_strandState->m_referenceTwists.getDirty();
+        const std::vector<scalar>& start_twists = start.m_referenceTwists.getDirty();
+        if ( (int) twists.size() == nv - 1 ) std::copy( twists.begin(), twists.end(), m_current.referenceTwists.begin() + vb );
+        if ( (int) start_twists.size() == nv - 1 ) std::copy( start_twists.begin(), start_twists.end(), m_start.referenceTwists.begin() + vb );
+
+        readStrand( s );
+
+        strand->m_batch = this;
+        strand->m_batchIndex = s;
+
+        // the batch keeps the derivatives from now on
+        TripletXs().swap( strand->m_strandHessianUpdate );
+        TripletXs().swap( strand->m_strandAngularHessianUpdate );
+        strand->m_strandState->m_gradTwistsSquared.free();
+        strand->m_strandState->m_bendingProducts.free();
+    } );
+}
+
+StrandBatch::~StrandBatch()
+{
+    for ( StrandForce* strand : m_strands )
+    {
+        strand->m_batch = NULL;
+        strand->m_batchIndex = -1;
+    }
+}
+
+void StrandBatch::detach()
+{
+    threadutils::for_each( 0, getNumStrands(), [&] ( int s ) {
+        writeStrand( s, true );
+
+        m_strands[s]->m_batch = NULL;
+        m_strands[s]->m_batchIndex = -1;
+    } );
+
+    m_strands.clear();
+}
+
+bool StrandBatch::accumulateViscous( int strand ) const
+{
+    return m_params[strand]->m_accumulateWithViscous;
+}
+
+bool StrandBatch::accumulateViscousStretch( int strand ) const
+{
+    return accumulateViscous( strand ) && !m_params[strand]->m_accumulateViscousOnlyForBendingModes;
+}
+
+void StrandBatch::readStrand( int s )
+{
+    StrandForce* strand = m_strands[s];
+    const int vb = vertBegin( s );
+    const int nv = numVerts( s );
+
+    m_v_plus.segment( vb * 4, nv * 4 ) = strand->m_v_plus;
+    m_elastic.stretchingMultipliers.segment( vb, nv ) = strand->m_stretching_multipliers;
+    m_elastic.bendingMultipliers.segment( vb * 2, nv * 2 ) = strand->m_bending_multipliers;
+    m_elastic.twistingMultipliers.segment( vb, nv ) = strand->m_twisting_multipliers;
+    m_viscous.stretchingMultipliers.segment( vb, nv ) = strand->m_viscous_stretching_multipliers;
+    m_viscous.bendingMultipliers.segment( vb * 2, nv * 2 ) = strand->m_viscous_bending_multipliers;
+    m_viscous.twistingMultipliers.segment( vb, nv ) = strand->m_viscous_twisting_multipliers;
+
+    ReferenceFrames1& frames = strand->m_strandState->m_referenceFrames1;
+    std::copy( frames.getStoredFrames().begin(), frames.getStoredFrames().end(), m_current.referenceFrames1.begin() + vb );
+    std::copy( frames.getPreviousTangents().begin(), frames.getPreviousTangents().end(), m_current.previousTangents.begin() + vb );
+
+    ReferenceFrames1& start_frames = strand->m_startState->m_referenceFrames1;
+    std::copy( start_frames.getStoredFrames().begin(), start_frames.getStoredFrames().end(), m_start.referenceFrames1.begin() + vb );
+    std::copy( start_frames.getPreviousTangents().begin(), start_frames.getPreviousTangents().end(), m_start.previousTangents.begin() + vb );
+}
+
+void StrandBatch::writeStrand( int s, bool with_dofs ) const
+{
+    StrandForce* strand = m_strands[s];
+    const int vb = vertBegin( s );
+    const int nv = numVerts( s );
+    const int ne = nv - 1;
+
+    strand->m_v_plus = m_v_plus.segment( vb * 4, nv * 4 );
+    strand->m_stretching_multipliers = m_elastic.stretchingMultipliers.segment( vb, nv );
+    strand->m_bending_multipliers = m_elastic.bendingMultipliers.segment( vb * 2, nv * 2 );
+    strand->m_twisting_multipliers = m_elastic.twistingMultipliers.segment( vb, nv );
+    strand->m_viscous_stretching_multipliers = m_viscous.stretchingMultipliers.segment( vb, nv );
+    strand->m_viscous_bending_multipliers = m_viscous.bendingMultipliers.segment( vb * 2, nv * 2 );
+    strand->m_viscous_twisting_multipliers = m_viscous.twistingMultipliers.segment( vb, nv );
+    strand->m_packing_fraction = m_packing_fraction.segment( vb, nv );
+
+    strand->m_strandState->m_referenceFrames1.restoreFrames(
+        Vec3Array( m_current.referenceFrames1.begin() + vb, m_current.referenceFrames1.begin() + vb + ne ),
+        Vec3Array( m_current.previousTangents.begin() + vb, m_current.previousTangents.begin() + vb + ne ) );
+    strand->m_startState->m_referenceFrames1.restoreFrames(
+        Vec3Array( m_start.referenceFrames1.begin() + vb, m_start.referenceFrames1.begin() + vb + ne ),
+        Vec3Array( m_start.previousTangents.begin() + vb, m_start.previousTangents.begin() + vb + ne ) );
+
+    if ( !with_dofs ) return;
+
+    VecX dofs( nv * 4 );
+    VecX start_dofs( nv * 4 );
+    for ( int v = 0; v < nv; ++v )
+    {
+        dofs.segment<4>( v * 4 ) = Vec4( m_current.x[vb + v], m_current.y[vb + v], m_current.z[vb + v], m_current.theta[vb + v] );
+        start_dofs.segment<4>( v * 4 ) = Vec4( m_start.x[vb + v], m_start.y[vb + v], m_start.z[vb + v], m_start.theta[vb + v] );
+    }
+
+    strand->m_strandState->m_referenceTwists.cleanSet( std::vector<scalar>( m_current.referenceTwists.begin() + vb,
+            m_current.referenceTwists.begin() + vb + ne ) );
+    strand->m_startState->m_referenceTwists.cleanSet( std::vector<scalar>( m_start.referenceTwists.begin() + vb,
+            m_start.referenceTwists.begin() + vb + ne ) );
+    strand->m_strandState->m_dofs.set( dofs );
+    strand->m_startState->m_dofs.set( start_dofs );
+}
+
+void StrandBatch::storeState( int strand ) const
+{
+    writeStrand( strand, false );
+}
+
+void StrandBatch::restoreState( int strand )
+{
+    readStrand( strand );
+
+    // the restored start frames are transported on the next use, as in ReferenceFrames1::restoreFrames
+    m_start_dirty[strand] = 1;
+}
+
+void StrandBatch::updateStartState()
+{
+    const VectorXs& x = m_scene.getX();
+    const VectorXs& psi = m_scene.getVolumeFraction();
+    const scalar lambda = m_scene.getLiquidInfo().lambda;
+
+    threadutils::for_each( 0, getNumStrands(), [&] ( int s ) {
+        const int vb = vertBegin( s );
+        const int ve = vb + numVerts( s );
+
+        for ( int i = vb; i < ve; ++i )
+        {
+            const int dof = m_scene.getDof( m_global_verts[i] );
+            m_start.x[i] = x[dof];
+            m_start.y[i] = x[dof + 1];
+            m_start.z[i] = x[dof + 2];
+            m_start.theta[i] = m_is_tip[i] ? 0. : x[dof + 3];
+
+            m_packing_fraction[i] = pow( psi[m_global_verts[i]], lambda );
+        }
+
+        m_start_dirty[s] = 1;
+    } );
+}
+
+void StrandBatch::gatherCoefficients( int s )
+{
+    const StrandParameters& params = *m_params[s];
+    const int vb = vertBegin( s );
+    const int nv = numVerts( s );
+
+    for ( int v = 0; v < nv - 1; ++v )
+    {
+        m_elastic.ks[vb + v] = params.getKs( v );
+        m_viscous.ks[vb + v] = params.getViscousKs( v );
+    }
+    for ( int v = 1; v < nv - 1; ++v )
+    {
+        m_elastic.kt[vb + v] = params.getKt( v );
+        m_viscous.kt[vb + v] = params.getViscousKt( v );
+    }
+    m_elastic.bendingCoefficient[s] = params.bendingCoefficient();
+    m_viscous.bendingCoefficient[s] = params.viscousBendingCoefficient();
+}
+
+void StrandBatch::computeGeometry( State& state, int begin, int end )
+{
+    // Edges between consecutive vertices of the range; the ones joining two strands are not used
+    const int num_edges = end - begin - 1;
+    if ( num_edges > 0 )
+    {
+        state.tx.segment( begin, num_edges ) = state.x.segment( begin + 1, num_edges ) - state.x.segment( begin, num_edges );
+        state.ty.segment( begin, num_edges ) = state.y.segment( begin + 1, num_edges ) - state.y.segment( begin, num_edges );
+        state.tz.segment( begin, num_edges ) = state.z.segment( begin + 1, num_edges ) - state.z.segment( begin, num_edges );
+
+        // same reduction as Lengths::compute
+        for ( int i = begin; i < begin + num_edges; ++i )
+        {
+            state.lengths[i] = state.tangent( i ).norm();
+        }
+
+        state.tx.segment( begin, num_edges ).array() /= state.lengths.segment( begin, num_edges ).array();
+        state.ty.segment( begin, num_edges ).array() /= state.lengths.segment( begin, num_edges ).array();
+        state.tz.segment( begin, num_edges ).array() /= state.lengths.segment( begin, num_edges ).array();
+    }
+
+    state.sinTheta.segment( begin, end - begin ) = state.theta.segment( begin, end - begin ).array().sin().matrix();
+    state.cosTheta.segment( begin, end - begin ) = state.theta.segment( begin, end - begin ).array().cos().matrix();
+}
+
+void StrandBatch::computeFrames( State& state, int s )
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+
+    // time-parallel transport of the reference frames along the motion of the tangents
+    for ( int i = vb; i < ve - 1; ++i )
+    {
+        const Vec3 tangent = state.tangent( i );
+        Vec3& u = state.referenceFrames1[i];
+
+        u = orthonormalParallelTransport( u, state.previousTangents[i], tangent );
+        orthoNormalize( u, tangent );
+        state.previousTangents[i] = tangent;
+
+        const Vec3 v = tangent.cross( u );
+        state.materialFrames1[i] = MaterialFrames<1>::linearMix( u, v, state.sinTheta[i], state.cosTheta[i] );
+        state.materialFrames2[i] = MaterialFrames<2>::linearMix( u, v, state.sinTheta[i], state.cosTheta[i] );
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const Vec3 te = state.tangent( i - 1 );
+        const Vec3 tf = state.tangent( i );
+
+        CurvatureBinormals::computeLocal( state.curvatureBinormals[i], te, tf, i - vb );
+        state.kappas[i] = Kappas::computeLocal( state.curvatureBinormals[i], state.materialFrames1[i - 1],
+                                                state.materialFrames2[i - 1], state.materialFrames1[i], state.materialFrames2[i] );
+        state.referenceTwists[i] = ReferenceTwists::computeLocal( state.referenceFrames1[i - 1], state.referenceFrames1[i],
+                                   te, tf, state.referenceTwists[i] );
+        state.twists[i] = state.referenceTwists[i] + state.theta[i] - state.theta[i - 1];
+    }
+}
+
+void StrandBatch::computeGradients( int s )
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+    const State& state = m_current;
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        GradKappas::computeLocal( m_gradKappas[i], state.lengths[i - 1], state.lengths[i], state.tangent( i - 1 ),
+                                  state.tangent( i ), state.materialFrames1[i - 1], state.materialFrames2[i - 1],
+                                  state.materialFrames1[i], state.materialFrames2[i], state.kappas[i], state.curvatureBinormals[i] );
+        GradTwists::computeLocal( m_gradTwists[i], state.lengths[i - 1], state.lengths[i], state.curvatureBinormals[i] );
+    }
+}
+
+void StrandBatch::computeStartState( int s )
+{
+    const int vb = vertBegin( s );
+
+    computeGeometry( m_start, vb, vb + numVerts( s ) );
+    computeFrames( m_start, s );
+
+    m_start_dirty[s] = 0;
+}
+
+void StrandBatch::preCompute()
+{
+    const VectorXs& x = m_scene.getX();
+
+    threadutils::for_each( 0, (int) m_block_begin.size() - 1, [&] ( int block ) {
+        const int strand_begin = m_block_begin[block];
+        const int strand_end = m_block_begin[block + 1];
+        const int begin = vertBegin( strand_begin );
+        const int end = vertBegin( strand_end );
+
+        for ( int i = begin; i < end; ++i )
+        {
+            const int dof = m_scene.getDof( m_global_verts[i] );
+            m_current.x[i] = x[dof];
+            m_current.y[i] = x[dof + 1];
+            m_current.z[i] = x[dof + 2];
+            m_current.theta[i] = m_is_tip[i] ? 0. : x[dof + 3];
+        }
+
+        computeGeometry( m_current, begin, end );
+
+        for ( int s = strand_begin; s < strand_end; ++s )
+        {
+            gatherCoefficients( s );
+            computeFrames( m_current, s );
+            computeGradients( s );
+            if ( accumulateViscous( s ) && m_start_dirty[s] ) computeStartState( s );
+
+            // same order of accumulation as StrandForce::accumulateQuantity
+            m_energy[s] = 0.;
+            m_force.segment( vertBegin( s ) * 4, numVerts( s ) * 4 ).setZero();
+
+            accumulateEnergy( m_elastic, s, true, m_energy[s] );
+            accumulateForce( m_elastic, s, true );
+            if ( accumulateViscous( s ) )
+            {
+                accumulateEnergy( m_viscous, s, accumulateViscousStretch( s ), m_energy[s] );
+                accumulateForce( m_viscous, s, accumulateViscousStretch( s ) );
+            }
+
+            computeHessian( s );
+        }
+    } );
+}
+
+void StrandBatch::accumulateEnergy( const Coefficients& coeff, int s, bool stretch, scalar& energy ) const
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+
+    if ( stretch )
+    {
+        for ( int i = vb; i < ve - 1; ++i )
+        {
+            const scalar ks = coeff.ks[i];
+            const scalar restLength = coeff.ellBar[i];
+            const scalar length = m_current.lengths[i];
+            const scalar psi_coeff = m_packing_fraction[i];
+
+            energy += 0.5 * ks * square( length / restLength - 1.0 ) * restLength * psi_coeff;
+        }
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const scalar kt = coeff.kt[i];
+        const scalar undefTwist = coeff.thetaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const scalar twist = m_current.twists[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        energy += 0.5 * kt * square( twist - undefTwist ) * ilen * psi_coeff;
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const Mat2 B = coeff.bendingCoefficient[s] * m_bendingMatrixBase[i];
+        const Vec2& kappaBar = coeff.kappaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const Vec2& kappa = m_current.kappas[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        energy += 0.5 * ilen * psi_coeff * ( kappa - kappaBar ).dot( Vec2( B * ( kappa - kappaBar ) ) );
+    }
+}
+
+void StrandBatch::accumulateForce( const Coefficients& coeff, int s, bool stretch )
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+
+    if ( stretch )
+    {
+        for ( int i = vb; i < ve - 1; ++i )
+        {
+            const scalar ks = coeff.ks[i];
+            const scalar restLength = coeff.ellBar[i];
+            const scalar length = m_current.lengths[i];
+            const Vec3 edge = m_current.tangent( i );
+            const scalar psi_coeff = m_packing_fraction[i];
+
+            const Vec3 f = ks * ( length / restLength - 1.0 ) * edge * psi_coeff;
+
+            m_force.segment<3>( 4 * i ) += f;
+            m_force.segment<3>( 4 * ( i + 1 ) ) -= f;
+        }
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const scalar kt = coeff.kt[i];
+        const scalar undefTwist = coeff.thetaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const scalar twist = m_current.twists[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        const Vec11 localF = -kt * ilen * ( twist - undefTwist ) * m_gradTwists[i] * psi_coeff;
+
+        m_force.segment<11>( 4 * ( i - 1 ) ) += localF;
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const Mat2 B = coeff.bendingCoefficient[s] * m_bendingMatrixBase[i];
+        const Vec2& kappaBar = coeff.kappaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const Vec2& kappa = m_current.kappas[i];
+        const GradKType& gradKappa = m_gradKappas[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        const Vec11 localF = -ilen * psi_coeff * gradKappa * B * ( kappa - kappaBar );
+
+        m_force.segment<11>( 4 * ( i - 1 ) ) += localF;
+    }
+}
+
+void StrandBatch::computeHessian( int s )
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+    const int num_edges = numVerts( s ) - 1;
+    const int num_inner = numVerts( s ) - 2;
+    const State& state = m_current;
+
+    // offsets of the parts, in the order of StrandForce::accumulateHessian
+    const int twist_offset = s_stretch_entries * num_edges;
+    const int bend_offset = twist_offset + s_element_entries * num_inner;
+    const int viscous_stretch_offset = bend_offset + s_element_entries * num_inner;
+    const int viscous_twist_offset = viscous_stretch_offset + ( accumulateViscousStretch( s ) ? s_stretch_entries * num_edges : 0 );
+    const int viscous_bend_offset = viscous_twist_offset + s_element_entries * num_inner;
+    const int part_offsets[2][2] = { { twist_offset, bend_offset }, { viscous_twist_offset, viscous_bend_offset } };
+
+    scalar* const hess = m_hess.data() + m_hess_begin[s];
+    scalar* const angular_hess = m_angular_hess.data() + m_angular_hess_begin[s];
+
+    auto stretchJacobian = [&] ( const Coefficients & coeff, int i ) -> Mat3 {
+        const scalar ks = coeff.ks[i];
+        const scalar restLength = coeff.ellBar[i];
+        const scalar length = state.lengths[i];
+        const Vec3 edge = state.tangent( i );
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        Mat3 M = ks * psi_coeff / restLength * edge * edge.transpose();
+        const scalar localL = coeff.stretchingMultipliers[i];
+        M -= ( Mat3::Identity() - edge * edge.transpose() ) / ( length * restLength ) * localL;
+        return M;
+    };
+
+    for ( int i = vb; i < ve - 1; ++i )
+    {
+        storeStretchJacobian( stretchJacobian( m_elastic, i ), hess + s_stretch_entries * ( i - vb ) );
+        if ( accumulateViscousStretch( s ) )
+            storeStretchJacobian( stretchJacobian( m_viscous, i ), hess + viscous_stretch_offset + s_stretch_entries * ( i - vb ) );
+    }
+
+    Mat11 localJ;
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const int k = i - vb - 1;
+        const scalar ilen = m_invVoronoiLengths[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        // shared by the elastic and viscous parts
+        const Vec11& gradTwist = m_gradTwists[i];
+        const Mat11 gradTwistSquared = gradTwist * gradTwist.transpose();
+        Mat11 hessTwist;
+        HessTwists::computeLocal( hessTwist, state.lengths[i - 1], state.lengths[i], state.tangent( i - 1 ), state.tangent( i ),
+                                  state.curvatureBinormals[i] );
+
+        Mat11 bendingProducts;
+        symBProduct<11>( bendingProducts, m_bendingMatrixBase[i], m_gradKappas[i] );
+#ifndef USE_APPROX_GRAD_KAPPA
+        HessKType hessKappa;
+        HessKappas::computeLocal( hessKappa, state.lengths[i - 1], state.lengths[i], state.tangent( i - 1 ), state.tangent( i ),
+                                  state.materialFrames1[i - 1], state.materialFrames2[i - 1], state.materialFrames1[i],
+                                  state.materialFrames2[i], state.kappas[i], state.curvatureBinormals[i] );
+#endif
+
+        for ( int part = 0; part < ( accumulateViscous( s ) ? 2 : 1 ); ++part )
+        {
+            const Coefficients& coeff = part ? m_viscous : m_elastic;
+
+            localJ = -coeff.kt[i] * ilen * gradTwistSquared * psi_coeff;
+            localJ += coeff.twistingMultipliers[i] * hessTwist;
+            storeElementJacobian( localJ, hess + part_offsets[part][0] + s_element_entries * k,
+                                  angular_hess + s_element_angular_entries * ( ( part * 2 ) * num_inner + k ) );
+
+            localJ = -ilen * coeff.bendingCoefficient[s] * psi_coeff * bendingProducts;
+#ifndef USE_APPROX_GRAD_KAPPA
+            const Vec2 temp = coeff.bendingMultipliers.segment<2>( 2 * i );
+            localJ += temp( 0 ) * hessKappa.first + temp( 1 ) * hessKappa.second;
+#endif
+            storeElementJacobian( localJ, hess + part_offsets[part][1] + s_element_entries * k,
+                                  angular_hess + s_element_angular_entries * ( ( part * 2 + 1 ) * num_inner + k ) );
+        }
+    }
+}
+
+void StrandBatch::addGradEToTotal( int s, VectorXs& gradE ) const
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+
+    for ( int i = vb; i < ve; ++i )
+    {
+        if ( i != ve - 1 )
+            gradE.segment<4>( 4 * m_global_verts[i] ) -= m_force.segment<4>( i * 4 );
+        else
+            gradE.segment<3>( 4 * m_global_verts[i] ) -= m_force.segment<3>( i * 4 );
+    }
+}
+
+void StrandBatch::addGradEToTotal( VectorXs& gradE ) const
+{
+    threadutils::for_each( 0, getNumStrands(), [&] ( int s ) {
+        addGradEToTotal( s, gradE );
+    } );
+}
+
+void StrandBatch::addHessXToTotal( int s, TripletXs& hessE, int hessE_index ) const
+{
+    const int* verts = m_global_verts.data() + vertBegin( s );
+    const int num_edges = numVerts( s ) - 1;
+    const int num_inner = numVerts( s ) - 2;
+    const scalar* hess = m_hess.data() + m_hess_begin[s];
+    int index = hessE_index;
+
+    auto addStretch = [&] () {
+        for ( int e = 0; e < num_edges; ++e )
+            for ( int r = 0; r < 6; ++r )
+                for ( int c = 0; c < 6; ++c )
+                    hessE[index++] = Triplets( 4 * verts[e + r / 3] + r % 3, 4 * verts[e + c / 3] + c % 3, -*hess++ );
+    };
+
+    auto addElements = [&] () {
+        for ( int e = 0; e < num_inner; ++e )
+            for ( int r = 0; r < 11; ++r )
+                for ( int c = 0; c < 11; ++c )
+                {
+                    if ( r % 4 == 3 || c % 4 == 3 ) continue;
+                    hessE[index++] = Triplets( 4 * verts[e + r / 4] + r % 4, 4 * verts[e + c / 4] + c % 4, -*hess++ );
+                }
+    };
+
+    addStretch();
+    addElements();
+    addElements();
+
+    if ( accumulateViscous( s ) )
+    {
+        if ( accumulateViscousStretch( s ) ) addStretch();
+        addElements();
+        addElements();
+    }
+}
+
+void StrandBatch::addAngularHessXToTotal( int s, TripletXs& hessE, int hessE_index ) const
+{
+    const int* verts = m_global_verts.data() + vertBegin( s );
+    const int num_inner = numVerts( s ) - 2;
+    const int num_parts = accumulateViscous( s ) ? 4 : 2;
+    const scalar* hess = m_angular_hess.data() + m_angular_hess_begin[s];
+    int index = hessE_index;
+
+    for ( int part = 0; part < num_parts; ++part )
+        for ( int e = 0; e < num_inner; ++e )
+            for ( int r = 0; r < 2; ++r )
+                for ( int c = 0; c < 2; ++c )
+                    hessE[index++] = Triplets( verts[e + r], verts[e + c], -*hess++ );
+}
+
+void StrandBatch::updateMultipliers( const VectorXs& vplus, const scalar& dt )
+{
+    threadutils::for_each( 0, getNumStrands(), [&] ( int s ) {
+        const int vb = vertBegin( s );
+        const int nv = numVerts( s );
+
+        for ( int i = vb; i < vb + nv; ++i )
+        {
+            m_v_plus.segment<4>( i * 4 ) = vplus.segment<4>( m_global_verts[i] * 4 );
+        }
+
+        if ( accumulateViscous( s ) && m_start_dirty[s] ) computeStartState( s );
+
+        m_elastic.stretchingMultipliers.segment( vb, nv ).setZero();
+        m_elastic.twistingMultipliers.segment( vb, nv ).setZero();
+        m_elastic.bendingMultipliers.segment( vb * 2, nv * 2 ).setZero();
+        accumulateMultipliers( m_elastic, s, true, dt );
+
+        if ( accumulateViscous( s ) )
+        {
+            if ( accumulateViscousStretch( s ) ) m_viscous.stretchingMultipliers.segment( vb, nv ).setZero();
+            m_viscous.twistingMultipliers.segment( vb, nv ).setZero();
+            m_viscous.bendingMultipliers.segment( vb * 2, nv * 2 ).setZero();
+            accumulateMultipliers( m_viscous, s, accumulateViscousStretch( s ), dt );
+        }
+    } );
+}
+
+void StrandBatch::accumulateMultipliers( Coefficients& coeff, int s, bool stretch, const scalar& dt )
+{
+    const int vb = vertBegin( s );
+    const int ve = vb + numVerts( s );
+
+    if ( stretch )
+    {
+        for ( int i = vb; i < ve - 1; ++i )
+        {
+            const scalar ks = coeff.ks[i];
+            const scalar length = m_current.lengths[i];
+            const Vec3 edge = m_current.tangent( i );
+            const scalar psi_coeff = m_packing_fraction[i];
+
+            coeff.stretchingMultipliers[i] += -ks * psi_coeff * ( length - coeff.ellBar[i] + dt * edge.dot( m_v_plus.segment<3>( ( i + 1 ) * 4 ) - m_v_plus.segment<3>( i * 4 ) ) );
+        }
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        const scalar kt = coeff.kt[i];
+        const scalar undefTwist = coeff.thetaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const scalar twist = m_current.twists[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        coeff.twistingMultipliers[i] += -kt * ilen * psi_coeff * ( twist - undefTwist + dt * m_gradTwists[i].dot( m_v_plus.segment<11>( 4 * ( i - 1 ) ) ) );
+    }
+
+    for ( int i = vb + 1; i < ve - 1; ++i )
+    {
+        // B.ilen.(phi+hJv)
+        const Mat2 B = coeff.bendingCoefficient[s] * m_bendingMatrixBase[i];
+        const Vec2& kappaBar = coeff.kappaBar[i];
+        const scalar ilen = m_invVoronoiLengths[i];
+        const Vec2& kappa = m_current.kappas[i];
+        const GradKType& gradKappa = m_gradKappas[i];
+        const scalar psi_coeff = m_packing_fraction[i];
+
+        Vec2 Jv = gradKappa.transpose() * m_v_plus.segment<11>( 4 * ( i - 1 ) );
+        const Vec2 localL = -ilen * psi_coeff * B * ( kappa - kappaBar + dt * Jv );
+
+        coeff.bendingMultipliers.segment<2>( 2 * i ) += localL;
+    }
+}
@@ -0,0 +1,170 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef STRAND_BATCH_H
+#define STRAND_BATCH_H
+
+#include <memory>
+#include <vector>
+
+#include "Definitions.h"
+#include "Dependencies/Kappas.h"
+#include "../MathDefs.h"
+
+class Force;
+class StrandForce;
+class TwoDScene;
+struct StrandParameters;
+
+/**
+ * \brief Evaluates the DER forces of a consecutive run of StrandForce objects together.
+ *
+ * Knitted garments are made of tens of thousands of strands with a handful of vertices each,
+ * where walking the dependency graph of every strand costs more than the arithmetic. The batch
+ * packs the vertices and edges of all strands into flat arrays, computes the edge geometry with
+ * loops over whole blocks of strands, and keeps the Hessian entries of every strand in fixed
+ * slots that are written straight into the global triplet lists.
+ *
+ * The per-element math is shared with the dependency nodes, so the batched strands produce the
+ * same forces as the individual ones. While batched, the strands forward to the batch; detach()
+ * hands the state back to them.
+ */
+class StrandBatch
+{
+public:
+	StrandBatch( TwoDScene& scene, const std::vector< std::shared_ptr<Force> >& forces );
+
+	~StrandBatch();
+
+	// copy the evolving state back into the strands and release them
+	void detach();
+
+	int getNumStrands() const { return (int) m_strands.size(); }
+	int getForceBegin() const { return m_force_begin; }
+	int getForceEnd() const { return m_force_begin + getNumStrands(); }
+	int getNumSceneForces() const { return m_num_scene_forces; }
+
+	void preCompute();
+
+	void updateStartState();
+
+	void updateMultipliers( const VectorXs& vplus, const scalar& dt );
+
+	// gradient of all the batched strands at once
+	void addGradEToTotal( VectorXs& gradE ) const;
+
+	void addGradEToTotal( int strand, VectorXs& gradE ) const;
+
+	scalar getEnergy( int strand ) const { return m_energy[strand]; }
+
+	int numHessX( int strand ) const { return m_hess_begin[strand + 1] - m_hess_begin[strand]; }
+
+	int numAngularHessX( int strand ) const { return m_angular_hess_begin[strand + 1] - m_angular_hess_begin[strand]; }
+
+	void addHessXToTotal( int strand, TripletXs& hessE, int hessE_index ) const;
+
+	void addAngularHessXToTotal( int strand, TripletXs& hessE, int hessE_index ) const;
+
+	// copy the state carried between steps into the strand before it is saved, or from it after loading
+	void storeState( int strand ) const;
+
+	void restoreState( int strand );
+
+private:
+	typedef std::vector<Mat2, Eigen::aligned_allocator<Mat2> > Mat2Array;
+
+	struct State
+	{
+		void resize( int num_verts );
+
+		Vec3 tangent( int i ) const { return Vec3( tx[i], ty[i], tz[i] ); }
+
+		// per vertex
+		VecX x, y, z, theta;
+		// per edge, indexed by its first vertex
+		VecX lengths, tx, ty, tz, sinTheta, cosTheta;
+		Vec3Array referenceFrames1, previousTangents, materialFrames1, materialFrames2;
+		// per interior vertex
+		Vec3Array curvatureBinormals;
+		Vec2Array kappas;
+		std::vector<scalar> referenceTwists, twists;
+	};
+
+	// stiffnesses and "rest shape" of the elastic or the viscous forces, cf. ViscousOrNotViscous.h
+	struct Coefficients
+	{
+		void resize( int num_verts, int num_strands );
+
+		VecX ks, kt;
+		std::vector<scalar> bendingCoefficient; // per strand
+		const scalar* ellBar;
+		const scalar* thetaBar;
+		const Vec2* kappaBar;
+		VecX stretchingMultipliers, twistingMultipliers, bendingMultipliers;
+	};
+
+	int vertBegin( int strand ) const { return m_vert_begin[strand]; }
+	int numVerts( int strand ) const { return m_vert_begin[strand + 1] - m_vert_begin[strand]; }
+	bool accumulateViscous( int strand ) const;
+	bool accumulateViscousStretch( int strand ) const;
+
+	void gatherCoefficients( int strand );
+	void computeGeometry( State& state, int begin, int end );
+	void computeFrames( State& state, int strand );
+	void computeGradients( int strand );
+	void computeStartState( int strand );
+
+	void accumulateEnergy( const Coefficients& coeff, int strand, bool stretch, scalar& energy ) const;
+	void accumulateForce( const Coefficients& coeff, int strand, bool stretch );
+	void accumulateMultipliers( Coefficients& coeff, int strand, bool stretch, const scalar& dt );
+	void computeHessian( int strand );
+
+	void writeStrand( int strand, bool with_dofs ) const;
+	void readStrand( int strand );
+
+	TwoDScene& m_scene;
+	std::vector<StrandForce*> m_strands;
+	std::vector< std::shared_ptr<StrandParameters> > m_params;
+	int m_force_begin;
+	int m_num_scene_forces;
+
+	// flat vertex range of each strand, and the ranges of strands processed by one task
+	std::vector<int> m_vert_begin;
+	std::vector<int> m_block_begin;
+	std::vector<int> m_global_verts;
+	std::vector<char> m_is_tip;
+
+	// rest shape, packed like the states
+	std::vector<scalar> m_restLengths, m_restTwists, m_invVoronoiLengths;
+	Vec2Array m_restKappas;
+	Mat2Array m_bendingMatrixBase;
+
+	State m_current;
+	State m_start;
+	std::vector<char> m_start_dirty;
+
+	GradKArrayType m_gradKappas;
+	Vec11Array m_gradTwists;
+
+	Coefficients m_elastic;
+	Coefficients m_viscous;
+
+	VecX m_packing_fraction;
+	VecX m_v_plus;
+	VecX m_force;
+	std::vector<scalar> m_energy;
+
+	// Hessian entries in the order StrandForce::accumulateHessian produces them, zero where it skips one
+	std::vector<int> m_hess_begin;
+	std::vector<int> m_angular_hess_begin;
+	std::vector<scalar> m_hess;
+	std::vector<scalar> m_angular_hess;
+};
+
+#endif
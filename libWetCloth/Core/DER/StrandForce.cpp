@@ -8,6 +8,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "StrandForce.h"
+#include "StrandBatch.h"
 
 #include "Forces/ForceAccumulator.h"
 #include "Forces/BendingForce.h"
@@ -40,7 +41,9 @@ StrandForce::StrandForce(
     m_strandForceUpdate( getNumVertices() * 4 - 1 ),
     m_strandHessianUpdate(),
     m_strandState( NULL ),
-    m_startState( NULL )
+    m_startState( NULL ),
+    m_batch( NULL ),
+    m_batchIndex( -1 )
 {
     m_strandParams = m_scene->getStrandParameters( parameterIndex );
 
@@ -126,6 +129,9 @@ StartState::StartState( const VecX& initDoFs ):
 
 void StrandForce::updateStartState()
 {
+    // the batch gathers the start state of all its strands at once
+    if ( m_batch ) return;
+
     const VectorXs& x = m_scene->getX();
     const VectorXs& psi = m_scene->getVolumeFraction();
 
@@ -144,6 +150,87 @@ void StrandForce::updateStartState()
     }
 }
 
+static void saveFrames( std::vector<scalar>& state, ReferenceFrames1& frames )
+{
+    const Vec3Array& stored = frames.getStoredFrames();
+    const Vec3Array& tangents = frames.getPreviousTangents();
+
+    state.push_back( (scalar) stored.size() );
+    for ( const Vec3& v : stored ) state.insert( state.end(), v.data(), v.data() + 3 );
+
+    state.push_back( (scalar) tangents.size() );
+    for ( const Vec3& v : tangents ) state.insert( state.end(), v.data(), v.data() + 3 );
+}
+
+static void loadFrames( const scalar*& state, ReferenceFrames1& frames )
+{
+    Vec3Array stored( (size_t) *state++ );
+    for ( Vec3& v : stored ) { v = Vec3( state[0], state[1], state[2] ); state += 3; }
+
+    Vec3Array tangents( (size_t) *state++ );
+    for ( Vec3& v : tangents ) { v = Vec3( state[0], state[1], state[2] ); state += 3; }
+
+    frames.restoreFrames( stored, tangents );
+}
+
+static bool checkFrames( const scalar*& state, const scalar* end, int size )
+{
+    for ( int i = 0; i < 2; ++i )
+    {
+        if ( end - state < 1 || *state != (scalar) size || end - state - 1 < 3 * size ) return false;
+        state += 1 + 3 * size;
+    }
+    return true;
+}
+
+void StrandForce::saveState( std::vector<scalar>& state ) const
+{
+    if ( m_batch ) m_batch->storeState( m_batchIndex );
+
+    saveVector( state, m_v_plus );
+    saveVector( state, m_stretching_multipliers );
+    saveVector( state, m_bending_multipliers );
+    saveVector( state, m_twisting_multipliers );
+    saveVector( state, m_viscous_stretching_multipliers );
+    saveVector( state, m_viscous_bending_multipliers );
+    saveVector( state, m_viscous_twisting_multipliers );
+
+    // the reference frames are time-parallel transported, hence depend on the history
+    saveFrames( state, m_strandState->m_referenceFrames1 );
+    saveFrames( state, m_startState->m_referenceFrames1 );
+}
+
+bool StrandForce::checkState( const scalar*& state, const scalar* end ) const
+{
+    const int num_verts = getNumVertices();
+
+    return checkVector( state, end, num_verts * 4 )
+           && checkVector( state, end, num_verts )
+           && checkVector( state, end, num_verts * 2 )
+           && checkVector( state, end, num_verts )
+           && checkVector( state, end, num_verts )
+           && checkVector( state, end, num_verts * 2 )
+           && checkVector( state, end, num_verts )
+           && checkFrames( state, end, getNumEdges() )
+           && checkFrames( state, end, getNumEdges() );
+}
+
+void StrandForce::loadState( const scalar*& state )
+{
+    loadVector( state, m_v_plus );
+    loadVector( state, m_stretching_multipliers );
+    loadVector( state, m_bending_multipliers );
+    loadVector( state, m_twisting_multipliers );
+    loadVector( state, m_viscous_stretching_multipliers );
+    loadVector( state, m_viscous_bending_multipliers );
+    loadVector( state, m_viscous_twisting_multipliers );
+
+    loadFrames( state, m_strandState->m_referenceFrames1 );
+    loadFrames( state, m_startState->m_referenceFrames1 );
+
+    if ( m_batch ) m_batch->restoreState( m_batchIndex );
+}
+
 void StrandForce::updateStrandState() {
     VecX initDoFs( getNumVertices() * 4 );
     initDoFs.setZero();
@@ -280,12 +367,17 @@ void StrandForce::accumulateHessian( TripletXs& accumulated, TripletXs& accumula
 
 Force* StrandForce::createNewCopy()
 {
-    return new StrandForce(*this);
+    StrandForce* copy = new StrandForce(*this);
+    copy->m_batch = NULL;
+    copy->m_batchIndex = -1;
+    return copy;
 }
 
 void StrandForce::preCompute()
 {
     /* nothing to do here, updateStartDoFs called separately and otherwise need to update every time we compute (in case nonlinear) */
+    if ( m_batch ) return;
+
     updateStrandState();
     recomputeGlobal();
 }
@@ -331,11 +423,17 @@ const char* StrandForce::name() { return "Strand Material Forces"; }
 void StrandForce::addEnergyToTotal( const VectorXs& x, const VectorXs& v, const VectorXs& m, const VectorXs& psi, const scalar& lambda, scalar& E )
 {
     // TODO
-    E += m_strandEnergyUpdate;
+    if ( m_batch ) E += m_batch->getEnergy( m_batchIndex );
+    else E += m_strandEnergyUpdate;
 }
 
 void StrandForce::addGradEToTotal( const VectorXs& x, const VectorXs& v, const VectorXs& m, const VectorXs& psi, const scalar& lambda, VectorXs& gradE )
 {
+    if ( m_batch ) {
+        m_batch->addGradEToTotal( m_batchIndex, gradE );
+        return;
+    }
+
     const int num_verts = m_verts.size();
 
     threadutils::for_each(0, num_verts, [&] (int i) {
@@ -348,6 +446,11 @@ void StrandForce::addGradEToTotal( const VectorXs& x, const VectorXs& v, const V
 
 void StrandForce::addHessXToTotal( const VectorXs& x, const VectorXs& v, const VectorXs& m, const VectorXs& psi, const scalar& lambda, TripletXs& hessE, int hessE_index, const scalar& dt )
 {
+    if ( m_batch ) {
+        m_batch->addHessXToTotal( m_batchIndex, hessE, hessE_index );
+        return;
+    }
+
     const int num_hess = numHessX();
 
     threadutils::for_each(0, num_hess, [&] (int i) {
@@ -362,6 +465,11 @@ void StrandForce::addHessXToTotal( const VectorXs& x, const VectorXs& v, const V
 
 void StrandForce::addAngularHessXToTotal( const VectorXs& x, const VectorXs& v, const VectorXs& m, const VectorXs& psi, const scalar& lambda, TripletXs& hessE, int hessE_index, const scalar& dt )
 {
+    if ( m_batch ) {
+        m_batch->addAngularHessXToTotal( m_batchIndex, hessE, hessE_index );
+        return;
+    }
+
     const int num_hess = numAngularHessX();
 
     threadutils::for_each(0, num_hess, [&] (int i) {
@@ -374,6 +482,9 @@ void StrandForce::addAngularHessXToTotal( const VectorXs& x, const VectorXs& v,
 
 void StrandForce::updateMultipliers( const VectorXs& x, const VectorXs& vplus, const VectorXs& m, const VectorXs& psi, const scalar& lambda, const scalar& dt )
 {
+    // the batch updates the multipliers of all its strands at once
+    if ( m_batch ) return;
+
     const int num_verts = getNumVertices();
     for (int i = 0; i < num_verts; ++i)
     {
@@ -404,11 +515,13 @@ void StrandForce::updateMultipliers( const VectorXs& x, const VectorXs& vplus, c
 
 int StrandForce::numHessX( )
 {
+    if ( m_batch ) return m_batch->numHessX( m_batchIndex );
     return m_strandHessianUpdate.size();
 }
 
 int StrandForce::numAngularHessX( )
 {
+    if ( m_batch ) return m_batch->numAngularHessX( m_batchIndex );
     return m_strandAngularHessianUpdate.size();
 }
 
@@ -26,6 +26,8 @@
 #include "Dependencies/BendingProducts.h"
 #include "StrandParameters.h"
 
+class StrandBatch;
+
 struct StrandState
 {
 	StrandState( const VecX& initDofs, BendingMatrixBase& bendingMatrixBase );
@@ -84,6 +86,12 @@ public:
 
 	virtual void updateStartState();
 
+	virtual void saveState( std::vector<scalar>& state ) const;
+
+	virtual bool checkState( const scalar*& state, const scalar* end ) const;
+
+	virtual void loadState( const scalar*& state );
+
 	virtual void updateMultipliers( const VectorXs& x, const VectorXs& vplus, const VectorXs& m, const VectorXs& psi, const scalar& lambda, const scalar& dt );
 
 	virtual void addEnergyToTotal( const VectorXs& x, const VectorXs& v, const VectorXs& m, const VectorXs& psi, const scalar& lambda, scalar& E );
@@ -164,6 +172,10 @@ public:
 	StrandState* m_strandState; // future state
 	StartState* m_startState; // current state
 
+	//// Batched evaluation, cf. StrandBatch ////////////////////////////
+	StrandBatch* m_batch; // NULL unless the forces are evaluated by a batch
+	int m_batchIndex;
+
 	//// Rest shape //////////////////////////////////////////////////////
 	std::vector<scalar> m_restLengths; // The following four members depend on m_restLengths, which is why updateEverythingThatDependsOnRestLengths() must be called
 	scalar m_totalRestLength;
@@ -576,7 +576,7 @@ scalar DistanceFieldObject::compute_phi(const Vector3s& pos) const
 		Eigen::Quaternion<scalar> p0(0.0, dx(0), dx(1), dx(2));
 		Eigen::Quaternion<scalar> irot = rot.conjugate();
 		Vector3s rotp_coord = ((irot * p0 * irot.inverse()).vec() - volume_origin) / parameter(1);
-		phi = sign * interpolate_value(rotp_coord, volume);
+		phi = sign * volume.interpolate(rotp_coord);
 		break;
 	}
 	default:
@@ -603,29 +603,29 @@ void DistanceFieldObject::process_file_mesh(const std::string& szfn_cache)
 
 	volume_origin = bbx_min;
 
+	Vector3s extend = (bbx_max - bbx_min) / dx;
+
+	int nx = (int) ceil(extend(0));
+	int ny = (int) ceil(extend(1));
+	int nz = (int) ceil(extend(2));
+
 	// check if cache exist
 	if (!szfn_cache.empty()) {
 		std::ifstream ifs(szfn_cache, std::ios::binary);
 
-		if (ifs.good()) {
-			// read from file directly
-			read_binary_array(ifs, volume);
+		// read from file directly, unless it holds the dense grid of older
+		// versions, another mesh or a damaged grid
+		if (ifs.good() && volume.read(ifs, nx, ny, nz)) {
 			ifs.close();
 			return;
 		}
 	}
 
-	Vector3s extend = (bbx_max - bbx_min) / dx;
-
-	int nx = (int) ceil(extend(0));
-	int ny = (int) ceil(extend(1));
-	int nz = (int) ceil(extend(2));
-
-	make_level_set3(mesh->getIndices(), mesh->getVertices(), volume_origin, dx, nx, ny, nz, volume);
+	make_level_set3_narrow_band(mesh->getIndices(), mesh->getVertices(), volume_origin, dx, nx, ny, nz, volume);
 
 	if (!szfn_cache.empty()) {
 		std::ofstream ofs(szfn_cache, std::ios::binary);
-		write_binary_array(ofs, volume);
+		volume.write(ofs);
 		ofs.close();
 	}
 }
@@ -684,6 +684,12 @@ bool DistanceFieldObject::local_bounding_box(Vector3s& bbx_low, Vector3s& bbx_hi
 	return sign < 0.0;
 }
 
+bool DistanceFieldObject::bounds_phi() const
+{
+	// the mesh volumes clamp to their grid, so far away they may read closer
+	return sign > 0.0 && type != DFT_FILE;
+}
+
 void DistanceFieldObject::render(const std::function<void(const std::vector<Vector3s>&, const std::vector<Vector3i>&, const Eigen::Quaternion<scalar>&, const Vector3s&, const scalar&)>& func) const
 {
 	if (!mesh) return;
@@ -902,6 +908,18 @@ bool DistanceFieldOperator::vote_sampled()
 	return m;
 }
 
+void DistanceFieldOperator::collect_union_leaves(std::vector< const DistanceField* >& leaves) const
+{
+	if (type != DFT_UNION) {
+		leaves.push_back(this);
+		return;
+	}
+
+	for (auto& child : children) {
+		child->collect_union_leaves(leaves);
+	}
+}
+
 bool DistanceFieldOperator::local_bounding_box(Vector3s& bbx_low, Vector3s& bbx_high) const
 {
 	bool inside = false;
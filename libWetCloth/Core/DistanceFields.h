@@ -17,6 +17,7 @@
 #include "SolidMesh.h"
 #include "array3.h"
 #include "array3_utils.h"
+#include "NarrowBandLevelSet.h"
 
 class TwoDScene;
 
@@ -69,6 +70,10 @@ struct DistanceField
 	virtual int vote_param_indices() { return params_index; };
 	virtual DISTANCE_FIELD_USAGE vote_usage() { return usage; };
 	virtual bool vote_sampled() { return sampled; };
+	// the fields whose minimum this one is, in order, taking unions apart
+	virtual void collect_union_leaves(std::vector< const DistanceField* >& leaves) const { leaves.push_back(this); };
+	// whether the field is never closer than the distance to its bounding box
+	virtual bool bounds_phi() const { return false; };
 
 	virtual void render(const std::function<void(const std::vector<Vector3s>&, const std::vector<Vector3i>&, const Eigen::Quaternion<scalar>&, const Vector3s&, const scalar&)>&) const = 0;
 
@@ -103,6 +108,7 @@ struct DistanceFieldOperator : public DistanceField
 	virtual int vote_param_indices();
 	virtual DISTANCE_FIELD_USAGE vote_usage();
 	virtual bool vote_sampled();
+	virtual void collect_union_leaves(std::vector< const DistanceField* >& leaves) const;
 
 	virtual void render(const std::function<void(const std::vector<Vector3s>&, const std::vector<Vector3i>&, const Eigen::Quaternion<scalar>&, const Vector3s&, const scalar&)>&) const;
 
@@ -122,6 +128,7 @@ struct DistanceFieldObject : public DistanceField
 	virtual void apply_global_rotation(const Eigen::Quaternion<scalar>& rot);
 	virtual void apply_local_rotation(const Eigen::Quaternion<scalar>& rot);
 	virtual void apply_translation(const Vector3s& t);
+	virtual bool bounds_phi() const;
 
 	virtual void render(const std::function<void(const std::vector<Vector3s>&, const std::vector<Vector3i>&, const Eigen::Quaternion<scalar>&, const Vector3s&, const scalar&)>&) const;
 
@@ -141,7 +148,7 @@ struct DistanceFieldObject : public DistanceField
 	scalar sign;
 
 	std::shared_ptr<SolidMesh> mesh;
-	Array3s volume;
+	NarrowBandLevelSet volume;
 	Vector3s volume_origin;
 
 	std::vector< DF_SOURCE_DURATION > durations;
@@ -0,0 +1,215 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "ElementBVH.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <igl/point_simplex_squared_distance.h>
+
+namespace
+{
+const int max_leaf_size = 4;
+const int max_depth = 48; // well within the traversal stack
+}
+
+ElementBVH::ElementBVH()
+{}
+
+void ElementBVH::clear()
+{
+	m_edges.resize(0, 2);
+	m_faces.resize(0, 3);
+	m_vertices.resize(0, 3);
+	m_nodes.clear();
+	m_elements.clear();
+}
+
+bool ElementBVH::empty() const
+{
+	return m_nodes.empty();
+}
+
+int ElementBVH::getNumEdges() const
+{
+	return m_edges.rows();
+}
+
+int ElementBVH::getNumFaces() const
+{
+	return m_faces.rows();
+}
+
+const MatrixXs& ElementBVH::getVertices() const
+{
+	return m_vertices;
+}
+
+void ElementBVH::refit( const MatrixXi& edges, const MatrixXi& faces, const VectorXs& x, const VectorXs& x_gauss )
+{
+	const int num_edges = edges.rows();
+	const int num_faces = faces.rows();
+
+	if (num_edges + num_faces == 0) {
+		clear();
+		return;
+	}
+
+	// comparing the indices costs less than the refit below
+	const bool rebuild = m_nodes.empty() || num_edges != m_edges.rows() || num_faces != m_faces.rows() ||
+	                     edges != m_edges || faces != m_faces;
+
+	if (rebuild) {
+		m_edges = edges;
+		m_faces = faces;
+
+		int num_vertices = 0;
+		if (num_edges) num_vertices = std::max(num_vertices, edges.maxCoeff() + 1);
+		if (num_faces) num_vertices = std::max(num_vertices, faces.maxCoeff() + 1);
+
+		m_vertices.resize(num_vertices, 3);
+	}
+
+	const int num_vertices = m_vertices.rows();
+
+	threadutils::for_each(0, num_vertices, [&] (int pidx) {
+		m_vertices.row(pidx) = x.segment<3>(pidx * 4).transpose();
+	});
+
+	if (rebuild) {
+		build(x_gauss);
+	}
+
+	// children always come after their parent
+	for (int n = (int) m_nodes.size() - 1; n >= 0; --n)
+	{
+		Node& node = m_nodes[n];
+
+		if (node.left >= 0) {
+			const Node& left = m_nodes[node.left];
+			const Node& right = m_nodes[node.right];
+			node.box_min = left.box_min.cwiseMin(right.box_min);
+			node.box_max = left.box_max.cwiseMax(right.box_max);
+			node.center_min = left.center_min.cwiseMin(right.center_min);
+			node.center_max = left.center_max.cwiseMax(right.center_max);
+			continue;
+		}
+
+		node.box_min.setConstant(1e+20);
+		node.box_max.setConstant(-1e+20);
+		node.center_min.setConstant(1e+20);
+		node.center_max.setConstant(-1e+20);
+
+		for (int i = node.begin; i < node.end; ++i)
+		{
+			const int element = m_elements[i];
+
+			if (element < num_edges) {
+				for (int r = 0; r < 2; ++r) {
+					node.box_min = node.box_min.cwiseMin(m_vertices.row(m_edges(element, r)).transpose());
+					node.box_max = node.box_max.cwiseMax(m_vertices.row(m_edges(element, r)).transpose());
+				}
+			} else {
+				for (int r = 0; r < 3; ++r) {
+					node.box_min = node.box_min.cwiseMin(m_vertices.row(m_faces(element - num_edges, r)).transpose());
+					node.box_max = node.box_max.cwiseMax(m_vertices.row(m_faces(element - num_edges, r)).transpose());
+				}
+			}
+
+			const Vector3s& c = x_gauss.segment<3>(element * 4);
+			node.center_min = node.center_min.cwiseMin(c);
+			node.center_max = node.center_max.cwiseMax(c);
+		}
+	}
+}
+
+void ElementBVH::build( const VectorXs& x_gauss )
+{
+	const int num_elements = m_edges.rows() + m_faces.rows();
+
+	m_elements.resize(num_elements);
+	for (int i = 0; i < num_elements; ++i) m_elements[i] = i;
+
+	m_nodes.clear();
+	m_nodes.reserve(2 * (num_elements / max_leaf_size + 1));
+
+	buildNode(x_gauss, 0, num_elements, 0);
+}
+
+int ElementBVH::buildNode( const VectorXs& x_gauss, int begin, int end, int depth )
+{
+	const int n = (int) m_nodes.size();
+	m_nodes.push_back(Node());
+	m_nodes[n].left = m_nodes[n].right = -1;
+	m_nodes[n].begin = begin;
+	m_nodes[n].end = end;
+
+	if (end - begin <= max_leaf_size || depth >= max_depth) return n;
+
+	Vector3s center_min = Vector3s::Constant(1e+20);
+	Vector3s center_max = Vector3s::Constant(-1e+20);
+	for (int i = begin; i < end; ++i) {
+		center_min = center_min.cwiseMin(x_gauss.segment<3>(m_elements[i] * 4));
+		center_max = center_max.cwiseMax(x_gauss.segment<3>(m_elements[i] * 4));
+	}
+
+	int axis;
+	(center_max - center_min).maxCoeff(&axis);
+
+	// split at the median center along the longest axis
+	const int mid = (begin + end) / 2;
+	std::nth_element(m_elements.begin() + begin, m_elements.begin() + mid, m_elements.begin() + end, [&] (int a, int b) {
+		return x_gauss(a * 4 + axis) < x_gauss(b * 4 + axis);
+	});
+
+	const int left = buildNode(x_gauss, begin, mid, depth + 1);
+	const int right = buildNode(x_gauss, mid, end, depth + 1);
+
+	m_nodes[n].left = left;
+	m_nodes[n].right = right;
+
+	return n;
+}
+
+scalar ElementBVH::closestPoint( int element, const Vector3s& p, Vector3s& cp, Vector3s& bary ) const
+{
+	scalar dist2 = 1e+20;
+	const int num_edges = m_edges.rows();
+
+	if (element < num_edges) {
+		Vector2s barye;
+		igl::point_simplex_squared_distance<3>(p, m_vertices, m_edges, element, dist2, cp, barye);
+		bary = Vector3s(barye(0), barye(1), 0.0);
+	} else {
+		igl::point_simplex_squared_distance<3>(p, m_vertices, m_faces, element - num_edges, dist2, cp, bary);
+	}
+
+	return dist2;
+}
+
+scalar ElementBVH::closestPoint( int element, const Vector3s& p ) const
+{
+	scalar dist2 = 1e+20;
+	Vector3s cp;
+	const int num_edges = m_edges.rows();
+
+	if (element < num_edges) {
+		igl::point_simplex_squared_distance<3>(p, m_vertices, m_edges, element, dist2, cp);
+	} else {
+		igl::point_simplex_squared_distance<3>(p, m_vertices, m_faces, element - num_edges, dist2, cp);
+	}
+
+	return dist2;
+}
+
+scalar ElementBVH::boxDistance2( const Node& node, const Vector3s& p )
+{
+	const Vector3s d = (node.box_min - p).cwiseMax(p - node.box_max).cwiseMax(Vector3s::Zero());
+	return d.squaredNorm();
+}
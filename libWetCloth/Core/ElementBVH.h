@@ -0,0 +1,126 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef ELEMENT_BVH_H
+#define ELEMENT_BVH_H
+
+#include <vector>
+
+#include "MathDefs.h"
+
+// Bounding volume hierarchy over the soft elastic elements, the edges
+// followed by the faces, numbered like the gausses. The tree is built once
+// from the element centers and only refit as the elements move, which keeps
+// it valid for any deformation while the topology stays the same. Any other
+// change of the elements builds it again.
+//
+// Each node bounds both the elements and their centers (the gauss points),
+// so that queries can prune by the distance to the elements as well as by
+// where the gauss points lie.
+class ElementBVH
+{
+public:
+	struct Node
+	{
+		Vector3s box_min;
+		Vector3s box_max;
+		Vector3s center_min;
+		Vector3s center_max;
+		int left; // -1 for leaves, the right child follows the left subtree
+		int right;
+		int begin; // range of the node in the element order
+		int end;
+	};
+
+	ElementBVH();
+
+	// builds the tree if the elements changed since the last call, and fits
+	// the bounds to the current positions
+	void refit( const MatrixXi& edges, const MatrixXi& faces, const VectorXs& x, const VectorXs& x_gauss );
+
+	void clear();
+
+	bool empty() const;
+
+	int getNumEdges() const;
+
+	int getNumFaces() const;
+
+	// positions of the elastic particles at the last refit, one per row
+	const MatrixXs& getVertices() const;
+
+	// squared distance from p to the element, with the closest point and its
+	// barycentric coordinates
+	scalar closestPoint( int element, const Vector3s& p, Vector3s& cp, Vector3s& bary ) const;
+
+	scalar closestPoint( int element, const Vector3s& p ) const;
+
+	// squared distance from p to the bounds of the elements under the node
+	static scalar boxDistance2( const Node& node, const Vector3s& p );
+
+	// depth-first traversal, descending into the nodes accepted by
+	// enter_node and calling visit_element on every element of the accepted
+	// leaves, near child first
+	template<typename NodeCallable, typename ElementCallable>
+	void traverse( const Vector3s& p, NodeCallable enter_node, ElementCallable visit_element ) const
+	{
+		if (m_nodes.empty() || !enter_node(m_nodes[0])) return;
+
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			const Node& node = m_nodes[stack[--top]];
+
+			if (node.left < 0) {
+				for (int i = node.begin; i < node.end; ++i) {
+					visit_element(m_elements[i]);
+				}
+				continue;
+			}
+
+			const Node& left = m_nodes[node.left];
+			const Node& right = m_nodes[node.right];
+
+			const bool enter_left = enter_node(left);
+			const bool enter_right = enter_node(right);
+
+			if (enter_left && enter_right) {
+				// the far child goes first on the stack so the near one is visited first
+				if (boxDistance2(left, p) <= boxDistance2(right, p)) {
+					stack[top++] = node.right;
+					stack[top++] = node.left;
+				} else {
+					stack[top++] = node.left;
+					stack[top++] = node.right;
+				}
+			} else if (enter_left) {
+				stack[top++] = node.left;
+			} else if (enter_right) {
+				stack[top++] = node.right;
+			}
+		}
+	}
+
+private:
+	void build( const VectorXs& x_gauss );
+
+	int buildNode( const VectorXs& x_gauss, int begin, int end, int depth );
+
+	MatrixXi m_edges;
+	MatrixXi m_faces;
+
+	MatrixXs m_vertices;
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_elements;
+};
+
+#endif
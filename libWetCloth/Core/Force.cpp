@@ -28,7 +28,42 @@ void Force::postCompute(VectorXs& v, const scalar& dt)
 
 }
 
+void Force::saveState( std::vector<scalar>& state ) const
+{
+
+}
+
+bool Force::checkState( const scalar*& state, const scalar* end ) const
+{
+	return true;
+}
+
+void Force::loadState( const scalar*& state )
+{
+
+}
+
 bool Force::parallelized() const
 {
 	return false;
 }
+
+void Force::saveVector( std::vector<scalar>& state, const VectorXs& v )
+{
+	state.push_back((scalar) v.size());
+	state.insert(state.end(), v.data(), v.data() + v.size());
+}
+
+void Force::loadVector( const scalar*& state, VectorXs& v )
+{
+	const int n = (int) *state++;
+	v = Eigen::Map<const VectorXs>(state, n);
+	state += n;
+}
+
+bool Force::checkVector( const scalar*& state, const scalar* end, int size )
+{
+	if (end - state < 1 || *state != (scalar) size || end - state - 1 < size) return false;
+	state += 1 + size;
+	return true;
+}
@@ -11,6 +11,7 @@
 #define FORCE_H
 
 #include <Eigen/Core>
+#include <vector>
 
 #include "MathDefs.h"
 
@@ -46,9 +47,27 @@ public:
 
 	virtual void postCompute(VectorXs& v, const scalar& dt);
 
+	// State carried from one step to the next (e.g. multipliers), appended
+	// to and consumed from a flat buffer for checkpoints
+	virtual void saveState( std::vector<scalar>& state ) const;
+
+	// consumes what loadState would from [state, end) without changing the force,
+	// false if the saved state does not fit this force
+	virtual bool checkState( const scalar*& state, const scalar* end ) const;
+
+	virtual void loadState( const scalar*& state );
+
 	virtual int flag() const = 0;
 
 	virtual bool parallelized() const;
+
+protected:
+	// length-prefixed vectors in the state buffer
+	static void saveVector( std::vector<scalar>& state, const VectorXs& v );
+
+	static void loadVector( const scalar*& state, VectorXs& v );
+
+	static bool checkVector( const scalar*& state, const scalar* end, int size );
 };
 
 #endif
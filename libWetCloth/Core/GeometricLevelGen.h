@@ -17,6 +17,7 @@
 #include <memory>
 #include <tbb/tbb.h>
 #include <cmath>
+#include <algorithm>
 #include "MathDefs.h"
 #include "pcgsolver/sparse_matrix.h"
 #include "pcgsolver/blas_wrapper.h"
@@ -270,12 +271,8 @@ struct levelGen {
 			Dof_ijk_fine = Dof_ijk_coarse;
 			//printf("generating R and P done!\n");
 			//printf("%d,%d,%d\n",A_L[i]->n, P_L[i]->n, R_L[i]->n);
-			FixedSparseMatrix<T> temp;
-			multiplyMat(*(A_L[i]), (P_L[i]), temp, 1.0);
-			multiplyMat((R_L[i]), temp, *(A_L[i + 1]), 0.5);
+			galerkinProductAggregation(*(A_L[i]), (R_L[i]), (P_L[i]), *(A_L[i + 1]), 0.5);
 			//printf("multiply matrix done\n");
-			temp.resize(0);
-			temp.clear();
 
 
 			unknowns = A_L[i + 1]->n;
@@ -294,6 +291,81 @@ struct levelGen {
 #endif
 	}
 
+	// Recompute the coarse operators A_{l+1} = R_l A_l P_l of an existing
+	// hierarchy after the values of the finest matrix A_L[0] have changed,
+	// keeping R_L, P_L and the smoothing patterns.
+	void updateLevelsGalerkinCoarseningSparse
+	(vector< std::shared_ptr< FixedSparseMatrix<T> > > &A_L,
+	 const vector<FixedSparseMatrix<T> > &R_L,
+	 const vector<FixedSparseMatrix<T> > &P_L,
+	 int total_level) {
+		for (int i = 0; i < total_level - 1; i++)
+		{
+			galerkinProductAggregation(*(A_L[i]), (R_L[i]), (P_L[i]), *(A_L[i + 1]), 0.5);
+		}
+	}
+
+	// Ac = scale * R * A * P, where P is an aggregation (each fine unknown
+	// is prolongated from exactly one coarse unknown). Coarse rows are
+	// assembled independently, without going through a dynamic SparseMatrix.
+	void galerkinProductAggregation(const FixedSparseMatrix<T> &A,
+	                                const FixedSparseMatrix<T> &R,
+	                                const FixedSparseMatrix<T> &P,
+	                                FixedSparseMatrix<T> &Ac,
+	                                T scale)
+	{
+		const unsigned int nc = R.n;
+		vector< vector< std::pair<unsigned int, T> > > rows(nc);
+
+		tbb::parallel_for((unsigned int) 0, nc, (unsigned int) 1, [&](unsigned int c)
+		{
+			vector< std::pair<unsigned int, T> > &row = rows[c];
+			for (unsigned int ri = R.rowstart[c]; ri < R.rowstart[c + 1]; ++ri)
+			{
+				const unsigned int i = R.colindex[ri];
+				const T r = R.value[ri] * scale;
+				for (unsigned int ai = A.rowstart[i]; ai < A.rowstart[i + 1]; ++ai)
+				{
+					const unsigned int pj = P.rowstart[A.colindex[ai]];
+					assert(P.rowstart[A.colindex[ai] + 1] == pj + 1);
+					row.push_back(std::make_pair(P.colindex[pj], r * A.value[ai] * P.value[pj]));
+				}
+			}
+
+			std::sort(row.begin(), row.end(), [] (const std::pair<unsigned int, T> &a, const std::pair<unsigned int, T> &b) {
+				return a.first < b.first;
+			});
+
+			unsigned int count = 0;
+			for (unsigned int k = 0; k < row.size(); ++k)
+			{
+				if (count > 0 && row[count - 1].first == row[k].first) row[count - 1].second += row[k].second;
+				else row[count++] = row[k];
+			}
+			row.resize(count);
+		});
+
+		Ac.resize(nc);
+		Ac.rowstart[0] = 0;
+		for (unsigned int c = 0; c < nc; ++c)
+		{
+			Ac.rowstart[c + 1] = Ac.rowstart[c] + rows[c].size();
+		}
+		Ac.value.resize(Ac.rowstart[nc]);
+		Ac.colindex.resize(Ac.rowstart[nc]);
+
+		tbb::parallel_for((unsigned int) 0, nc, (unsigned int) 1, [&](unsigned int c)
+		{
+			unsigned int j = Ac.rowstart[c];
+			for (const std::pair<unsigned int, T> &entry : rows[c])
+			{
+				Ac.colindex[j] = entry.first;
+				Ac.value[j] = entry.second;
+				++j;
+			}
+		});
+	}
+
 
 
 
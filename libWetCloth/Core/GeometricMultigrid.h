@@ -0,0 +1,355 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef GEOMETRIC_MULTIGRID_H
+#define GEOMETRIC_MULTIGRID_H
+
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <tbb/tbb.h>
+
+#include "MathDefs.h"
+#include "pcgsolver/blas_wrapper.h"
+
+/*
+Geometric multigrid preconditioned CG for 7-point stencils on the sparse
+bucket grid. No matrix is assembled: every level stores, per cell, the
+diagonal and the six face coefficients (ordered -x, +x, -y, +y, -z, +z),
+and the operator is applied through the neighbor table of the level.
+
+Cells are coarsened 2x2x2 by their (i, j, k) coordinates. The coarse
+stencils are the aggregation Galerkin products used by the AMG hierarchy
+in GeometricLevelGen.h, which stay 7-point, hence red-black Gauss-Seidel
+is an exact Gauss-Seidel sweep on every level.
+*/
+template<class T>
+class GMGPCGSolver
+{
+public:
+	GMGPCGSolver()
+		: num_rebuilds(0)
+	{}
+
+	// Dof_ijk: grid coordinates of the unknowns
+	// diag: diagonal of the operator, one per unknown
+	// offdiag: face coefficients, six per unknown; couplings to cells that
+	// are not unknowns are ignored
+	bool solve(const std::vector<Vector3i> &Dof_ijk,
+	           const std::vector<T> &diag,
+	           const std::vector<T> &offdiag,
+	           const std::vector<T> &rhs,
+	           std::vector<T> &result,
+	           T tolerance_factor,
+	           int max_iterations,
+	           T &residual_out,
+	           int &iterations_out,
+	           bool use_initial_guess = false)
+	{
+		if (levels.empty() || Dof_ijk != levels[0].ijk) {
+			buildLevels(Dof_ijk);
+			++num_rebuilds;
+		}
+
+		levels[0].diag = diag;
+		levels[0].offdiag = offdiag;
+		updateLevels();
+
+		const unsigned int n = (unsigned int) Dof_ijk.size();
+		if (z.size() != n) { s.resize(n); z.resize(n); r.resize(n); }
+		double tol = tolerance_factor * BLAS::abs_max(rhs);
+		if (use_initial_guess && result.size() == n) {
+			// start from the given iterate; the tolerance stays relative to rhs
+			multiply(levels[0], result, r);
+			for (unsigned int i = 0; i < n; ++i) r[i] = rhs[i] - r[i];
+		} else {
+			result.resize(n);
+			std::fill(result.begin(), result.end(), (T) 0);
+			r = rhs;
+		}
+		residual_out = BLAS::abs_max(r);
+		if (residual_out == 0 || residual_out <= tol) {
+			iterations_out = 0;
+			return true;
+		}
+
+		vCycle(r, z);
+
+		double rho = BLAS::dot(z, r);
+		if (rho == 0 || rho != rho) {
+			iterations_out = 0;
+			return false;
+		}
+
+		s = z;
+
+		int iteration;
+		for (iteration = 0; iteration < max_iterations; ++iteration) {
+			multiply(levels[0], s, z);
+			double alpha = rho / BLAS::dot(s, z);
+			BLAS::add_scaled(alpha, s, result);
+			BLAS::add_scaled(-alpha, z, r);
+			residual_out = BLAS::abs_max(r);
+
+			if (residual_out <= tol) {
+				iterations_out = iteration + 1;
+				return true;
+			}
+
+			vCycle(r, z);
+
+			double rho_new = BLAS::dot(z, r);
+			double beta = rho_new / rho;
+			BLAS::add_scaled(beta, s, z); s.swap(z); // s=beta*s+z
+			rho = rho_new;
+		}
+		iterations_out = iteration;
+		return false;
+	}
+
+	// release the hierarchy, forcing a rebuild on the next solve
+	void clear()
+	{
+		levels.clear();
+		levels.shrink_to_fit();
+	}
+
+	int getNumRebuilds() const
+	{
+		return num_rebuilds;
+	}
+
+	int getNumLevels() const
+	{
+		return (int) levels.size();
+	}
+
+private:
+	struct Level
+	{
+		std::vector<Vector3i> ijk;
+		std::vector<int> neighbors;		// 6 per cell, -1 if absent
+		std::vector<int> parent;		// cell on the next coarser level
+		std::vector<int> child_start;	// cells on the next finer level
+		std::vector<int> children;
+		std::vector<int> odd, even;		// cells by parity of i + j + k
+		std::vector<T> diag;
+		std::vector<T> offdiag;
+		std::vector<T> x, b, r;
+	};
+
+	// coarsen while the level has more unknowns than this, as the AMG does
+	static const int max_coarsest_unknowns = 4096;
+	static const int num_smooth = 4;
+	static const int num_coarsest_smooth = 200;
+
+	// Ac = scale * R * A * P with R = 1/8 P^T, see levelGen::generateLevelsGalerkinCoarseningSparse
+	static T galerkinScale()
+	{
+		return (T)(0.5 * 0.125);
+	}
+
+	static long long cellKey(const Vector3i &ijk)
+	{
+		return ((long long) ijk(2) << 42) | ((long long) ijk(1) << 21) | (long long) ijk(0);
+	}
+
+	static void buildNeighbors(Level &level)
+	{
+		const int n = (int) level.ijk.size();
+		std::unordered_map<long long, int> index_mapping;
+		index_mapping.reserve(n);
+		for (int i = 0; i < n; ++i) index_mapping[cellKey(level.ijk[i])] = i;
+
+		level.neighbors.resize(n * 6);
+		level.odd.resize(0);
+		level.even.resize(0);
+		for (int i = 0; i < n; ++i) {
+			const Vector3i &ijk = level.ijk[i];
+			if ((ijk(0) + ijk(1) + ijk(2)) % 2 == 1) level.odd.push_back(i);
+			else level.even.push_back(i);
+		}
+
+		tbb::parallel_for(0, n, 1, [&](int i) {
+			for (int d = 0; d < 6; ++d) {
+				Vector3i nijk = level.ijk[i];
+				nijk(d / 2) += (d % 2 == 0) ? -1 : 1;
+
+				auto itr = index_mapping.find(cellKey(nijk));
+				level.neighbors[i * 6 + d] = (itr == index_mapping.end()) ? -1 : itr->second;
+			}
+		});
+
+		level.x.resize(n);
+		level.b.resize(n);
+		level.r.resize(n);
+		level.diag.resize(n);
+		level.offdiag.resize(n * 6);
+	}
+
+	void buildLevels(const std::vector<Vector3i> &Dof_ijk)
+	{
+		levels.resize(1);
+		levels[0].ijk = Dof_ijk;
+		buildNeighbors(levels[0]);
+
+		while ((int) levels.back().ijk.size() > max_coarsest_unknowns)
+		{
+			levels.push_back(Level());
+			Level &fine = levels[levels.size() - 2];
+			Level &coarse = levels.back();
+
+			const int nf = (int) fine.ijk.size();
+			std::unordered_map<long long, int> index_mapping;
+			fine.parent.resize(nf);
+			for (int i = 0; i < nf; ++i) {
+				const Vector3i cijk = Vector3i(fine.ijk[i](0) / 2, fine.ijk[i](1) / 2, fine.ijk[i](2) / 2);
+				auto itr = index_mapping.find(cellKey(cijk));
+				if (itr == index_mapping.end()) {
+					const int idx_c = (int) coarse.ijk.size();
+					index_mapping[cellKey(cijk)] = idx_c;
+					coarse.ijk.push_back(cijk);
+					fine.parent[i] = idx_c;
+				} else {
+					fine.parent[i] = itr->second;
+				}
+			}
+
+			const int nc = (int) coarse.ijk.size();
+			coarse.child_start.assign(nc + 1, 0);
+			for (int i = 0; i < nf; ++i) coarse.child_start[fine.parent[i] + 1]++;
+			for (int c = 0; c < nc; ++c) coarse.child_start[c + 1] += coarse.child_start[c];
+
+			std::vector<int> fill(coarse.child_start.begin(), coarse.child_start.end() - 1);
+			coarse.children.resize(nf);
+			for (int i = 0; i < nf; ++i) coarse.children[fill[fine.parent[i]]++] = i;
+
+			buildNeighbors(coarse);
+		}
+	}
+
+	// recompute the coarse stencils from the finest one
+	void updateLevels()
+	{
+		const T scale = galerkinScale();
+
+		for (int l = 1; l < (int) levels.size(); ++l)
+		{
+			const Level &fine = levels[l - 1];
+			Level &coarse = levels[l];
+
+			tbb::parallel_for(0, (int) coarse.ijk.size(), 1, [&](int c) {
+				T diag = 0;
+				T offdiag[6] = {0, 0, 0, 0, 0, 0};
+
+				for (int ci = coarse.child_start[c]; ci < coarse.child_start[c + 1]; ++ci) {
+					const int f = coarse.children[ci];
+					diag += scale * fine.diag[f];
+
+					for (int d = 0; d < 6; ++d) {
+						const int nf = fine.neighbors[f * 6 + d];
+						if (nf < 0) continue;
+
+						if (fine.parent[nf] == c) diag += scale * fine.offdiag[f * 6 + d];
+						else offdiag[d] += scale * fine.offdiag[f * 6 + d];
+					}
+				}
+
+				coarse.diag[c] = diag;
+				for (int d = 0; d < 6; ++d) coarse.offdiag[c * 6 + d] = offdiag[d];
+			});
+		}
+	}
+
+	static void multiply(const Level &level, const std::vector<T> &x, std::vector<T> &y)
+	{
+		tbb::parallel_for(0, (int) level.ijk.size(), 1, [&](int i) {
+			T sum = level.diag[i] * x[i];
+			for (int d = 0; d < 6; ++d) {
+				const int n = level.neighbors[i * 6 + d];
+				if (n >= 0) sum += level.offdiag[i * 6 + d] * x[n];
+			}
+			y[i] = sum;
+		});
+	}
+
+	static void smoothCells(Level &level, const std::vector<int> &cells)
+	{
+		tbb::parallel_for(0, (int) cells.size(), 1, [&](int ci) {
+			const int i = cells[ci];
+			T sum = 0;
+			for (int d = 0; d < 6; ++d) {
+				const int n = level.neighbors[i * 6 + d];
+				if (n >= 0) sum += level.offdiag[i * 6 + d] * level.x[n];
+			}
+
+			if (level.diag[i] != 0) level.x[i] = (level.b[i] - sum) / level.diag[i];
+			else level.x[i] = 0;
+		});
+	}
+
+	static void smooth(Level &level, int iternum)
+	{
+		for (int iter = 0; iter < iternum; ++iter) {
+			smoothCells(level, level.odd);
+			smoothCells(level, level.even);
+		}
+	}
+
+	// b_coarse = 1/8 * sum of the residuals of the children
+	static void restrictResidual(Level &fine, Level &coarse)
+	{
+		multiply(fine, fine.x, fine.r);
+
+		tbb::parallel_for(0, (int) coarse.ijk.size(), 1, [&](int c) {
+			T sum = 0;
+			for (int ci = coarse.child_start[c]; ci < coarse.child_start[c + 1]; ++ci) {
+				const int f = coarse.children[ci];
+				sum += fine.b[f] - fine.r[f];
+			}
+			coarse.b[c] = sum * (T) 0.125;
+		});
+	}
+
+	static void prolongate(const Level &coarse, Level &fine)
+	{
+		tbb::parallel_for(0, (int) fine.ijk.size(), 1, [&](int f) {
+			fine.x[f] += coarse.x[fine.parent[f]];
+		});
+	}
+
+	void vCycle(const std::vector<T> &b, std::vector<T> &x)
+	{
+		const int total_level = (int) levels.size();
+		levels[0].b = b;
+		for (int l = 0; l < total_level; ++l) {
+			std::fill(levels[l].x.begin(), levels[l].x.end(), (T) 0);
+		}
+
+		for (int l = 0; l < total_level - 1; ++l) {
+			smooth(levels[l], num_smooth);
+			restrictResidual(levels[l], levels[l + 1]);
+		}
+
+		smooth(levels[total_level - 1], num_coarsest_smooth);
+
+		for (int l = total_level - 2; l >= 0; --l) {
+			prolongate(levels[l + 1], levels[l]);
+			smooth(levels[l], num_smooth);
+		}
+
+		x = levels[0].x;
+	}
+
+	std::vector<Level> levels;
+	std::vector<T> z, s, r;
+	int num_rebuilds;
+};
+
+#endif
@@ -15,7 +15,12 @@
 #include "Viscosity.h"
 #include "array3_utils.h"
 #include "AlgebraicMultigrid.h"
+#include "GeometricMultigrid.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
+#include "pcgsolver/pcg_solver.h"
 
+#include <limits>
 #include <unordered_map>
 
 //#define OPTIMIZE_SAT
@@ -23,6 +28,13 @@
 
 LinearizedImplicitEuler::LinearizedImplicitEuler(const scalar& criterion, const scalar& pressure_criterion, const scalar& quasi_static_criterion, const scalar& viscous_criterion, int maxiters, int manifold_substeps, int viscosity_substeps, int surf_tension_substeps)
 	: SceneStepper(), m_pcg_criterion(criterion), m_pressure_criterion(pressure_criterion), m_quasi_static_criterion(quasi_static_criterion), m_viscous_criterion(viscous_criterion), m_maxiters(maxiters), m_manifold_substeps(manifold_substeps), m_viscosity_substeps(viscosity_substeps), m_surf_tension_substeps(surf_tension_substeps)
+	, m_pressure_amg(std::make_shared< AMGPCGSolver<scalar> >())
+	, m_pressure_gmg(std::make_shared< GMGPCGSolver<scalar> >())
+	, m_prev_bucket_origin(Vector3i::Zero())
+	, m_prev_num_buckets(Vector3i::Zero())
+	, m_pressure_change(std::numeric_limits<scalar>::infinity())
+	, m_elasto_amg(std::make_shared< AMGPCGSolver<scalar> >())
+	, m_visc_solver(std::make_shared< robertbridson::PCGSolver<scalar> >())
 {}
 
 LinearizedImplicitEuler::~LinearizedImplicitEuler()
@@ -31,6 +43,8 @@ LinearizedImplicitEuler::~LinearizedImplicitEuler()
 
 bool LinearizedImplicitEuler::advectSurfTension( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("advectSurfTension");
+
 	if (!scene.useSurfTension()) return true;
 
 	const scalar subdt = dt / (scalar) m_surf_tension_substeps;
@@ -96,6 +110,77 @@ void LinearizedImplicitEuler::performInvLocalSolve( const TwoDScene& scene,
 	});
 }
 
+scalar LinearizedImplicitEuler::performInvLocalSolveDot( const TwoDScene& scene,
+        const std::vector< VectorXs >& node_rhs_x,
+        const std::vector< VectorXs >& node_rhs_y,
+        const std::vector< VectorXs >& node_rhs_z,
+        const std::vector< VectorXs >& node_inv_mass_x,
+        const std::vector< VectorXs >& node_inv_mass_y,
+        const std::vector< VectorXs >& node_inv_mass_z,
+        std::vector< VectorXs >& out_node_vec_x,
+        std::vector< VectorXs >& out_node_vec_y,
+        std::vector< VectorXs >& out_node_vec_z )
+{
+	const Sorter& buckets = scene.getParticleBuckets();
+
+	VectorXs bucket_dot = VectorXs::Zero(scene.getNumBuckets());
+
+	buckets.for_each_bucket([&] (int bucket_idx) {
+		if (!scene.isBucketActivated(bucket_idx)) return;
+
+		const int num_nodes = scene.getNumNodes(bucket_idx);
+
+		const VectorXs& bucket_node_masses_x = node_inv_mass_x[bucket_idx];
+		const VectorXs& bucket_node_masses_y = node_inv_mass_y[bucket_idx];
+		const VectorXs& bucket_node_masses_z = node_inv_mass_z[bucket_idx];
+
+		const VectorXs& bucket_node_rhs_x = node_rhs_x[bucket_idx];
+		const VectorXs& bucket_node_rhs_y = node_rhs_y[bucket_idx];
+		const VectorXs& bucket_node_rhs_z = node_rhs_z[bucket_idx];
+
+		VectorXs& bucket_out_node_vec_x = out_node_vec_x[bucket_idx];
+		VectorXs& bucket_out_node_vec_y = out_node_vec_y[bucket_idx];
+		VectorXs& bucket_out_node_vec_z = out_node_vec_z[bucket_idx];
+
+		scalar sum = 0.0;
+		for (int i = 0; i < num_nodes; ++i)
+		{
+			bucket_out_node_vec_x[i] = bucket_node_rhs_x[i] * bucket_node_masses_x[i];
+			bucket_out_node_vec_y[i] = bucket_node_rhs_y[i] * bucket_node_masses_y[i];
+			bucket_out_node_vec_z[i] = bucket_node_rhs_z[i] * bucket_node_masses_z[i];
+
+			sum += bucket_node_rhs_x[i] * bucket_out_node_vec_x[i] + bucket_node_rhs_y[i] * bucket_out_node_vec_y[i] + bucket_node_rhs_z[i] * bucket_out_node_vec_z[i];
+		}
+
+		bucket_dot[bucket_idx] = sum;
+	});
+
+	return bucket_dot.sum();
+}
+
+scalar LinearizedImplicitEuler::updatePCRVectors( const TwoDScene& scene, const scalar& alpha )
+{
+	const Sorter& buckets = scene.getParticleBuckets();
+
+	VectorXs bucket_length = VectorXs::Zero(scene.getNumBuckets());
+
+	buckets.for_each_bucket([&] (int bucket_idx) {
+		m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
+		m_node_r_x[bucket_idx] -= m_node_z_x[bucket_idx] * alpha;
+		m_node_t_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
+		m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
+		m_node_r_y[bucket_idx] -= m_node_z_y[bucket_idx] * alpha;
+		m_node_t_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
+		m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
+		m_node_r_z[bucket_idx] -= m_node_z_z[bucket_idx] * alpha;
+		m_node_t_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
+
+		bucket_length[bucket_idx] = m_node_t_x[bucket_idx].squaredNorm() + m_node_t_y[bucket_idx].squaredNorm() + m_node_t_z[bucket_idx].squaredNorm();
+	});
+
+	return sqrt(bucket_length.sum());
+}
+
 void LinearizedImplicitEuler::performLocalSolve( const TwoDScene& scene, const VectorXs& rhs, const VectorXs& m, VectorXs& out)
 {
 	const int num_elasto = scene.getNumSoftElastoParticles();
@@ -203,6 +288,8 @@ bool LinearizedImplicitEuler::stepVelocityLagrangian( TwoDScene& scene, scalar d
 
 bool LinearizedImplicitEuler::stepVelocity( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("stepVelocity");
+
 	// build node particle pairs
 	scene.precompute();
 
@@ -335,29 +422,10 @@ void LinearizedImplicitEuler::performGlobalMultiply( const TwoDScene& scene, con
 
 	if (num_elasto == 0) return;
 
-	struct Triplets_override
-	{
-		int m_row, m_col;
-		scalar m_value;
-	};
-
 	const int ndof = num_elasto * 4;
 
-	if (m_multiply_buffer.size() != num_elasto * 4) m_multiply_buffer.resize( ndof );
 	// Ax
-	threadutils::for_each(0, ndof, [&] (int i) {
-		const int idata_start = m_triA_sup[i].first;
-		const int idata_end = m_triA_sup[i].second;
-
-		scalar val = 0.0;
-		for (int j = idata_start; j < idata_end; ++j)
-		{
-			const Triplets_override& tri = *((const Triplets_override*) &m_triA[j]);
-
-			val += tri.m_value * vec[tri.m_col];
-		}
-		m_multiply_buffer[i] = val;
-	});
+	m_blockA.multiply( vec, m_multiply_buffer );
 
 	out = m_multiply_buffer * (dt * dt) + VectorXs(m.segment(0, ndof).array() * vec.array());
 }
@@ -382,26 +450,8 @@ void LinearizedImplicitEuler::performGlobalMultiply( const TwoDScene& scene, con
 	// Wx
 	mapNodeToSoftParticles( scene, node_v_x, node_v_y, node_v_z, m_pre_mult_buffer );
 
-	struct Triplets_override
-	{
-		int m_row, m_col;
-		scalar m_value;
-	};
-
 	// AWx
-	threadutils::for_each(0, num_elasto * 4, [&] (int i) {
-		const int idata_start = m_triA_sup[i].first;
-		const int idata_end = m_triA_sup[i].second;
-
-		scalar val = 0.0;
-		for (int j = idata_start; j < idata_end; ++j)
-		{
-			const Triplets_override& tri = *((const Triplets_override*) &m_triA[j]);
-
-			val += tri.m_value * m_pre_mult_buffer[tri.m_col];
-		}
-		m_multiply_buffer[i] = val;
-	});
+	m_blockA.multiply( m_pre_mult_buffer, m_multiply_buffer );
 //    m_multiply_buffer = m_A * m_pre_mult_buffer;
 
 	// W^TAWx
@@ -450,26 +500,8 @@ void LinearizedImplicitEuler::performGlobalMultiply( const TwoDScene& scene, con
 		m_pre_mult_buffer[i * 4 + 3] = angular_vec(i);
 	});
 
-	struct Triplets_override
-	{
-		int m_row, m_col;
-		scalar m_value;
-	};
-
 	// AWx
-	threadutils::for_each(0, num_elasto * 4, [&] (int i) {
-		const int idata_start = m_triA_sup[i].first;
-		const int idata_end = m_triA_sup[i].second;
-
-		scalar val = 0.0;
-		for (int j = idata_start; j < idata_end; ++j)
-		{
-			const Triplets_override& tri = *((const Triplets_override*) &m_triA[j]);
-
-			val += tri.m_value * m_pre_mult_buffer[tri.m_col];
-		}
-		m_multiply_buffer[i] = val;
-	});
+	m_blockA.multiply( m_pre_mult_buffer, m_multiply_buffer );
 
 
 	// grab angular DOFs back
@@ -680,6 +712,8 @@ void LinearizedImplicitEuler::constructHessianPreProcess( TwoDScene& scene, cons
 
 void LinearizedImplicitEuler::constructHessianPostProcess( TwoDScene& scene, const scalar& dt)
 {
+	profiler::ScopedTimer timer("constructHessian");
+
 	const int num_soft_elasto = scene.getNumSoftElastoParticles();
 
 	tbb::parallel_sort(m_triA.begin(), m_triA.end(), [] (const Triplets & x, const Triplets & y) {
@@ -710,6 +744,9 @@ void LinearizedImplicitEuler::constructHessianPostProcess( TwoDScene& scene, con
 		}
 	});
 
+	// merge the triplets into 4x4 blocks for the multiplies of the solvers
+	m_blockA.build(num_soft_elasto, m_triA, m_triA_sup);
+
 	if (scene.getLiquidInfo().use_group_precondition) {
 		prepareGroupPrecondition(scene, m_node_Cs_x, m_node_Cs_y, m_node_Cs_z, dt);
 	}
@@ -1127,36 +1164,25 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCR( TwoDScene& scene, s
 			                      m_node_p_x, m_node_p_y, m_node_p_z,
 			                      m_node_q_x, m_node_q_y, m_node_q_z);
 
+			scalar qz;
 			if (scene.getLiquidInfo().use_group_precondition) {
 				performGroupedLocalSolve(scene, m_node_q_x, m_node_q_y, m_node_q_z,
 				                         m_node_z_x, m_node_z_y, m_node_z_z);
+				qz = dotNodeVectors(m_node_q_x, m_node_q_y, m_node_q_z, m_node_z_x, m_node_z_y, m_node_z_z);
 			} else {
-				// Mz=q
-				performInvLocalSolve(scene, m_node_q_x, m_node_q_y, m_node_q_z,
-				                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
-				                     m_node_z_x, m_node_z_y, m_node_z_z);
+				// Mz=q, fused with (q, z)
+				qz = performInvLocalSolveDot(scene, m_node_q_x, m_node_q_y, m_node_q_z,
+				                             m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
+				                             m_node_z_x, m_node_z_y, m_node_z_z);
 			}
 
-
 			// alpha = rho / (q, z)
-			scalar alpha = rho / dotNodeVectors(m_node_q_x, m_node_q_y, m_node_q_z, m_node_z_x, m_node_z_y, m_node_z_z);
+			scalar alpha = rho / qz;
 
 			// x = x + alpha * p
 			// r = r - alpha * z
 			// t = t - alpha * q
-			buckets.for_each_bucket([&] (int bucket_idx) {
-				m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
-				m_node_r_x[bucket_idx] -= m_node_z_x[bucket_idx] * alpha;
-				m_node_t_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
-				m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
-				m_node_r_y[bucket_idx] -= m_node_z_y[bucket_idx] * alpha;
-				m_node_t_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
-				m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
-				m_node_r_z[bucket_idx] -= m_node_z_z[bucket_idx] * alpha;
-				m_node_t_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
-			});
-
-			res_norm = lengthNodeVectors(m_node_t_x, m_node_t_y, m_node_t_z) / res_norm_0;
+			res_norm = updatePCRVectors(scene, alpha) / res_norm_0;
 
 			const scalar rho_criterion = (m_pcg_criterion * res_norm_0) * (m_pcg_criterion * res_norm_0);
 
@@ -1187,36 +1213,24 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCR( TwoDScene& scene, s
 					m_node_q_z[bucket_idx] = m_node_w_z[bucket_idx] + m_node_q_z[bucket_idx] * beta;
 				});
 
-				// Mz = q
 				if (scene.getLiquidInfo().use_group_precondition) {
 					performGroupedLocalSolve(scene, m_node_q_x, m_node_q_y, m_node_q_z,
 					                         m_node_z_x, m_node_z_y, m_node_z_z);
+					qz = dotNodeVectors(m_node_q_x, m_node_q_y, m_node_q_z, m_node_z_x, m_node_z_y, m_node_z_z);
 				} else {
-					// Mz=q
-					performInvLocalSolve(scene, m_node_q_x, m_node_q_y, m_node_q_z,
-					                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
-					                     m_node_z_x, m_node_z_y, m_node_z_z);
+					// Mz=q, fused with (q, z)
+					qz = performInvLocalSolveDot(scene, m_node_q_x, m_node_q_y, m_node_q_z,
+					                             m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
+					                             m_node_z_x, m_node_z_y, m_node_z_z);
 				}
 
 				// alpha = rho / (q, z)
-				alpha = rho / dotNodeVectors(m_node_q_x, m_node_q_y, m_node_q_z, m_node_z_x, m_node_z_y, m_node_z_z);
+				alpha = rho / qz;
 
 				// x = x + alpha * p
 				// r = r - alpha * z
 				// t = t - alpha * q
-				buckets.for_each_bucket([&] (int bucket_idx) {
-					m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
-					m_node_r_x[bucket_idx] -= m_node_z_x[bucket_idx] * alpha;
-					m_node_t_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
-					m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
-					m_node_r_y[bucket_idx] -= m_node_z_y[bucket_idx] * alpha;
-					m_node_t_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
-					m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
-					m_node_r_z[bucket_idx] -= m_node_z_z[bucket_idx] * alpha;
-					m_node_t_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
-				});
-
-				res_norm = lengthNodeVectors(m_node_t_x, m_node_t_y, m_node_t_z) / res_norm_0;
+				res_norm = updatePCRVectors(scene, alpha) / res_norm_0;
 				if (scene.getLiquidInfo().iteration_print_step > 0 && iter % scene.getLiquidInfo().iteration_print_step == 0)
 					std::cout << "[pcr total iter: " << iter
 					          << ", res: " << res_norm << "/" << m_pcg_criterion
@@ -1231,6 +1245,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCR( TwoDScene& scene, s
 			          << ", rho: " << (rho / (res_norm_0 * res_norm_0)) << "/" << (rho_criterion / (res_norm_0 * res_norm_0))
 			          << ", abs. rho: " << rho << "/" << rho_criterion << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto", iter, res_norm, iter < m_maxiters);
 	}
 
 	if (res_norm_1 > m_pcg_criterion) {
@@ -1351,6 +1367,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCR( TwoDScene& scene, s
 			          << ", rho: " << (rho / (res_norm_1 * res_norm_1)) << "/" << (rho_criterion / (res_norm_1 * res_norm_1))
 			          << ", abs. rho: " << rho << "/" << rho_criterion << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto_angular", iter, res_norm, iter < m_maxiters);
 	}
 
 	return true;
@@ -1538,6 +1556,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoLagrangian( TwoDScene& scene, sc
 
 			std::cout << "[pcg total iter: " << iter << ", res: " << res_norm << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto", iter, res_norm, iter < m_maxiters);
 	}
 
 	scene.getV().segment(0, ndof_elasto) = m_v_plus;
@@ -1696,6 +1716,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCGCoSolve( TwoDScene& s
 
 			std::cout << "[pcg total iter: " << iter << ", res: " << res_norm << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto", iter, res_norm, iter < m_maxiters);
 	}
 
 	return true;
@@ -1711,7 +1733,9 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 	scalar res_norm_0 = lengthNodeVectors(m_node_rhs_x, m_node_rhs_y, m_node_rhs_z);
 	scalar res_norm_1 = m_angular_moment_buffer.norm();
 
-	if (res_norm_0 > m_pcg_criterion) {
+	if (res_norm_0 > m_pcg_criterion && scene.getLiquidInfo().use_pipelined_pcg) {
+		stepImplicitElastoPipelinedPCG(scene, dt, res_norm_0);
+	} else if (res_norm_0 > m_pcg_criterion) {
 		// build Hessian
 		constructHessianPreProcess(scene, dt);
 		constructHessianPostProcess(scene, dt);
@@ -1742,9 +1766,9 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 			          << ", abs. res: " << (res_norm * res_norm_0) << "/" << (m_pcg_criterion * res_norm_0)
 			          << "]" << std::endl;
 		} else {
-			performInvLocalSolve(scene, m_node_r_x, m_node_r_y, m_node_r_z,
-			                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
-			                     m_node_z_x, m_node_z_y, m_node_z_z);
+			scalar rho = performInvLocalSolveDot(scene, m_node_r_x, m_node_r_y, m_node_r_z,
+			                                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
+			                                     m_node_z_x, m_node_z_y, m_node_z_z);
 
 			buckets.for_each_bucket([&] (int bucket_idx) {
 				m_node_p_x[bucket_idx] = m_node_z_x[bucket_idx];
@@ -1757,20 +1781,10 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 			                      m_node_p_x, m_node_p_y, m_node_p_z,
 			                      m_node_q_x, m_node_q_y, m_node_q_z);
 
-			scalar rho = dotNodeVectors(m_node_r_x, m_node_r_y, m_node_r_z, m_node_z_x, m_node_z_y, m_node_z_z);
-
 			scalar alpha = rho / dotNodeVectors(m_node_p_x, m_node_p_y, m_node_p_z, m_node_q_x, m_node_q_y, m_node_q_z);
 
-			buckets.for_each_bucket([&] (int bucket_idx) {
-				m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
-				m_node_r_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
-				m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
-				m_node_r_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
-				m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
-				m_node_r_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
-			});
-
-			res_norm = lengthNodeVectors(m_node_r_x, m_node_r_y, m_node_r_z) / res_norm_0;
+			res_norm = addScaledNodeVectors(alpha, m_node_p_x, m_node_p_y, m_node_p_z, m_node_q_x, m_node_q_y, m_node_q_z,
+			                                m_node_v_plus_x, m_node_v_plus_y, m_node_v_plus_z, m_node_r_x, m_node_r_y, m_node_r_z) / res_norm_0;
 
 			const scalar rho_criterion = (m_pcg_criterion * res_norm_0) * (m_pcg_criterion * res_norm_0);
 
@@ -1779,11 +1793,9 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 			{
 				rho_old = rho;
 
-				performInvLocalSolve(scene, m_node_r_x, m_node_r_y, m_node_r_z,
-				                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
-				                     m_node_z_x, m_node_z_y, m_node_z_z);
-
-				rho = dotNodeVectors(m_node_r_x, m_node_r_y, m_node_r_z, m_node_z_x, m_node_z_y, m_node_z_z);
+				rho = performInvLocalSolveDot(scene, m_node_r_x, m_node_r_y, m_node_r_z,
+				                              m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
+				                              m_node_z_x, m_node_z_y, m_node_z_z);
 
 				beta = rho / rho_old;
 
@@ -1800,16 +1812,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 
 				alpha = rho / dotNodeVectors(m_node_p_x, m_node_p_y, m_node_p_z, m_node_q_x, m_node_q_y, m_node_q_z);
 
-				buckets.for_each_bucket([&] (int bucket_idx) {
-					m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
-					m_node_r_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
-					m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
-					m_node_r_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
-					m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
-					m_node_r_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
-				});
-
-				res_norm = lengthNodeVectors(m_node_r_x, m_node_r_y, m_node_r_z) / res_norm_0;
+				res_norm = addScaledNodeVectors(alpha, m_node_p_x, m_node_p_y, m_node_p_z, m_node_q_x, m_node_q_y, m_node_q_z,
+				                                m_node_v_plus_x, m_node_v_plus_y, m_node_v_plus_z, m_node_r_x, m_node_r_y, m_node_r_z) / res_norm_0;
 
 				if (scene.getLiquidInfo().iteration_print_step > 0 && iter % scene.getLiquidInfo().iteration_print_step == 0)
 					std::cout << "[pcg total iter: " << iter
@@ -1826,6 +1830,8 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 			          << ", rho: " << (rho / (res_norm_0 * res_norm_0)) << "/" << (rho_criterion / (res_norm_0 * res_norm_0))
 			          << ", abs. rho: " << rho << "/" << rho_criterion << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto", iter, res_norm, iter < m_maxiters);
 	}
 
 	if (res_norm_1 > m_pcg_criterion)
@@ -1913,10 +1919,167 @@ bool LinearizedImplicitEuler::stepImplicitElastoDiagonalPCG( TwoDScene& scene, s
 			          << ", rho: " << (rho / (res_norm_1 * res_norm_1)) << "/" << (rho_criterion / (res_norm_1 * res_norm_1))
 			          << ", abs. rho: " << rho << "/" << rho_criterion << "]" << std::endl;
 		}
+
+		profiler::Profiler::instance().recordSolve("elasto_angular", iter, res_norm, iter < m_maxiters);
 	}
 	return true;
 }
 
+// Pipelined PCG of Ghysels and Vanroose: s = Ap, q = M^-1 s and z = Aq are
+// updated by recurrences, so that every iteration takes one multiply and a
+// single fused pass over the node vectors that also yields (r, u), (w, u)
+// and |r| for the next iteration, instead of the two separate reductions
+// and the residual norm of the classical iteration.
+void LinearizedImplicitEuler::stepImplicitElastoPipelinedPCG( TwoDScene& scene, scalar dt, const scalar& res_norm_0 )
+{
+	const Sorter& buckets = scene.getParticleBuckets();
+	const int num_buckets = scene.getNumBuckets();
+
+	// build Hessian
+	constructHessianPreProcess(scene, dt);
+	constructHessianPostProcess(scene, dt);
+
+	// r, u = M^-1 r, w = Au, p, s = Ap, q = M^-1 s, z = Aq, m = M^-1 w, n = Am
+	allocateNodeVectors(scene, m_node_r_x, m_node_r_y, m_node_r_z);
+	allocateNodeVectors(scene, m_node_z_x, m_node_z_y, m_node_z_z);
+	allocateNodeVectors(scene, m_node_w_x, m_node_w_y, m_node_w_z);
+	allocateNodeVectors(scene, m_node_p_x, m_node_p_y, m_node_p_z);
+	allocateNodeVectors(scene, m_node_q_x, m_node_q_y, m_node_q_z);
+	allocateNodeVectors(scene, m_node_t_x, m_node_t_y, m_node_t_z);
+	allocateNodeVectors(scene, m_node_y_x, m_node_y_y, m_node_y_z);
+	allocateNodeVectors(scene, m_node_m_x, m_node_m_y, m_node_m_z);
+	allocateNodeVectors(scene, m_node_n_x, m_node_n_y, m_node_n_z);
+
+	performGlobalMultiply(scene, dt,
+	                      m_node_Cs_x, m_node_Cs_y, m_node_Cs_z,
+	                      m_node_v_plus_x, m_node_v_plus_y, m_node_v_plus_z,
+	                      m_node_r_x, m_node_r_y, m_node_r_z);
+
+	buckets.for_each_bucket([&] (int bucket_idx) {
+		m_node_r_x[bucket_idx] = m_node_rhs_x[bucket_idx] - m_node_r_x[bucket_idx];
+		m_node_r_y[bucket_idx] = m_node_rhs_y[bucket_idx] - m_node_r_y[bucket_idx];
+		m_node_r_z[bucket_idx] = m_node_rhs_z[bucket_idx] - m_node_r_z[bucket_idx];
+	});
+
+	performInvLocalSolve(scene, m_node_r_x, m_node_r_y, m_node_r_z,
+	                     m_node_inv_Cs_x, m_node_inv_Cs_y, m_node_inv_Cs_z,
+	                     m_node_z_x, m_node_z_y, m_node_z_z);
+
+	performGlobalMultiply(scene, dt,
+	                      m_node_Cs_x, m_node_Cs_y, m_node_Cs_z,
+	                      m_node_z_x, m_node_z_y, m_node_z_z,
+	                      m_node_w_x, m_node_w_y, m_node_w_z);
+
+	// (r, u), (w, u), (r, r) of a bucket, and m = M^-1 w
+	MatrixXs bucket_sums(num_buckets, 3);
+
+	auto reduce_bucket = [&] (int bucket_idx) {
+		if (!scene.isBucketActivated(bucket_idx)) {
+			bucket_sums.row(bucket_idx).setZero();
+			return;
+		}
+
+		m_node_m_x[bucket_idx] = m_node_w_x[bucket_idx].cwiseProduct(m_node_inv_Cs_x[bucket_idx]);
+		m_node_m_y[bucket_idx] = m_node_w_y[bucket_idx].cwiseProduct(m_node_inv_Cs_y[bucket_idx]);
+		m_node_m_z[bucket_idx] = m_node_w_z[bucket_idx].cwiseProduct(m_node_inv_Cs_z[bucket_idx]);
+
+		bucket_sums(bucket_idx, 0) = m_node_r_x[bucket_idx].dot(m_node_z_x[bucket_idx]) + m_node_r_y[bucket_idx].dot(m_node_z_y[bucket_idx]) + m_node_r_z[bucket_idx].dot(m_node_z_z[bucket_idx]);
+		bucket_sums(bucket_idx, 1) = m_node_w_x[bucket_idx].dot(m_node_z_x[bucket_idx]) + m_node_w_y[bucket_idx].dot(m_node_z_y[bucket_idx]) + m_node_w_z[bucket_idx].dot(m_node_z_z[bucket_idx]);
+		bucket_sums(bucket_idx, 2) = m_node_r_x[bucket_idx].squaredNorm() + m_node_r_y[bucket_idx].squaredNorm() + m_node_r_z[bucket_idx].squaredNorm();
+	};
+
+	buckets.for_each_bucket(reduce_bucket);
+
+	Vector3s sums = bucket_sums.colwise().sum().transpose();
+	scalar gamma = sums(0);
+	scalar delta = sums(1);
+	scalar res_norm = sqrt(sums(2)) / res_norm_0;
+
+	int iter = 0;
+
+	const scalar rho_criterion = (m_pcg_criterion * res_norm_0) * (m_pcg_criterion * res_norm_0);
+
+	if (res_norm < m_pcg_criterion) {
+		std::cout << "[pipelined pcg total iter: " << iter
+		          << ", res: " << res_norm << "/" << m_pcg_criterion
+		          << ", abs. res: " << (res_norm * res_norm_0) << "/" << (m_pcg_criterion * res_norm_0)
+		          << "]" << std::endl;
+	} else {
+		scalar gamma_old = gamma;
+		scalar alpha = 0.0;
+		scalar beta = 0.0;
+
+		for (; iter < m_maxiters && res_norm > m_pcg_criterion && gamma > rho_criterion; ++iter)
+		{
+			// n = Am
+			performGlobalMultiply(scene, dt,
+			                      m_node_Cs_x, m_node_Cs_y, m_node_Cs_z,
+			                      m_node_m_x, m_node_m_y, m_node_m_z,
+			                      m_node_n_x, m_node_n_y, m_node_n_z);
+
+			if (iter > 0) {
+				beta = gamma / gamma_old;
+				alpha = gamma / (delta - beta * gamma / alpha);
+			} else {
+				beta = 0.0;
+				alpha = gamma / delta;
+			}
+			gamma_old = gamma;
+
+			buckets.for_each_bucket([&] (int bucket_idx) {
+				m_node_y_x[bucket_idx] = m_node_n_x[bucket_idx] + m_node_y_x[bucket_idx] * beta;
+				m_node_y_y[bucket_idx] = m_node_n_y[bucket_idx] + m_node_y_y[bucket_idx] * beta;
+				m_node_y_z[bucket_idx] = m_node_n_z[bucket_idx] + m_node_y_z[bucket_idx] * beta;
+				m_node_t_x[bucket_idx] = m_node_m_x[bucket_idx] + m_node_t_x[bucket_idx] * beta;
+				m_node_t_y[bucket_idx] = m_node_m_y[bucket_idx] + m_node_t_y[bucket_idx] * beta;
+				m_node_t_z[bucket_idx] = m_node_m_z[bucket_idx] + m_node_t_z[bucket_idx] * beta;
+				m_node_q_x[bucket_idx] = m_node_w_x[bucket_idx] + m_node_q_x[bucket_idx] * beta;
+				m_node_q_y[bucket_idx] = m_node_w_y[bucket_idx] + m_node_q_y[bucket_idx] * beta;
+				m_node_q_z[bucket_idx] = m_node_w_z[bucket_idx] + m_node_q_z[bucket_idx] * beta;
+				m_node_p_x[bucket_idx] = m_node_z_x[bucket_idx] + m_node_p_x[bucket_idx] * beta;
+				m_node_p_y[bucket_idx] = m_node_z_y[bucket_idx] + m_node_p_y[bucket_idx] * beta;
+				m_node_p_z[bucket_idx] = m_node_z_z[bucket_idx] + m_node_p_z[bucket_idx] * beta;
+
+				m_node_v_plus_x[bucket_idx] += m_node_p_x[bucket_idx] * alpha;
+				m_node_v_plus_y[bucket_idx] += m_node_p_y[bucket_idx] * alpha;
+				m_node_v_plus_z[bucket_idx] += m_node_p_z[bucket_idx] * alpha;
+				m_node_r_x[bucket_idx] -= m_node_q_x[bucket_idx] * alpha;
+				m_node_r_y[bucket_idx] -= m_node_q_y[bucket_idx] * alpha;
+				m_node_r_z[bucket_idx] -= m_node_q_z[bucket_idx] * alpha;
+				m_node_z_x[bucket_idx] -= m_node_t_x[bucket_idx] * alpha;
+				m_node_z_y[bucket_idx] -= m_node_t_y[bucket_idx] * alpha;
+				m_node_z_z[bucket_idx] -= m_node_t_z[bucket_idx] * alpha;
+				m_node_w_x[bucket_idx] -= m_node_y_x[bucket_idx] * alpha;
+				m_node_w_y[bucket_idx] -= m_node_y_y[bucket_idx] * alpha;
+				m_node_w_z[bucket_idx] -= m_node_y_z[bucket_idx] * alpha;
+
+				// the single reduction of the iteration
+				reduce_bucket(bucket_idx);
+			});
+
+			sums = bucket_sums.colwise().sum().transpose();
+			gamma = sums(0);
+			delta = sums(1);
+			res_norm = sqrt(sums(2)) / res_norm_0;
+
+			if (scene.getLiquidInfo().iteration_print_step > 0 && iter % scene.getLiquidInfo().iteration_print_step == 0)
+				std::cout << "[pipelined pcg total iter: " << iter
+				          << ", res: " << res_norm << "/" << m_pcg_criterion
+				          << ", abs. res: " << (res_norm * res_norm_0) << "/" << (m_pcg_criterion * res_norm_0)
+				          << ", rho: " << (gamma / (res_norm_0 * res_norm_0)) << "/" << (rho_criterion / (res_norm_0 * res_norm_0))
+				          << ", abs. rho: " << gamma << "/" << rho_criterion << "]" << std::endl;
+		}
+
+		std::cout << "[pipelined pcg total iter: " << iter
+		          << ", res: " << res_norm << "/" << m_pcg_criterion
+		          << ", abs. res: " << (res_norm * res_norm_0) << "/" << (m_pcg_criterion * res_norm_0)
+		          << ", rho: " << (gamma / (res_norm_0 * res_norm_0)) << "/" << (rho_criterion / (res_norm_0 * res_norm_0))
+		          << ", abs. rho: " << gamma << "/" << rho_criterion << "]" << std::endl;
+	}
+
+	profiler::Profiler::instance().recordSolve("elasto", iter, res_norm, iter < m_maxiters);
+}
+
 bool LinearizedImplicitEuler::stepImplicitViscosityDiagonalPCG( const TwoDScene& scene,
         const std::vector< VectorXs >& node_vel_src_x,
         const std::vector< VectorXs >& node_vel_src_y,
@@ -1926,6 +2089,8 @@ bool LinearizedImplicitEuler::stepImplicitViscosityDiagonalPCG( const TwoDScene&
         std::vector< VectorXs >& node_vel_z,
         const scalar& dt )
 {
+	profiler::ScopedTimer timer("solveViscosity");
+
 	allocateNodeVectors(scene, m_node_visc_indices_x, m_node_visc_indices_y, m_node_visc_indices_z);
 
 	int offset_nodes_x;
@@ -1934,6 +2099,13 @@ bool LinearizedImplicitEuler::stepImplicitViscosityDiagonalPCG( const TwoDScene&
 
 	const scalar sub_dt = dt / (scalar) m_viscosity_substeps;
 
+	auto gather_guess = [&] (const std::vector< Vector2i >& effective_node_indices, const std::vector< VectorXs >& node_vel, int offset) {
+		threadutils::for_each(0, (int) effective_node_indices.size(), [&] (int dof_idx) {
+			const Vector2i& dof_loc = effective_node_indices[dof_idx];
+			m_visc_solution[dof_idx + offset] = node_vel[dof_loc[0]][dof_loc[1]];
+		});
+	};
+
 	for (int i = 0; i < m_viscosity_substeps; ++i)
 	{
 		if (i == 0) {
@@ -1953,14 +2125,28 @@ bool LinearizedImplicitEuler::stepImplicitViscosityDiagonalPCG( const TwoDScene&
 		int iter_out;
 		scalar residual;
 
+		const bool warm_start = scene.getLiquidInfo().use_warm_start &&
+		                        m_visc_rhs.size() == m_effective_node_indices_x.size() + m_effective_node_indices_y.size() + m_effective_node_indices_z.size();
+
+		if (warm_start) {
+			// start from the source velocity, i.e. the result of the previous
+			// viscosity sub-step or the velocity transferred from the particles
+			m_visc_solution.resize(m_visc_rhs.size());
+			gather_guess(m_effective_node_indices_x, node_vel_src_x, offset_nodes_x);
+			gather_guess(m_effective_node_indices_y, node_vel_src_y, offset_nodes_y);
+			gather_guess(m_effective_node_indices_z, node_vel_src_z, offset_nodes_z);
+		}
+
 		viscosity::applyNodeViscosityImplicit(scene, m_node_visc_indices_x, m_node_visc_indices_y, m_node_visc_indices_z,
 		                                      offset_nodes_x, offset_nodes_y, offset_nodes_z,
-		                                      m_visc_matrix, m_visc_rhs, m_visc_solution,
+		                                      m_visc_matrix, *m_visc_solver, m_visc_rhs, m_visc_solution,
 		                                      node_vel_x, node_vel_y, node_vel_z,
 		                                      residual, iter_out,
-		                                      m_viscous_criterion, m_maxiters);
+		                                      m_viscous_criterion, m_maxiters,
+		                                      warm_start);
 
 		std::cout << "[implicit viscosity sub-step: " << i << ", total iter: " << iter_out << ", res: " << residual << "]" << std::endl;
+		profiler::Profiler::instance().recordSolve("viscosity", iter_out, residual, iter_out < m_maxiters);
 	}
 
 
@@ -2096,11 +2282,14 @@ bool LinearizedImplicitEuler::stepImplicitElastoAMGPCG( TwoDScene& scene, scalar
 		scalar tolerance = 0.0;
 		int iterations = 0;
 
-		success = AMGPCGSolveSparse(m_H, m_elasto_rhs, m_elasto_result,
-		                            m_dof_ijk, m_pcg_criterion, m_maxiters,
-		                            tolerance, iterations, ni * 3, nj, nk);
+		m_elasto_amg->setMixedPrecision(scene.getLiquidInfo().use_mixed_precision_elasto);
+
+		success = m_elasto_amg->solve(m_H, m_elasto_rhs, m_elasto_result,
+		                              m_dof_ijk, m_pcg_criterion, m_maxiters,
+		                              tolerance, iterations, ni * 3, nj, nk);
 
 		std::cout << "[amg pcg elasto total iter: " << iterations << ", res: " << tolerance << "]" << std::endl;
+		profiler::Profiler::instance().recordSolve("elasto", iterations, tolerance, success);
 
 		if (!success) {
 			std::cout << "WARNING: AMG PCG solve failed!" << std::endl;
@@ -2135,9 +2324,11 @@ bool LinearizedImplicitEuler::stepImplicitElastoAMGPCG( TwoDScene& scene, scalar
 
 bool LinearizedImplicitEuler::stepImplicitElasto( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("stepImplicitElasto");
+
 	if (scene.getLiquidInfo().use_amgpcg_solid) {
 		return stepImplicitElastoAMGPCG(scene, dt);
-	} else if (scene.getLiquidInfo().use_pcr) {
+	} else if (scene.getLiquidInfo().use_pcr && !scene.getLiquidInfo().use_pipelined_pcg) {
 		return stepImplicitElastoDiagonalPCR(scene, dt);
 	} else {
 		if (scene.getLiquidInfo().use_cosolve_angular)
@@ -2149,6 +2340,8 @@ bool LinearizedImplicitEuler::stepImplicitElasto( TwoDScene& scene, scalar dt )
 
 bool LinearizedImplicitEuler::applyPressureDragElasto( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("applyPressureDragElasto");
+
 	if (scene.getNumFluidParticles() == 0) return false;
 
 	int ndof_elasto = scene.getNumSoftElastoParticles() * 4;
@@ -2231,6 +2424,8 @@ void LinearizedImplicitEuler::popElastoVelocity()
 
 bool LinearizedImplicitEuler::applyPressureDragFluid( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("applyPressureDragFluid");
+
 	if (scene.getNumFluidParticles() == 0) return false;
 
 	const std::vector< VectorXs >& node_mass_fluid_x = scene.getNodeFluidMassX();
@@ -2281,12 +2476,30 @@ bool LinearizedImplicitEuler::applyPressureDragFluid( TwoDScene& scene, scalar d
 
 bool LinearizedImplicitEuler::projectFine( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("projectFine");
+
 	if (scene.getNumFluidParticles() == 0) return false;
 
 	allocateCenterNodeVectors(scene, m_fine_global_indices);
 
+	const bool warm_start = scene.getLiquidInfo().use_warm_start;
+	if (warm_start) {
+		// start from the pressure of the previous substep
+		pressure::remapNodePressure(scene, m_prev_node_pressure, m_prev_bucket_origin, m_prev_num_buckets, scene.getNodePressure());
+	}
+
+	// the sub-cycles of the elastic objects reuse the pressure
+	const bool subcycling = scene.getLiquidInfo().elasto_subcycles > 1;
+	const bool keep_pressure = warm_start || subcycling;
+
+	std::vector< VectorXs > carried_pressure;
+	if (subcycling && !m_prev_node_pressure.empty()) {
+		carried_pressure = scene.getNodePressure();
+		if (!warm_start) pressure::remapNodePressure(scene, m_prev_node_pressure, m_prev_bucket_origin, m_prev_num_buckets, carried_pressure);
+	}
+
 	pressure::solveNodePressure(scene, scene.getNodePressure(), m_fine_pressure_rhs,
-	                            m_fine_pressure_matrix, m_fine_global_indices,
+	                            m_fine_pressure_matrix, *m_pressure_amg, *m_pressure_gmg, m_fine_global_indices,
 	                            m_node_psi_fs_x, m_node_psi_fs_y, m_node_psi_fs_z,
 	                            m_node_psi_sf_x, m_node_psi_sf_y, m_node_psi_sf_z,
 	                            m_node_v_fluid_plus_x, m_node_v_fluid_plus_y, m_node_v_fluid_plus_z,
@@ -2297,6 +2510,27 @@ bool LinearizedImplicitEuler::projectFine( TwoDScene& scene, scalar dt )
 	                            m_node_mshdvm_hdvm_x, m_node_mshdvm_hdvm_y, m_node_mshdvm_hdvm_z,
 	                            dt, m_pressure_criterion, m_maxiters);
 
+	if (carried_pressure.empty()) {
+		m_pressure_change = std::numeric_limits<scalar>::infinity();
+	} else {
+		const std::vector< VectorXs >& node_pressure = scene.getNodePressure();
+		scalar change = 0.0;
+		scalar norm = 0.0;
+		for (int i = 0; i < (int) node_pressure.size(); ++i) {
+			if (carried_pressure[i].size() != node_pressure[i].size()) continue;
+			change += (node_pressure[i] - carried_pressure[i]).squaredNorm();
+			norm += node_pressure[i].squaredNorm();
+		}
+		m_pressure_change = sqrt(change) / std::max(1e-20, sqrt(norm));
+	}
+
+	if (keep_pressure) {
+		const Sorter& buckets = scene.getParticleBuckets();
+		m_prev_node_pressure = scene.getNodePressure();
+		m_prev_bucket_origin = pressure::getBucketOrigin(scene);
+		m_prev_num_buckets = Vector3i(buckets.ni, buckets.nj, buckets.nk);
+	}
+
 #ifdef CHECK_EQU_24
 	pushFluidVelocity();
 	pushElastoVelocity();
@@ -2358,11 +2592,68 @@ bool LinearizedImplicitEuler::projectFine( TwoDScene& scene, scalar dt )
 	return true;
 }
 
+bool LinearizedImplicitEuler::reuseProjection( TwoDScene& scene, scalar dt )
+{
+	profiler::ScopedTimer timer("reuseProjection");
+
+	if (scene.getNumFluidParticles() == 0) return false;
+
+	if (m_prev_node_pressure.empty()) return projectFine(scene, dt);
+
+	pressure::remapNodePressure(scene, m_prev_node_pressure, m_prev_bucket_origin, m_prev_num_buckets, scene.getNodePressure());
+
+	return true;
+}
+
+scalar LinearizedImplicitEuler::getPressureChange() const
+{
+	return m_pressure_change;
+}
+
 std::string LinearizedImplicitEuler::getName() const
 {
 	return "Linearized Implicit Euler";
 }
 
+void LinearizedImplicitEuler::writeCheckpoint( checkpoint::Writer& writer ) const
+{
+	// the pressure warm start, per bucket
+	const int num_buckets = (int) m_prev_node_pressure.size();
+	std::vector<int> sizes(num_buckets);
+	std::vector<scalar> pressure;
+	for (int i = 0; i < num_buckets; ++i) {
+		sizes[i] = (int) m_prev_node_pressure[i].size();
+		pressure.insert(pressure.end(), m_prev_node_pressure[i].data(), m_prev_node_pressure[i].data() + sizes[i]);
+	}
+
+	writer.writeValue("stepper/prev_bucket_origin", m_prev_bucket_origin);
+	writer.writeValue("stepper/prev_num_buckets", m_prev_num_buckets);
+	writer.writeVector("stepper/prev_pressure_sizes", sizes);
+	writer.writeVector("stepper/prev_pressure", pressure);
+}
+
+bool LinearizedImplicitEuler::readCheckpoint( checkpoint::Reader& reader )
+{
+	std::vector<int> sizes;
+	std::vector<scalar> pressure;
+	if (!reader.readValue("stepper/prev_bucket_origin", m_prev_bucket_origin) ||
+	        !reader.readValue("stepper/prev_num_buckets", m_prev_num_buckets) ||
+	        !reader.readVector("stepper/prev_pressure_sizes", sizes) ||
+	        !reader.readVector("stepper/prev_pressure", pressure)) return false;
+
+	const int num_buckets = (int) sizes.size();
+	m_prev_node_pressure.resize(num_buckets);
+
+	size_t offset = 0;
+	for (int i = 0; i < num_buckets; ++i) {
+		if (offset + sizes[i] > pressure.size()) return false;
+		m_prev_node_pressure[i] = Eigen::Map<const VectorXs>(pressure.data() + offset, sizes[i]);
+		offset += sizes[i];
+	}
+
+	return offset == pressure.size();
+}
+
 void LinearizedImplicitEuler::zeroFixedDoFs( const TwoDScene& scene, VectorXs& vec )
 {
 	int nprts = scene.getNumParticles();
@@ -2374,6 +2665,8 @@ void LinearizedImplicitEuler::zeroFixedDoFs( const TwoDScene& scene, VectorXs& v
 
 bool LinearizedImplicitEuler::manifoldPropagate( TwoDScene& scene, scalar dt )
 {
+	profiler::ScopedTimer timer("manifoldPropagate");
+
 	const scalar subdt = dt / (scalar) m_manifold_substeps;
 
 	VectorXs& fluid_vol = scene.getFluidVol();
@@ -2573,6 +2866,7 @@ bool LinearizedImplicitEuler::manifoldPropagate( TwoDScene& scene, scalar dt )
 	}
 
 	std::cout << "[manifold propagate avg iter: " << ((scalar) total_iter / (scalar) m_manifold_substeps) << ", avg res: " << sqrt(total_res / (scalar) m_manifold_substeps) << "]" << std::endl;
+	profiler::Profiler::instance().recordSolve("manifold", total_iter, sqrt(total_res / (scalar) m_manifold_substeps));
 
 	return true;
 }
@@ -16,8 +16,20 @@
 #include "MathUtilities.h"
 #include "StringUtilities.h"
 #include "array3.h"
+#include "BlockSparseMatrix.h"
 #include "pcgsolver/sparse_matrix.h"
 
+template<class T>
+class AMGPCGSolver;
+
+template<class T>
+class GMGPCGSolver;
+
+namespace robertbridson {
+template<class T>
+struct PCGSolver;
+}
+
 class LinearizedImplicitEuler : public SceneStepper
 {
 public:
@@ -33,6 +45,10 @@ public:
 
   virtual bool projectFine( TwoDScene& scene, scalar dt );
 
+  virtual bool reuseProjection( TwoDScene& scene, scalar dt );
+
+  virtual scalar getPressureChange() const;
+
   virtual bool acceptVelocity( TwoDScene& scene );
 
   virtual bool stepImplicitElasto( TwoDScene& scene, scalar dt );
@@ -43,6 +59,9 @@ public:
 
   virtual bool stepImplicitElastoDiagonalPCG( TwoDScene& scene, scalar dt );
 
+  // translational part of stepImplicitElastoDiagonalPCG, with a single reduction per iteration
+  void stepImplicitElastoPipelinedPCG( TwoDScene& scene, scalar dt, const scalar& res_norm_0 );
+
   virtual bool stepImplicitViscosityDiagonalPCG( const TwoDScene& scene,
       const std::vector< VectorXs >& node_vel_src_x,
       const std::vector< VectorXs >& node_vel_src_y,
@@ -79,6 +98,10 @@ public:
 
   virtual std::string getName() const;
 
+  virtual void writeCheckpoint( checkpoint::Writer& writer ) const;
+
+  virtual bool readCheckpoint( checkpoint::Reader& reader );
+
 private:
   void zeroFixedDoFs( const TwoDScene& scene, VectorXs& vec );
 
@@ -115,6 +138,21 @@ private:
                              std::vector< VectorXs >& out_node_vec_y,
                              std::vector< VectorXs >& out_node_vec_z );
 
+  // performInvLocalSolve fused with the dot product of rhs and out, which it returns
+  scalar performInvLocalSolveDot( const TwoDScene& scene,
+                                  const std::vector< VectorXs >& node_rhs_x,
+                                  const std::vector< VectorXs >& node_rhs_y,
+                                  const std::vector< VectorXs >& node_rhs_z,
+                                  const std::vector< VectorXs >& node_inv_mass_x,
+                                  const std::vector< VectorXs >& node_inv_mass_y,
+                                  const std::vector< VectorXs >& node_inv_mass_z,
+                                  std::vector< VectorXs >& out_node_vec_x,
+                                  std::vector< VectorXs >& out_node_vec_y,
+                                  std::vector< VectorXs >& out_node_vec_z );
+
+  // x += alpha * p, r -= alpha * z and t -= alpha * q of the PCR iteration in one pass, returns |t|
+  scalar updatePCRVectors( const TwoDScene& scene, const scalar& alpha );
+
   void performGroupedLocalSolve( const TwoDScene& scene,
                                  const std::vector< VectorXs >& node_rhs_x,
                                  const std::vector< VectorXs >& node_rhs_y,
@@ -279,6 +317,7 @@ private:
   std::vector< std::pair<int, int> > m_angular_triA_sup;
   TripletXs m_triA;
   TripletXs m_angular_triA;
+  BlockSparseMatrix4 m_blockA;
   VectorXs m_multiply_buffer;
   VectorXs m_pre_mult_buffer;
 
@@ -329,6 +368,15 @@ private:
   std::vector< VectorXs > m_node_t_x; // t
   std::vector< VectorXs > m_node_t_y;
   std::vector< VectorXs > m_node_t_z;
+  std::vector< VectorXs > m_node_m_x; // m = M^-1 w, for pipelined PCG
+  std::vector< VectorXs > m_node_m_y;
+  std::vector< VectorXs > m_node_m_z;
+  std::vector< VectorXs > m_node_n_x; // n = Am
+  std::vector< VectorXs > m_node_n_y;
+  std::vector< VectorXs > m_node_n_z;
+  std::vector< VectorXs > m_node_y_x; // z = Aq of pipelined PCG, whose u is in m_node_z_*
+  std::vector< VectorXs > m_node_y_y;
+  std::vector< VectorXs > m_node_y_z;
 
   VectorXs m_angular_r;
   VectorXs m_angular_z;
@@ -474,9 +522,17 @@ private:
   robertbridson::SparseMatrix<scalar> m_arr_pressure_matrix;
 
   std::vector<double> m_fine_pressure_rhs;
-  robertbridson::SparseMatrix<scalar> m_fine_pressure_matrix;
+  robertbridson::FixedSparseMatrix<scalar> m_fine_pressure_matrix;
+  std::shared_ptr< AMGPCGSolver<scalar> > m_pressure_amg;
+  std::shared_ptr< GMGPCGSolver<scalar> > m_pressure_gmg;
   std::vector< VectorXi > m_fine_global_indices;
 
+  // pressure of the previous substep and its bucket grid, for warm starts
+  std::vector< VectorXs > m_prev_node_pressure;
+  Vector3i m_prev_bucket_origin;
+  Vector3i m_prev_num_buckets;
+  scalar m_pressure_change;
+
   SparseXs m_A;
   std::vector< VectorXi > m_node_global_indices_x;
   std::vector< VectorXi > m_node_global_indices_y;
@@ -490,6 +546,7 @@ private:
   std::vector< double > m_elasto_rhs;
   std::vector< double > m_elasto_result;
   robertbridson::SparseMatrix<scalar> m_H;
+  std::shared_ptr< AMGPCGSolver<scalar> > m_elasto_amg;
 
   VectorXs m_lagrangian_rhs;
   VectorXs m_v_plus;
@@ -505,6 +562,7 @@ private:
   std::vector< VectorXi > m_node_visc_indices_z;
 
   robertbridson::SparseMatrix<scalar> m_visc_matrix;
+  std::shared_ptr< robertbridson::PCGSolver<scalar> > m_visc_solver;
   std::vector< scalar > m_visc_rhs;
   std::vector< scalar > m_visc_solution;
 
@@ -20,6 +20,12 @@ bool approxSymmetric( const MatrixXs& A, const scalar& eps )
 	return true;
 }
 
+std::mt19937& randomEngine()
+{
+	static std::mt19937 engine;
+	return engine;
+}
+
 scalar scalarRand( const scalar min, const scalar max )
 {
 	static thread_local std::mt19937 generator;
@@ -12,6 +12,8 @@
 
 #include <Eigen/Core>
 #include "MathDefs.h"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <random>
 #include <string>
@@ -240,12 +242,68 @@ inline void swap(Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic>& v, int i, int
 	v.template block<K, K>(j * K, 0) = c;
 }
 
+// Moves the K-segments [begin, begin + order.size()) of v so that segment
+// begin + i becomes the old segment begin + order[i]
+template<typename S, int K>
+inline void permute(Eigen::Matrix<S, Eigen::Dynamic, 1>& v, int begin, const std::vector<int>& order)
+{
+	const int n = (int) order.size();
+	Eigen::Matrix<S, Eigen::Dynamic, 1> c(n * K);
+	for (int i = 0; i < n; ++i) c.template segment<K>(i * K) = v.template segment<K>((begin + order[i]) * K);
+	v.segment(begin * K, n * K) = c;
+}
+
+template<typename S, int K>
+inline void permute(Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic>& v, int begin, const std::vector<int>& order)
+{
+	const int n = (int) order.size();
+	Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic> c(n * K, v.cols());
+	for (int i = 0; i < n; ++i) c.middleRows(i * K, K) = v.middleRows((begin + order[i]) * K, K);
+	v.middleRows(begin * K, n * K) = c;
+}
+
+template<typename T, typename A>
+inline void permute(std::vector<T, A>& v, int begin, const std::vector<int>& order)
+{
+	const int n = (int) order.size();
+	std::vector<T, A> c(n);
+	for (int i = 0; i < n; ++i) c[i] = std::move(v[begin + order[i]]);
+	std::move(c.begin(), c.end(), v.begin() + begin);
+}
+
+// spreads the lower 21 bits of x to every third bit
+inline uint64_t spreadBits3( uint64_t x )
+{
+	x &= 0x1fffffULL;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+
+// Morton (Z-order) code of a non-negative grid location
+inline uint64_t mortonCode( int i, int j, int k )
+{
+	return spreadBits3((uint64_t) i) | spreadBits3((uint64_t) j) << 1 | spreadBits3((uint64_t) k) << 2;
+}
+
+// Engine of the random choices made on the simulation thread, kept apart
+// from std::rand so that its state can be saved in checkpoints
+std::mt19937& randomEngine();
+
+inline int randomInt( int n )
+{
+	return (int) (randomEngine()() % (unsigned int) n);
+}
+
 inline void fisherYates( int n, std::vector<int>& indices )
 {
 	indices.resize(n);
 	for (int i = 0; i < n; ++i) indices[i] = i;
 	for (int i = n - 1; i >= 1; --i) {
-		const int j = rand() % (i + 1);
+		const int j = randomInt(i + 1);
 		std::swap(indices[i], indices[j]);
 	}
 }
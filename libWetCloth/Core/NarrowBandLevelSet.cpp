@@ -0,0 +1,173 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "NarrowBandLevelSet.h"
+#include "array3_utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const char cache_magic[8] = {'W', 'C', 'N', 'B', 'L', 'S', '0', '1'};
+}
+
+NarrowBandLevelSet::NarrowBandLevelSet()
+	: ni(0), nj(0), nk(0), nti(0), ntj(0), ntk(0), background(0.0)
+{}
+
+void NarrowBandLevelSet::resize( int ni_, int nj_, int nk_, scalar background_ )
+{
+	ni = ni_;
+	nj = nj_;
+	nk = nk_;
+	nti = (ni + tile_size - 1) / tile_size;
+	ntj = (nj + tile_size - 1) / tile_size;
+	ntk = (nk + tile_size - 1) / tile_size;
+	background = background_;
+
+	const int num_tiles = nti * ntj * ntk;
+	tiles.assign(num_tiles, -1);
+	signs.assign(num_tiles, 1);
+	values.clear();
+	coarse.resize(nti + 1, ntj + 1, ntk + 1);
+	coarse.assign(background);
+}
+
+void NarrowBandLevelSet::clear()
+{
+	resize(0, 0, 0, 0.0);
+}
+
+int NarrowBandLevelSet::tileIndex( int ti, int tj, int tk ) const
+{
+	return (tk * ntj + tj) * nti + ti;
+}
+
+int NarrowBandLevelSet::getNumBandTiles() const
+{
+	return (int) (values.size() / tile_nodes);
+}
+
+int NarrowBandLevelSet::tileOffset( int i, int j, int k )
+{
+	return ((k % tile_size) * tile_size + (j % tile_size)) * tile_size + (i % tile_size);
+}
+
+scalar NarrowBandLevelSet::coarseValue( int i, int j, int k ) const
+{
+	const scalar inv_tile = 1.0 / (scalar) tile_size;
+	return interpolate_value(Vector3s(i * inv_tile, j * inv_tile, k * inv_tile), coarse);
+}
+
+scalar NarrowBandLevelSet::operator()( int i, int j, int k ) const
+{
+	const int t = tileIndex(i / tile_size, j / tile_size, k / tile_size);
+	const int block = tiles[t];
+
+	if (block >= 0) {
+		return values[(size_t) block * tile_nodes + tileOffset(i, j, k)];
+	}
+
+	return (scalar) signs[t] * std::max(background, coarseValue(i, j, k));
+}
+
+scalar NarrowBandLevelSet::interpolate( const Vector3s& point ) const
+{
+	int i, j, k;
+	scalar fi, fj, fk;
+
+	get_barycentric(point[0], i, fi, 0, ni);
+	get_barycentric(point[1], j, fj, 0, nj);
+	get_barycentric(point[2], k, fk, 0, nk);
+
+	return trilerp(
+	           (*this)(i, j, k), (*this)(i + 1, j, k), (*this)(i, j + 1, k), (*this)(i + 1, j + 1, k),
+	           (*this)(i, j, k + 1), (*this)(i + 1, j, k + 1), (*this)(i, j + 1, k + 1), (*this)(i + 1, j + 1, k + 1),
+	           fi, fj, fk);
+}
+
+void NarrowBandLevelSet::write( std::ostream& output ) const
+{
+	const int num_tiles = (int) tiles.size();
+	const int num_band_tiles = getNumBandTiles();
+
+	output.write(cache_magic, sizeof(cache_magic));
+	output.write((char*) &ni, sizeof(int));
+	output.write((char*) &nj, sizeof(int));
+	output.write((char*) &nk, sizeof(int));
+	output.write((char*) &background, sizeof(scalar));
+	output.write((char*) &num_band_tiles, sizeof(int));
+
+	if (num_tiles) {
+		output.write((char*) &tiles[0], num_tiles * sizeof(int));
+		output.write((char*) &signs[0], num_tiles * sizeof(signed char));
+	}
+	if (num_band_tiles) output.write((char*) &values[0], values.size() * sizeof(scalar));
+
+	write_binary_array(output, coarse);
+}
+
+bool NarrowBandLevelSet::read( std::istream& input, int ni_, int nj_, int nk_ )
+{
+	char magic[sizeof(cache_magic)];
+	input.read(magic, sizeof(magic));
+	if (!input.good() || std::memcmp(magic, cache_magic, sizeof(cache_magic)) != 0) return false;
+
+	int file_ni, file_nj, file_nk, num_band_tiles;
+	scalar background_;
+	input.read((char*) &file_ni, sizeof(int));
+	input.read((char*) &file_nj, sizeof(int));
+	input.read((char*) &file_nk, sizeof(int));
+	input.read((char*) &background_, sizeof(scalar));
+	input.read((char*) &num_band_tiles, sizeof(int));
+	if (!input.good() || file_ni != ni_ || file_nj != nj_ || file_nk != nk_) return false;
+
+	resize(ni_, nj_, nk_, background_);
+
+	const int num_tiles = (int) tiles.size();
+	if (num_band_tiles < 0 || num_band_tiles > num_tiles) {
+		clear();
+		return false;
+	}
+
+	if (num_tiles) {
+		input.read((char*) &tiles[0], num_tiles * sizeof(int));
+		input.read((char*) &signs[0], num_tiles * sizeof(signed char));
+	}
+
+	for (int t = 0; t < num_tiles; ++t) {
+		if (tiles[t] < -1 || tiles[t] >= num_band_tiles) {
+			clear();
+			return false;
+		}
+	}
+
+	values.resize((size_t) num_band_tiles * tile_nodes);
+	if (num_band_tiles) input.read((char*) &values[0], values.size() * sizeof(scalar));
+
+	// the coarse grid has a node at every tile corner, as resize made it
+	int coarse_ni, coarse_nj, coarse_nk;
+	input.read((char*) &coarse_ni, sizeof(int));
+	input.read((char*) &coarse_nj, sizeof(int));
+	input.read((char*) &coarse_nk, sizeof(int));
+	if (!input.good() || coarse_ni != coarse.ni || coarse_nj != coarse.nj || coarse_nk != coarse.nk) {
+		clear();
+		return false;
+	}
+
+	input.read((char*) &coarse.a[0], coarse.a.size() * sizeof(scalar));
+
+	if (!input.good()) {
+		clear();
+		return false;
+	}
+
+	return true;
+}
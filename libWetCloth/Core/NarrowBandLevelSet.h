@@ -0,0 +1,68 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef NARROW_BAND_LEVEL_SET_H
+#define NARROW_BAND_LEVEL_SET_H
+
+#include <iostream>
+#include <vector>
+
+#include "MathDefs.h"
+#include "array3.h"
+
+// Signed distance sampled on ni x nj x nk nodes, split into cubic tiles of
+// tile_size nodes per side. Only the tiles within the narrow band of the
+// surface store their nodes. Every other tile keeps just its sign, and its
+// magnitude comes from a coarse unsigned distance grid with a node at each
+// tile corner, never less than the band width.
+struct NarrowBandLevelSet
+{
+	static const int tile_size = 8;
+	static const int tile_nodes = tile_size * tile_size * tile_size;
+
+	NarrowBandLevelSet();
+
+	// drops every tile from the band, all positive
+	void resize( int ni_, int nj_, int nk_, scalar background_ );
+
+	void clear();
+
+	int tileIndex( int ti, int tj, int tk ) const;
+
+	int getNumBandTiles() const;
+
+	// index of the node in the values of its band tile
+	static int tileOffset( int i, int j, int k );
+
+	scalar operator()( int i, int j, int k ) const;
+
+	// unsigned distance from the coarse grid, at a node
+	scalar coarseValue( int i, int j, int k ) const;
+
+	// trilinear interpolation at a point in grid coordinates, clamped to the
+	// grid like interpolate_value on Array3
+	scalar interpolate( const Vector3s& point ) const;
+
+	void write( std::ostream& output ) const;
+
+	// returns false if the stream does not hold a narrow band level set of
+	// ni_ x nj_ x nk_ nodes, or holds a truncated or inconsistent one
+	bool read( std::istream& input, int ni_, int nj_, int nk_ );
+
+	int ni, nj, nk;
+	int nti, ntj, ntk;
+	scalar background; // the band width, and the least magnitude outside of it
+
+	std::vector<int> tiles; // per tile, the block in values or -1 outside of the band
+	std::vector<signed char> signs; // per tile outside of the band
+	std::vector<scalar> values; // tile_nodes per band tile, i fastest
+	Array3s coarse;
+};
+
+#endif
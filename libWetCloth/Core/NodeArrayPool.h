@@ -0,0 +1,129 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef NODE_ARRAY_POOL_H
+#define NODE_ARRAY_POOL_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/spin_mutex.h>
+
+#include "MathDefs.h"
+
+// Block allocator for the per-bucket node arrays. Every activated bucket
+// holds arrays of the same few sizes, so the storage of the arrays of
+// deactivated buckets is parked in a free list per size and handed to the
+// buckets activated next, instead of being freed and allocated again.
+template<typename VectorType>
+class NodeArrayFreeList
+{
+public:
+	NodeArrayFreeList()
+		: m_max_free_blocks(8192)
+	{}
+
+	NodeArrayFreeList( const NodeArrayFreeList& )
+		: m_max_free_blocks(8192)
+	{}
+
+	NodeArrayFreeList& operator=( const NodeArrayFreeList& )
+	{
+		return *this;
+	}
+
+	// resizes v to n entries; the content is left undefined, like resize()
+	void fit( VectorType& v, int n )
+	{
+		if ((int) v.size() == n) return;
+
+		{
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			if (v.size() > 0) {
+				std::vector<VectorType>& free_list = m_free[(int) v.size()];
+				if (free_list.size() < m_max_free_blocks) {
+					free_list.push_back(VectorType());
+					free_list.back().swap(v);
+				}
+			}
+
+			if (n > 0) {
+				auto itr = m_free.find(n);
+				if (itr != m_free.end() && !itr->second.empty()) {
+					v.swap(itr->second.back());
+					itr->second.pop_back();
+					return;
+				}
+			}
+		}
+
+		v.resize(n);
+	}
+
+	// resizes the bucket list, recycling the arrays of dropped buckets
+	void fitBuckets( std::vector<VectorType>& arrays, int num_buckets )
+	{
+		if ((int) arrays.size() == num_buckets) return;
+
+		for (int i = num_buckets; i < (int) arrays.size(); ++i) {
+			fit(arrays[i], 0);
+		}
+
+		arrays.resize(num_buckets);
+	}
+
+	size_t getNumFreeBlocks() const
+	{
+		size_t count = 0;
+		for (const auto& free_list : m_free) count += free_list.second.size();
+		return count;
+	}
+
+	void clear()
+	{
+		m_free.clear();
+	}
+
+private:
+	std::unordered_map< int, std::vector<VectorType> > m_free;
+	size_t m_max_free_blocks; // per size
+	tbb::spin_mutex m_mutex;
+};
+
+class NodeArrayPool
+{
+public:
+	void fit( VectorXs& v, int n ) { m_scalar.fit(v, n); }
+	void fit( VectorXi& v, int n ) { m_int.fit(v, n); }
+	void fit( VectorXuc& v, int n ) { m_uchar.fit(v, n); }
+
+	void fitBuckets( std::vector<VectorXs>& arrays, int num_buckets ) { m_scalar.fitBuckets(arrays, num_buckets); }
+	void fitBuckets( std::vector<VectorXi>& arrays, int num_buckets ) { m_int.fitBuckets(arrays, num_buckets); }
+	void fitBuckets( std::vector<VectorXuc>& arrays, int num_buckets ) { m_uchar.fitBuckets(arrays, num_buckets); }
+
+	size_t getNumFreeBlocks() const
+	{
+		return m_scalar.getNumFreeBlocks() + m_int.getNumFreeBlocks() + m_uchar.getNumFreeBlocks();
+	}
+
+	void clear()
+	{
+		m_scalar.clear();
+		m_int.clear();
+		m_uchar.clear();
+	}
+
+private:
+	NodeArrayFreeList<VectorXs> m_scalar;
+	NodeArrayFreeList<VectorXi> m_int;
+	NodeArrayFreeList<VectorXuc> m_uchar;
+};
+
+#endif
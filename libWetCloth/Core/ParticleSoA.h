@@ -0,0 +1,130 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef PARTICLE_SOA_H
+#define PARTICLE_SOA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "MathDefs.h"
+
+// Layout of ParticleSoA: 0 stores every component in its own contiguous
+// array (SoA); N > 0 interleaves the components in packets of N particles
+// (AoSoA), which keeps all components of a particle within a few cache lines.
+#ifndef PARTICLE_SOA_PACKET
+#define PARTICLE_SOA_PACKET 0
+#endif
+
+namespace soautils
+{
+const static int alignment = 64;
+
+// Allocator for cache-line aligned storage, independent of Eigen's alignment settings.
+template<typename T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	AlignedAllocator() {}
+	template<typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		void* raw = std::malloc(n * sizeof(T) + alignment + sizeof(void*));
+		if (!raw) throw std::bad_alloc();
+
+		std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* p, std::size_t)
+	{
+		if (p) std::free(reinterpret_cast<void**>(p)[-1]);
+	}
+
+	template<typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+}
+
+// D scalar components per particle, laid out according to PARTICLE_SOA_PACKET.
+template<int D>
+class ParticleSoA
+{
+public:
+	typedef Eigen::Matrix<scalar, D, 1> VectorDs;
+
+	const static int packet = PARTICLE_SOA_PACKET;
+
+	ParticleSoA() : m_size(0), m_stride(0) {}
+
+	void resize(int n)
+	{
+		m_size = n;
+		// round up to whole packets, which offset() fills, and then to whole
+		// cache lines so that every component array starts on one
+		const int line = soautils::alignment / (int) sizeof(scalar);
+#if PARTICLE_SOA_PACKET > 0
+		const int slots = (n + packet - 1) / packet * packet;
+#else
+		const int slots = n;
+#endif
+		m_stride = (slots + line - 1) / line * line;
+		m_data.resize((size_t) m_stride * D);
+	}
+
+	int size() const
+	{
+		return m_size;
+	}
+
+	inline size_t offset(int i, int c) const
+	{
+#if PARTICLE_SOA_PACKET > 0
+		return (size_t)(i / packet) * packet * D + c * packet + i % packet;
+#else
+		return (size_t) c * m_stride + i;
+#endif
+	}
+
+	inline scalar& operator()(int i, int c)
+	{
+		return m_data[offset(i, c)];
+	}
+
+	inline const scalar& operator()(int i, int c) const
+	{
+		return m_data[offset(i, c)];
+	}
+
+	inline VectorDs get(int i) const
+	{
+		VectorDs v;
+		for (int c = 0; c < D; ++c) v(c) = m_data[offset(i, c)];
+		return v;
+	}
+
+	template<typename Derived>
+	inline void set(int i, const Eigen::MatrixBase<Derived>& v)
+	{
+		for (int c = 0; c < D; ++c) m_data[offset(i, c)] = v(c);
+	}
+
+private:
+	int m_size;
+	int m_stride;
+	std::vector< scalar, soautils::AlignedAllocator<scalar> > m_data;
+};
+
+#endif
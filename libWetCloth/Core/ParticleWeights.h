@@ -0,0 +1,75 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef PARTICLE_WEIGHTS_H
+#define PARTICLE_WEIGHTS_H
+
+#include "MathDefs.h"
+#include "MathUtilities.h"
+
+// Store the 1D weights in single precision. Halves the storage again at the
+// cost of ~1e-7 relative error in the transfer weights.
+#ifndef PARTICLE_WEIGHTS_FLOAT
+#define PARTICLE_WEIGHTS_FLOAT 0
+#endif
+
+// Quadratic B-spline weights of a particle on the 3x3x3 node stencils of
+// the staggered grids. The kernel is separable, hence only the three 1D
+// weights along each axis are stored and the 27 weights are formed on access.
+// Node nidx of a stencil is ordered as in TwoDScene::findNodes, i.e.
+// nidx = k * 9 + j * 3 + i.
+class ParticleWeights
+{
+public:
+#if PARTICLE_WEIGHTS_FLOAT
+	typedef float weight_type;
+#else
+	typedef scalar weight_type;
+#endif
+
+	enum Grid
+	{
+		GRID_X = 0,
+		GRID_Y,
+		GRID_Z,
+		GRID_SOLID_PHI,
+		GRID_P,
+
+		NUM_GRIDS
+	};
+
+	// dx: (particle position - first node of the stencil) / cell size
+	inline void set( int grid, const Vector3s& dx )
+	{
+		for (int r = 0; r < 3; ++r) {
+			for (int a = 0; a < 3; ++a) {
+				m_w[grid][r][a] = (weight_type) mathutils::quad_kernel(dx(r) - (scalar) a);
+			}
+		}
+	}
+
+	inline scalar operator()( int nidx, int grid ) const
+	{
+		const int k = nidx / 9;
+		const int j = (nidx - k * 9) / 3;
+		const int i = nidx - k * 9 - j * 3;
+
+		return (scalar) m_w[grid][0][i] * (scalar) m_w[grid][1][j] * (scalar) m_w[grid][2][k];
+	}
+
+	inline int rows() const
+	{
+		return 27;
+	}
+
+private:
+	weight_type m_w[NUM_GRIDS][3][3];
+};
+
+#endif
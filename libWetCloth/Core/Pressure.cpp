@@ -12,6 +12,8 @@
 #include "ThreadUtils.h"
 #include "MathUtilities.h"
 #include "AlgebraicMultigrid.h"
+#include "GeometricMultigrid.h"
+#include "Profiler.h"
 
 #include <numeric>
 
@@ -22,6 +24,36 @@ const scalar theta_criterion = 0.01;
 namespace pressure
 {
 
+// One row of the 7-point pressure stencil. Entries are kept sorted by column
+// and merged in the same way as SparseMatrix::add_to_element.
+struct StencilRow
+{
+	int num_entries;
+	unsigned int index[7];
+	scalar value[7];
+
+	inline void add(unsigned int j, scalar v)
+	{
+		int k = 0;
+		for (; k < num_entries; ++k) {
+			if (index[k] == j) {
+				value[k] += v;
+				return;
+			} else if (index[k] > j) {
+				break;
+			}
+		}
+
+		for (int l = num_entries; l > k; --l) {
+			index[l] = index[l - 1];
+			value[l] = value[l - 1];
+		}
+		index[k] = j;
+		value[k] = v;
+		++num_entries;
+	}
+};
+
 void computePorePressureGrads(const TwoDScene& scene, std::vector< VectorXs >& rhs_vec_x, std::vector< VectorXs >& rhs_vec_y, std::vector< VectorXs >& rhs_vec_z, const std::vector< VectorXs >& node_vol_x, const std::vector< VectorXs >& node_vol_y, const std::vector< VectorXs >& node_vol_z, const scalar& dt)
 {
 	const Sorter& buckets = scene.getParticleBuckets();
@@ -222,7 +254,9 @@ void constructNodeIncompressibleCondition(const TwoDScene& scene,
 void solveNodePressure( const TwoDScene& scene,
                         std::vector< VectorXs >& pressure,
                         std::vector<double>& rhs,
-                        robertbridson::SparseMatrix<scalar>& matrix,
+                        robertbridson::FixedSparseMatrix<scalar>& matrix,
+                        AMGPCGSolver<scalar>& solver,
+                        GMGPCGSolver<scalar>& gmg_solver,
                         std::vector< VectorXi >& node_global_indices,
                         const std::vector< VectorXs >& node_psi_fs_x,
                         const std::vector< VectorXs >& node_psi_fs_y,
@@ -252,6 +286,8 @@ void solveNodePressure( const TwoDScene& scene,
                         const scalar& criterion,
                         int maxiters )
 {
+	profiler::ScopedTimer timer("solveNodePressure");
+
 	const Sorter& buckets = scene.getParticleBuckets();
 	const int bucket_num_cell = scene.getDefaultNumNodes();
 	const int ni = buckets.ni * bucket_num_cell;
@@ -324,23 +360,27 @@ void solveNodePressure( const TwoDScene& scene,
 	std::partial_sum(num_effective_nodes.begin(), num_effective_nodes.end(), num_effective_nodes.begin());
 
 	const int total_num_nodes = num_effective_nodes[num_effective_nodes.size() - 1];
-	if (total_num_nodes == 0) return;
+	if (total_num_nodes == 0) {
+		buckets.for_each_bucket([&] (int bucket_idx) {
+			pressure[bucket_idx].setZero();
+		});
+		return;
+	}
 
 	std::vector< Vector2i > effective_node_indices(total_num_nodes);
 	std::vector< Vector3i > dof_ijk(total_num_nodes);
 	std::vector< double > result(total_num_nodes);
 
+	// pressure holds the initial guess on entry when warm starting
+	const bool use_initial_guess = scene.getLiquidInfo().use_warm_start;
+
 	result.assign(total_num_nodes, 0.0);
-	buckets.for_each_bucket([&] (int bucket_idx) {
-		pressure[bucket_idx].setZero();
-	});
 
 	if ((int) rhs.size() != total_num_nodes) {
 		rhs.resize(total_num_nodes);
-		matrix.resize(total_num_nodes);
 	}
 
-	matrix.zero();
+	std::vector< StencilRow > stencil(total_num_nodes);
 
 	buckets.for_each_bucket([&] (int bucket_idx) {
 		if (!scene.isBucketActivated(bucket_idx)) return;
@@ -363,10 +403,18 @@ void solveNodePressure( const TwoDScene& scene,
 				                               handle(1) * bucket_num_cell + local_handle(1),
 				                               handle(2) * bucket_num_cell + local_handle(2)
 				                              );
+
+				if (use_initial_guess) {
+					result[global_idx] = pressure[bucket_idx][i];
+				}
 			}
 		}
 	});
 
+	buckets.for_each_bucket([&] (int bucket_idx) {
+		pressure[bucket_idx].setZero();
+	});
+
 	const scalar dx = scene.getCellSize();
 	const scalar coeff = dt / (dx * dx);
 
@@ -378,6 +426,9 @@ void solveNodePressure( const TwoDScene& scene,
 		const scalar center_phi = node_liquid_phi[bucket_idx][node_idx];
 		rhs[dof_idx] = 0.0;
 
+		StencilRow& row = stencil[dof_idx];
+		row.num_entries = 0;
+
 		const VectorXi& bucket_pn = pressure_neighbors[bucket_idx];
 
 		const int bucket_idx_left = bucket_pn[node_idx * 12 + 0];
@@ -411,12 +462,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_left >= 0);
 
 						if (dof_left >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_left, -term);
+							row.add(dof_idx, term);
+							row.add(dof_left, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, left_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -452,12 +503,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_right >= 0);
 
 						if (dof_right >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_right, -term);
+							row.add(dof_idx, term);
+							row.add(dof_right, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, right_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -493,12 +544,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_bottom >= 0);
 
 						if (dof_bottom >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_bottom, -term);
+							row.add(dof_idx, term);
+							row.add(dof_bottom, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, bottom_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -534,12 +585,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_top >= 0);
 
 						if (dof_top >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_top, -term);
+							row.add(dof_idx, term);
+							row.add(dof_top, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, top_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -575,12 +626,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_near >= 0);
 
 						if (dof_near >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_near, -term);
+							row.add(dof_idx, term);
+							row.add(dof_near, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, near_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -616,12 +667,12 @@ void solveNodePressure( const TwoDScene& scene,
 						assert(dof_far >= 0);
 
 						if (dof_far >= 0) {
-							matrix.add_to_element(dof_idx, dof_idx, term);
-							matrix.add_to_element(dof_idx, dof_far, -term);
+							row.add(dof_idx, term);
+							row.add(dof_far, -term);
 						}
 					} else {
 						const scalar theta = std::max(mathutils::fraction_inside(center_phi, far_phi), theta_criterion);
-						matrix.add_to_element(dof_idx, dof_idx, term / theta);
+						row.add(dof_idx, term / theta);
 					}
 				}
 			}
@@ -632,12 +683,72 @@ void solveNodePressure( const TwoDScene& scene,
 	scalar tolerance = 0.0;
 	int iterations = 0;
 
-	success = AMGPCGSolveSparse(matrix, rhs, result, dof_ijk, criterion, maxiters, tolerance, iterations, ni, nj, nk);
+	if (scene.getLiquidInfo().use_geometric_mg) {
+		// scatter the rows into the 7-point stencils of the geometric multigrid
+		std::vector< scalar > diag(total_num_nodes);
+		std::vector< scalar > offdiag(total_num_nodes * 6);
+
+		threadutils::for_each(0, total_num_nodes, [&] (int dof_idx) {
+			const StencilRow& row = stencil[dof_idx];
+			const Vector3i& ijk = dof_ijk[dof_idx];
+
+			diag[dof_idx] = 0.0;
+			for (int d = 0; d < 6; ++d) offdiag[dof_idx * 6 + d] = 0.0;
+
+			for (int k = 0; k < row.num_entries; ++k) {
+				const unsigned int j = row.index[k];
+				if (j == (unsigned int) dof_idx) {
+					diag[dof_idx] = row.value[k];
+					continue;
+				}
+
+				const Vector3i dijk = dof_ijk[j] - ijk;
+				const int axis = (dijk(0) != 0) ? 0 : ((dijk(1) != 0) ? 1 : 2);
+				offdiag[dof_idx * 6 + axis * 2 + (dijk(axis) > 0 ? 1 : 0)] = row.value[k];
+			}
+		});
+
+		{
+			profiler::ScopedTimer solve_timer("gmgpcg");
+			success = gmg_solver.solve(dof_ijk, diag, offdiag, rhs, result, criterion, maxiters, tolerance, iterations, use_initial_guess);
+		}
+
+		std::cout << "[gmg pcg total iter: " << iterations << ", res: " << tolerance << "]" << std::endl;
+	} else {
+		// compress the rows: prefix sum over the row sizes, then fill in parallel
+		matrix.resize(total_num_nodes);
+		matrix.rowstart[0] = 0;
+		for (int i = 0; i < total_num_nodes; ++i) {
+			matrix.rowstart[i + 1] = matrix.rowstart[i] + stencil[i].num_entries;
+		}
 
-	std::cout << "[amg pcg total iter: " << iterations << ", res: " << tolerance << "]" << std::endl;
+		matrix.value.resize(matrix.rowstart[total_num_nodes]);
+		matrix.colindex.resize(matrix.rowstart[total_num_nodes]);
+
+		threadutils::for_each(0, total_num_nodes, [&] (int dof_idx) {
+			const StencilRow& row = stencil[dof_idx];
+			const unsigned int start = matrix.rowstart[dof_idx];
+
+			for (int k = 0; k < row.num_entries; ++k) {
+				matrix.colindex[start + k] = row.index[k];
+				matrix.value[start + k] = row.value[k];
+			}
+		});
+
+		solver.setMixedPrecision(scene.getLiquidInfo().use_mixed_precision_pressure);
+
+		{
+			profiler::ScopedTimer solve_timer("amgpcg");
+			success = solver.solve(matrix, rhs, result, dof_ijk, criterion, maxiters, tolerance, iterations, ni, nj, nk, use_initial_guess);
+		}
+
+		std::cout << "[amg pcg total iter: " << iterations << ", res: " << tolerance << "]" << std::endl;
+	}
+
+	profiler::Profiler::instance().recordSolve("pressure", iterations, tolerance, success);
 
 	if (!success) {
-		std::cout << "WARNING: AMG PCG solve failed!" << std::endl;
+		std::cout << "WARNING: pressure PCG solve failed!" << std::endl;
 
 		std::cout << "rhs=[";
 		for (scalar s : rhs) {
@@ -664,6 +775,55 @@ void solveNodePressure( const TwoDScene& scene,
 	});
 }
 
+Vector3i getBucketOrigin( const TwoDScene& scene )
+{
+	const Vector3s& mincorner = scene.getBucketMinCorner();
+	const scalar bucket_size = scene.getBucketLength();
+
+	return Vector3i((int) floor(mincorner(0) / bucket_size + 0.5),
+	                (int) floor(mincorner(1) / bucket_size + 0.5),
+	                (int) floor(mincorner(2) / bucket_size + 0.5));
+}
+
+void remapNodeValues( const TwoDScene& scene,
+                      const std::vector< VectorXs >& old_values,
+                      const Vector3i& old_bucket_origin,
+                      const Vector3i& old_num_buckets,
+                      std::vector< VectorXs >& values,
+                      const scalar& fill )
+{
+	const Sorter& buckets = scene.getParticleBuckets();
+	const Vector3i offset = getBucketOrigin(scene) - old_bucket_origin;
+
+	buckets.for_each_bucket([&] (int bucket_idx) {
+		VectorXs& bucket_values = values[bucket_idx];
+		bucket_values.setConstant(fill);
+
+		const Vector3i old_handle = buckets.bucket_handle(bucket_idx) + offset;
+		if (old_handle(0) < 0 || old_handle(0) >= old_num_buckets(0) ||
+		        old_handle(1) < 0 || old_handle(1) >= old_num_buckets(1) ||
+		        old_handle(2) < 0 || old_handle(2) >= old_num_buckets(2)) return;
+
+		const int old_bucket_idx = (old_handle(2) * old_num_buckets(1) + old_handle(1)) * old_num_buckets(0) + old_handle(0);
+		if (old_bucket_idx >= (int) old_values.size()) return;
+
+		// node layout within a bucket does not change
+		const VectorXs& old_bucket_values = old_values[old_bucket_idx];
+		if (old_bucket_values.size() != bucket_values.size()) return;
+
+		bucket_values = old_bucket_values;
+	});
+}
+
+void remapNodePressure( const TwoDScene& scene,
+                        const std::vector< VectorXs >& old_pressure,
+                        const Vector3i& old_bucket_origin,
+                        const Vector3i& old_num_buckets,
+                        std::vector< VectorXs >& pressure )
+{
+	remapNodeValues(scene, old_pressure, old_bucket_origin, old_num_buckets, pressure, 0.0);
+}
+
 void multiplyPressureMatrix( const TwoDScene& scene, const std::vector< VectorXs >& node_vec, std::vector< VectorXs >& out_node_vec, const std::vector< VectorXs >& node_inv_mdv_x, const std::vector< VectorXs >& node_inv_mdv_y, const std::vector< VectorXs >& node_inv_mdv_z, const std::vector< VectorXs >& node_inv_mdvs_x, const std::vector< VectorXs >& node_inv_mdvs_y, const std::vector< VectorXs >& node_inv_mdvs_z, const scalar& dt )
 {
 	const Sorter& buckets = scene.getParticleBuckets();
@@ -18,6 +18,12 @@
 
 class TwoDScene;
 
+template<class T>
+class AMGPCGSolver;
+
+template<class T>
+class GMGPCGSolver;
+
 namespace pressure {
 void constructNodeIncompressibleCondition(const TwoDScene& scene,
     std::vector< VectorXs >& node_ic,
@@ -32,7 +38,9 @@ void multiplyPressureMatrix( const TwoDScene& scene, const std::vector< VectorXs
 void solveNodePressure( const TwoDScene& scene,
                         std::vector< VectorXs >& pressure,
                         std::vector<double>& rhs,
-                        robertbridson::SparseMatrix<scalar>& matrix,
+                        robertbridson::FixedSparseMatrix<scalar>& matrix,
+                        AMGPCGSolver<scalar>& solver,
+                        GMGPCGSolver<scalar>& gmg_solver,
                         std::vector< VectorXi >& node_global_indices,
                         const std::vector< VectorXs >& node_psi_fs_x,
                         const std::vector< VectorXs >& node_psi_fs_y,
@@ -62,6 +70,26 @@ void solveNodePressure( const TwoDScene& scene,
                         const scalar& criterion,
                         int maxiters );
 
+// Origin of the bucket grid of the scene, in buckets.
+Vector3i getBucketOrigin( const TwoDScene& scene );
+
+// Copy node values of a previous bucket grid (given by its origin and
+// dimensions) onto the current one, whose buckets are already sized.
+// Nodes of buckets that were not activated before get fill.
+void remapNodeValues( const TwoDScene& scene,
+                      const std::vector< VectorXs >& old_values,
+                      const Vector3i& old_bucket_origin,
+                      const Vector3i& old_num_buckets,
+                      std::vector< VectorXs >& values,
+                      const scalar& fill );
+
+// remapNodeValues for the node pressure, which is zero where it is new.
+void remapNodePressure( const TwoDScene& scene,
+                        const std::vector< VectorXs >& old_pressure,
+                        const Vector3i& old_bucket_origin,
+                        const Vector3i& old_num_buckets,
+                        std::vector< VectorXs >& pressure );
+
 
 void constructJacobiPreconditioner( const TwoDScene& scene, std::vector< VectorXs >& out_node_vec, const std::vector< VectorXs >& node_inv_mdv_x, const std::vector< VectorXs >& node_inv_mdv_y, const std::vector< VectorXs >& node_inv_mdv_z, const std::vector< VectorXs >& node_inv_mdvs_x, const std::vector< VectorXs >& node_inv_mdvs_y, const std::vector< VectorXs >& node_inv_mdvs_z, const scalar& dt );
 void allocateNodes( const TwoDScene& scene, std::vector< VectorXs >& out_node_vec );
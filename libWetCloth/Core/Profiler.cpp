@@ -0,0 +1,455 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+namespace profiler
+{
+
+namespace
+{
+// read without the lock by the scopes on worker threads
+std::atomic<std::thread::id> g_owner_thread;
+
+void writeString( std::ostream& os, const std::string& str )
+{
+	os << '"';
+	for (char c : str) {
+		switch (c) {
+		case '"': os << "\\\""; break;
+		case '\\': os << "\\\\"; break;
+		case '\n': os << "\\n"; break;
+		case '\t': os << "\\t"; break;
+		default: os << c; break;
+		}
+	}
+	os << '"';
+}
+}
+
+Profiler& Profiler::instance()
+{
+	static Profiler s_profiler;
+	return s_profiler;
+}
+
+Profiler::Profiler()
+	: m_enabled(true)
+	, m_trace_enabled(false)
+	, m_max_events(0)
+	, m_num_frames(0)
+	, m_num_substeps(0)
+	, m_frame_substeps(0)
+	, m_last_frame_substeps(0)
+	, m_current_substep(-1)
+	, m_origin(now())
+{}
+
+double Profiler::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setEnabled( bool enabled )
+{
+	m_enabled = enabled;
+}
+
+bool Profiler::isEnabled() const
+{
+	return m_enabled;
+}
+
+void Profiler::setTraceEnabled( bool enabled, int max_events )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_trace_enabled = enabled;
+	m_max_events = max_events;
+	if (enabled) m_events.reserve(std::min(max_events, 1 << 16));
+}
+
+bool Profiler::isTraceEnabled() const
+{
+	return m_trace_enabled;
+}
+
+void Profiler::beginFrame( const char* name )
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		g_owner_thread.store(std::this_thread::get_id());
+
+		for (auto& p : m_phases) {
+			p.second.frame_time = 0.0;
+		}
+
+		for (auto& s : m_solvers) {
+			s.second.frame_iterations = 0;
+		}
+
+		m_frame_substeps = 0;
+		m_current_substep = -1;
+	}
+
+	// the frame itself is the root phase
+	if (m_enabled) push(name);
+}
+
+void Profiler::endFrame()
+{
+	if (m_enabled) pop();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	g_owner_thread.store(std::thread::id());
+
+	for (auto& p : m_phases) {
+		p.second.last_frame_time = p.second.frame_time;
+	}
+
+	for (auto& s : m_solvers) {
+		s.second.last_frame_iterations = s.second.frame_iterations;
+	}
+
+	m_last_frame_substeps = m_frame_substeps;
+	m_current_substep = -1;
+	++m_num_frames;
+}
+
+void Profiler::beginSubstep()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& p : m_phases) {
+		p.second.substep_time = 0.0;
+	}
+
+	m_current_substep = m_frame_substeps;
+}
+
+void Profiler::endSubstep()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& p : m_phases) {
+		p.second.max_substep_time = std::max(p.second.max_substep_time, p.second.substep_time);
+	}
+
+	++m_frame_substeps;
+	++m_num_substeps;
+}
+
+void Profiler::push( const char* name )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Frame frame;
+	frame.path = m_stack.empty() ? std::string(name) : (m_stack.back().path + "/" + name);
+
+	// register phases on entry so that they are listed in the order of execution
+	if (m_phases.find(frame.path) == m_phases.end()) {
+		PhaseStats stats;
+		memset(&stats, 0, sizeof(PhaseStats));
+		stats.order = (int) m_phases.size();
+		stats.depth = (int) m_stack.size();
+		m_phases.insert(std::make_pair(frame.path, stats));
+	}
+
+	frame.begin = now();
+	m_stack.push_back(frame);
+}
+
+void Profiler::pop()
+{
+	const double end = now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stack.empty()) return;
+
+	const Frame& frame = m_stack.back();
+	const scalar elapsed = end - frame.begin;
+
+	PhaseStats& stats = m_phases[frame.path];
+	++stats.calls;
+	stats.total_time += elapsed;
+	stats.frame_time += elapsed;
+	stats.substep_time += elapsed;
+
+	if (m_trace_enabled && (int) m_events.size() < m_max_events) {
+		TraceEvent event;
+		event.name = frame.path;
+		event.begin = frame.begin - m_origin;
+		event.duration = elapsed;
+		event.frame = m_num_frames;
+		event.substep = m_current_substep;
+		m_events.push_back(event);
+	}
+
+	m_stack.pop_back();
+}
+
+void Profiler::recordSolve( const std::string& name, int iterations, scalar residual, bool success )
+{
+	if (!m_enabled) return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itr = m_solvers.find(name);
+	if (itr == m_solvers.end()) {
+		SolverStats stats;
+		memset(&stats, 0, sizeof(SolverStats));
+		itr = m_solvers.insert(std::make_pair(name, stats)).first;
+	}
+
+	SolverStats& stats = itr->second;
+	++stats.calls;
+	if (!success) ++stats.failures;
+	stats.total_iterations += iterations;
+	stats.frame_iterations += iterations;
+	stats.last_iterations = iterations;
+	stats.max_iterations = std::max(stats.max_iterations, iterations);
+	stats.last_residual = residual;
+	stats.max_residual = std::max(stats.max_residual, residual);
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_num_frames = 0;
+	m_num_substeps = 0;
+	m_frame_substeps = 0;
+	m_last_frame_substeps = 0;
+	m_current_substep = -1;
+	m_origin = now();
+
+	m_stack.clear();
+	m_phases.clear();
+	m_solvers.clear();
+	m_events.clear();
+}
+
+std::vector< std::map< std::string, PhaseStats >::const_iterator > Profiler::sortedPhases() const
+{
+	std::vector< std::map< std::string, PhaseStats >::const_iterator > sorted;
+	sorted.reserve(m_phases.size());
+	for (auto itr = m_phases.begin(); itr != m_phases.end(); ++itr) {
+		sorted.push_back(itr);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [] (const std::map< std::string, PhaseStats >::const_iterator & a,
+	const std::map< std::string, PhaseStats >::const_iterator & b) {
+		return a->second.order < b->second.order;
+	});
+
+	return sorted;
+}
+
+int Profiler::getNumFrames() const
+{
+	return m_num_frames;
+}
+
+int Profiler::getNumSubsteps() const
+{
+	return m_num_substeps;
+}
+
+int Profiler::getNumFrameSubsteps() const
+{
+	return m_frame_substeps;
+}
+
+int Profiler::getLastFrameSubsteps() const
+{
+	return m_last_frame_substeps;
+}
+
+scalar Profiler::getLastFrameTime( const std::string& path ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto itr = m_phases.find(path);
+	return itr == m_phases.end() ? 0.0 : itr->second.last_frame_time;
+}
+
+scalar Profiler::getTotalTime( const std::string& path ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto itr = m_phases.find(path);
+	return itr == m_phases.end() ? 0.0 : itr->second.total_time;
+}
+
+const std::map< std::string, PhaseStats >& Profiler::getPhases() const
+{
+	return m_phases;
+}
+
+const std::map< std::string, SolverStats >& Profiler::getSolvers() const
+{
+	return m_solvers;
+}
+
+bool Profiler::getSolverStats( const std::string& name, SolverStats& stats ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto itr = m_solvers.find(name);
+	if (itr == m_solvers.end()) return false;
+
+	stats = itr->second;
+	return true;
+}
+
+void Profiler::printSummary( std::ostream& os ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const scalar divisor = (scalar) std::max(1, m_num_frames);
+
+	scalar total_time = 0.0;
+	for (const auto& p : m_phases) {
+		if (p.second.depth == 0) total_time += p.second.total_time;
+	}
+
+	for (const auto& p : sortedPhases()) {
+		const PhaseStats& stats = p->second;
+		const size_t sep = p->first.find_last_of('/');
+		const std::string name = sep == std::string::npos ? p->first : p->first.substr(sep + 1);
+
+		os << std::string(stats.depth * 2, ' ') << name << ", " << stats.last_frame_time
+		   << ", " << (stats.total_time / divisor) << ", " << (total_time > 0.0 ? (stats.total_time / total_time * 100.0) : 0.0) << "%" << std::endl;
+	}
+
+	for (const auto& s : m_solvers) {
+		const SolverStats& stats = s.second;
+		os << "[solver " << s.first << "] calls: " << stats.calls << ", iter (frame): " << stats.last_frame_iterations
+		   << ", iter (avg.): " << ((scalar) stats.total_iterations / (scalar) std::max(1, stats.calls))
+		   << ", iter (max): " << stats.max_iterations << ", res: " << stats.last_residual
+		   << ", failures: " << stats.failures << std::endl;
+	}
+}
+
+void Profiler::writeJSON( std::ostream& os ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	os << std::setprecision(9);
+	os << "{" << std::endl;
+	os << "  \"frames\": " << m_num_frames << "," << std::endl;
+	os << "  \"substeps\": " << m_num_substeps << "," << std::endl;
+	os << "  \"last_frame_substeps\": " << m_last_frame_substeps << "," << std::endl;
+
+	os << "  \"phases\": [";
+	bool first = true;
+	for (const auto& p : sortedPhases()) {
+		const PhaseStats& stats = p->second;
+		os << (first ? "" : ",") << std::endl << "    {\"name\": ";
+		writeString(os, p->first);
+		os << ", \"depth\": " << stats.depth
+		   << ", \"calls\": " << stats.calls
+		   << ", \"total\": " << stats.total_time
+		   << ", \"per_frame\": " << (stats.total_time / (scalar) std::max(1, m_num_frames))
+		   << ", \"last_frame\": " << stats.last_frame_time
+		   << ", \"max_substep\": " << stats.max_substep_time << "}";
+		first = false;
+	}
+	os << std::endl << "  ]," << std::endl;
+
+	os << "  \"solvers\": [";
+	first = true;
+	for (const auto& s : m_solvers) {
+		const SolverStats& stats = s.second;
+		os << (first ? "" : ",") << std::endl << "    {\"name\": ";
+		writeString(os, s.first);
+		os << ", \"calls\": " << stats.calls
+		   << ", \"failures\": " << stats.failures
+		   << ", \"total_iterations\": " << stats.total_iterations
+		   << ", \"last_frame_iterations\": " << stats.last_frame_iterations
+		   << ", \"max_iterations\": " << stats.max_iterations
+		   << ", \"last_residual\": " << stats.last_residual
+		   << ", \"max_residual\": " << stats.max_residual << "}";
+		first = false;
+	}
+	os << std::endl << "  ]" << std::endl;
+	os << "}" << std::endl;
+}
+
+void Profiler::writeChromeTrace( std::ostream& os ) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	os << std::setprecision(12);
+	os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	for (const TraceEvent& event : m_events) {
+		const size_t sep = event.name.find_last_of('/');
+		const std::string name = sep == std::string::npos ? event.name : event.name.substr(sep + 1);
+
+		os << (first ? "" : ",") << std::endl << "{\"name\": ";
+		writeString(os, name);
+		os << ", \"cat\": \"sim\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0"
+		   << ", \"ts\": " << (event.begin * 1e6)
+		   << ", \"dur\": " << (event.duration * 1e6)
+		   << ", \"args\": {\"path\": ";
+		writeString(os, event.name);
+		os << ", \"frame\": " << event.frame << ", \"substep\": " << event.substep << "}}";
+		first = false;
+	}
+	os << std::endl << "]}" << std::endl;
+}
+
+bool Profiler::writeJSON( const std::string& filename ) const
+{
+	std::ofstream ofs(filename.c_str());
+	if (!ofs.good()) {
+		std::cerr << "Failed to write profile to " << filename << std::endl;
+		return false;
+	}
+
+	writeJSON(ofs);
+	return true;
+}
+
+bool Profiler::writeChromeTrace( const std::string& filename ) const
+{
+	std::ofstream ofs(filename.c_str());
+	if (!ofs.good()) {
+		std::cerr << "Failed to write trace to " << filename << std::endl;
+		return false;
+	}
+
+	writeChromeTrace(ofs);
+	return true;
+}
+
+ScopedTimer::ScopedTimer( const char* name )
+	: m_active(false)
+{
+	Profiler& prof = Profiler::instance();
+	if (!prof.isEnabled()) return;
+
+	// only record scopes within a frame, on the thread that opened it
+	if (g_owner_thread.load(std::memory_order_relaxed) != std::this_thread::get_id()) return;
+
+	prof.push(name);
+	m_active = true;
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	if (m_active) Profiler::instance().pop();
+}
+
+}
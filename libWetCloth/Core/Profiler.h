@@ -0,0 +1,163 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MathDefs.h"
+
+namespace profiler
+{
+
+// Accumulated timing of a (nested) phase, keyed by its path, e.g.
+// "stepSystem/projectFine/solveNodePressure".
+struct PhaseStats
+{
+	int order;
+	int depth;
+	int calls;
+	scalar total_time;
+	scalar frame_time;
+	scalar substep_time;
+	scalar last_frame_time;
+	scalar max_substep_time;
+};
+
+// Iteration and residual counters of a linear solver.
+struct SolverStats
+{
+	int calls;
+	int failures;
+	long long total_iterations;
+	int frame_iterations;
+	int last_frame_iterations;
+	int last_iterations;
+	int max_iterations;
+	scalar last_residual;
+	scalar max_residual;
+};
+
+struct TraceEvent
+{
+	std::string name;
+	double begin;
+	double duration;
+	int frame;
+	int substep;
+};
+
+class Profiler
+{
+public:
+	static Profiler& instance();
+
+	void setEnabled( bool enabled );
+	bool isEnabled() const;
+
+	// Record individual scope events for a Chrome trace (chrome://tracing).
+	// Events beyond max_events are dropped.
+	void setTraceEnabled( bool enabled, int max_events = 1 << 20 );
+	bool isTraceEnabled() const;
+
+	// Opens the root phase of a frame; all scopes within are nested under it.
+	void beginFrame( const char* name = "stepSystem" );
+	void endFrame();
+
+	void beginSubstep();
+	void endSubstep();
+
+	void push( const char* name );
+	void pop();
+
+	void recordSolve( const std::string& name, int iterations, scalar residual, bool success = true );
+
+	void reset();
+
+	int getNumFrames() const;
+	int getNumSubsteps() const;
+	int getNumFrameSubsteps() const;
+	int getLastFrameSubsteps() const;
+
+	// Time of a phase (by its full path) within the last finished frame, or
+	// accumulated over all frames.
+	scalar getLastFrameTime( const std::string& path ) const;
+	scalar getTotalTime( const std::string& path ) const;
+
+	const std::map< std::string, PhaseStats >& getPhases() const;
+	const std::map< std::string, SolverStats >& getSolvers() const;
+
+	bool getSolverStats( const std::string& name, SolverStats& stats ) const;
+
+	void printSummary( std::ostream& os ) const;
+	void writeJSON( std::ostream& os ) const;
+	void writeChromeTrace( std::ostream& os ) const;
+
+	bool writeJSON( const std::string& filename ) const;
+	bool writeChromeTrace( const std::string& filename ) const;
+
+private:
+	Profiler();
+
+	static double now();
+
+	std::vector< std::map< std::string, PhaseStats >::const_iterator > sortedPhases() const;
+
+	struct Frame
+	{
+		std::string path;
+		double begin;
+	};
+
+	bool m_enabled;
+	bool m_trace_enabled;
+	int m_max_events;
+
+	int m_num_frames;
+	int m_num_substeps;
+	int m_frame_substeps;
+	int m_last_frame_substeps;
+	int m_current_substep;
+
+	double m_origin;
+
+	std::vector< Frame > m_stack;
+
+	std::map< std::string, PhaseStats > m_phases;
+	std::map< std::string, SolverStats > m_solvers;
+	std::vector< TraceEvent > m_events;
+
+	mutable std::mutex m_mutex;
+};
+
+// Times the enclosing scope as a child of the innermost active scope.
+// Only scopes opened between beginFrame() and endFrame() on the thread
+// driving the simulation are recorded; scopes opened from inside parallel
+// loops or outside of a frame are ignored.
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer( const char* name );
+	~ScopedTimer();
+
+	ScopedTimer( const ScopedTimer& ) = delete;
+	ScopedTimer& operator=( const ScopedTimer& ) = delete;
+
+private:
+	bool m_active;
+};
+
+}
+
+#endif
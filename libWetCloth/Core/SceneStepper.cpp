@@ -51,6 +51,15 @@ bool SceneStepper::useApic() const
     return m_apic;
 }
 
+void SceneStepper::writeCheckpoint( checkpoint::Writer& writer ) const
+{
+}
+
+bool SceneStepper::readCheckpoint( checkpoint::Reader& reader )
+{
+    return true;
+}
+
 void SceneStepper::mapNodeToSoftParticles( const TwoDScene& scene, const std::vector< VectorXs >& node_vec_x, const std::vector< VectorXs >& node_vec_y, const std::vector< VectorXs >& node_vec_z, VectorXs& part_vec ) const
 {
     part_vec.setZero();
@@ -305,7 +314,7 @@ void SceneStepper::mapSoftParticlesToNode( const TwoDScene& scene, std::vector<
 
     const std::vector<int>& particle_to_surfels = scene.getParticleToSurfels();
     const int num_elasto = scene.getNumElastoParticles();
-    const std::vector< Matrix27x4s >& particle_weights = scene.getParticleWeights();
+    const std::vector< ParticleWeights >& particle_weights = scene.getParticleWeights();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         if (!scene.isBucketActivated(bucket_idx)) return;
@@ -379,7 +388,7 @@ void SceneStepper::mapSoftParticlesToNodeSqr( const TwoDScene& scene, std::vecto
 
     const std::vector<int>& particle_to_surfels = scene.getParticleToSurfels();
     const int num_elasto = scene.getNumElastoParticles();
-    const std::vector< Matrix27x4s >& particle_weights = scene.getParticleWeights();
+    const std::vector< ParticleWeights >& particle_weights = scene.getParticleWeights();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         if (!scene.isBucketActivated(bucket_idx)) return;
@@ -503,14 +512,14 @@ void SceneStepper::allocateCenterNodeVectors( const TwoDScene& scene, std::vecto
 {
     const int num_buckets = scene.getNumBuckets();
 
-    if ((int) node_vec_p.size() != num_buckets) node_vec_p.resize(num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_p, num_buckets);
 
     const Sorter& buckets = scene.getParticleBuckets();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         const int num_nodes = scene.getNumNodes(bucket_idx);
 
-        node_vec_p[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_p[bucket_idx], num_nodes);
         node_vec_p[bucket_idx].setZero();
     });
 }
@@ -519,14 +528,14 @@ void SceneStepper::allocateCenterNodeVectors( const TwoDScene& scene, std::vecto
 {
     const int num_buckets = scene.getNumBuckets();
 
-    if ((int) node_vec_p.size() != num_buckets) node_vec_p.resize(num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_p, num_buckets);
 
     const Sorter& buckets = scene.getParticleBuckets();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         const int num_nodes = scene.getNumNodes(bucket_idx);
 
-        node_vec_p[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_p[bucket_idx], num_nodes);
         node_vec_p[bucket_idx].setZero();
     });
 }
@@ -535,20 +544,20 @@ void SceneStepper::allocateNodeVectors( const TwoDScene& scene, std::vector< Vec
 {
     const int num_buckets = scene.getNumBuckets();
 
-    if ((int) node_vec_x.size() != num_buckets) node_vec_x.resize(num_buckets);
-    if ((int) node_vec_y.size() != num_buckets) node_vec_y.resize(num_buckets);
-    if ((int) node_vec_z.size() != num_buckets) node_vec_z.resize(num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_x, num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_y, num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_z, num_buckets);
 
     const Sorter& buckets = scene.getParticleBuckets();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         const int num_nodes = scene.getNumNodes(bucket_idx);
 
-        node_vec_x[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_x[bucket_idx], num_nodes);
         node_vec_x[bucket_idx].setZero();
-        node_vec_y[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_y[bucket_idx], num_nodes);
         node_vec_y[bucket_idx].setZero();
-        node_vec_z[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_z[bucket_idx], num_nodes);
         node_vec_z[bucket_idx].setZero();
     });
 }
@@ -557,20 +566,20 @@ void SceneStepper::allocateNodeVectors( const TwoDScene& scene, std::vector< Vec
 {
     const int num_buckets = scene.getNumBuckets();
 
-    if ((int) node_vec_x.size() != num_buckets) node_vec_x.resize(num_buckets);
-    if ((int) node_vec_y.size() != num_buckets) node_vec_y.resize(num_buckets);
-    if ((int) node_vec_z.size() != num_buckets) node_vec_z.resize(num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_x, num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_y, num_buckets);
+    m_node_array_pool.fitBuckets(node_vec_z, num_buckets);
 
     const Sorter& buckets = scene.getParticleBuckets();
 
     buckets.for_each_bucket([&] (int bucket_idx) {
         const int num_nodes = scene.getNumNodes(bucket_idx);
 
-        node_vec_x[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_x[bucket_idx], num_nodes);
         node_vec_x[bucket_idx].setZero();
-        node_vec_y[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_y[bucket_idx], num_nodes);
         node_vec_y[bucket_idx].setZero();
-        node_vec_z[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(node_vec_z[bucket_idx], num_nodes);
         node_vec_z[bucket_idx].setZero();
     });
 }
@@ -651,4 +660,24 @@ scalar SceneStepper::lengthNodeVectors( const std::vector< VectorXs >& node_vec
     return sqrt(bucket_length.sum());
 }
 
+scalar SceneStepper::addScaledNodeVectors( const scalar& alpha, const std::vector< VectorXs >& node_vec_px, const std::vector< VectorXs >& node_vec_py, const std::vector< VectorXs >& node_vec_pz, const std::vector< VectorXs >& node_vec_qx, const std::vector< VectorXs >& node_vec_qy, const std::vector< VectorXs >& node_vec_qz, std::vector< VectorXs >& node_vec_xx, std::vector< VectorXs >& node_vec_xy, std::vector< VectorXs >& node_vec_xz, std::vector< VectorXs >& node_vec_rx, std::vector< VectorXs >& node_vec_ry, std::vector< VectorXs >& node_vec_rz ) const
+{
+    VectorXs bucket_length(node_vec_rx.size());
+
+    const int num_buckets = node_vec_rx.size();
+
+    threadutils::for_each(0, num_buckets, [&] (int bucket_idx) {
+        node_vec_xx[bucket_idx] += node_vec_px[bucket_idx] * alpha;
+        node_vec_xy[bucket_idx] += node_vec_py[bucket_idx] * alpha;
+        node_vec_xz[bucket_idx] += node_vec_pz[bucket_idx] * alpha;
+        node_vec_rx[bucket_idx] -= node_vec_qx[bucket_idx] * alpha;
+        node_vec_ry[bucket_idx] -= node_vec_qy[bucket_idx] * alpha;
+        node_vec_rz[bucket_idx] -= node_vec_qz[bucket_idx] * alpha;
+
+        bucket_length[bucket_idx] = node_vec_rx[bucket_idx].squaredNorm() + node_vec_ry[bucket_idx].squaredNorm() + node_vec_rz[bucket_idx].squaredNorm();
+    });
+
+    return sqrt(bucket_length.sum());
+}
+
 
@@ -10,6 +10,7 @@
 #define SCENE_STEPPER
 
 #include "TwoDScene.h"
+#include "NodeArrayPool.h"
 #include <functional>
 #include <stack>
 
@@ -28,6 +29,14 @@ public:
 
 	virtual bool projectFine( TwoDScene& scene, scalar dt ) = 0;
 
+	// carries the pressure of the last projection over to the current nodes
+	// instead of solving again; projects if there is none
+	virtual bool reuseProjection( TwoDScene& scene, scalar dt ) = 0;
+
+	// relative change of the pressure in the last projection from the one
+	// carried over, infinite if nothing has been carried over
+	virtual scalar getPressureChange() const = 0;
+
 	virtual bool applyPressureDragElasto( TwoDScene& scene, scalar dt ) = 0;
 
 	virtual bool applyPressureDragFluid( TwoDScene& scene, scalar dt ) = 0;
@@ -60,6 +69,11 @@ public:
 
 	virtual bool useApic() const;
 
+	// state kept by the stepper from one step to the next, for checkpoints
+	virtual void writeCheckpoint( checkpoint::Writer& writer ) const;
+
+	virtual bool readCheckpoint( checkpoint::Reader& reader );
+
 	// tools function
 	void mapNodeToSoftParticles( const TwoDScene& scene, const std::vector< VectorXs >& node_vec_x, const std::vector< VectorXs >& node_vec_y, const std::vector< VectorXs >& node_vec_z, VectorXs& part_vec ) const;
 
@@ -103,11 +117,17 @@ public:
 
 	scalar lengthNodeVectors( const std::vector< VectorXs >& node_vec ) const;
 
+	// x += alpha * p and r -= alpha * q in a single pass, returns the length of the updated r
+	scalar addScaledNodeVectors( const scalar& alpha, const std::vector< VectorXs >& node_vec_px, const std::vector< VectorXs >& node_vec_py, const std::vector< VectorXs >& node_vec_pz, const std::vector< VectorXs >& node_vec_qx, const std::vector< VectorXs >& node_vec_qy, const std::vector< VectorXs >& node_vec_qz, std::vector< VectorXs >& node_vec_xx, std::vector< VectorXs >& node_vec_xy, std::vector< VectorXs >& node_vec_xz, std::vector< VectorXs >& node_vec_rx, std::vector< VectorXs >& node_vec_ry, std::vector< VectorXs >& node_vec_rz ) const;
+
 	void mapGaussToNode( const TwoDScene& scene, std::vector< VectorXs >& node_vec_x, std::vector< VectorXs >& node_vec_y, std::vector< VectorXs >& node_vec_z, const MatrixXs& gauss_vec ) const;
 
 	void allocateLagrangianVectors( const TwoDScene& scene, VectorXs& vec );
 protected:
 	bool m_apic;
+
+	// storage of the node vectors of deactivated buckets
+	mutable NodeArrayPool m_node_array_pool;
 };
 
 #endif
@@ -588,6 +588,21 @@ void ShellBendingForce::updateStartState()
 	computeBendingRestPhi(m_pos, m_per_edge_start_phi);
 }
 
+void ShellBendingForce::saveState( std::vector<scalar>& state ) const
+{
+	saveVector(state, m_multipliers);
+}
+
+bool ShellBendingForce::checkState( const scalar*& state, const scalar* end ) const
+{
+	return checkVector(state, end, (int) m_multipliers.size());
+}
+
+void ShellBendingForce::loadState( const scalar*& state )
+{
+	loadVector(state, m_multipliers);
+}
+
 Force* ShellBendingForce::createNewCopy()
 {
 	return new ShellBendingForce(*this);
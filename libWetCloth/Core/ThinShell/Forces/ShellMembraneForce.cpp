@@ -246,6 +246,24 @@ void ShellMembraneForce::updateStartState()
 	m_start_pos = m_pos;
 }
 
+void ShellMembraneForce::saveState( std::vector<scalar>& state ) const
+{
+	saveVector(state, m_membrane_multiplier);
+	saveVector(state, m_viscous_multipler);
+}
+
+bool ShellMembraneForce::checkState( const scalar*& state, const scalar* end ) const
+{
+	return checkVector(state, end, (int) m_membrane_multiplier.size()) &&
+	       checkVector(state, end, (int) m_viscous_multipler.size());
+}
+
+void ShellMembraneForce::loadState( const scalar*& state )
+{
+	loadVector(state, m_membrane_multiplier);
+	loadVector(state, m_viscous_multipler);
+}
+
 Force* ShellMembraneForce::createNewCopy()
 {
 	return new ShellMembraneForce(*this);
@@ -71,6 +71,12 @@ public:
 	virtual void preCompute();
 	
 	virtual void updateStartState();
+
+	virtual void saveState( std::vector<scalar>& state ) const;
+
+	virtual bool checkState( const scalar*& state, const scalar* end ) const;
+
+	virtual void loadState( const scalar*& state );
 	
 	virtual Force* createNewCopy();
 
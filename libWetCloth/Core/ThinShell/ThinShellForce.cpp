@@ -202,6 +202,31 @@ void ThinShellForce::updateStartState()
 	}
 }
 
+void ThinShellForce::saveState( std::vector<scalar>& state ) const
+{
+	for(auto& force : m_forces)
+	{
+		force->saveState(state);
+	}
+}
+
+bool ThinShellForce::checkState( const scalar*& state, const scalar* end ) const
+{
+	for(auto& force : m_forces)
+	{
+		if (!force->checkState(state, end)) return false;
+	}
+	return true;
+}
+
+void ThinShellForce::loadState( const scalar*& state )
+{
+	for(auto& force : m_forces)
+	{
+		force->loadState(state);
+	}
+}
+
 Force* ThinShellForce::createNewCopy()
 {
 	return new ThinShellForce(*this);
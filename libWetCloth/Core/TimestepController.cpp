@@ -0,0 +1,228 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "TimestepController.h"
+#include "TwoDScene.h"
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+TimestepController::~TimestepController()
+{}
+
+bool TimestepController::needsReport() const
+{
+	return false;
+}
+
+bool TimestepController::needsRollback() const
+{
+	return false;
+}
+
+void TimestepController::writeCheckpoint( checkpoint::Writer& writer ) const
+{}
+
+bool TimestepController::readCheckpoint( checkpoint::Reader& reader )
+{
+	return true;
+}
+
+CFLTimestepController::CFLTimestepController()
+	: m_max_elasto_dt(0.0)
+	, m_max_fluid_dt(0.0)
+	, m_num_substeps(1)
+	, m_sub_dt(0.0)
+{}
+
+void CFLTimestepController::beginFrame( const TwoDScene& scene, scalar dt )
+{
+	const scalar max_elasto_vel = scene.getMaxVelocity();
+	const scalar max_fluid_vel = scene.getMaxFluidVelocity();
+	const scalar dx = scene.getCellSize();
+	m_max_elasto_dt = std::min(dx / std::max(1e-63, max_elasto_vel) / 3.0, 1.0 / 30.0); // 1/6 CFLs
+	m_max_fluid_dt = std::min(dx / std::max(1e-63, max_fluid_vel) * 3.0, 1.0 / 30.0); // 3 CFLs
+	const scalar max_dt = std::min(m_max_elasto_dt, m_max_fluid_dt);
+
+	m_num_substeps = std::max(1, (int) ceil(dt / max_dt));
+	m_sub_dt = dt / (scalar) m_num_substeps;
+}
+
+scalar CFLTimestepController::nextSubstep( const TwoDScene& scene, scalar remaining )
+{
+	return m_sub_dt;
+}
+
+bool CFLTimestepController::acceptSubstep( const SubstepReport& report, scalar sub_dt )
+{
+	return true;
+}
+
+scalar CFLTimestepController::getMaxFluidDt() const
+{
+	return m_max_fluid_dt;
+}
+
+void CFLTimestepController::print( std::ostream& os ) const
+{
+	os << "max dt: " << std::min(m_max_elasto_dt, m_max_fluid_dt) << " (" << m_max_elasto_dt << ", " << m_max_fluid_dt
+	   << "), # sub-step: (" << m_num_substeps << "), sub-dt: " << m_sub_dt;
+}
+
+std::string CFLTimestepController::getName() const
+{
+	return "cfl";
+}
+
+AdaptiveTimestepController::Parameters::Parameters()
+	: elasto_cfl(1.0)
+	, fluid_cfl(3.0)
+	, max_dt(1.0 / 30.0)
+	, min_dt(1e-6)
+	, safety(0.9)
+	, max_growth(1.25)
+	, max_shrink(0.5)
+	, reject_error(2.0)
+	, target_iterations(50.0)
+	, target_divergence_ratio(0.1)
+	, target_deformation_change(0.1)
+	, max_rejects(3)
+{}
+
+AdaptiveTimestepController::AdaptiveTimestepController( const Parameters& params )
+	: m_params(params)
+	, m_dx(0.0)
+	, m_max_elasto_vel(0.0)
+	, m_max_fluid_vel(0.0)
+	, m_target_dt(0.0)
+	, m_last_error(0.0)
+	, m_num_rejects(0)
+{}
+
+void AdaptiveTimestepController::beginFrame( const TwoDScene& scene, scalar dt )
+{
+	m_dx = scene.getCellSize();
+	m_max_elasto_vel = scene.getMaxVelocity();
+	m_max_fluid_vel = scene.getMaxFluidVelocity();
+
+	// start from the conservative step of the CFL controller
+	if (m_target_dt <= 0.0) {
+		const scalar max_elasto_dt = m_dx / std::max(1e-63, m_max_elasto_vel) / 3.0;
+		const scalar max_fluid_dt = m_dx / std::max(1e-63, m_max_fluid_vel) * 3.0;
+		m_target_dt = std::min(std::min(max_elasto_dt, max_fluid_dt), m_params.max_dt);
+	}
+}
+
+scalar AdaptiveTimestepController::nextSubstep( const TwoDScene& scene, scalar remaining )
+{
+	const scalar max_elasto_dt = m_dx / std::max(1e-63, m_max_elasto_vel) * m_params.elasto_cfl;
+	const scalar max_fluid_dt = m_dx / std::max(1e-63, m_max_fluid_vel) * m_params.fluid_cfl;
+	const scalar max_dt = std::min(std::min(max_elasto_dt, max_fluid_dt), m_params.max_dt);
+
+	const scalar h = std::max(std::min(m_target_dt, max_dt), m_params.min_dt);
+
+	// spread the rest of the frame evenly instead of leaving a sliver at its end
+	const int num_substeps = std::max(1, (int) ceil(remaining / h - 1e-6));
+	return remaining / (scalar) num_substeps;
+}
+
+scalar AdaptiveTimestepController::computeError( const SubstepReport& report, scalar sub_dt ) const
+{
+	const scalar cfl_error = std::max(report.max_elasto_vel / m_params.elasto_cfl, report.max_fluid_vel / m_params.fluid_cfl) * sub_dt / m_dx;
+
+	const scalar iteration_error = report.solver_iterations / m_params.target_iterations;
+
+	scalar divergence_error = 0.0;
+	if (report.initial_divergence > 1e-12) {
+		divergence_error = report.divergence / report.initial_divergence / m_params.target_divergence_ratio;
+	}
+
+	const scalar deformation_error = report.deformation_change / m_params.target_deformation_change;
+
+	return std::max(std::max(cfl_error, iteration_error), std::max(divergence_error, deformation_error));
+}
+
+bool AdaptiveTimestepController::acceptSubstep( const SubstepReport& report, scalar sub_dt )
+{
+	const bool failed = !report.finite || report.solver_failures > 0;
+	const scalar error = failed ? std::numeric_limits<scalar>::infinity() : computeError(report, sub_dt);
+	m_last_error = error;
+
+	const bool can_retry = m_num_rejects < m_params.max_rejects && sub_dt > m_params.min_dt;
+
+	if ((failed || error > m_params.reject_error) && can_retry) {
+		++m_num_rejects;
+		m_target_dt = std::max(sub_dt * std::max(std::min(m_params.safety / error, m_params.max_shrink), 0.25), m_params.min_dt);
+		std::cout << "[sub-step of " << sub_dt << " rejected, error: " << error << ", retry with " << m_target_dt << "]" << std::endl;
+		return false;
+	}
+
+	m_num_rejects = 0;
+
+	if (report.finite) {
+		m_max_elasto_vel = report.max_elasto_vel;
+		m_max_fluid_vel = report.max_fluid_vel;
+	}
+
+	// the error grows about linearly with the step for the first-order integrator
+	const scalar factor = error > 0.0 ? m_params.safety / error : m_params.max_growth;
+	m_target_dt = std::max(std::min(m_target_dt * std::max(std::min(factor, m_params.max_growth), m_params.max_shrink), m_params.max_dt), m_params.min_dt);
+	return true;
+}
+
+scalar AdaptiveTimestepController::getMaxFluidDt() const
+{
+	return std::min(m_dx / std::max(1e-63, m_max_fluid_vel) * m_params.fluid_cfl, m_params.max_dt);
+}
+
+bool AdaptiveTimestepController::needsReport() const
+{
+	return true;
+}
+
+bool AdaptiveTimestepController::needsRollback() const
+{
+	return m_params.max_rejects > 0;
+}
+
+void AdaptiveTimestepController::print( std::ostream& os ) const
+{
+	const scalar max_elasto_dt = m_dx / std::max(1e-63, m_max_elasto_vel) * m_params.elasto_cfl;
+	const scalar max_fluid_dt = m_dx / std::max(1e-63, m_max_fluid_vel) * m_params.fluid_cfl;
+	os << "max dt: " << std::min(std::min(max_elasto_dt, max_fluid_dt), m_params.max_dt) << " (" << max_elasto_dt << ", " << max_fluid_dt
+	   << "), target dt: " << m_target_dt << ", last error: " << m_last_error;
+}
+
+std::string AdaptiveTimestepController::getName() const
+{
+	return "adaptive";
+}
+
+void AdaptiveTimestepController::writeCheckpoint( checkpoint::Writer& writer ) const
+{
+	writer.writeValue("timestep/target_dt", m_target_dt);
+}
+
+bool AdaptiveTimestepController::readCheckpoint( checkpoint::Reader& reader )
+{
+	// checkpoints of the CFL controller restart from the conservative step
+	if (!reader.has("timestep/target_dt")) {
+		m_target_dt = 0.0;
+		return true;
+	}
+
+	return reader.readValue("timestep/target_dt", m_target_dt);
+}
+
+const AdaptiveTimestepController::Parameters& AdaptiveTimestepController::getParameters() const
+{
+	return m_params;
+}
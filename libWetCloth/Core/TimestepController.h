@@ -0,0 +1,167 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef TIMESTEP_CONTROLLER_H
+#define TIMESTEP_CONTROLLER_H
+
+#include <iostream>
+#include <string>
+
+#include "MathDefs.h"
+
+class TwoDScene;
+
+namespace checkpoint
+{
+class Writer;
+class Reader;
+}
+
+// What happened during one sub-step, measured after it has been taken
+struct SubstepReport
+{
+	scalar max_elasto_vel;
+	scalar max_fluid_vel;
+	scalar initial_divergence; // before the pressure projection
+	scalar divergence; // after the velocities are accepted
+	scalar deformation_change; // largest relative change of an elastic deformation gradient
+	scalar solver_iterations; // largest average iteration count of a linear solver
+	int solver_failures;
+	bool finite;
+};
+
+// Decides the length of the sub-steps taken within a frame. The core asks
+// for the next sub-step until the frame is covered, and hands back a report
+// after each one; a controller that rejects the report has the sub-step
+// rolled back to its start and asks again.
+class TimestepController
+{
+public:
+	virtual ~TimestepController();
+
+	virtual void beginFrame( const TwoDScene& scene, scalar dt ) = 0;
+
+	// at most remaining, up to round-off
+	virtual scalar nextSubstep( const TwoDScene& scene, scalar remaining ) = 0;
+
+	// false if the sub-step should be rolled back and taken again
+	virtual bool acceptSubstep( const SubstepReport& report, scalar sub_dt ) = 0;
+
+	// longest time a single pressure projection may cover, when the elastic
+	// objects are sub-cycled within the steps of the liquid
+	virtual scalar getMaxFluidDt() const = 0;
+
+	// whether acceptSubstep looks at the report, which costs a few passes over the scene
+	virtual bool needsReport() const;
+
+	// whether the state should be kept at the start of each sub-step to roll back to
+	virtual bool needsRollback() const;
+
+	virtual void print( std::ostream& os ) const = 0;
+
+	virtual std::string getName() const = 0;
+
+	virtual void writeCheckpoint( checkpoint::Writer& writer ) const;
+
+	virtual bool readCheckpoint( checkpoint::Reader& reader );
+};
+
+// Splits the frame into equal sub-steps bounded by the CFL condition on the
+// velocities at the start of the frame, the original scheme of the simulator
+class CFLTimestepController : public TimestepController
+{
+public:
+	CFLTimestepController();
+
+	virtual void beginFrame( const TwoDScene& scene, scalar dt );
+
+	virtual scalar nextSubstep( const TwoDScene& scene, scalar remaining );
+
+	virtual bool acceptSubstep( const SubstepReport& report, scalar sub_dt );
+
+	virtual scalar getMaxFluidDt() const;
+
+	virtual void print( std::ostream& os ) const;
+
+	virtual std::string getName() const;
+
+private:
+	scalar m_max_elasto_dt;
+	scalar m_max_fluid_dt;
+	int m_num_substeps;
+	scalar m_sub_dt;
+};
+
+// Grows and shrinks the sub-step from the error estimates of the previous
+// one: the CFL number reached, the iterations of the linear solvers, the
+// divergence left after the projection and the change of the elastic
+// deformation gradients, each relative to its target. The step changes by
+// a bounded factor per sub-step, and a sub-step whose solvers failed, whose
+// velocities blew up or whose error is far off the target is rolled back
+// and retried with a shorter step.
+class AdaptiveTimestepController : public TimestepController
+{
+public:
+	struct Parameters
+	{
+		Parameters();
+
+		scalar elasto_cfl;
+		scalar fluid_cfl;
+		scalar max_dt;
+		scalar min_dt;
+		scalar safety;
+		scalar max_growth;
+		scalar max_shrink;
+		scalar reject_error;
+		scalar target_iterations;
+		scalar target_divergence_ratio;
+		scalar target_deformation_change;
+		int max_rejects; // per sub-step, zero disables the rollback
+	};
+
+	explicit AdaptiveTimestepController( const Parameters& params );
+
+	virtual void beginFrame( const TwoDScene& scene, scalar dt );
+
+	virtual scalar nextSubstep( const TwoDScene& scene, scalar remaining );
+
+	virtual bool acceptSubstep( const SubstepReport& report, scalar sub_dt );
+
+	virtual scalar getMaxFluidDt() const;
+
+	virtual bool needsReport() const;
+
+	virtual bool needsRollback() const;
+
+	virtual void print( std::ostream& os ) const;
+
+	virtual std::string getName() const;
+
+	virtual void writeCheckpoint( checkpoint::Writer& writer ) const;
+
+	virtual bool readCheckpoint( checkpoint::Reader& reader );
+
+	const Parameters& getParameters() const;
+
+private:
+	scalar computeError( const SubstepReport& report, scalar sub_dt ) const;
+
+	Parameters m_params;
+
+	scalar m_dx;
+	scalar m_max_elasto_vel;
+	scalar m_max_fluid_vel;
+	scalar m_target_dt;
+	scalar m_last_error;
+
+	int m_num_rejects;
+};
+
+#endif
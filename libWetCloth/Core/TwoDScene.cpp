@@ -10,8 +10,12 @@
 #include "TwoDScene.h"
 #include "ThreadUtils.h"
 #include "MathUtilities.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
+#include "Pressure.h"
 #include <iostream>
 #include "DER/StrandForce.h"
+#include "DER/StrandBatch.h"
 #include "AttachForce.h"
 #include "sphere_pattern.h"
 #include "volume_fractions.h"
@@ -64,6 +68,17 @@ std::ostream& operator<<(std::ostream& os, const LiquidInfo& info)
     os << "propagate solid velocity: " <<       info.propagate_solid_velocity << std::endl;
     os << "check divergence: " <<               info.check_divergence << std::endl;
     os << "use varying fraction: " <<           info.use_varying_fraction << std::endl;
+    os << "use scatter p2g: " <<                info.use_scatter_p2g << std::endl;
+    os << "use geometric mg: " <<               info.use_geometric_mg << std::endl;
+    os << "use warm start: " <<                 info.use_warm_start << std::endl;
+    os << "use mixed precision pressure: " <<   info.use_mixed_precision_pressure << std::endl;
+    os << "use mixed precision elasto: " <<     info.use_mixed_precision_elasto << std::endl;
+    os << "use pipelined pcg: " <<              info.use_pipelined_pcg << std::endl;
+    os << "use parallel viscosity precondition: " << info.use_parallel_viscosity_precondition << std::endl;
+    os << "use strand batch: " <<               info.use_strand_batch << std::endl;
+    os << "particle reorder interval: " <<      info.particle_reorder_interval << std::endl;
+    os << "elasto subcycles: " <<               info.elasto_subcycles << std::endl;
+    os << "elasto subcycle tolerance: " <<      info.elasto_subcycle_tolerance << std::endl;
     return os;
 }
 
@@ -79,6 +94,7 @@ TwoDScene::TwoDScene()
     , m_edges()
     , m_num_colors(1)
     , m_forces()
+    , m_strand_batch_num_forces(-1)
 {
     sphere_pattern::generateSpherePattern(m_sphere_pattern);
 }
@@ -325,7 +341,7 @@ const std::shared_ptr< DistanceField >& TwoDScene::getGroupDistanceField(int igr
     return m_group_distance_field[igroup];
 }
 
-const Matrix27x4s& TwoDScene::getParticleWeights( int pidx ) const
+const ParticleWeights& TwoDScene::getParticleWeights( int pidx ) const
 {
     return m_particle_weights[pidx];
 }
@@ -340,12 +356,12 @@ const std::vector<bool>& TwoDScene::getTwist() const
     return m_twist;
 }
 
-const std::vector< Matrix27x4s >& TwoDScene::getParticleWeights() const
+const std::vector< ParticleWeights >& TwoDScene::getParticleWeights() const
 {
     return m_particle_weights;
 }
 
-Matrix27x4s& TwoDScene::getParticleWeights( int pidx )
+ParticleWeights& TwoDScene::getParticleWeights( int pidx )
 {
     return m_particle_weights[pidx];
 }
@@ -972,7 +988,6 @@ void TwoDScene::resizeParticleSystem( int num_particles )
     m_particle_nodes_solid_phi.resize(num_particles);
 
     m_particle_weights.resize(num_particles);
-    m_particle_weights_p.resize(num_particles);
 
     m_is_strand_tip.resize(num_particles);
 
@@ -1006,6 +1021,8 @@ bool TwoDScene::isOutsideFluid(int pidx) const
  */
 void TwoDScene::conservativeResizeParticles(int num_particles)
 {
+    profiler::ScopedTimer timer("conservativeResizeParticles");
+
     m_x.conservativeResize(4 * num_particles);
     m_rest_x.conservativeResize(4 * num_particles);
     m_v.conservativeResize(4 * num_particles);
@@ -1043,7 +1060,6 @@ void TwoDScene::conservativeResizeParticles(int num_particles)
     m_particle_nodes_solid_phi.resize(num_particles);
 
     m_particle_weights.resize(num_particles);
-    m_particle_weights_p.resize(num_particles);
 
     m_is_strand_tip.resize( num_particles );
     m_div.resize( num_particles );
@@ -1141,11 +1157,30 @@ const std::vector< std::vector<RayTriInfo> >& TwoDScene::getIntersections() cons
     return m_ray_tri_gauss;
 }
 
+/*!
+ * refit the bounding volumes of the soft elastic elements to their current
+ * positions, building the hierarchy on first use. Queried by the cohesion
+ * and the extended liquid levelset of the same sub-step.
+ */
+void TwoDScene::updateElementBVH()
+{
+    profiler::ScopedTimer timer("updateElementBVH");
+
+    m_element_bvh.refit(m_edges, m_faces, m_x, m_x_gauss);
+}
+
+const ElementBVH& TwoDScene::getElementBVH() const
+{
+    return m_element_bvh;
+}
+
 /*!
  * shoot rays and compute hitting points on elements. This is used for finding cohesion pairs.
  */
 void TwoDScene::updateIntersection()
 {
+    profiler::ScopedTimer timer("updateIntersection");
+
     const int num_edges = getNumEdges();
     const int num_faces = getNumFaces();
     const int num_soft_elasto = num_faces + num_edges;
@@ -1158,13 +1193,10 @@ void TwoDScene::updateIntersection()
         return;
     }
 
-    const int num_elasto = getNumElastoParticles();
-
-    MatrixXs m_x_reshaped(num_elasto, 3);
-
-    threadutils::for_each(0, num_elasto, [&] (int pidx) {
-        m_x_reshaped.row(pidx) = m_x.segment<3>(pidx * 4).transpose();
-    });
+    // the search dirs accept the gausses within 30 degrees
+    const scalar cos_cone = 0.866;
+    const scalar cone_angle = acos(cos_cone);
+    const scalar slack = m_bucket_size * 1e-6;
 
     // do nearest neighbor searching
     m_gauss_buckets.for_each_bucket_particles([&] (int gidx, int bucket_idx) {
@@ -1203,46 +1235,40 @@ void TwoDScene::updateIntersection()
         std::vector< Vector3s > ele_min_np(num_dirs); //temp buffer storing the cloeset point and thus we don't need to recompute later
         std::vector< Vector3s > ele_min_bary(num_dirs); //temp buffer storing the bary of cloeset point and thus we don't need to recompute later
 
-        m_gauss_buckets.loop_neighbor_bucket_particles(bucket_idx, [&] (int ngidx, int) {
-            if (ngidx == gidx) return false;
-            if (!m_liquid_info.solid_cohesion && ngidx >= num_soft_elasto ) return false;
-            if (!m_liquid_info.soft_cohesion && ngidx < num_soft_elasto) return false;
+        const Vector3s xg = m_x_gauss.segment<3>(gidx * 4);
 
-            Vector3s dx = m_x_gauss.segment<3>(ngidx * 4) - m_x_gauss.segment<3>(gidx * 4);
+        auto check_neighbor = [&] (int ngidx) {
+            if (ngidx == gidx) return;
+
+            Vector3s dx = m_x_gauss.segment<3>(ngidx * 4) - xg;
             scalar ldx = dx.norm();
-            if (ldx < 1e-20) return false;
+            if (ldx < 1e-20) return;
 
             dx /= ldx;
 
             // check other angle if surfel met
             if (ngidx >= num_soft_elasto) {
-                if (dx.dot(m_surfel_norms[ngidx - num_soft_elasto]) < 0.866) return false;
+                if (dx.dot(m_surfel_norms[ngidx - num_soft_elasto]) < cos_cone) return;
             }
 
             // check angle
             int angle_sel = -1;
             for (int r = 0; r < num_dirs; ++r) {
-                if (dx.dot(search_dirs[r]) < 0.866) continue;
+                if (dx.dot(search_dirs[r]) < cos_cone) continue;
 
                 angle_sel = r;
                 break;
             }
 
-            if (angle_sel == -1) return false;
-
-
+            if (angle_sel == -1) return;
 
             scalar dist2 = 1e+20;
             Vector3s np = Vector3s::Zero();
             Vector3s bary = Vector3s::Zero();
 
             // check min dist
-            if (ngidx < num_edges) {
-                Vector2s barye;
-                igl::point_simplex_squared_distance<3>(m_x_gauss.segment<3>(gidx * 4), m_x_reshaped, m_edges, ngidx, dist2, np, barye);
-                bary.segment(0, 2) = barye;
-            } else if (ngidx < (num_edges + num_faces)) {
-                igl::point_simplex_squared_distance<3>(m_x_gauss.segment<3>(gidx * 4), m_x_reshaped, m_faces, ngidx - num_edges, dist2, np, bary);
+            if (ngidx < num_soft_elasto) {
+                dist2 = m_element_bvh.closestPoint(ngidx, xg, np, bary);
             } else {
                 dist2 = ldx * ldx;
                 np = m_x_gauss.segment<3>(ngidx * 4);
@@ -1255,9 +1281,55 @@ void TwoDScene::updateIntersection()
                 ele_min_np[angle_sel] = np;
                 ele_min_bary[angle_sel] = bary;
             }
+        };
 
-            return false;
-        });
+        // the candidates are the gausses in the neighboring buckets, as for the surfels below
+        const Vector3i center_handle = m_gauss_buckets.bucket_handle(bucket_idx);
+
+        if (m_liquid_info.soft_cohesion) {
+            const Vector3s region_min = m_bucket_mincorner + (center_handle - Vector3i::Ones()).cast<scalar>() * m_bucket_size - Vector3s::Constant(slack);
+            const Vector3s region_max = region_min + Vector3s::Constant(m_bucket_size * 3.0 + slack * 2.0);
+
+            // a node is worth entering if its gausses may lie in the region and
+            // within a search cone, and its elements may be closer than what
+            // has been found in that direction
+            auto enter_node = [&] (const ElementBVH::Node & node) -> bool {
+                if ((node.center_max.array() < region_min.array()).any() || (node.center_min.array() > region_max.array()).any()) return false;
+
+                const scalar box_dist2 = ElementBVH::boxDistance2(node, xg);
+
+                const Vector3s c = (node.center_min + node.center_max) * 0.5;
+                const scalar rad = (node.center_max - node.center_min).norm() * 0.5 + slack;
+                const Vector3s dc = c - xg;
+                const scalar ldc = dc.norm();
+
+                for (int r = 0; r < num_dirs; ++r) {
+                    if (box_dist2 >= min_dists[r]) continue;
+                    if (ldc <= rad) return true;
+
+                    const scalar angle = acos(mathutils::clamp(dc.dot(search_dirs[r]) / ldc, -1.0, 1.0));
+                    if (angle - asin(rad / ldc) <= cone_angle + 1e-6) return true;
+                }
+
+                return false;
+            };
+
+            m_element_bvh.traverse(xg, enter_node, [&] (int ngidx) {
+                for (int r = 0; r < 3; ++r) {
+                    const int h = (int)floor((m_x_gauss(ngidx * 4 + r) - m_bucket_mincorner(r)) / m_bucket_size);
+                    if (std::abs(h - center_handle(r)) > 1) return;
+                }
+
+                check_neighbor(ngidx);
+            });
+        }
+
+        if (m_liquid_info.solid_cohesion && num_soft_elasto < getNumGausses()) {
+            m_gauss_buckets.loop_neighbor_bucket_particles(bucket_idx, [&] (int ngidx, int) {
+                if (ngidx >= num_soft_elasto) check_neighbor(ngidx);
+                return false;
+            });
+        }
 
         for (int r = 0; r < num_dirs; ++r) {
             if (ele_min_dists[r] >= 0) {
@@ -1638,6 +1710,8 @@ void TwoDScene::initGaussSystem()
  * compute derivative of energy E over deformation gradient Fe, this is crucial for computing collision force
  */
 void TwoDScene::computedEdFe() {
+    profiler::ScopedTimer timer("computedEdFe");
+
     const int num_gauss = getNumGausses();
     const int num_edges = getNumEdges();
 
@@ -1801,6 +1875,8 @@ const Vector3s& TwoDScene::getBucketMinCorner() const
  */
 void TwoDScene::rebucketizeParticles()
 {
+    profiler::ScopedTimer timer("rebucketizeParticles");
+
     scalar dx = getCellSize();
 
     const scalar extra_border = 3.0;
@@ -1843,6 +1919,82 @@ void TwoDScene::rebucketizeParticles()
     m_bucket_activated.assign(total_buckets, 0U);
 }
 
+/*!
+ * permute the liquid particles into the Morton order of their buckets, so
+ * that particles close in space are close in memory. The elastic particles
+ * are left in place, since edges, faces, gausses and the strands refer to
+ * them by index.
+ */
+void TwoDScene::reorderLiquidParticles()
+{
+    profiler::ScopedTimer timer("reorderLiquidParticles");
+
+    const int num_parts = getNumParticles();
+    const int num_elasto = getNumElastoParticles();
+    const int num_fluids = num_parts - num_elasto;
+    if (num_fluids < 2) return;
+
+    // bucket code in the high part, keeping the current order within a bucket
+    std::vector<uint64_t> keys(num_fluids);
+    threadutils::for_each(0, num_fluids, [&] (int fidx) {
+        const int pidx = num_elasto + fidx;
+        const int i = std::max(0, std::min(m_particle_buckets.ni - 1, (int)floor((m_x(pidx * 4 + 0) - m_bucket_mincorner(0)) / m_bucket_size)));
+        const int j = std::max(0, std::min(m_particle_buckets.nj - 1, (int)floor((m_x(pidx * 4 + 1) - m_bucket_mincorner(1)) / m_bucket_size)));
+        const int k = std::max(0, std::min(m_particle_buckets.nk - 1, (int)floor((m_x(pidx * 4 + 2) - m_bucket_mincorner(2)) / m_bucket_size)));
+        keys[fidx] = mathutils::mortonCode(i, j, k) << 32UL | (uint64_t) fidx;
+    });
+
+    tbb::parallel_sort(keys.begin(), keys.end());
+
+    std::vector<int> order(num_fluids);
+    bool sorted = true;
+    for (int fidx = 0; fidx < num_fluids; ++fidx) {
+        order[fidx] = (int) (keys[fidx] & 0xFFFFFFFFUL);
+        sorted = sorted && order[fidx] == fidx;
+    }
+
+    if (sorted) return;
+
+    mathutils::permute<scalar, 4>(m_x, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_rest_x, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_v, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_saved_v, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_dv, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_fluid_v, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_m, num_elasto, order);
+    mathutils::permute<scalar, 4>(m_fluid_m, num_elasto, order);
+    mathutils::permute<scalar, 3>(m_orientation, num_elasto, order);
+    mathutils::permute<scalar, 2>(m_radius, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_vol, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_rest_vol, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_fluid_vol, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_shape_factor, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_particle_rest_length, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_particle_rest_area, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_volume_fraction, num_elasto, order);
+    mathutils::permute<scalar, 1>(m_rest_volume_fraction, num_elasto, order);
+    mathutils::permute<unsigned char, 1>(m_inside, num_elasto, order);
+    mathutils::permute<scalar, 3>(m_B, num_elasto, order);
+    mathutils::permute<scalar, 3>(m_fB, num_elasto, order);
+    mathutils::permute(m_fixed, num_elasto, order);
+    mathutils::permute(m_twist, num_elasto, order);
+    mathutils::permute(m_particle_to_edge, num_elasto, order);
+    mathutils::permute(m_particle_to_face, num_elasto, order);
+    mathutils::permute(m_particle_to_surfel, num_elasto, order);
+    mathutils::permute(m_particle_group, num_elasto, order);
+    mathutils::permute(m_classifier, num_elasto, order);
+    mathutils::permute(m_is_strand_tip, num_elasto, order);
+    mathutils::permute(m_div, num_elasto, order);
+
+    // m_fluids stays the range of liquid particles; the nodes and weights of
+    // the particles are recomputed from the buckets
+    m_particle_buckets.sort(num_parts, [&] (int pidx, int& i, int& j, int& k) {
+        i = (int)floor((m_x(pidx * 4 + 0) - m_bucket_mincorner(0)) / m_bucket_size);
+        j = (int)floor((m_x(pidx * 4 + 1) - m_bucket_mincorner(1)) / m_bucket_size);
+        k = (int)floor((m_x(pidx * 4 + 2) - m_bucket_mincorner(2)) / m_bucket_size);
+    });
+}
+
 /*!
  * remove empty particles.
  */
@@ -1851,15 +2003,7 @@ void TwoDScene::removeEmptyParticles()
     const int num_parts = getNumParticles();
     const int num_elasto = getNumElastoParticles();
 
-    int new_num_parts = num_parts;
-    for (int i = num_elasto; i < new_num_parts; )
-    {
-        if (m_fluid_vol(i) < 1e-20) {
-            swapParticles(i, --new_num_parts);
-        } else {
-            ++i;
-        }
-    }
+    const int new_num_parts = collectEmptyParticles();
 
     if (new_num_parts < num_parts) {
         conservativeResizeParticles(new_num_parts);
@@ -1878,6 +2022,35 @@ void TwoDScene::removeEmptyParticles()
     }
 }
 
+/*!
+ * move the particles left without liquid behind the others and mark them
+ * as tombstones, without resizing the buffers. Returns the number of
+ * particles kept. Callers about to add particles resize once to the kept
+ * ones plus the new ones, instead of shrinking and growing every buffer.
+ */
+int TwoDScene::collectEmptyParticles()
+{
+    const int num_parts = getNumParticles();
+    const int num_elasto = getNumElastoParticles();
+
+    int new_num_parts = num_parts;
+    for (int i = num_elasto; i < new_num_parts; )
+    {
+        if (m_fluid_vol(i) < 1e-20) {
+            swapParticles(i, --new_num_parts);
+        } else {
+            ++i;
+        }
+    }
+
+    for (int i = new_num_parts; i < num_parts; ++i)
+    {
+        m_classifier[i] = PC_NONE;
+    }
+
+    return new_num_parts;
+}
+
 void TwoDScene::updateStrandParamViscosity(const scalar& dt)
 {
     const int num_params = (int) m_strandParameters.size();
@@ -1901,10 +2074,14 @@ void TwoDScene::terminateParticles()
         const Vector3s& pos = m_x.segment<3>(pidx * 4);
         Vector3s vel;
         const scalar phi = computePhiVel(pos, vel, term_sel);
-        if (phi < 0.0) m_fluid_vol(pidx) = 0.0;
+        if (phi < 0.0) {
+            m_fluid_vol(pidx) = 0.0;
+            m_classifier[pidx] = PC_NONE;
+        }
     });
 
-    removeEmptyParticles();
+    // the terminated particles stay as tombstones until mergeLiquidParticles
+    // removes them together with the merged ones
 }
 
 /*!
@@ -2007,6 +2184,8 @@ void TwoDScene::constrainLiquidVelocity()
  */
 void TwoDScene::updateSolidWeights()
 {
+    profiler::ScopedTimer timer("updateSolidWeights");
+
     const int num_buckets = m_particle_buckets.size();
     m_node_solid_weight_x.resize( num_buckets );
     m_node_solid_weight_y.resize( num_buckets );
@@ -2098,6 +2277,8 @@ void TwoDScene::updateSolidWeights()
  */
 void TwoDScene::correctLiquidParticles(const scalar& dt)
 {
+    profiler::ScopedTimer timer("correctLiquidParticles");
+
     const int num_fluid = getNumFluidParticles();
     const scalar dx = getCellSize();
 
@@ -2114,7 +2295,7 @@ void TwoDScene::correctLiquidParticles(const scalar& dt)
 
     const scalar iD = getInverseDCoeff();
 
-    const int correction_selector = rand() % m_liquid_info.correction_step;
+    const int correction_selector = mathutils::randomInt(m_liquid_info.correction_step);
 
     m_particle_cells.for_each_bucket_particles_colored([&] (int i, int cell_idx) {
 
@@ -2221,88 +2402,17 @@ void TwoDScene::updateParticleWeights(scalar dt, int start, int end)
         const Matrix27x2i& indices_sphi = m_particle_nodes_solid_phi[pidx];
         const Matrix27x2i& indices_p = m_particle_nodes_p[pidx];
 
-        Vector27s& weights_p = m_particle_weights_p[pidx];
-        Matrix27x4s& weights = m_particle_weights[pidx];
+        ParticleWeights& weights = m_particle_weights[pidx];
 
         const Vector3s& pos = m_x.segment<3>(pidx * 4);
 
-        for (int nidx = 0; nidx < indices_p.rows(); ++nidx)
-        {
-            const int node_bucket_idx = indices_p(nidx, 0);
-            const int node_idx = indices_p(nidx, 1);
-            Vector3s dx;
-
-            const Vector3s& np = getNodePosP(node_bucket_idx, node_idx);
-            dx = (pos - np) / h;
-
-            const scalar w = mathutils::N_kernel<2>(dx);
-
-            weights_p(nidx) = w;
-        }
-
-        for (int nidx = 0; nidx < indices_sphi.rows(); ++nidx)
-        {
-            const int node_bucket_idx = indices_sphi(nidx, 0);
-            const int node_idx = indices_sphi(nidx, 1);
-
-            Vector3s dx;
-
-            const Vector3s& np = getNodePosSolidPhi(node_bucket_idx, node_idx);
-            dx = (pos - np) / h;
-
-            Vector3s g;
-            const scalar w = mathutils::N_kernel<2>(dx);
-
-            weights(nidx, 3) = w;
-        }
-
-        for (int nidx = 0; nidx < indices_x.rows(); ++nidx)
-        {
-            const int node_bucket_idx = indices_x(nidx, 0);
-            const int node_idx = indices_x(nidx, 1);
-
-            Vector3s dx;
-
-            const Vector3s& np = getNodePosX(node_bucket_idx, node_idx);
-            dx = (pos - np) / h;
-
-            Vector3s g;
-            const scalar w = mathutils::N_kernel<2>(dx);
-
-            weights(nidx, 0) = w;
-        }
-
-        for (int nidx = 0; nidx < indices_y.rows(); ++nidx)
-        {
-            const int node_bucket_idx = indices_y(nidx, 0);
-            const int node_idx = indices_y(nidx, 1);
-
-            Vector3s dx;
-
-            const Vector3s& np = getNodePosY(node_bucket_idx, node_idx);
-            dx = (pos - np) / h;
-
-            Vector3s g;
-            const scalar w = mathutils::N_kernel<2>(dx);
-
-            weights(nidx, 1) = w;
-        }
-
-        for (int nidx = 0; nidx < indices_z.rows(); ++nidx)
-        {
-            const int node_bucket_idx = indices_z(nidx, 0);
-            const int node_idx = indices_z(nidx, 1);
-
-            Vector3s dx;
-
-            const Vector3s& np = getNodePosZ(node_bucket_idx, node_idx);
-            dx = (pos - np) / h;
-
-            Vector3s g;
-            const scalar w = mathutils::N_kernel<2>(dx);
-
-            weights(nidx, 2) = w;
-        }
+        // the weights are separable, only the distance to the first (lowest)
+        // node of each stencil is needed
+        weights.set(ParticleWeights::GRID_X, (pos - getNodePosX(indices_x(0, 0), indices_x(0, 1))) / h);
+        weights.set(ParticleWeights::GRID_Y, (pos - getNodePosY(indices_y(0, 0), indices_y(0, 1))) / h);
+        weights.set(ParticleWeights::GRID_Z, (pos - getNodePosZ(indices_z(0, 0), indices_z(0, 1))) / h);
+        weights.set(ParticleWeights::GRID_SOLID_PHI, (pos - getNodePosSolidPhi(indices_sphi(0, 0), indices_sphi(0, 1))) / h);
+        weights.set(ParticleWeights::GRID_P, (pos - getNodePosP(indices_p(0, 0), indices_p(0, 1))) / h);
     });
 
 }
@@ -2381,6 +2491,8 @@ void TwoDScene::updateGaussWeights(scalar dt)
 
 void TwoDScene::computeWeights(scalar dt)
 {
+    profiler::ScopedTimer timer("computeWeights");
+
     updateParticleWeights(dt, 0, getNumParticles());
 
     updateGaussWeights(dt);
@@ -2441,6 +2553,10 @@ void TwoDScene::buildNodeParticlePairs()
         }
     });
 
+    // with scatter transfers the liquid particles are only needed on the pressure grid
+    const int num_elasto = getNumElastoParticles();
+    const bool skip_fluid = m_liquid_info.use_scatter_p2g;
+
     m_particle_buckets.for_each_bucket_particles_colored([&] (int pidx, int bucket_idx) {
         if (!m_bucket_activated[bucket_idx]) return;
 
@@ -2450,7 +2566,15 @@ void TwoDScene::buildNodeParticlePairs()
         auto& indices_p = m_particle_nodes_p[pidx];
 
         auto& weights = m_particle_weights[pidx];
-        auto& weights_p = m_particle_weights_p[pidx];
+
+        for (int i = 0; i < indices_p.rows(); ++i)
+        {
+            if (m_bucket_activated[indices_p(i, 0)] && weights(i, 4) > 0.0) {
+                m_node_particles_p[ indices_p(i, 0) ][ indices_p(i, 1) ].emplace_back( std::pair<int, int>( pidx, i ) );
+            }
+        }
+
+        if (skip_fluid && pidx >= num_elasto) return;
 
         for (int i = 0; i < indices_x.rows(); ++i)
         {
@@ -2472,13 +2596,6 @@ void TwoDScene::buildNodeParticlePairs()
                 m_node_particles_z[ indices_z(i, 0) ][ indices_z(i, 1) ].emplace_back( std::pair<int, int>( pidx, i ) );
             }
         }
-
-        for (int i = 0; i < indices_p.rows(); ++i)
-        {
-            if (m_bucket_activated[indices_p(i, 0)] && weights_p(i) > 0.0) {
-                m_node_particles_p[ indices_p(i, 0) ][ indices_p(i, 1) ].emplace_back( std::pair<int, int>( pidx, i ) );
-            }
-        }
     }, 3);
 }
 
@@ -2492,6 +2609,8 @@ void TwoDScene::updateOptiVolume()
  */
 void TwoDScene::splitLiquidParticles()
 {
+    profiler::ScopedTimer timer("splitLiquidParticles");
+
     const int num_fluids = getNumFluidParticles();
     if (!num_fluids) return;
 
@@ -2614,6 +2733,12 @@ void TwoDScene::relabelLiquidParticles()
     const int num_elasto = getNumElastoParticles();
     const int num_parts = getNumParticles();
     threadutils::for_each(num_elasto, num_parts, [&] (int pidx) {
+        // tombstones are neither split nor merged
+        if (m_fluid_vol(pidx) < 1e-20) {
+            m_classifier[pidx] = PC_NONE;
+            return;
+        }
+
         const scalar mrel = m_fluid_vol(pidx) / V_fine;
 
         if (mrel < 0.5) m_classifier[pidx] = PC_S;
@@ -2629,6 +2754,8 @@ void TwoDScene::relabelLiquidParticles()
  */
 void TwoDScene::mergeLiquidParticles()
 {
+    profiler::ScopedTimer timer("mergeLiquidParticles");
+
     const int num_parts = getNumParticles();
     const int num_elasto = getNumElastoParticles();
     std::vector< unsigned char > removed(num_parts, false);
@@ -2639,7 +2766,7 @@ void TwoDScene::mergeLiquidParticles()
     const scalar rad_fine = mathutils::defaultRadiusMultiplier() * getCellSize() * m_liquid_info.particle_cell_multiplier;
     const scalar V_fine = 4.0 / 3.0 * M_PI * rad_fine * rad_fine * rad_fine;
 
-    const int correction_selector = rand() % m_liquid_info.correction_step;
+    const int correction_selector = mathutils::randomInt(m_liquid_info.correction_step);
 
     m_particle_buckets.for_each_bucket_particles_colored_randomized([&] (int pidx, int bucket_idx) {
         if (!isFluid(pidx) || (m_classifier[pidx] != PC_S && m_classifier[pidx] != PC_l)) return;
@@ -2777,7 +2904,6 @@ void TwoDScene::mergeLiquidParticles()
 void TwoDScene::extendLiquidPhi()
 {
     const int num_buckets = (int) m_particle_buckets.size();
-    const int num_elasto = getNumSoftElastoParticles();
     const scalar dx = getCellSize();
 
     m_node_combined_phi.resize(num_buckets);
@@ -2792,12 +2918,7 @@ void TwoDScene::extendLiquidPhi()
     const int num_edges = getNumEdges();
     const int num_faces = getNumFaces();
 
-    MatrixXs m_x_reshaped(num_elasto, 3);
-
-    threadutils::for_each(0, num_elasto, [&] (int pidx) {
-        m_x_reshaped.row(pidx) = m_x.segment<3>(pidx * 4).transpose();
-    });
-
+    // the closest points are taken on the elements as last refit
     m_gauss_buckets.for_each_bucket_particles_colored([&] (int gidx, int) {
         if (gidx < num_edges) {
             const auto& indices = m_gauss_nodes_p[gidx];
@@ -2812,9 +2933,7 @@ void TwoDScene::extendLiquidPhi()
 
                 const Vector3s& np = getNodePosP( indices(i, 0), indices(i, 1) );
 
-                scalar sqr_d = dx * 3.0;
-                Vector3s cp;
-                igl::point_simplex_squared_distance<3>(np, m_x_reshaped, m_edges, gidx, sqr_d, cp);
+                const scalar sqr_d = m_element_bvh.closestPoint(gidx, np);
 
                 const scalar phi = sqrt(std::max(0.0, sqr_d)) - std::max(dx * 0.71, rad_e);
 
@@ -2823,8 +2942,6 @@ void TwoDScene::extendLiquidPhi()
                 }
             }
         } else if (gidx < num_edges + num_faces) {
-            const int fidx = gidx - num_edges;
-
             const auto& indices = m_gauss_nodes_p[gidx];
             const scalar rad_e = m_radius_gauss(gidx);
 
@@ -2836,9 +2953,7 @@ void TwoDScene::extendLiquidPhi()
 
                 const Vector3s& np = getNodePosP( indices(i, 0), indices(i, 1) );
 
-                scalar sqr_d = dx * 3.0;
-                Vector3s cp;
-                igl::point_simplex_squared_distance<3>(np, m_x_reshaped, m_faces, fidx, sqr_d, cp);
+                const scalar sqr_d = m_element_bvh.closestPoint(gidx, np);
 
                 const scalar phi = sqrt(std::max(0.0, sqr_d)) - std::max(dx * 0.51, rad_e);
 
@@ -3306,15 +3421,8 @@ void TwoDScene::advectCurvatureP(const scalar& dt)
     // reinit elasto part
     const int num_edges = getNumEdges();
     const int num_faces = getNumFaces();
-    const int num_elasto = num_edges + num_faces;
     const scalar dx = getCellSize();
 
-    MatrixXs m_x_reshaped(num_elasto, 3);
-
-    threadutils::for_each(0, num_elasto, [&] (int pidx) {
-        m_x_reshaped.row(pidx) = m_x.segment<3>(pidx * 4).transpose();
-    });
-
     m_gauss_buckets.for_each_bucket_particles_colored([&] (int gidx, int) {
         if (gidx < num_edges) {
             const auto& indices = m_gauss_nodes_p[gidx];
@@ -3329,9 +3437,7 @@ void TwoDScene::advectCurvatureP(const scalar& dt)
 
                 const Vector3s& np = getNodePosP( indices(i, 0), indices(i, 1) );
 
-                scalar sqr_d = dx * 3.0;
-                Vector3s cp;
-                igl::point_simplex_squared_distance<3>(np, m_x_reshaped, m_edges, gidx, sqr_d, cp);
+                const scalar sqr_d = m_element_bvh.closestPoint(gidx, np);
 
                 const scalar phi = sqrt(std::max(0.0, sqr_d)) - std::max(dx * 0.71, rad_e);
 
@@ -3340,8 +3446,6 @@ void TwoDScene::advectCurvatureP(const scalar& dt)
                 }
             }
         } else if (gidx < num_edges + num_faces) {
-            const int fidx = gidx - num_edges;
-
             const auto& indices = m_gauss_nodes_p[gidx];
             const scalar rad_e = m_radius_gauss(gidx);
 
@@ -3353,9 +3457,7 @@ void TwoDScene::advectCurvatureP(const scalar& dt)
 
                 const Vector3s& np = getNodePosP( indices(i, 0), indices(i, 1) );
 
-                scalar sqr_d = dx * 3.0;
-                Vector3s cp;
-                igl::point_simplex_squared_distance<3>(np, m_x_reshaped, m_faces, fidx, sqr_d, cp);
+                const scalar sqr_d = m_element_bvh.closestPoint(gidx, np);
 
                 const scalar phi = sqrt(std::max(0.0, sqr_d)) - std::max(dx * 0.51, rad_e);
 
@@ -3382,25 +3484,14 @@ bool TwoDScene::useSurfTension() const
  */
 void TwoDScene::updateLiquidPhi(scalar dt)
 {
-    const int num_buckets = (int) m_particle_buckets.size();
-
-    m_node_liquid_phi.resize(num_buckets);
-    m_node_pressure.resize(num_buckets);
+    profiler::ScopedTimer timer("updateLiquidPhi");
 
-    const scalar dx = getCellSize();
-
-    m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
-        const int num_nodes = getNumNodes(bucket_idx);
-
-        m_node_liquid_phi[bucket_idx].resize( num_nodes );
-        m_node_liquid_phi[bucket_idx].setConstant(3.0 * m_bucket_size);
-        m_node_pressure[bucket_idx].resize( num_nodes );
-        m_node_pressure[bucket_idx].setZero();
-    });
+    resetLiquidPhi();
 
     if (getNumFluidParticles() == 0) return;
 
     const int num_elasto = getNumElastoParticles();
+    const scalar dx = getCellSize();
 
     m_particle_buckets.for_each_bucket_particles_colored([&] (int pidx, int bucket_idx) {
         if (pidx < num_elasto) return;
@@ -3425,20 +3516,68 @@ void TwoDScene::updateLiquidPhi(scalar dt)
         }
     }, 3);
 
-    auto solid_sel = [] (const std::shared_ptr<DistanceField>& dfptr) -> bool {
-        return dfptr->usage == DFU_SOLID;
-    };
+    // kept with its grid for the sub-cycles of the elastic objects
+    if (m_liquid_info.elasto_subcycles > 1) {
+        m_node_particle_liquid_phi = m_node_liquid_phi;
+        m_particle_liquid_phi_origin = pressure::getBucketOrigin(*this);
+        m_particle_liquid_phi_num_buckets = Vector3i(m_particle_buckets.ni, m_particle_buckets.nj, m_particle_buckets.nk);
+    }
+
+    finishLiquidPhi();
+}
+
+/*!
+ * carry the liquid level set of the last updateLiquidPhi over to the current
+ * grid, in place of splatting the liquid particles again
+ */
+void TwoDScene::carryLiquidPhi()
+{
+    if (m_node_particle_liquid_phi.empty()) {
+        updateLiquidPhi(0.0);
+        return;
+    }
+
+    profiler::ScopedTimer timer("carryLiquidPhi");
+
+    resetLiquidPhi();
+
+    if (getNumFluidParticles() == 0) return;
+
+    pressure::remapNodeValues(*this, m_node_particle_liquid_phi, m_particle_liquid_phi_origin, m_particle_liquid_phi_num_buckets, m_node_liquid_phi, 3.0 * m_bucket_size);
+
+    finishLiquidPhi();
+}
+
+void TwoDScene::resetLiquidPhi()
+{
+    const int num_buckets = (int) m_particle_buckets.size();
+
+    m_node_liquid_phi.resize(num_buckets);
+    m_node_pressure.resize(num_buckets);
+
+    m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
+        const int num_nodes = getNumNodes(bucket_idx);
+
+        m_node_liquid_phi[bucket_idx].resize( num_nodes );
+        m_node_liquid_phi[bucket_idx].setConstant(3.0 * m_bucket_size);
+        m_node_pressure[bucket_idx].resize( num_nodes );
+        m_node_pressure[bucket_idx].setZero();
+    });
+}
 
+void TwoDScene::finishLiquidPhi()
+{
+    const scalar dx = getCellSize();
+
+    // the solid phi at the cell centers was sampled by updateSolidPhi
     m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
         VectorXs& bucket_liquid_phi = m_node_liquid_phi[ bucket_idx ];
+        const VectorXs& bucket_cell_solid_phi = m_node_cell_solid_phi[ bucket_idx ];
 
         const int num_pressure = bucket_liquid_phi.size();
 
         for (int i = 0; i < num_pressure; ++i) {
-            const Vector3s& np = getNodePosP(bucket_idx, i);
-
-            Vector3s vel;
-            const scalar sphi = computePhiVel(np, vel, solid_sel);
+            const scalar sphi = bucket_cell_solid_phi(i);
             if (sphi < 0.0)
                 bucket_liquid_phi(i) = -0.5 * dx;
         }
@@ -4750,203 +4889,148 @@ void TwoDScene::connectPressureNodes()
 void TwoDScene::postAllocateNodes()
 {
     const int num_buckets = m_particle_buckets.size();
-    // check allocation
-    if ((int) m_node_mass_x.size() != num_buckets) m_node_mass_x.resize(num_buckets);
-    if ((int) m_node_sat_x.size() != num_buckets) m_node_sat_x.resize(num_buckets);
-    if ((int) m_node_psi_x.size() != num_buckets) m_node_psi_x.resize(num_buckets);
-    if ((int) m_node_vel_x.size() != num_buckets) m_node_vel_x.resize(num_buckets);
-    if ((int) m_node_vol_x.size() != num_buckets) m_node_vol_x.resize(num_buckets);
-    if ((int) m_node_shape_factor_x.size() != num_buckets) m_node_shape_factor_x.resize(num_buckets);
-    if ((int) m_node_raw_weight_x.size() != num_buckets) m_node_raw_weight_x.resize(num_buckets);
-    if ((int) m_node_orientation_x.size() != num_buckets) m_node_orientation_x.resize(num_buckets);
-
-    if ((int) m_node_mass_y.size() != num_buckets) m_node_mass_y.resize(num_buckets);
-    if ((int) m_node_sat_y.size() != num_buckets) m_node_sat_y.resize(num_buckets);
-    if ((int) m_node_psi_y.size() != num_buckets) m_node_psi_y.resize(num_buckets);
-    if ((int) m_node_vel_y.size() != num_buckets) m_node_vel_y.resize(num_buckets);
-    if ((int) m_node_vol_y.size() != num_buckets) m_node_vol_y.resize(num_buckets);
-    if ((int) m_node_shape_factor_y.size() != num_buckets) m_node_shape_factor_y.resize(num_buckets);
-    if ((int) m_node_raw_weight_y.size() != num_buckets) m_node_raw_weight_y.resize(num_buckets);
-    if ((int) m_node_orientation_y.size() != num_buckets) m_node_orientation_y.resize(num_buckets);
-
-    if ((int) m_node_mass_z.size() != num_buckets) m_node_mass_z.resize(num_buckets);
-    if ((int) m_node_sat_z.size() != num_buckets) m_node_sat_z.resize(num_buckets);
-    if ((int) m_node_psi_z.size() != num_buckets) m_node_psi_z.resize(num_buckets);
-    if ((int) m_node_vel_z.size() != num_buckets) m_node_vel_z.resize(num_buckets);
-    if ((int) m_node_vol_z.size() != num_buckets) m_node_vol_z.resize(num_buckets);
-    if ((int) m_node_shape_factor_z.size() != num_buckets) m_node_shape_factor_z.resize(num_buckets);
-    if ((int) m_node_raw_weight_z.size() != num_buckets) m_node_raw_weight_z.resize(num_buckets);
-    if ((int) m_node_orientation_z.size() != num_buckets) m_node_orientation_z.resize(num_buckets);
-
-    if ((int) m_node_mass_fluid_x.size() != num_buckets) m_node_mass_fluid_x.resize(num_buckets);
-    if ((int) m_node_vel_fluid_x.size() != num_buckets) m_node_vel_fluid_x.resize(num_buckets);
-    if ((int) m_node_vol_fluid_x.size() != num_buckets) m_node_vol_fluid_x.resize(num_buckets);
-    if ((int) m_node_vol_pure_fluid_x.size() != num_buckets) m_node_vol_pure_fluid_x.resize(num_buckets);
-
-    if ((int) m_node_mass_fluid_y.size() != num_buckets) m_node_mass_fluid_y.resize(num_buckets);
-    if ((int) m_node_vel_fluid_y.size() != num_buckets) m_node_vel_fluid_y.resize(num_buckets);
-    if ((int) m_node_vol_fluid_y.size() != num_buckets) m_node_vol_fluid_y.resize(num_buckets);
-    if ((int) m_node_vol_pure_fluid_y.size() != num_buckets) m_node_vol_pure_fluid_y.resize(num_buckets);
-
-    if ((int) m_node_mass_fluid_z.size() != num_buckets) m_node_mass_fluid_z.resize(num_buckets);
-    if ((int) m_node_vel_fluid_z.size() != num_buckets) m_node_vel_fluid_z.resize(num_buckets);
-    if ((int) m_node_vol_fluid_z.size() != num_buckets) m_node_vol_fluid_z.resize(num_buckets);
-    if ((int) m_node_vol_pure_fluid_z.size() != num_buckets) m_node_vol_pure_fluid_z.resize(num_buckets);
-
-    if ((int) m_node_solid_phi.size() != num_buckets) m_node_solid_phi.resize(num_buckets);
-
-    if ((int) m_node_solid_vel_x.size() != num_buckets) m_node_solid_vel_x.resize(num_buckets);
-    if ((int) m_node_solid_vel_y.size() != num_buckets) m_node_solid_vel_y.resize(num_buckets);
-    if ((int) m_node_solid_vel_z.size() != num_buckets) m_node_solid_vel_z.resize(num_buckets);
-
-    if ((int) m_node_liquid_valid_x.size() != num_buckets) m_node_liquid_valid_x.resize(num_buckets);
-    if ((int) m_node_liquid_valid_y.size() != num_buckets) m_node_liquid_valid_y.resize(num_buckets);
-    if ((int) m_node_liquid_valid_z.size() != num_buckets) m_node_liquid_valid_z.resize(num_buckets);
+    // check allocation, recycling the arrays of deactivated buckets
+    m_node_array_pool.fitBuckets(m_node_mass_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_sat_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_psi_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_shape_factor_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_raw_weight_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_orientation_x, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_mass_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_sat_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_psi_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_shape_factor_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_raw_weight_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_orientation_y, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_mass_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_sat_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_psi_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_shape_factor_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_raw_weight_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_orientation_z, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_mass_fluid_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_fluid_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_fluid_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_pure_fluid_x, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_mass_fluid_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_fluid_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_fluid_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_pure_fluid_y, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_mass_fluid_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vel_fluid_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_fluid_z, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_vol_pure_fluid_z, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_solid_phi, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_cell_solid_phi, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_solid_vel_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_solid_vel_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_solid_vel_z, num_buckets);
+
+    m_node_array_pool.fitBuckets(m_node_liquid_valid_x, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_liquid_valid_y, num_buckets);
+    m_node_array_pool.fitBuckets(m_node_liquid_valid_z, num_buckets);
 
     m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
         const int num_nodes = getNumNodes(bucket_idx);
 
-        if (m_node_mass_x[bucket_idx].size() != num_nodes)
-            m_node_mass_x[bucket_idx].resize(num_nodes);
-        if (m_node_vel_x[bucket_idx].size() != num_nodes)
-            m_node_vel_x[bucket_idx].resize(num_nodes);
-        if (m_node_vol_x[bucket_idx].size() != num_nodes)
-            m_node_vol_x[bucket_idx].resize(num_nodes);
-        if (m_node_sat_x[bucket_idx].size() != num_nodes)
-            m_node_sat_x[bucket_idx].resize(num_nodes);
-        if (m_node_psi_x[bucket_idx].size() != num_nodes)
-            m_node_psi_x[bucket_idx].resize(num_nodes);
-        if (m_node_shape_factor_x[bucket_idx].size() != num_nodes)
-            m_node_shape_factor_x[bucket_idx].resize(num_nodes);
-        if (m_node_raw_weight_x[bucket_idx].size() != num_nodes)
-            m_node_raw_weight_x[bucket_idx].resize(num_nodes);
-        if (m_node_orientation_x[bucket_idx].size() != num_nodes * 3)
-            m_node_orientation_x[bucket_idx].resize(num_nodes * 3);
-
-        if (m_node_mass_y[bucket_idx].size() != num_nodes)
-            m_node_mass_y[bucket_idx].resize(num_nodes);
-        if (m_node_vel_y[bucket_idx].size() != num_nodes)
-            m_node_vel_y[bucket_idx].resize(num_nodes);
-        if (m_node_vol_y[bucket_idx].size() != num_nodes)
-            m_node_vol_y[bucket_idx].resize(num_nodes);
-        if (m_node_sat_y[bucket_idx].size() != num_nodes)
-            m_node_sat_y[bucket_idx].resize(num_nodes);
-        if (m_node_psi_y[bucket_idx].size() != num_nodes)
-            m_node_psi_y[bucket_idx].resize(num_nodes);
-        if (m_node_shape_factor_y[bucket_idx].size() != num_nodes)
-            m_node_shape_factor_y[bucket_idx].resize(num_nodes);
-        if (m_node_raw_weight_y[bucket_idx].size() != num_nodes)
-            m_node_raw_weight_y[bucket_idx].resize(num_nodes);
-        if (m_node_orientation_y[bucket_idx].size() != num_nodes * 3)
-            m_node_orientation_y[bucket_idx].resize(num_nodes * 3);
-
-        if (m_node_mass_z[bucket_idx].size() != num_nodes)
-            m_node_mass_z[bucket_idx].resize(num_nodes);
-        if (m_node_vel_z[bucket_idx].size() != num_nodes)
-            m_node_vel_z[bucket_idx].resize(num_nodes);
-        if (m_node_vol_z[bucket_idx].size() != num_nodes)
-            m_node_vol_z[bucket_idx].resize(num_nodes);
-        if (m_node_sat_z[bucket_idx].size() != num_nodes)
-            m_node_sat_z[bucket_idx].resize(num_nodes);
-        if (m_node_psi_z[bucket_idx].size() != num_nodes)
-            m_node_psi_z[bucket_idx].resize(num_nodes);
-        if (m_node_shape_factor_z[bucket_idx].size() != num_nodes)
-            m_node_shape_factor_z[bucket_idx].resize(num_nodes);
-        if (m_node_raw_weight_z[bucket_idx].size() != num_nodes)
-            m_node_raw_weight_z[bucket_idx].resize(num_nodes);
-        if (m_node_orientation_z[bucket_idx].size() != num_nodes * 3)
-            m_node_orientation_z[bucket_idx].resize(num_nodes * 3);
-
-        if (m_node_mass_fluid_x[bucket_idx].size() != num_nodes)
-            m_node_mass_fluid_x[bucket_idx].resize(num_nodes);
-        if (m_node_vel_fluid_x[bucket_idx].size() != num_nodes)
-            m_node_vel_fluid_x[bucket_idx].resize(num_nodes);
-        if (m_node_vol_fluid_x[bucket_idx].size() != num_nodes)
-            m_node_vol_fluid_x[bucket_idx].resize(num_nodes);
-        if (m_node_vol_pure_fluid_x[bucket_idx].size() != num_nodes)
-            m_node_vol_pure_fluid_x[bucket_idx].resize(num_nodes);
-
-        if (m_node_mass_fluid_y[bucket_idx].size() != num_nodes)
-            m_node_mass_fluid_y[bucket_idx].resize(num_nodes);
-        if (m_node_vel_fluid_y[bucket_idx].size() != num_nodes)
-            m_node_vel_fluid_y[bucket_idx].resize(num_nodes);
-        if (m_node_vol_fluid_y[bucket_idx].size() != num_nodes)
-            m_node_vol_fluid_y[bucket_idx].resize(num_nodes);
-        if (m_node_vol_pure_fluid_y[bucket_idx].size() != num_nodes)
-            m_node_vol_pure_fluid_y[bucket_idx].resize(num_nodes);
-
-        if (m_node_mass_fluid_z[bucket_idx].size() != num_nodes)
-            m_node_mass_fluid_z[bucket_idx].resize(num_nodes);
-        if (m_node_vel_fluid_z[bucket_idx].size() != num_nodes)
-            m_node_vel_fluid_z[bucket_idx].resize(num_nodes);
-        if (m_node_vol_fluid_z[bucket_idx].size() != num_nodes)
-            m_node_vol_fluid_z[bucket_idx].resize(num_nodes);
-        if (m_node_vol_pure_fluid_z[bucket_idx].size() != num_nodes)
-            m_node_vol_pure_fluid_z[bucket_idx].resize(num_nodes);
-
-        if (m_node_solid_phi[bucket_idx].size() != num_nodes)
-            m_node_solid_phi[bucket_idx].resize(num_nodes);
-
-        if (m_node_solid_vel_x[bucket_idx].size() != num_nodes)
-            m_node_solid_vel_x[bucket_idx].resize(num_nodes);
-        if (m_node_solid_vel_y[bucket_idx].size() != num_nodes)
-            m_node_solid_vel_y[bucket_idx].resize(num_nodes);
-        if (m_node_solid_vel_z[bucket_idx].size() != num_nodes)
-            m_node_solid_vel_z[bucket_idx].resize(num_nodes);
-
-        if (m_node_liquid_valid_x[bucket_idx].size() != num_nodes)
-            m_node_liquid_valid_x[bucket_idx].resize(num_nodes);
-        if (m_node_liquid_valid_y[bucket_idx].size() != num_nodes)
-            m_node_liquid_valid_y[bucket_idx].resize(num_nodes);
-        if (m_node_liquid_valid_z[bucket_idx].size() != num_nodes)
-            m_node_liquid_valid_z[bucket_idx].resize(num_nodes);
+        m_node_array_pool.fit(m_node_mass_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_sat_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_psi_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_shape_factor_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_raw_weight_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_orientation_x[bucket_idx], num_nodes * 3);
+
+        m_node_array_pool.fit(m_node_mass_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_sat_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_psi_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_shape_factor_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_raw_weight_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_orientation_y[bucket_idx], num_nodes * 3);
+
+        m_node_array_pool.fit(m_node_mass_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_sat_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_psi_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_shape_factor_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_raw_weight_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_orientation_z[bucket_idx], num_nodes * 3);
+
+        m_node_array_pool.fit(m_node_mass_fluid_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_fluid_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_fluid_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_pure_fluid_x[bucket_idx], num_nodes);
+
+        m_node_array_pool.fit(m_node_mass_fluid_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_fluid_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_fluid_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_pure_fluid_y[bucket_idx], num_nodes);
+
+        m_node_array_pool.fit(m_node_mass_fluid_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vel_fluid_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_fluid_z[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_vol_pure_fluid_z[bucket_idx], num_nodes);
+
+        m_node_array_pool.fit(m_node_solid_phi[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_cell_solid_phi[bucket_idx], num_nodes);
+
+        m_node_array_pool.fit(m_node_solid_vel_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_solid_vel_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_solid_vel_z[bucket_idx], num_nodes);
+
+        m_node_array_pool.fit(m_node_liquid_valid_x[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_liquid_valid_y[bucket_idx], num_nodes);
+        m_node_array_pool.fit(m_node_liquid_valid_z[bucket_idx], num_nodes);
     });
 
     if (m_liquid_info.compute_viscosity) {
-        if ((int) m_node_liquid_c_vf.size() != num_buckets) m_node_liquid_c_vf.resize(num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_c_vf, num_buckets);
 
-        if ((int) m_node_liquid_u_vf.size() != num_buckets) m_node_liquid_u_vf.resize(num_buckets);
-        if ((int) m_node_liquid_v_vf.size() != num_buckets) m_node_liquid_v_vf.resize(num_buckets);
-        if ((int) m_node_liquid_w_vf.size() != num_buckets) m_node_liquid_w_vf.resize(num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_u_vf, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_v_vf, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_w_vf, num_buckets);
 
-        if ((int) m_node_liquid_ex_vf.size() != num_buckets) m_node_liquid_ex_vf.resize(num_buckets);
-        if ((int) m_node_liquid_ey_vf.size() != num_buckets) m_node_liquid_ey_vf.resize(num_buckets);
-        if ((int) m_node_liquid_ez_vf.size() != num_buckets) m_node_liquid_ez_vf.resize(num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_ex_vf, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_ey_vf, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_liquid_ez_vf, num_buckets);
 
-        if ((int) m_node_cell_solid_phi.size() != num_buckets) m_node_cell_solid_phi.resize(num_buckets);
-        if ((int) m_node_state_u.size() != num_buckets) m_node_state_u.resize(num_buckets);
-        if ((int) m_node_state_v.size() != num_buckets) m_node_state_v.resize(num_buckets);
-        if ((int) m_node_state_w.size() != num_buckets) m_node_state_w.resize(num_buckets);
+        m_node_array_pool.fitBuckets(m_node_state_u, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_state_v, num_buckets);
+        m_node_array_pool.fitBuckets(m_node_state_w, num_buckets);
 
         m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
             const int num_nodes = getNumNodes(bucket_idx);
 
-            if (m_node_cell_solid_phi[bucket_idx].size() != num_nodes)
-                m_node_cell_solid_phi[bucket_idx].resize(num_nodes);
-
-            if (m_node_liquid_c_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_c_vf[bucket_idx].resize(num_nodes);
-
-            if (m_node_liquid_u_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_u_vf[bucket_idx].resize(num_nodes);
-            if (m_node_liquid_v_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_v_vf[bucket_idx].resize(num_nodes);
-            if (m_node_liquid_w_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_w_vf[bucket_idx].resize(num_nodes);
-
-            if (m_node_state_u[bucket_idx].size() != num_nodes)
-                m_node_state_u[bucket_idx].resize(num_nodes);
-            if (m_node_state_v[bucket_idx].size() != num_nodes)
-                m_node_state_v[bucket_idx].resize(num_nodes);
-            if (m_node_state_w[bucket_idx].size() != num_nodes)
-                m_node_state_w[bucket_idx].resize(num_nodes);
-
-            if (m_node_liquid_ex_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_ex_vf[bucket_idx].resize(num_nodes);
-            if (m_node_liquid_ey_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_ey_vf[bucket_idx].resize(num_nodes);
-            if (m_node_liquid_ez_vf[bucket_idx].size() != num_nodes)
-                m_node_liquid_ez_vf[bucket_idx].resize(num_nodes);
+            m_node_array_pool.fit(m_node_liquid_c_vf[bucket_idx], num_nodes);
+
+            m_node_array_pool.fit(m_node_liquid_u_vf[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_liquid_v_vf[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_liquid_w_vf[bucket_idx], num_nodes);
+
+            m_node_array_pool.fit(m_node_state_u[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_state_v[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_state_w[bucket_idx], num_nodes);
+
+            m_node_array_pool.fit(m_node_liquid_ex_vf[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_liquid_ey_vf[bucket_idx], num_nodes);
+            m_node_array_pool.fit(m_node_liquid_ez_vf[bucket_idx], num_nodes);
         });
     }
 }
@@ -5025,6 +5109,8 @@ void TwoDScene::expandFluidNodesMarked(int layers)
  */
 void TwoDScene::resampleNodes()
 {
+    profiler::ScopedTimer timer("resampleNodes");
+
     preAllocateNodes();
 
     auto particle_node_criteria = [this] (int pidx) -> bool { return isSoft(pidx); };
@@ -5453,6 +5539,8 @@ void TwoDScene::sampleSolidDistanceFields()
  */
 void TwoDScene::sampleLiquidDistanceFields(scalar cur_time)
 {
+    profiler::ScopedTimer timer("sampleLiquidDistanceFields");
+
     int num_group = (int) m_group_distance_field.size();
 
     const scalar dx = getCellSize(); // we use denser dx to prevent penetration
@@ -5876,10 +5964,10 @@ void TwoDScene::mapParticleSaturationPsiNodes()
                 const int pidx = pair.first;
                 if (m_particle_to_surfel[pidx] >= 0) continue;
 
-                auto& weights = m_particle_weights_p[pidx];
+                auto& weights = m_particle_weights[pidx];
 
-                vol_liquid += m_fluid_vol(pidx) * weights(pair.second);
-                vol_solid += m_rest_vol(pidx) * weights(pair.second) * m_rest_volume_fraction[pidx];
+                vol_liquid += m_fluid_vol(pidx) * weights(pair.second, 4);
+                vol_solid += m_rest_vol(pidx) * weights(pair.second, 4) * m_rest_volume_fraction[pidx];
             }
 
             scalar psi = mathutils::clamp(vol_solid / dV, 0.0, 1.0);
@@ -5901,8 +5989,14 @@ void TwoDScene::setVolumeFraction(int particle, const scalar& vol_frac)
  */
 void TwoDScene::distributeElastoFluid()
 {
+    profiler::ScopedTimer timer("liquidDripping");
+
     const int num_elasto_parts = getNumElastoParticles();
 
+    // fluid particles emptied by the capturing are moved to the end, and
+    // dropped by the resize below
+    const int num_part = collectEmptyParticles();
+
     const scalar rel_rad = mathutils::defaultRadiusMultiplier() * getCellSize() * m_liquid_info.particle_cell_multiplier;
     const scalar rel_vol = 4.0 / 3.0 * M_PI * rel_rad * rel_rad * rel_rad;
 
@@ -5913,7 +6007,7 @@ void TwoDScene::distributeElastoFluid()
     const int num_faces = getNumFaces();
 
     VectorXs back_vol = m_fluid_vol;
-    scalar old_sum_vol = back_vol.sum();
+    scalar old_sum_vol = back_vol.head(num_part).sum();
 
     m_gauss_buckets.for_each_bucket_particles_colored([&] (int gidx, int bucket_idx) {
         auto& bucket_buffer = buffer[bucket_idx];
@@ -6014,16 +6108,18 @@ void TwoDScene::distributeElastoFluid()
         count += (int) buffer[i].size();
     }
 
-    if (!count) return;
+    if (!count) {
+        removeEmptyParticles();
+        return;
+    }
 
     threadutils::for_each(0, num_elasto_parts, [&] (int pidx) {
         m_fluid_m.segment<3>(pidx * 4).setConstant(m_fluid_vol(pidx) * m_liquid_info.liquid_density);
     });
 
-    const int num_part = getNumParticles();
     conservativeResizeParticles(num_part + count);
 
-    const int num_fluid = (int) m_fluids.size();
+    const int num_fluid = num_part - num_elasto_parts;
     m_fluids.resize(num_fluid + count);
 
     threadutils::for_each(0, num_buckets, [&] (int bucket_idx) {
@@ -6158,6 +6254,8 @@ void TwoDScene::computeDDA()
  */
 void TwoDScene::distributeFluidElasto(const scalar& dt)
 {
+    profiler::ScopedTimer timer("liquidCapturing");
+
     const int num_elasto_parts = getNumElastoParticles();
 
     const scalar old_sum_vol = m_fluid_vol.sum();
@@ -6173,6 +6271,9 @@ void TwoDScene::distributeFluidElasto(const scalar& dt)
         m_node_raw_weight_y[bucket_idx].setZero();
         m_node_raw_weight_z[bucket_idx].setZero();
 
+        // no fluid particles in the node-particle pairs, scattered below
+        if (m_liquid_info.use_scatter_p2g) return;
+
         const auto& bucket_node_particles_x = m_node_particles_x[bucket_idx];
         const auto& bucket_node_particles_y = m_node_particles_y[bucket_idx];
         const auto& bucket_node_particles_z = m_node_particles_z[bucket_idx];
@@ -6249,6 +6350,54 @@ void TwoDScene::distributeFluidElasto(const scalar& dt)
         }
     });
 
+    if (m_liquid_info.use_scatter_p2g) {
+        m_particle_buckets.for_each_bucket_particles_colored([&] (int pidx, int bucket_idx) {
+            if (!m_bucket_activated[bucket_idx] || pidx < num_elasto_parts || m_inside[pidx] != 2U) return;
+
+            const auto& weights = m_particle_weights[pidx];
+            const scalar fvol = m_fluid_vol(pidx);
+
+            const auto& indices_x = m_particle_nodes_x[pidx];
+
+            for (int nidx = 0; nidx < indices_x.rows(); ++nidx)
+            {
+                const int node_bucket_idx = indices_x(nidx, 0);
+                const scalar w = weights(nidx, 0);
+                if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+                const int node_idx = indices_x(nidx, 1);
+                m_node_vol_pure_fluid_x[node_bucket_idx](node_idx) += fvol * w;
+                m_node_raw_weight_x[node_bucket_idx](node_idx) += w;
+            }
+
+            const auto& indices_y = m_particle_nodes_y[pidx];
+
+            for (int nidx = 0; nidx < indices_y.rows(); ++nidx)
+            {
+                const int node_bucket_idx = indices_y(nidx, 0);
+                const scalar w = weights(nidx, 1);
+                if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+                const int node_idx = indices_y(nidx, 1);
+                m_node_vol_pure_fluid_y[node_bucket_idx](node_idx) += fvol * w;
+                m_node_raw_weight_y[node_bucket_idx](node_idx) += w;
+            }
+
+            const auto& indices_z = m_particle_nodes_z[pidx];
+
+            for (int nidx = 0; nidx < indices_z.rows(); ++nidx)
+            {
+                const int node_bucket_idx = indices_z(nidx, 0);
+                const scalar w = weights(nidx, 2);
+                if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+                const int node_idx = indices_z(nidx, 1);
+                m_node_vol_pure_fluid_z[node_bucket_idx](node_idx) += fvol * w;
+                m_node_raw_weight_z[node_bucket_idx](node_idx) += w;
+            }
+    }, 3);
+    }
+
     // capture fluid from nodes, reducing amount on nodes
     const int num_part = getNumParticles();
 
@@ -6463,8 +6612,54 @@ void TwoDScene::distributeFluidElasto(const scalar& dt)
         });
     }
 
-    // remove empty fluid particles
-    removeEmptyParticles();
+    // the empty fluid particles are removed by distributeElastoFluid, with
+    // the same resize that adds the dripping ones
+}
+
+/*!
+ * gather the particle states read by the particle-to-grid transfer into
+ * SoA arrays, so that the node-centric loops only touch the components of
+ * the axis being transferred.
+ */
+void TwoDScene::gatherTransferParticles()
+{
+    const int num_part = getNumParticles();
+
+    m_transfer_x.resize(num_part);
+    m_transfer_v.resize(num_part);
+    m_transfer_m.resize(num_part);
+    m_transfer_B.resize(num_part);
+    m_transfer_vol.resize(num_part);
+    m_transfer_orientation.resize(num_part);
+
+    threadutils::for_each(0, num_part, [&] (int pidx) {
+        m_transfer_x.set(pidx, m_x.segment<3>(pidx * 4));
+
+        if (isFluid(pidx)) {
+            const Matrix3s& fB = m_fB.block<3, 3>(pidx * 3, 0);
+
+            m_transfer_v.set(pidx, m_fluid_v.segment<3>(pidx * 4));
+            m_transfer_m.set(pidx, m_fluid_m.segment<3>(pidx * 4));
+            for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) m_transfer_B(pidx, r * 3 + c) = fB(r, c);
+
+            m_transfer_vol.set(pidx, Vector4s(0.0, m_fluid_vol(pidx), 0.0, 0.0));
+            m_transfer_orientation.set(pidx, Vector3s::Zero());
+        } else {
+            const Matrix3s& B = m_B.block<3, 3>(pidx * 3, 0);
+
+            m_transfer_v.set(pidx, m_v.segment<3>(pidx * 4));
+            m_transfer_m.set(pidx, m_m.segment<3>(pidx * 4) + m_fluid_m.segment<3>(pidx * 4));
+            for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) m_transfer_B(pidx, r * 3 + c) = B(r, c);
+
+            if (m_particle_to_surfel[pidx] < 0) {
+                m_transfer_vol.set(pidx, Vector4s(m_rest_vol(pidx) * m_rest_volume_fraction(pidx), m_fluid_vol(pidx), m_shape_factor(pidx), 1.0));
+                m_transfer_orientation.set(pidx, m_orientation.segment<3>(pidx * 3));
+            } else {
+                m_transfer_vol.set(pidx, Vector4s::Zero());
+                m_transfer_orientation.set(pidx, Vector3s::Zero());
+            }
+        }
+    });
 }
 
 /*!
@@ -6472,8 +6667,18 @@ void TwoDScene::distributeFluidElasto(const scalar& dt)
  */
 void TwoDScene::mapParticleNodesAPIC()
 {
+    profiler::ScopedTimer timer("mapParticleNodesAPIC");
+
     const scalar dx = getCellSize();
     const scalar dV = dx * dx * dx;
+
+    gatherTransferParticles();
+
+    if (m_liquid_info.use_scatter_p2g) {
+        scatterParticleNodesAPIC();
+        return;
+    }
+
     //    std::cout << "FVb: " << m_fluid_v << std::endl;
     m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
         if (!m_bucket_activated[bucket_idx]) return;
@@ -6538,34 +6743,25 @@ void TwoDScene::mapParticleNodesAPIC()
             for (auto& pair : node_particles_x) {
                 const int pidx = pair.first;
 
-                auto& weights = m_particle_weights[pidx];
-                const scalar& vol = m_rest_vol(pidx);
-                const Vector3s& m = m_m.segment<3>(pidx * 4);
-                const scalar& fvol = m_fluid_vol(pidx);
-                const Vector3s& fm = m_fluid_m.segment<3>(pidx * 4);
-                const Vector3s& v = m_v.segment<3>(pidx * 4);
-                const Vector3s& fluidv = m_fluid_v.segment<3>(pidx * 4);
-                const Vector3s& pos = m_x.segment<3>(pidx * 4);
-                const Matrix3s& B = m_B.block<3, 3>(pidx * 3, 0);
-                const Matrix3s& fB = m_fB.block<3, 3>(pidx * 3, 0);
+                const scalar w = m_particle_weights[pidx](pair.second, 0);
+                const Vector3s dpos = np - m_transfer_x.get(pidx);
+                const scalar vel = m_transfer_v(pidx, 0) + m_transfer_B(pidx, 0) * dpos(0) + m_transfer_B(pidx, 1) * dpos(1) + m_transfer_B(pidx, 2) * dpos(2);
+                const scalar pm = m_transfer_m(pidx, 0);
 
                 if (!isFluid(pidx)) {
-                    const scalar vel = v(0) + B.row(0).dot(np - pos);
-                    p += vel * (m(0) + fm(0)) * weights(pair.second, 0);
-                    mass += (m(0) + fm(0)) * weights(pair.second, 0);
-
-                    if (m_particle_to_surfel[pidx] < 0) {
-                        vol_solid += vol * m_rest_volume_fraction(pidx) * weights(pair.second, 0);
-                        vol_fluid_elasto += fvol * weights(pair.second, 0);
-                        shape_factor += m_shape_factor(pidx) * weights(pair.second, 0);
-                        shape_factor_rw += weights(pair.second, 0);
-                        orientation += m_orientation.segment<3>(pidx * 3) * weights(pair.second, 0);
-                    }
+                    p += vel * pm * w;
+                    mass += pm * w;
+
+                    // the volume terms are zero for surfels
+                    vol_solid += m_transfer_vol(pidx, 0) * w;
+                    vol_fluid_elasto += m_transfer_vol(pidx, 1) * w;
+                    shape_factor += m_transfer_vol(pidx, 2) * w;
+                    shape_factor_rw += m_transfer_vol(pidx, 3) * w;
+                    orientation += m_transfer_orientation.get(pidx) * w;
                 } else {
-                    const scalar vel = fluidv(0) + fB.row(0).dot(np - pos);
-                    p_fluid += vel * fm(0) * weights(pair.second, 0);
-                    mass_fluid += fm(0) * weights(pair.second, 0);
-                    vol_fluid += fvol * weights(pair.second, 0);
+                    p_fluid += vel * pm * w;
+                    mass_fluid += pm * w;
+                    vol_fluid += m_transfer_vol(pidx, 1) * w;
                 }
             }
 
@@ -6623,34 +6819,25 @@ void TwoDScene::mapParticleNodesAPIC()
             for (auto& pair : node_particles_y) {
                 const int pidx = pair.first;
 
-                auto& weights = m_particle_weights[pidx];
-                const scalar& vol = m_rest_vol(pidx);
-                const Vector3s& m = m_m.segment<3>(pidx * 4);
-                const scalar& fvol = m_fluid_vol(pidx);
-                const Vector3s& fm = m_fluid_m.segment<3>(pidx * 4);
-                const Vector3s& v = m_v.segment<3>(pidx * 4);
-                const Vector3s& fluidv = m_fluid_v.segment<3>(pidx * 4);
-                const Vector3s& pos = m_x.segment<3>(pidx * 4);
-                const Matrix3s& B = m_B.block<3, 3>(pidx * 3, 0);
-                const Matrix3s& fB = m_fB.block<3, 3>(pidx * 3, 0);
+                const scalar w = m_particle_weights[pidx](pair.second, 1);
+                const Vector3s dpos = np - m_transfer_x.get(pidx);
+                const scalar vel = m_transfer_v(pidx, 1) + m_transfer_B(pidx, 3) * dpos(0) + m_transfer_B(pidx, 4) * dpos(1) + m_transfer_B(pidx, 5) * dpos(2);
+                const scalar pm = m_transfer_m(pidx, 1);
 
                 if (!isFluid(pidx)) {
-                    const scalar vel = v(1) + B.row(1).dot(np - pos);
-                    p += vel * (m(1) + fm(1)) * weights(pair.second, 1);
-                    mass += (m(1) + fm(1)) * weights(pair.second, 1);
-
-                    if (m_particle_to_surfel[pidx] < 0) {
-                        vol_solid += vol * m_rest_volume_fraction(pidx) * weights(pair.second, 1);
-                        vol_fluid_elasto += fvol * weights(pair.second, 1);
-                        shape_factor += m_shape_factor(pidx) * weights(pair.second, 1);
-                        shape_factor_rw += weights(pair.second, 1);
-                        orientation += m_orientation.segment<3>(pidx * 3) * weights(pair.second, 1);
-                    }
+                    p += vel * pm * w;
+                    mass += pm * w;
+
+                    // the volume terms are zero for surfels
+                    vol_solid += m_transfer_vol(pidx, 0) * w;
+                    vol_fluid_elasto += m_transfer_vol(pidx, 1) * w;
+                    shape_factor += m_transfer_vol(pidx, 2) * w;
+                    shape_factor_rw += m_transfer_vol(pidx, 3) * w;
+                    orientation += m_transfer_orientation.get(pidx) * w;
                 } else {
-                    const scalar vel = fluidv(1) + fB.row(1).dot(np - pos);
-                    p_fluid += vel * fm(1) * weights(pair.second, 1);
-                    mass_fluid += fm(1) * weights(pair.second, 1);
-                    vol_fluid += fvol * weights(pair.second, 1);
+                    p_fluid += vel * pm * w;
+                    mass_fluid += pm * w;
+                    vol_fluid += m_transfer_vol(pidx, 1) * w;
                 }
             }
 
@@ -6708,34 +6895,25 @@ void TwoDScene::mapParticleNodesAPIC()
             for (auto& pair : node_particles_z) {
                 const int pidx = pair.first;
 
-                auto& weights = m_particle_weights[pidx];
-                const scalar& vol = m_rest_vol(pidx);
-                const Vector3s& m = m_m.segment<3>(pidx * 4);
-                const scalar& fvol = m_fluid_vol(pidx);
-                const Vector3s& fm = m_fluid_m.segment<3>(pidx * 4);
-                const Vector3s& v = m_v.segment<3>(pidx * 4);
-                const Vector3s& fluidv = m_fluid_v.segment<3>(pidx * 4);
-                const Vector3s& pos = m_x.segment<3>(pidx * 4);
-                const Matrix3s& B = m_B.block<3, 3>(pidx * 3, 0);
-                const Matrix3s& fB = m_fB.block<3, 3>(pidx * 3, 0);
+                const scalar w = m_particle_weights[pidx](pair.second, 2);
+                const Vector3s dpos = np - m_transfer_x.get(pidx);
+                const scalar vel = m_transfer_v(pidx, 2) + m_transfer_B(pidx, 6) * dpos(0) + m_transfer_B(pidx, 7) * dpos(1) + m_transfer_B(pidx, 8) * dpos(2);
+                const scalar pm = m_transfer_m(pidx, 2);
 
                 if (!isFluid(pidx)) {
-                    const scalar vel = v(2) + B.row(2).dot(np - pos);
-                    p += vel * (m(2) + fm(2)) * weights(pair.second, 2);
-                    mass += (m(2) + fm(2)) * weights(pair.second, 2);
-
-                    if (m_particle_to_surfel[pidx] < 0) {
-                        vol_solid += vol * m_rest_volume_fraction(pidx) * weights(pair.second, 2);
-                        vol_fluid_elasto += fvol * weights(pair.second, 2);
-                        shape_factor += m_shape_factor(pidx) * weights(pair.second, 2);
-                        shape_factor_rw += weights(pair.second, 2);
-                        orientation += m_orientation.segment<3>(pidx * 3) * weights(pair.second, 2);
-                    }
+                    p += vel * pm * w;
+                    mass += pm * w;
+
+                    // the volume terms are zero for surfels
+                    vol_solid += m_transfer_vol(pidx, 0) * w;
+                    vol_fluid_elasto += m_transfer_vol(pidx, 1) * w;
+                    shape_factor += m_transfer_vol(pidx, 2) * w;
+                    shape_factor_rw += m_transfer_vol(pidx, 3) * w;
+                    orientation += m_transfer_orientation.get(pidx) * w;
                 } else {
-                    const scalar vel = fluidv(2) + fB.row(2).dot(np - pos);
-                    p_fluid += vel * fm(2) * weights(pair.second, 2);
-                    mass_fluid += fm(2) * weights(pair.second, 2);
-                    vol_fluid += fvol * weights(pair.second, 2);
+                    p_fluid += vel * pm * w;
+                    mass_fluid += pm * w;
+                    vol_fluid += m_transfer_vol(pidx, 1) * w;
                 }
             }
 
@@ -6774,6 +6952,292 @@ void TwoDScene::mapParticleNodesAPIC()
     });
 }
 
+/*!
+ * scatter form of mapParticleNodesAPIC: instead of gathering over the
+ * node-particle pairs, each particle adds its contribution to the nodes of its
+ * stencil. Particles are visited in the order of the particle buckets, and the
+ * buckets in 3x3x3 colors so that no two threads touch the same node. Every
+ * node thus receives the contributions in the same order as the gather.
+ */
+void TwoDScene::scatterParticleNodesAPIC()
+{
+    const scalar dx = getCellSize();
+    const scalar dV = dx * dx * dx;
+
+    // until normalized below, the node arrays hold the weighted sums:
+    // vel(_fluid) <- momentum, psi <- solid volume, vol <- liquid volume in the
+    // elastic material and sat <- weight of the shape factor
+    m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
+        if (!m_bucket_activated[bucket_idx]) return;
+
+        m_node_mass_x[bucket_idx].setZero();
+        m_node_vel_x[bucket_idx].setZero();
+        m_node_vol_x[bucket_idx].setZero();
+        m_node_mass_fluid_x[bucket_idx].setZero();
+        m_node_vel_fluid_x[bucket_idx].setZero();
+        m_node_vol_fluid_x[bucket_idx].setZero();
+        m_node_psi_x[bucket_idx].setZero();
+        m_node_sat_x[bucket_idx].setZero();
+        m_node_orientation_x[bucket_idx].setZero();
+        m_node_shape_factor_x[bucket_idx].setZero();
+
+        m_node_mass_y[bucket_idx].setZero();
+        m_node_vel_y[bucket_idx].setZero();
+        m_node_vol_y[bucket_idx].setZero();
+        m_node_mass_fluid_y[bucket_idx].setZero();
+        m_node_vel_fluid_y[bucket_idx].setZero();
+        m_node_vol_fluid_y[bucket_idx].setZero();
+        m_node_psi_y[bucket_idx].setZero();
+        m_node_sat_y[bucket_idx].setZero();
+        m_node_orientation_y[bucket_idx].setZero();
+        m_node_shape_factor_y[bucket_idx].setZero();
+
+        m_node_mass_z[bucket_idx].setZero();
+        m_node_vel_z[bucket_idx].setZero();
+        m_node_vol_z[bucket_idx].setZero();
+        m_node_mass_fluid_z[bucket_idx].setZero();
+        m_node_vel_fluid_z[bucket_idx].setZero();
+        m_node_vol_fluid_z[bucket_idx].setZero();
+        m_node_psi_z[bucket_idx].setZero();
+        m_node_sat_z[bucket_idx].setZero();
+        m_node_orientation_z[bucket_idx].setZero();
+        m_node_shape_factor_z[bucket_idx].setZero();
+    });
+
+    m_particle_buckets.for_each_bucket_particles_colored([&] (int pidx, int bucket_idx) {
+        if (!m_bucket_activated[bucket_idx]) return;
+
+        const bool is_fluid = isFluid(pidx);
+        const Vector3s pos = m_transfer_x.get(pidx);
+        const Vector3s orientation = m_transfer_orientation.get(pidx);
+        const Vector4s vol = m_transfer_vol.get(pidx);
+        // local copies, the node arrays written below may alias the particle data
+        const ParticleWeights weights = m_particle_weights[pidx];
+
+        const auto& indices_x = m_particle_nodes_x[pidx];
+        const scalar v_x = m_transfer_v(pidx, 0);
+        const scalar pm_x = m_transfer_m(pidx, 0);
+        const Vector3s B_x(m_transfer_B(pidx, 0), m_transfer_B(pidx, 1), m_transfer_B(pidx, 2));
+
+        for (int nidx = 0; nidx < indices_x.rows(); ++nidx)
+        {
+            const int node_bucket_idx = indices_x(nidx, 0);
+            const scalar w = weights(nidx, 0);
+            if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+            const int node_idx = indices_x(nidx, 1);
+            const Vector3s dpos = getNodePosX(node_bucket_idx, node_idx) - pos;
+            const scalar vel = v_x + B_x(0) * dpos(0) + B_x(1) * dpos(1) + B_x(2) * dpos(2);
+
+            if (!is_fluid) {
+                m_node_vel_x[node_bucket_idx](node_idx) += vel * pm_x * w;
+                m_node_mass_x[node_bucket_idx](node_idx) += pm_x * w;
+
+                // the volume terms are zero for surfels
+                m_node_psi_x[node_bucket_idx](node_idx) += vol(0) * w;
+                m_node_vol_x[node_bucket_idx](node_idx) += vol(1) * w;
+                m_node_shape_factor_x[node_bucket_idx](node_idx) += vol(2) * w;
+                m_node_sat_x[node_bucket_idx](node_idx) += vol(3) * w;
+                m_node_orientation_x[node_bucket_idx].segment<3>(node_idx * 3) += orientation * w;
+            } else {
+                m_node_vel_fluid_x[node_bucket_idx](node_idx) += vel * pm_x * w;
+                m_node_mass_fluid_x[node_bucket_idx](node_idx) += pm_x * w;
+                m_node_vol_fluid_x[node_bucket_idx](node_idx) += vol(1) * w;
+            }
+        }
+
+        const auto& indices_y = m_particle_nodes_y[pidx];
+        const scalar v_y = m_transfer_v(pidx, 1);
+        const scalar pm_y = m_transfer_m(pidx, 1);
+        const Vector3s B_y(m_transfer_B(pidx, 3), m_transfer_B(pidx, 4), m_transfer_B(pidx, 5));
+
+        for (int nidx = 0; nidx < indices_y.rows(); ++nidx)
+        {
+            const int node_bucket_idx = indices_y(nidx, 0);
+            const scalar w = weights(nidx, 1);
+            if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+            const int node_idx = indices_y(nidx, 1);
+            const Vector3s dpos = getNodePosY(node_bucket_idx, node_idx) - pos;
+            const scalar vel = v_y + B_y(0) * dpos(0) + B_y(1) * dpos(1) + B_y(2) * dpos(2);
+
+            if (!is_fluid) {
+                m_node_vel_y[node_bucket_idx](node_idx) += vel * pm_y * w;
+                m_node_mass_y[node_bucket_idx](node_idx) += pm_y * w;
+
+                // the volume terms are zero for surfels
+                m_node_psi_y[node_bucket_idx](node_idx) += vol(0) * w;
+                m_node_vol_y[node_bucket_idx](node_idx) += vol(1) * w;
+                m_node_shape_factor_y[node_bucket_idx](node_idx) += vol(2) * w;
+                m_node_sat_y[node_bucket_idx](node_idx) += vol(3) * w;
+                m_node_orientation_y[node_bucket_idx].segment<3>(node_idx * 3) += orientation * w;
+            } else {
+                m_node_vel_fluid_y[node_bucket_idx](node_idx) += vel * pm_y * w;
+                m_node_mass_fluid_y[node_bucket_idx](node_idx) += pm_y * w;
+                m_node_vol_fluid_y[node_bucket_idx](node_idx) += vol(1) * w;
+            }
+        }
+
+        const auto& indices_z = m_particle_nodes_z[pidx];
+        const scalar v_z = m_transfer_v(pidx, 2);
+        const scalar pm_z = m_transfer_m(pidx, 2);
+        const Vector3s B_z(m_transfer_B(pidx, 6), m_transfer_B(pidx, 7), m_transfer_B(pidx, 8));
+
+        for (int nidx = 0; nidx < indices_z.rows(); ++nidx)
+        {
+            const int node_bucket_idx = indices_z(nidx, 0);
+            const scalar w = weights(nidx, 2);
+            if (!m_bucket_activated[node_bucket_idx] || w <= 0.0) continue;
+
+            const int node_idx = indices_z(nidx, 1);
+            const Vector3s dpos = getNodePosZ(node_bucket_idx, node_idx) - pos;
+            const scalar vel = v_z + B_z(0) * dpos(0) + B_z(1) * dpos(1) + B_z(2) * dpos(2);
+
+            if (!is_fluid) {
+                m_node_vel_z[node_bucket_idx](node_idx) += vel * pm_z * w;
+                m_node_mass_z[node_bucket_idx](node_idx) += pm_z * w;
+
+                // the volume terms are zero for surfels
+                m_node_psi_z[node_bucket_idx](node_idx) += vol(0) * w;
+                m_node_vol_z[node_bucket_idx](node_idx) += vol(1) * w;
+                m_node_shape_factor_z[node_bucket_idx](node_idx) += vol(2) * w;
+                m_node_sat_z[node_bucket_idx](node_idx) += vol(3) * w;
+                m_node_orientation_z[node_bucket_idx].segment<3>(node_idx * 3) += orientation * w;
+            } else {
+                m_node_vel_fluid_z[node_bucket_idx](node_idx) += vel * pm_z * w;
+                m_node_mass_fluid_z[node_bucket_idx](node_idx) += pm_z * w;
+                m_node_vol_fluid_z[node_bucket_idx](node_idx) += vol(1) * w;
+            }
+        }
+    }, 3);
+
+    m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
+        if (!m_bucket_activated[bucket_idx]) return;
+
+        const int num_nodes = getNumNodes(bucket_idx);
+
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            const scalar mass = m_node_mass_x[bucket_idx](i);
+            const scalar mass_fluid = m_node_mass_fluid_x[bucket_idx](i);
+            const scalar vol_solid = m_node_psi_x[bucket_idx](i);
+            const scalar vol_fluid_elasto = m_node_vol_x[bucket_idx](i);
+            const scalar vol_fluid = m_node_vol_fluid_x[bucket_idx](i);
+            const scalar shape_factor_rw = m_node_sat_x[bucket_idx](i);
+
+            if (mass > 1e-20) {
+                m_node_vel_x[bucket_idx](i) /= mass;
+            } else {
+                m_node_vel_x[bucket_idx](i) = 0.0;
+            }
+
+            if (mass_fluid > 1e-20) {
+                m_node_vel_fluid_x[bucket_idx](i) /= mass_fluid;
+            } else {
+                m_node_vel_fluid_x[bucket_idx](i) = 0.0;
+            }
+
+            if (shape_factor_rw > 1e-20) {
+                m_node_shape_factor_x[bucket_idx](i) /= shape_factor_rw;
+            }
+
+            m_node_vol_x[bucket_idx](i) = vol_solid + vol_fluid_elasto;
+
+            m_node_psi_x[bucket_idx](i) = mathutils::clamp(vol_solid / dV, 0.0, 1.0);
+            m_node_sat_x[bucket_idx](i) = mathutils::clamp((vol_fluid + vol_fluid_elasto) / std::max(1e-20, dV - vol_solid), 0.0, 1.0);
+
+            const scalar lo = m_node_orientation_x[bucket_idx].segment<3>(i * 3).norm();
+            if (lo > 1e-20) {
+                m_node_orientation_x[bucket_idx].segment<3>(i * 3) /= lo;
+            }
+        }
+
+        assert(!std::isnan(m_node_vel_x[bucket_idx].sum()));
+        assert(!std::isnan(m_node_mass_fluid_x[bucket_idx].sum()));
+        assert(!std::isnan(m_node_vol_fluid_x[bucket_idx].sum()));
+
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            const scalar mass = m_node_mass_y[bucket_idx](i);
+            const scalar mass_fluid = m_node_mass_fluid_y[bucket_idx](i);
+            const scalar vol_solid = m_node_psi_y[bucket_idx](i);
+            const scalar vol_fluid_elasto = m_node_vol_y[bucket_idx](i);
+            const scalar vol_fluid = m_node_vol_fluid_y[bucket_idx](i);
+            const scalar shape_factor_rw = m_node_sat_y[bucket_idx](i);
+
+            if (mass > 1e-20) {
+                m_node_vel_y[bucket_idx](i) /= mass;
+            } else {
+                m_node_vel_y[bucket_idx](i) = 0.0;
+            }
+
+            if (mass_fluid > 1e-20) {
+                m_node_vel_fluid_y[bucket_idx](i) /= mass_fluid;
+            } else {
+                m_node_vel_fluid_y[bucket_idx](i) = 0.0;
+            }
+
+            if (shape_factor_rw > 1e-20) {
+                m_node_shape_factor_y[bucket_idx](i) /= shape_factor_rw;
+            }
+
+            m_node_vol_y[bucket_idx](i) = vol_solid + vol_fluid_elasto;
+
+            m_node_psi_y[bucket_idx](i) = mathutils::clamp(vol_solid / dV, 0.0, 1.0);
+            m_node_sat_y[bucket_idx](i) = mathutils::clamp((vol_fluid + vol_fluid_elasto) / std::max(1e-20, dV - vol_solid), 0.0, 1.0);
+
+            const scalar lo = m_node_orientation_y[bucket_idx].segment<3>(i * 3).norm();
+            if (lo > 1e-20) {
+                m_node_orientation_y[bucket_idx].segment<3>(i * 3) /= lo;
+            }
+        }
+
+        assert(!std::isnan(m_node_vel_y[bucket_idx].sum()));
+        assert(!std::isnan(m_node_mass_fluid_y[bucket_idx].sum()));
+        assert(!std::isnan(m_node_vol_fluid_y[bucket_idx].sum()));
+
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            const scalar mass = m_node_mass_z[bucket_idx](i);
+            const scalar mass_fluid = m_node_mass_fluid_z[bucket_idx](i);
+            const scalar vol_solid = m_node_psi_z[bucket_idx](i);
+            const scalar vol_fluid_elasto = m_node_vol_z[bucket_idx](i);
+            const scalar vol_fluid = m_node_vol_fluid_z[bucket_idx](i);
+            const scalar shape_factor_rw = m_node_sat_z[bucket_idx](i);
+
+            if (mass > 1e-20) {
+                m_node_vel_z[bucket_idx](i) /= mass;
+            } else {
+                m_node_vel_z[bucket_idx](i) = 0.0;
+            }
+
+            if (mass_fluid > 1e-20) {
+                m_node_vel_fluid_z[bucket_idx](i) /= mass_fluid;
+            } else {
+                m_node_vel_fluid_z[bucket_idx](i) = 0.0;
+            }
+
+            if (shape_factor_rw > 1e-20) {
+                m_node_shape_factor_z[bucket_idx](i) /= shape_factor_rw;
+            }
+
+            m_node_vol_z[bucket_idx](i) = vol_solid + vol_fluid_elasto;
+
+            m_node_psi_z[bucket_idx](i) = mathutils::clamp(vol_solid / dV, 0.0, 1.0);
+            m_node_sat_z[bucket_idx](i) = mathutils::clamp((vol_fluid + vol_fluid_elasto) / std::max(1e-20, dV - vol_solid), 0.0, 1.0);
+
+            const scalar lo = m_node_orientation_z[bucket_idx].segment<3>(i * 3).norm();
+            if (lo > 1e-20) {
+                m_node_orientation_z[bucket_idx].segment<3>(i * 3) /= lo;
+            }
+        }
+
+        assert(!std::isnan(m_node_vel_z[bucket_idx].sum()));
+        assert(!std::isnan(m_node_mass_fluid_z[bucket_idx].sum()));
+        assert(!std::isnan(m_node_vol_fluid_z[bucket_idx].sum()));
+    });
+}
+
 bool TwoDScene::isFluid(int pidx) const
 {
     return pidx >= getNumElastoParticles();
@@ -6796,6 +7260,8 @@ void TwoDScene::saveParticleVelocity()
  */
 void TwoDScene::mapNodeParticlesAPIC()
 {
+    profiler::ScopedTimer timer("mapNodeParticlesAPIC");
+
     const int num_part = getNumParticles();
 
     const scalar invD = getInverseDCoeff();
@@ -7358,18 +7824,48 @@ void TwoDScene::postcompute(VectorXs& v, const scalar& dt)
     });
 }
 
+void TwoDScene::updateStrandBatch()
+{
+    const int num_forces = (int) m_forces.size();
+
+    if (m_strand_batch && (!m_liquid_info.use_strand_batch || m_strand_batch->getNumSceneForces() != num_forces)) {
+        m_strand_batch->detach();
+        m_strand_batch.reset();
+    }
+
+    if (!m_liquid_info.use_strand_batch) {
+        m_strand_batch_num_forces = -1;
+        return;
+    }
+
+    // only retry once the forces have changed
+    if (m_strand_batch || m_strand_batch_num_forces == num_forces) return;
+
+    m_strand_batch_num_forces = num_forces;
+    m_strand_batch = std::make_shared<StrandBatch>(*this, m_forces);
+    if (!m_strand_batch->getNumStrands()) m_strand_batch.reset();
+}
+
 void TwoDScene::precompute()
 {
+    updateStrandBatch();
+
     threadutils::for_each(0, (int) m_forces.size(), [&] (int f) {
         m_forces[f]->preCompute();
     });
+
+    if (m_strand_batch) m_strand_batch->preCompute();
 }
 
 void TwoDScene::updateStartState()
 {
+    updateStrandBatch();
+
     threadutils::for_each(0, (int) m_forces.size(), [&] (int f) {
         m_forces[f]->updateStartState();
     });
+
+    if (m_strand_batch) m_strand_batch->updateStartState();
 }
 
 scalar TwoDScene::computeTotalEnergy() const
@@ -7392,6 +7888,8 @@ VectorXs& TwoDScene::getVolumeFraction()
  */
 void TwoDScene::updateManifoldOperators()
 {
+    profiler::ScopedTimer timer("updateManifoldOperators");
+
     const int num_edges = m_edges.rows();
     const int num_triangles = m_faces.rows();
     const int num_surfels = m_surfels.size();
@@ -7565,14 +8063,15 @@ void TwoDScene::accumulateManifoldGradPorePressure( VectorXs& F )
 
         if (m_liquid_info.apply_pressure_manifold) {
             auto& indices_p = m_particle_nodes_p[pidx];
-            auto& weights = m_particle_weights_p[pidx];
+            auto& weights = m_particle_weights[pidx];
             const int num_indices = indices_p.rows();
 
             scalar p = 0.0;
 
             for (int i = 0; i < num_indices; ++i) {
-                if (weights(i) == 0.0 || !m_bucket_activated[indices_p(i, 0)]) continue;
-                p += m_node_pressure[indices_p(i, 0)][indices_p(i, 1)] * weights[i];
+                const scalar w = weights(i, 4);
+                if (w == 0.0 || !m_bucket_activated[indices_p(i, 0)]) continue;
+                p += m_node_pressure[indices_p(i, 0)][indices_p(i, 1)] * w;
             }
 
             pore_pressure(pidx) -= p;
@@ -7619,8 +8118,13 @@ void TwoDScene::accumulateGradU( VectorXs& F, const VectorXs& dx, const VectorXs
 
     VectorXs combined_mass = m_m + m_fluid_m;
 
-    // Accumulate all energy gradients
+    // Accumulate all energy gradients, the batched strands all at once
     if ( dx.size() == 0 ) for ( std::vector<Force*>::size_type i = 0; i < m_forces.size(); ++i ) {
+            if (m_strand_batch && (int) i == m_strand_batch->getForceBegin()) {
+                m_strand_batch->addGradEToTotal( F );
+                i = m_strand_batch->getForceEnd() - 1;
+                continue;
+            }
             if (m_forces[i]->flag() & 1) m_forces[i]->addGradEToTotal( m_x, m_v, combined_mass, m_volume_fraction, m_liquid_info.lambda, F );
         }
     else                 {
@@ -7628,6 +8132,11 @@ void TwoDScene::accumulateGradU( VectorXs& F, const VectorXs& dx, const VectorXs
         VectorXs ddv = m_v + dv;
 
         for ( std::vector<Force*>::size_type i = 0; i < m_forces.size(); ++i ) {
+            if (m_strand_batch && (int) i == m_strand_batch->getForceBegin()) {
+                m_strand_batch->addGradEToTotal( F );
+                i = m_strand_batch->getForceEnd() - 1;
+                continue;
+            }
             if (m_forces[i]->flag() & 1) m_forces[i]->addGradEToTotal( ddx, ddv, m_m, m_volume_fraction, m_liquid_info.lambda, F );
         }
     }
@@ -7775,6 +8284,8 @@ void TwoDScene::updateMultipliers(const scalar& dt)
     for ( int i = 0; i < num_force; ++i ) {
         m_forces[i]->updateMultipliers( m_x, m_v, m_m, m_volume_fraction, m_liquid_info.lambda, dt );
     }
+
+    if (m_strand_batch) m_strand_batch->updateMultipliers( m_v, dt );
 }
 
 /*!
@@ -7823,6 +8334,361 @@ void TwoDScene::dump_geometry(std::string filename) {
     myfile.close();
 }
 
+/*!
+ * write the particle, element, kinematic and force state to a checkpoint.
+ * Topology and parameters come from the scene file, the grid is rebuilt
+ * from the particles.
+ */
+void TwoDScene::writeCheckpoint(checkpoint::Writer& writer) const
+{
+    const int num_parts = getNumParticles();
+
+    writer.writeValue("scene/num_particles", num_parts);
+    writer.writeValue("scene/num_elasto", getNumElastoParticles());
+    writer.writeValue("scene/num_gausses", getNumGausses());
+
+    writer.writeMatrix("scene/x", m_x);
+    writer.writeMatrix("scene/rest_x", m_rest_x);
+    writer.writeMatrix("scene/v", m_v);
+    writer.writeMatrix("scene/saved_v", m_saved_v);
+    writer.writeMatrix("scene/dv", m_dv);
+    writer.writeMatrix("scene/fluid_v", m_fluid_v);
+    writer.writeMatrix("scene/m", m_m);
+    writer.writeMatrix("scene/fluid_m", m_fluid_m);
+    writer.writeMatrix("scene/radius", m_radius);
+    writer.writeMatrix("scene/vol", m_vol);
+    writer.writeMatrix("scene/rest_vol", m_rest_vol);
+    writer.writeMatrix("scene/shape_factor", m_shape_factor);
+    writer.writeMatrix("scene/fluid_vol", m_fluid_vol);
+    writer.writeMatrix("scene/volume_fraction", m_volume_fraction);
+    writer.writeMatrix("scene/rest_volume_fraction", m_rest_volume_fraction);
+    writer.writeMatrix("scene/orientation", m_orientation);
+    writer.writeMatrix("scene/particle_rest_length", m_particle_rest_length);
+    writer.writeMatrix("scene/particle_rest_area", m_particle_rest_area);
+    writer.writeMatrix("scene/inside", m_inside);
+    writer.writeMatrix("scene/B", m_B);
+    writer.writeMatrix("scene/fB", m_fB);
+
+    writer.writeVector("scene/fixed", m_fixed);
+    writer.writeVector("scene/particle_group", m_particle_group);
+    writer.writeVector("scene/particle_to_surfel", m_particle_to_surfel);
+
+    std::vector<unsigned char> twist(m_twist.begin(), m_twist.end());
+    writer.writeVector("scene/twist", twist);
+
+    std::vector<unsigned char> strand_tip(m_is_strand_tip.begin(), m_is_strand_tip.end());
+    writer.writeVector("scene/strand_tip", strand_tip);
+
+    std::vector<int> classifier(m_classifier.begin(), m_classifier.end());
+    writer.writeVector("scene/classifier", classifier);
+
+    // elements, including the plastic deformation
+    writer.writeMatrix("scene/x_gauss", m_x_gauss);
+    writer.writeMatrix("scene/v_gauss", m_v_gauss);
+    writer.writeMatrix("scene/dv_gauss", m_dv_gauss);
+    writer.writeMatrix("scene/fluid_v_gauss", m_fluid_v_gauss);
+    writer.writeMatrix("scene/m_gauss", m_m_gauss);
+    writer.writeMatrix("scene/vol_gauss", m_vol_gauss);
+    writer.writeMatrix("scene/rest_vol_gauss", m_rest_vol_gauss);
+    writer.writeMatrix("scene/radius_gauss", m_radius_gauss);
+    writer.writeMatrix("scene/fluid_m_gauss", m_fluid_m_gauss);
+    writer.writeMatrix("scene/fluid_vol_gauss", m_fluid_vol_gauss);
+    writer.writeMatrix("scene/volume_fraction_gauss", m_volume_fraction_gauss);
+    writer.writeMatrix("scene/rest_volume_fraction_gauss", m_rest_volume_fraction_gauss);
+    writer.writeMatrix("scene/Fe_gauss", m_Fe_gauss);
+    writer.writeMatrix("scene/d_gauss", m_d_gauss);
+    writer.writeMatrix("scene/d_old_gauss", m_d_old_gauss);
+    writer.writeMatrix("scene/D_gauss", m_D_gauss);
+    writer.writeMatrix("scene/D_inv_gauss", m_D_inv_gauss);
+    writer.writeMatrix("scene/dFe_gauss", m_dFe_gauss);
+    writer.writeMatrix("scene/norm_gauss", m_norm_gauss);
+
+    writer.writeVector("scene/surfel_norms", m_surfel_norms);
+
+    // kinematic objects and liquid sources
+    const int num_groups = (int) m_group_pos.size();
+    std::vector<scalar> groups;
+    groups.reserve(num_groups * 14);
+    for (int i = 0; i < num_groups; ++i)
+    {
+        groups.insert(groups.end(), m_group_pos[i].data(), m_group_pos[i].data() + 3);
+        groups.insert(groups.end(), m_group_rot[i].coeffs().data(), m_group_rot[i].coeffs().data() + 4);
+        groups.insert(groups.end(), m_group_prev_pos[i].data(), m_group_prev_pos[i].data() + 3);
+        groups.insert(groups.end(), m_group_prev_rot[i].coeffs().data(), m_group_prev_rot[i].coeffs().data() + 4);
+    }
+    writer.writeVector("scene/groups", groups);
+    writer.writeVector("scene/shooting_vol_accum", m_shooting_vol_accum);
+
+    std::vector<scalar> fields;
+    for (const std::shared_ptr<DistanceField>& dfptr : m_distance_fields)
+    {
+        const DistanceFieldObject* obj = dynamic_cast<const DistanceFieldObject*>(dfptr.get());
+        if (!obj) continue;
+
+        fields.insert(fields.end(), obj->center.data(), obj->center.data() + 3);
+        fields.insert(fields.end(), obj->rot.coeffs().data(), obj->rot.coeffs().data() + 4);
+        fields.insert(fields.end(), obj->future_center.data(), obj->future_center.data() + 3);
+        fields.insert(fields.end(), obj->future_rot.coeffs().data(), obj->future_rot.coeffs().data() + 4);
+        fields.insert(fields.end(), obj->omega.data(), obj->omega.data() + 3);
+        fields.insert(fields.end(), obj->V.data(), obj->V.data() + 3);
+    }
+    writer.writeVector("scene/distance_fields", fields);
+
+    // forces, concatenated with the offset of each
+    const int num_forces = (int) m_forces.size();
+    std::vector<int> force_offsets(num_forces + 1);
+    std::vector<scalar> force_state;
+    for (int i = 0; i < num_forces; ++i)
+    {
+        force_offsets[i] = (int) force_state.size();
+        m_forces[i]->saveState(force_state);
+    }
+    force_offsets[num_forces] = (int) force_state.size();
+
+    writer.writeVector("scene/force_offsets", force_offsets);
+    writer.writeVector("scene/force_state", force_state);
+}
+
+bool TwoDScene::readCheckpoint(checkpoint::Reader& reader)
+{
+    int num_parts = 0;
+    int num_elasto = 0;
+    int num_gausses = 0;
+    if (!reader.readValue("scene/num_particles", num_parts) ||
+            !reader.readValue("scene/num_elasto", num_elasto) ||
+            !reader.readValue("scene/num_gausses", num_gausses)) return false;
+
+    const int num_groups = (int) m_group_pos.size();
+    const int num_forces = (int) m_forces.size();
+
+    if (num_elasto != getNumElastoParticles() || num_gausses != getNumGausses() ||
+            reader.count("scene/groups") != (size_t) num_groups * 14 ||
+            reader.count("scene/force_offsets") != (size_t) num_forces + 1) {
+        std::cerr << "Checkpoint does not match the scene: " << num_elasto << " elastic particles, " << num_gausses << " elements, "
+                  << reader.count("scene/groups") / 14 << " groups, " << (int) reader.count("scene/force_offsets") - 1 << " forces, while the scene has "
+                  << getNumElastoParticles() << ", " << getNumGausses() << ", " << num_groups << " and " << num_forces << "." << std::endl;
+        return false;
+    }
+
+    // the saved state of every force must fit it before anything is restored
+    std::vector<int> force_offsets;
+    std::vector<scalar> force_state;
+    if (!reader.readVector("scene/force_offsets", force_offsets) ||
+            !reader.readVector("scene/force_state", force_state)) return false;
+
+    for (int i = 0; i < num_forces; ++i)
+    {
+        if (force_offsets[i] < 0 || force_offsets[i] > force_offsets[i + 1] || force_offsets[i + 1] > (int) force_state.size()) {
+            std::cerr << "Checkpoint does not match the scene: state of force " << i << " is out of range." << std::endl;
+            return false;
+        }
+
+        const scalar* state = force_state.data() + force_offsets[i];
+        const scalar* end = force_state.data() + force_offsets[i + 1];
+        if (!m_forces[i]->checkState(state, end) || state != end) {
+            std::cerr << "Checkpoint does not match the scene: state of force " << i << " has a different size." << std::endl;
+            return false;
+        }
+    }
+
+    // kinematic objects and liquid sources
+    int num_fields = 0;
+    for (const std::shared_ptr<DistanceField>& dfptr : m_distance_fields)
+    {
+        if (dynamic_cast<const DistanceFieldObject*>(dfptr.get())) ++num_fields;
+    }
+
+    std::vector<scalar> groups;
+    std::vector<scalar> fields;
+    std::vector<scalar> shooting_vol_accum;
+    if (!reader.readVector("scene/groups", groups, num_groups * 14) ||
+            !reader.readVector("scene/distance_fields", fields, num_fields * 20) ||
+            !reader.readVector("scene/shooting_vol_accum", shooting_vol_accum, m_shooting_vol_accum.size())) return false;
+
+    // the liquid particles may have been emitted, split, merged or removed
+    // since the start, so the particles are read to the saved count, and
+    // only swapped in once every section has been read at its size
+    if (num_parts < num_elasto) {
+        std::cerr << "Checkpoint does not match the scene: " << num_parts << " particles, fewer than the " << num_elasto << " elastic ones." << std::endl;
+        return false;
+    }
+
+    const size_t np = (size_t) num_parts;
+
+    VectorXs x, rest_x, v, saved_v, dv, fluid_v, m, fluid_m, radius, vol, rest_vol, shape_factor, fluid_vol,
+             volume_fraction, rest_volume_fraction, orientation, particle_rest_length, particle_rest_area;
+    VectorXuc inside;
+    MatrixXs B, fB;
+    std::vector<unsigned char> fixed;
+    std::vector<int> particle_group;
+    std::vector<int> particle_to_surfel;
+    std::vector<unsigned char> twist;
+    std::vector<unsigned char> strand_tip;
+    std::vector<int> classifier;
+
+    bool success =
+        reader.readMatrix("scene/x", x, np * 4, 1) &&
+        reader.readMatrix("scene/rest_x", rest_x, np * 4, 1) &&
+        reader.readMatrix("scene/v", v, np * 4, 1) &&
+        reader.readMatrix("scene/saved_v", saved_v, np * 4, 1) &&
+        reader.readMatrix("scene/dv", dv, np * 4, 1) &&
+        reader.readMatrix("scene/fluid_v", fluid_v, np * 4, 1) &&
+        reader.readMatrix("scene/m", m, np * 4, 1) &&
+        reader.readMatrix("scene/fluid_m", fluid_m, np * 4, 1) &&
+        reader.readMatrix("scene/radius", radius, np * 2, 1) &&
+        reader.readMatrix("scene/vol", vol, np, 1) &&
+        reader.readMatrix("scene/rest_vol", rest_vol, np, 1) &&
+        reader.readMatrix("scene/shape_factor", shape_factor, np, 1) &&
+        reader.readMatrix("scene/fluid_vol", fluid_vol, np, 1) &&
+        reader.readMatrix("scene/volume_fraction", volume_fraction, np, 1) &&
+        reader.readMatrix("scene/rest_volume_fraction", rest_volume_fraction, np, 1) &&
+        reader.readMatrix("scene/orientation", orientation, np * 3, 1) &&
+        reader.readMatrix("scene/particle_rest_length", particle_rest_length, np, 1) &&
+        reader.readMatrix("scene/particle_rest_area", particle_rest_area, np, 1) &&
+        reader.readMatrix("scene/inside", inside, np, 1) &&
+        reader.readMatrix("scene/B", B, np * 3, 3) &&
+        reader.readMatrix("scene/fB", fB, np * 3, 3) &&
+        reader.readVector("scene/fixed", fixed, np) &&
+        reader.readVector("scene/particle_group", particle_group, np) &&
+        reader.readVector("scene/particle_to_surfel", particle_to_surfel, np) &&
+        reader.readVector("scene/twist", twist, np) &&
+        reader.readVector("scene/strand_tip", strand_tip, np) &&
+        reader.readVector("scene/classifier", classifier, np);
+
+    if (!success) return false;
+
+    // elements, whose number does not change
+    VectorXs x_gauss, v_gauss, dv_gauss, fluid_v_gauss, m_gauss, vol_gauss, rest_vol_gauss, radius_gauss,
+             fluid_m_gauss, fluid_vol_gauss, volume_fraction_gauss, rest_volume_fraction_gauss;
+    MatrixXs Fe_gauss, d_gauss, d_old_gauss, D_gauss, D_inv_gauss, dFe_gauss, norm_gauss;
+    std::vector<Vector3s> surfel_norms;
+
+    success =
+        reader.readMatrix("scene/x_gauss", x_gauss, m_x_gauss.rows(), m_x_gauss.cols()) &&
+        reader.readMatrix("scene/v_gauss", v_gauss, m_v_gauss.rows(), m_v_gauss.cols()) &&
+        reader.readMatrix("scene/dv_gauss", dv_gauss, m_dv_gauss.rows(), m_dv_gauss.cols()) &&
+        reader.readMatrix("scene/fluid_v_gauss", fluid_v_gauss, m_fluid_v_gauss.rows(), m_fluid_v_gauss.cols()) &&
+        reader.readMatrix("scene/m_gauss", m_gauss, m_m_gauss.rows(), m_m_gauss.cols()) &&
+        reader.readMatrix("scene/vol_gauss", vol_gauss, m_vol_gauss.rows(), m_vol_gauss.cols()) &&
+        reader.readMatrix("scene/rest_vol_gauss", rest_vol_gauss, m_rest_vol_gauss.rows(), m_rest_vol_gauss.cols()) &&
+        reader.readMatrix("scene/radius_gauss", radius_gauss, m_radius_gauss.rows(), m_radius_gauss.cols()) &&
+        reader.readMatrix("scene/fluid_m_gauss", fluid_m_gauss, m_fluid_m_gauss.rows(), m_fluid_m_gauss.cols()) &&
+        reader.readMatrix("scene/fluid_vol_gauss", fluid_vol_gauss, m_fluid_vol_gauss.rows(), m_fluid_vol_gauss.cols()) &&
+        reader.readMatrix("scene/volume_fraction_gauss", volume_fraction_gauss, m_volume_fraction_gauss.rows(), m_volume_fraction_gauss.cols()) &&
+        reader.readMatrix("scene/rest_volume_fraction_gauss", rest_volume_fraction_gauss, m_rest_volume_fraction_gauss.rows(), m_rest_volume_fraction_gauss.cols()) &&
+        reader.readMatrix("scene/Fe_gauss", Fe_gauss, m_Fe_gauss.rows(), m_Fe_gauss.cols()) &&
+        reader.readMatrix("scene/d_gauss", d_gauss, m_d_gauss.rows(), m_d_gauss.cols()) &&
+        reader.readMatrix("scene/d_old_gauss", d_old_gauss, m_d_old_gauss.rows(), m_d_old_gauss.cols()) &&
+        reader.readMatrix("scene/D_gauss", D_gauss, m_D_gauss.rows(), m_D_gauss.cols()) &&
+        reader.readMatrix("scene/D_inv_gauss", D_inv_gauss, m_D_inv_gauss.rows(), m_D_inv_gauss.cols()) &&
+        reader.readMatrix("scene/dFe_gauss", dFe_gauss, m_dFe_gauss.rows(), m_dFe_gauss.cols()) &&
+        reader.readMatrix("scene/norm_gauss", norm_gauss, m_norm_gauss.rows(), m_norm_gauss.cols()) &&
+        reader.readVector("scene/surfel_norms", surfel_norms, m_surfel_norms.size());
+
+    if (!success) return false;
+
+    // everything fits, nothing below can fail
+    conservativeResizeParticles(num_parts);
+
+    m_fluids.resize(num_parts - num_elasto);
+    for (int i = num_elasto; i < num_parts; ++i)
+    {
+        m_fluids[i - num_elasto] = i;
+        m_particle_to_edge[i].resize(0);
+        m_particle_to_face[i].resize(0);
+        m_div[i].resize(0);
+    }
+
+    m_x.swap(x);
+    m_rest_x.swap(rest_x);
+    m_v.swap(v);
+    m_saved_v.swap(saved_v);
+    m_dv.swap(dv);
+    m_fluid_v.swap(fluid_v);
+    m_m.swap(m);
+    m_fluid_m.swap(fluid_m);
+    m_radius.swap(radius);
+    m_vol.swap(vol);
+    m_rest_vol.swap(rest_vol);
+    m_shape_factor.swap(shape_factor);
+    m_fluid_vol.swap(fluid_vol);
+    m_volume_fraction.swap(volume_fraction);
+    m_rest_volume_fraction.swap(rest_volume_fraction);
+    m_orientation.swap(orientation);
+    m_particle_rest_length.swap(particle_rest_length);
+    m_particle_rest_area.swap(particle_rest_area);
+    m_inside.swap(inside);
+    m_B.swap(B);
+    m_fB.swap(fB);
+    m_fixed.swap(fixed);
+    m_particle_group.swap(particle_group);
+    m_particle_to_surfel.swap(particle_to_surfel);
+
+    m_twist.assign(twist.begin(), twist.end());
+    m_is_strand_tip.assign(strand_tip.begin(), strand_tip.end());
+    for (int i = 0; i < num_parts; ++i) m_classifier[i] = (ParticleClassifier) classifier[i];
+
+    m_x_gauss.swap(x_gauss);
+    m_v_gauss.swap(v_gauss);
+    m_dv_gauss.swap(dv_gauss);
+    m_fluid_v_gauss.swap(fluid_v_gauss);
+    m_m_gauss.swap(m_gauss);
+    m_vol_gauss.swap(vol_gauss);
+    m_rest_vol_gauss.swap(rest_vol_gauss);
+    m_radius_gauss.swap(radius_gauss);
+    m_fluid_m_gauss.swap(fluid_m_gauss);
+    m_fluid_vol_gauss.swap(fluid_vol_gauss);
+    m_volume_fraction_gauss.swap(volume_fraction_gauss);
+    m_rest_volume_fraction_gauss.swap(rest_volume_fraction_gauss);
+    m_Fe_gauss.swap(Fe_gauss);
+    m_d_gauss.swap(d_gauss);
+    m_d_old_gauss.swap(d_old_gauss);
+    m_D_gauss.swap(D_gauss);
+    m_D_inv_gauss.swap(D_inv_gauss);
+    m_dFe_gauss.swap(dFe_gauss);
+    m_norm_gauss.swap(norm_gauss);
+    m_surfel_norms.swap(surfel_norms);
+    m_shooting_vol_accum.swap(shooting_vol_accum);
+
+    for (int i = 0; i < num_groups; ++i)
+    {
+        const scalar* g = &groups[i * 14];
+        m_group_pos[i] = Vector3s(g[0], g[1], g[2]);
+        m_group_rot[i].coeffs() = Vector4s(g[3], g[4], g[5], g[6]);
+        m_group_prev_pos[i] = Vector3s(g[7], g[8], g[9]);
+        m_group_prev_rot[i].coeffs() = Vector4s(g[10], g[11], g[12], g[13]);
+    }
+
+    size_t field_offset = 0;
+    for (const std::shared_ptr<DistanceField>& dfptr : m_distance_fields)
+    {
+        DistanceFieldObject* obj = dynamic_cast<DistanceFieldObject*>(dfptr.get());
+        if (!obj) continue;
+
+        const scalar* f = &fields[field_offset];
+        obj->center = Vector3s(f[0], f[1], f[2]);
+        obj->rot.coeffs() = Vector4s(f[3], f[4], f[5], f[6]);
+        obj->future_center = Vector3s(f[7], f[8], f[9]);
+        obj->future_rot.coeffs() = Vector4s(f[10], f[11], f[12], f[13]);
+        obj->omega = Vector3s(f[14], f[15], f[16]);
+        obj->V = Vector3s(f[17], f[18], f[19]);
+        field_offset += 20;
+    }
+
+    for (int i = 0; i < num_forces; ++i)
+    {
+        const scalar* state = force_state.data() + force_offsets[i];
+        m_forces[i]->loadState(state);
+    }
+
+    // rebuild the grid around the restored particles
+    updateParticleBoundingBox();
+    rebucketizeParticles();
+    resampleNodes();
+
+    return true;
+}
+
 void TwoDScene::stepScript(const scalar& dt, const scalar& current_time)
 {
     threadutils::for_each(0, (int) m_scripts.size(), [&] (int i) {
@@ -7831,20 +8697,78 @@ void TwoDScene::stepScript(const scalar& dt, const scalar& current_time)
 }
 
 /*!
- * update rigid body level set
+ * update rigid body level set, sampled once per substep at the nodes, the
+ * faces and the cell centers
  */
 void TwoDScene::updateSolidPhi()
 {
-    auto solid_sel = [] (const std::shared_ptr<DistanceField>& dfptr) -> bool {
-        return dfptr->usage == DFU_SOLID;
-    };
+    profiler::ScopedTimer timer("updateSolidPhi");
+
+    // flatten the unions of the solid groups once per substep, in the order
+    // computePhiVel visits them so that ties resolve the same way
+    std::vector< const DistanceField* > solids;
+    for (auto dfptr : m_group_distance_field)
+    {
+        if (dfptr->usage == DFU_SOLID) dfptr->collect_union_leaves(solids);
+    }
+
+    const int num_solids = (int) solids.size();
+    std::vector< Vector3s > solid_low(num_solids), solid_high(num_solids);
+    std::vector< unsigned char > solid_bounded(num_solids);
+    for (int s = 0; s < num_solids; ++s)
+    {
+        solids[s]->local_bounding_box(solid_low[s], solid_high[s]);
+        solid_bounded[s] = solids[s]->bounds_phi();
+    }
+
+    const scalar dx = getCellSize();
+    const scalar far_phi = 3.0 * m_bucket_size;
 
     m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
         if (!m_bucket_activated[bucket_idx]) return;
 
         const int num_nodes = getNumNodes(bucket_idx);
+        const VectorXs& node_pos = m_node_pos[bucket_idx];
+
+        // the samples of the bucket lie between its nodes and the cell centers
+        Vector3s low = Vector3s::Constant(1e+20);
+        Vector3s high = Vector3s::Constant(-1e+20);
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            low = low.cwiseMin(node_pos.segment<3>(i * 3));
+            high = high.cwiseMax(node_pos.segment<3>(i * 3));
+        }
+        high += Vector3s::Constant(0.5 * dx);
+
+        // a bounded field this far from the bucket never gets closer than far_phi
+        std::vector< const DistanceField* > near_solids;
+        near_solids.reserve(num_solids);
+        for (int s = 0; s < num_solids; ++s)
+        {
+            if (solid_bounded[s]) {
+                const Vector3s gap = (solid_low[s] - high).cwiseMax(low - solid_high[s]).cwiseMax(Vector3s::Zero());
+                if (gap.squaredNorm() >= far_phi * far_phi) continue;
+            }
+            near_solids.push_back(solids[s]);
+        }
+
+        auto compute_phi_vel = [&] (const Vector3s& pos, Vector3s& vel) -> scalar {
+            scalar min_phi = far_phi;
+            vel.setZero();
+            for (const DistanceField* dfptr : near_solids)
+            {
+                Vector3s v;
+                const scalar phi = dfptr->compute_phi_vel(pos, v);
+                if (phi < min_phi) {
+                    min_phi = phi;
+                    vel = v;
+                }
+            }
+            return min_phi;
+        };
 
         VectorXs& node_phi = m_node_solid_phi[bucket_idx];
+        VectorXs& node_cell_solid_phi = m_node_cell_solid_phi[bucket_idx];
 
         VectorXs& node_solid_vel_x = m_node_solid_vel_x[bucket_idx];
         VectorXs& node_solid_vel_y = m_node_solid_vel_y[bucket_idx];
@@ -7852,35 +8776,26 @@ void TwoDScene::updateSolidPhi()
 
         for (int i = 0; i < num_nodes; ++i)
         {
+            const Vector3s np = node_pos.segment<3>(i * 3);
+
             Vector3s vel;
-            node_phi(i) = computePhiVel(getNodePosSolidPhi(bucket_idx, i), vel, solid_sel);
+            node_phi(i) = compute_phi_vel(np, vel);
 
-            computePhiVel(getNodePosX(bucket_idx, i), vel, solid_sel);
+            compute_phi_vel(np + Vector3s(0.0, 0.5, 0.5) * dx, vel);
             node_solid_vel_x(i) = vel(0);
 
-            computePhiVel(getNodePosY(bucket_idx, i), vel, solid_sel);
+            compute_phi_vel(np + Vector3s(0.5, 0.0, 0.5) * dx, vel);
             node_solid_vel_y(i) = vel(1);
 
-            computePhiVel(getNodePosZ(bucket_idx, i), vel, solid_sel);
+            compute_phi_vel(np + Vector3s(0.5, 0.5, 0.0) * dx, vel);
             node_solid_vel_z(i) = vel(2);
+
+            node_cell_solid_phi(i) = compute_phi_vel(np + Vector3s(0.5, 0.5, 0.5) * dx, vel);
         }
     });
 
     if (m_liquid_info.compute_viscosity)
     {
-        m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
-            if (!m_bucket_activated[bucket_idx]) return;
-
-            VectorXs& node_cell_solid_phi = m_node_cell_solid_phi[bucket_idx];
-
-            const int num_node_p = getNumNodes(bucket_idx);
-
-            for (int i = 0; i < num_node_p; ++i)
-            {
-                node_cell_solid_phi(i) = computePhi(getNodePosP(bucket_idx, i), solid_sel);
-            }
-        });
-
         m_particle_buckets.for_each_bucket([&] (int bucket_idx) {
             if (!m_bucket_activated[bucket_idx]) return;
 
@@ -17,12 +17,23 @@
 #include "Force.h"
 #include "DER/StrandParameters.h"
 #include "sorter.h"
+#include "ElementBVH.h"
+#include "NodeArrayPool.h"
 #include "Script.h"
 #include "DistanceFields.h"
+#include "ParticleSoA.h"
+#include "ParticleWeights.h"
 
 class StrandForce;
+class StrandBatch;
 class AttachForce;
 
+namespace checkpoint
+{
+class Writer;
+class Reader;
+}
+
 #ifdef PC_NONE
 #undef PC_NONE
 #endif
@@ -99,6 +110,17 @@ struct LiquidInfo
 	bool use_group_precondition;
 	bool use_lagrangian_mpm;
 	bool use_cosolve_angular;
+	bool use_scatter_p2g;
+	bool use_geometric_mg;
+	bool use_warm_start;
+	bool use_mixed_precision_pressure;
+	bool use_mixed_precision_elasto;
+	bool use_pipelined_pcg;
+	bool use_parallel_viscosity_precondition;
+	bool use_strand_batch;
+	int particle_reorder_interval;
+	int elasto_subcycles;
+	scalar elasto_subcycle_tolerance;
 
 	friend std::ostream& operator<<(std::ostream&, const LiquidInfo&);
 };
@@ -475,11 +497,11 @@ public:
 
 	Matrix27x2i& getGaussNodesZ( int pidx );
 
-	const std::vector< Matrix27x4s >& getParticleWeights() const;
+	const std::vector< ParticleWeights >& getParticleWeights() const;
 
-	const Matrix27x4s& getParticleWeights( int pidx ) const;
+	const ParticleWeights& getParticleWeights( int pidx ) const;
 
-	Matrix27x4s& getParticleWeights( int pidx );
+	ParticleWeights& getParticleWeights( int pidx );
 
 	const Matrix27x3s& getGaussWeights(int pidx) const;
 
@@ -674,6 +696,8 @@ public:
 
 	void precompute();
 
+	void updateStrandBatch();
+
 	void postcompute(VectorXs& v, const scalar& dt);
 
 	void stepScript(const scalar& dt, const scalar& current_time);
@@ -718,12 +742,14 @@ public:
 
 	void updateParticleBoundingBox();
 	void rebucketizeParticles();
+	void reorderLiquidParticles();
 	void resampleNodes();
 	void updateParticleWeights(scalar dt, int start, int end);
 	void updateGaussWeights(scalar dt);
 	void computeWeights(scalar dt);
 	void updateSolidWeights();
 	void updateLiquidPhi(scalar dt);
+	void carryLiquidPhi();
 	void extendLiquidPhi();
 	void renormalizeLiquidPhi();
 	void updateCurvatureP();
@@ -803,6 +829,12 @@ public:
 
 	void dump_geometry(std::string filename);
 
+	// Checkpoint of the state evolved by the simulation. The scene must have
+	// been loaded from the scene file the checkpoint was written from.
+	void writeCheckpoint(checkpoint::Writer& writer) const;
+
+	bool readCheckpoint(checkpoint::Reader& reader);
+
 	int getKernelOrder() const;
 
 	void updateSolidPhi();
@@ -815,6 +847,8 @@ public:
 
 	void removeEmptyParticles();
 
+	int collectEmptyParticles();
+
 	void preAllocateNodes();
 
 	template<typename Callable>
@@ -856,6 +890,10 @@ public:
 
 	const std::vector< VectorXs >& getNodeSurfTensionP() const;
 
+	void updateElementBVH();
+
+	const ElementBVH& getElementBVH() const;
+
 	void updateIntersection();
 
 	const std::vector< std::vector<RayTriInfo> >& getIntersections() const;
@@ -907,6 +945,13 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 private:
+	void resetLiquidPhi();
+	void finishLiquidPhi();
+
+	void gatherTransferParticles();
+
+	void scatterParticleNodesAPIC();
+
 	int step_count;
 	VectorXs m_x; //particle pos
 	VectorXs m_rest_x; //particle rest pos
@@ -937,6 +982,14 @@ private:
 	MatrixXs m_B; // particle B matrix
 	MatrixXs m_fB;
 
+	// particle states gathered in SoA form for the transfer kernels
+	ParticleSoA<3> m_transfer_x;
+	ParticleSoA<3> m_transfer_v; // velocity, or fluid velocity for liquid particles
+	ParticleSoA<3> m_transfer_m; // total mass, or fluid mass for liquid particles
+	ParticleSoA<9> m_transfer_B; // B (or fB) in row-major order
+	ParticleSoA<4> m_transfer_vol; // solid volume, fluid volume, shape factor and its weight
+	ParticleSoA<3> m_transfer_orientation;
+
 	VectorXs m_x_gauss;
 	VectorXs m_v_gauss;
 	VectorXs m_dv_gauss;
@@ -995,8 +1048,7 @@ private:
 	std::vector< Matrix27x2i > m_gauss_nodes_z;
 	std::vector< Matrix27x2i > m_gauss_nodes_p;
 
-	std::vector< Vector27s > m_particle_weights_p;
-	std::vector< Matrix27x4s > m_particle_weights;
+	std::vector< ParticleWeights > m_particle_weights;
 
 	std::vector< Matrix27x3s > m_gauss_weights;
 
@@ -1022,8 +1074,12 @@ private:
 	Sorter m_gauss_buckets;
 	Sorter m_particle_cells;
 
+	ElementBVH m_element_bvh;
+
 	std::vector< unsigned char > m_bucket_activated;
 
+	NodeArrayPool m_node_array_pool;
+
 	std::vector< VectorXs > m_node_pos;
 
 	std::vector< VectorXs > m_node_shape_factor_x;
@@ -1047,6 +1103,9 @@ private:
 
 	std::vector< VectorXs > m_node_solid_phi;
 	std::vector< VectorXs > m_node_liquid_phi;
+	std::vector< VectorXs > m_node_particle_liquid_phi; // as splatted by updateLiquidPhi, on the grid below
+	Vector3i m_particle_liquid_phi_origin;
+	Vector3i m_particle_liquid_phi_num_buckets;
 	std::vector< VectorXs > m_node_combined_phi;
 	std::vector< VectorXs > m_node_surf_tension;
 	std::vector< VectorXs > m_node_curvature_p;
@@ -1145,6 +1204,10 @@ private:
 	// Forces. Note that the scene inherits responsibility for deleting forces.
 	std::vector< std::shared_ptr<Force> > m_forces;
 
+	// strand forces evaluated together, rebuilt when the forces change
+	std::shared_ptr<StrandBatch> m_strand_batch;
+	int m_strand_batch_num_forces;
+
 	std::vector< std::shared_ptr<AttachForce> > m_attach_forces;
 
 	std::vector< std::shared_ptr<StrandParameters> > m_strandParameters;
@@ -113,6 +113,7 @@ void applyNodeViscosityImplicit( const TwoDScene& scene,
                                  int offset_nodes_y,
                                  int offset_nodes_z,
                                  const SparseMatrix< scalar >& matrix,
+                                 PCGSolver< scalar >& solver,
                                  const std::vector< scalar >& rhs,
                                  std::vector< scalar >& soln,
                                  std::vector< VectorXs >& node_vel_x,
@@ -121,15 +122,27 @@ void applyNodeViscosityImplicit( const TwoDScene& scene,
                                  scalar& residual,
                                  int& iter_out,
                                  const scalar& criterion,
-                                 int maxiters)
+                                 int maxiters,
+                                 bool use_initial_guess)
 {
-	soln.assign(rhs.size(), 0.0);
+	if (!use_initial_guess || soln.size() != rhs.size()) {
+		use_initial_guess = false;
+		soln.assign(rhs.size(), 0.0);
+	}
 
-	PCGSolver<double> solver;
 	solver.set_solver_parameters(criterion, maxiters, 0.97, 0.1);
+
+	if (scene.getLiquidInfo().use_parallel_viscosity_precondition) {
+		// block Jacobi MIC(0) over contiguous ranges of the unknowns, which are
+		// numbered bucket by bucket; keep the blocks large enough to precondition well
+		const int num_blocks = std::max(1, std::min((int) threadutils::get_num_threads() * 2, (int) rhs.size() / 1024));
+		solver.set_preconditioner(num_blocks, true);
+	} else {
+		solver.set_preconditioner(1, false);
+	}
 	bool success = false;
 
-	success = solver.solve(matrix, rhs, soln, residual, iter_out);
+	success = solver.solve(matrix, rhs, soln, residual, iter_out, use_initial_guess);
 	if (!success) {
 		std::cerr << "\n\n\n**********VISCOSITY FAILED**************\n\n\n" << std::endl;
 		exit(0);
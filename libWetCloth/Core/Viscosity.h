@@ -18,6 +18,11 @@
 
 class TwoDScene;
 
+namespace robertbridson {
+template<class T>
+struct PCGSolver;
+}
+
 using namespace robertbridson;
 
 namespace viscosity {
@@ -63,6 +68,7 @@ void applyNodeViscosityImplicit( const TwoDScene& scene,
                                  int offset_nodes_y,
                                  int offset_nodes_z,
                                  const SparseMatrix< scalar >& matrix,
+                                 PCGSolver< scalar >& solver,
                                  const std::vector< scalar >& rhs,
                                  std::vector< scalar >& soln,
                                  std::vector< VectorXs >& node_vel_x,
@@ -71,7 +77,8 @@ void applyNodeViscosityImplicit( const TwoDScene& scene,
                                  scalar& residual,
                                  int& iter_out,
                                  const scalar& criterion,
-                                 int maxiters);
+                                 int maxiters,
+                                 bool use_initial_guess = false);
 
 void applyNodeViscosityExplicit( const TwoDScene& scene,
                                  const std::vector< VectorXs >& node_vel_src_x,
@@ -7,17 +7,21 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "WetClothCore.h"
-#include "TimingUtilities.h"
+#include "Profiler.h"
 #include "MemUtilities.h"
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <map>
+#include <sstream>
 
 WetClothCore::WetClothCore( const std::shared_ptr<TwoDScene>& scene, const std::shared_ptr<SceneStepper>& scene_stepper )
     : m_scene(scene)
     , m_scene_stepper(scene_stepper)
+    , m_timestep_controller(std::make_shared<CFLTimestepController>())
     , m_current_step(0)
+    , m_elasto_subcycles(1)
 {
-    timing_buffer.resize(15);
-    timing_buffer.assign(15, 0.0);
-
     memset(&m_info, 0, sizeof(Info));
 }
 
@@ -39,171 +43,336 @@ int WetClothCore::getCurrentTime() const
     return m_current_step;
 }
 
-const std::shared_ptr<TwoDScene>& WetClothCore::getScene() const
+void WetClothCore::setTimestepController( const std::shared_ptr<TimestepController>& controller )
 {
-    return m_scene;
+    m_timestep_controller = controller;
+}
+
+const std::shared_ptr<TimestepController>& WetClothCore::getTimestepController() const
+{
+    return m_timestep_controller;
+}
+
+void WetClothCore::writeState( checkpoint::Writer& writer ) const
+{
+    writer.writeValue("core/current_step", m_current_step);
+    writer.writeValue("core/info", m_info);
+    writer.writeValue("core/elasto_subcycles", m_elasto_subcycles);
+
+    std::ostringstream random_state;
+    random_state << mathutils::randomEngine();
+    const std::string random_str = random_state.str();
+    writer.write("core/random_engine", random_str.data(), 1, random_str.size());
+
+    m_scene->writeCheckpoint(writer);
+    m_scene_stepper->writeCheckpoint(writer);
 }
 
-const std::vector<scalar>& WetClothCore::getTimingStatistics() const
+bool WetClothCore::readState( checkpoint::Reader& reader )
 {
-    return timing_buffer;
+    int current_step = 0;
+    Info info;
+    std::vector<char> random_str;
+    if (!reader.readValue("core/current_step", current_step) ||
+            !reader.readValue("core/info", info) ||
+            !reader.readVector("core/random_engine", random_str)) return false;
+
+    // absent from checkpoints written before the multi-rate stepping
+    int elasto_subcycles = 1;
+    if (reader.has("core/elasto_subcycles") && !reader.readValue("core/elasto_subcycles", elasto_subcycles)) return false;
+
+    if (!m_scene->readCheckpoint(reader) || !m_scene_stepper->readCheckpoint(reader)) return false;
+
+    std::istringstream random_state(std::string(random_str.begin(), random_str.end()));
+    random_state >> mathutils::randomEngine();
+
+    m_current_step = current_step;
+    m_elasto_subcycles = elasto_subcycles;
+    m_info = info;
+    return true;
+}
+
+bool WetClothCore::saveCheckpoint( const std::string& filename ) const
+{
+    profiler::ScopedTimer timer("saveCheckpoint");
+
+    const std::string tmp_filename = filename + ".tmp";
+
+    checkpoint::Writer writer;
+    if (!writer.open(tmp_filename)) return false;
+
+    writeState(writer);
+    m_timestep_controller->writeCheckpoint(writer);
+
+    if (!writer.close()) {
+        std::cerr << "Failed to write checkpoint " << tmp_filename << "." << std::endl;
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+
+    // rename replaces the previous checkpoint atomically on POSIX
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool WetClothCore::loadCheckpoint( const std::string& filename )
+{
+    checkpoint::Reader reader;
+    if (!reader.open(filename)) return false;
+
+    if (!readState(reader) || !m_timestep_controller->readCheckpoint(reader)) {
+        std::cerr << "Failed to restore checkpoint " << filename << "." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+const std::shared_ptr<TwoDScene>& WetClothCore::getScene() const
+{
+    return m_scene;
 }
 
 /*
  * This is the main function where time stepping happens
  */
-void WetClothCore::stepSystem(const scalar &dt) {
+bool WetClothCore::stepSystem(const scalar &dt) {
     assert( m_scene != NULL );
     assert( m_scene_stepper != NULL );
 
+    profiler::Profiler& prof = profiler::Profiler::instance();
+    prof.beginFrame("stepSystem");
+
     VectorXs oldpos = m_scene->getX();
     VectorXs oldvel = m_scene->getV();
 
     const scalar max_elasto_vel = m_scene->getMaxVelocity();
     const scalar max_fluid_vel = m_scene->getMaxFluidVelocity();
-    const scalar dx = m_scene->getCellSize();
-    const scalar max_elasto_dt = std::min(dx / std::max(1e-63, max_elasto_vel) / 3.0, 1.0 / 30.0); // 1/6 CFLs
-    const scalar max_fluid_dt = std::min(dx / std::max(1e-63, max_fluid_vel) * 3.0, 1.0 / 30.0); // 3 CFLs
-    const scalar max_dt = std::min(max_elasto_dt, max_fluid_dt);
-
-    const int num_substeps = std::max(1, (int) ceil(dt / max_dt));
-    const scalar sub_dt = dt / (scalar) num_substeps;
 
     m_info.m_historical_max_vel = std::max(m_info.m_historical_max_vel, max_elasto_vel);
     m_info.m_historical_max_vel_fluid = std::max(m_info.m_historical_max_vel_fluid, max_fluid_vel);
 
+    TimestepController& controller = *m_timestep_controller;
+    controller.beginFrame(*m_scene, dt);
+
     std::cout << "[step system max vel: (" << max_elasto_vel << " <" << m_info.m_historical_max_vel << ">, " << max_fluid_vel
-              << " <" << m_info.m_historical_max_vel_fluid << ">) max dt: " << max_dt << " (" << max_elasto_dt << ", " << max_fluid_dt
-              << "), # sub-step: (" << num_substeps << "), sub-dt: " << sub_dt << "]" << std::endl;
+              << " <" << m_info.m_historical_max_vel_fluid << ">) ";
+    controller.print(std::cout);
+    std::cout << "]" << std::endl;
+
+    const bool needs_report = controller.needsReport();
+    const bool needs_rollback = controller.needsRollback();
+    const bool check_divergence = m_scene->getLiquidInfo().check_divergence || needs_report;
+
+    std::map< std::string, profiler::SolverStats > solver_stats;
+    MatrixXs old_Fe;
+
+    // Sub-steps of the same length are timed from the start of their run, so
+    // that a frame of equal sub-steps sees the same times as k * sub_dt
+    scalar run_start = 0.0;
+    scalar run_dt = 0.0;
+    int run_length = 0;
+
+    int num_substeps = 0;
+    int num_rejected = 0;
+
+    // Multi-rate: the elastic objects may be sub-cycled within one step of
+    // the liquid, which is projected and resampled at its own rate only
+    const int max_subcycles = std::max(1, m_scene->getLiquidInfo().elasto_subcycles);
+    const scalar max_fluid_dt = controller.getMaxFluidDt();
+    int subcycles_left = 0;
+    scalar fluid_dt = 0.0;
+    int num_projections = 0;
 
     // Start the possible sub-steps
-    for (int k = 0; k < num_substeps; ++k) {
-        scalar cur_time = (scalar) m_current_step * dt + k * sub_dt;
-        std::cout << "[(" << cur_time << " s) start substep: " << k << "/" << num_substeps << "]" << std::endl;
+    while (true) {
+        const scalar remaining = dt - (run_start + run_length * run_dt);
+        const scalar sub_dt = controller.nextSubstep(*m_scene, remaining);
+        const bool last_substep = sub_dt >= remaining * (1.0 - 1e-6);
+
+        if (sub_dt != run_dt) {
+            run_start += run_length * run_dt;
+            run_dt = sub_dt;
+            run_length = 0;
+        }
 
-        scalar t0 = timingutils::seconds();
-        scalar t1;
+        scalar cur_time = (scalar) m_current_step * dt + run_start + run_length * sub_dt;
 
-        // Update Viscous Parameter for Elastic Rods
-        m_scene->updateStrandParamViscosity(sub_dt);
+        // The first sub-cycle of a liquid step does the coupling of both
+        // phases for the whole step
+        const bool fluid_substep = subcycles_left == 0;
+        if (fluid_substep) {
+            int subcycles = std::min(std::min(m_elasto_subcycles, max_subcycles), (int) floor(max_fluid_dt / sub_dt));
+            subcycles = std::max(1, std::min(subcycles, (int) floor(remaining / sub_dt + 1e-6)));
+            fluid_dt = (scalar) subcycles * sub_dt;
+            subcycles_left = subcycles;
+        }
 
-        // Setup Scripting for Kinematic Objects
-        m_scene->stepScript(sub_dt, cur_time);
-        m_scene->applyScript(sub_dt);
+        if (needs_rollback) {
+            checkpoint::Writer writer;
+            writer.openBuffer();
+            writeState(writer);
+            writer.close();
+            m_rollback_state = writer.takeBuffer();
+        }
 
-        // Emit Liquid Particles for Liquid Sources
-        m_scene->sampleLiquidDistanceFields(cur_time + sub_dt);
+        SubstepReport report;
+        memset(&report, 0, sizeof(SubstepReport));
 
-        // Remove Liquid Particles outside Simulation Domain (to save time)
-        std::cout << "[terminate particles]" << std::endl;
-        m_scene->terminateParticles();
+        if (needs_report) {
+            solver_stats = prof.getSolvers();
+            old_Fe = m_scene->getGaussFe();
+        }
 
-        // Calculate the Optimal Volume of Liquid Particles
-        std::cout << "[update optimal volume]" << std::endl;
-        m_scene->updateOptiVolume();
+        prof.beginSubstep();
 
-        // Split the Liquid Particles if They are too Large
-        std::cout << "[split particles]" << std::endl;
-        m_scene->splitLiquidParticles();
+        {
+            profiler::ScopedTimer timer("sampleMergeSplitParticles");
 
-        // Merge the Liquid Particles if They are too Small
-        std::cout << "[merge particles]" << std::endl;
-        m_scene->mergeLiquidParticles();
-        t1 = timingutils::seconds();
-        timing_buffer[0] += t1 - t0; // Merge & Split Particles
-        t0 = t1;
+            // Update Viscous Parameter for Elastic Rods
+            m_scene->updateStrandParamViscosity(sub_dt);
 
-        // Create Grid around Particles
-        m_scene->updateParticleBoundingBox();
-        m_scene->rebucketizeParticles();
-        m_scene->resampleNodes();
-        t1 = timingutils::seconds();
-        timing_buffer[1] += t1 - t0; // build Grid
-        t0 = t1;
+            // Setup Scripting for Kinematic Objects
+            m_scene->stepScript(sub_dt, cur_time);
+            m_scene->applyScript(sub_dt);
 
-        // Update Particle-Node Weight
-        m_scene->computeWeights(sub_dt);
+            if (fluid_substep) {
+                // Emit Liquid Particles for Liquid Sources, for the first sub-step
+                // only, which is all of the group that is certain to be taken
+                m_scene->sampleLiquidDistanceFields(cur_time + sub_dt);
 
-        // Update Solid Stress
-        m_scene->computedEdFe();
+                // Remove Liquid Particles outside Simulation Domain (to save time)
+                m_scene->terminateParticles();
 
-        m_scene->updateManifoldOperators();
+                // Calculate the Optimal Volume of Liquid Particles
+                m_scene->updateOptiVolume();
 
-        // Update the Orientation Field
-        m_scene->updateOrientation();
+                // Split the Liquid Particles if They are too Large
+                m_scene->splitLiquidParticles();
 
-        // Update the Liquid Distance Field
-        m_scene->updateLiquidPhi(sub_dt);
+                // Merge the Liquid Particles if They are too Small
+                m_scene->mergeLiquidParticles();
+            }
+        }
+
+        {
+            profiler::ScopedTimer timer("buildGrid");
+
+            // Create Grid around Particles
+            m_scene->updateParticleBoundingBox();
+            m_scene->rebucketizeParticles();
 
-        // Compute Cohesion Force
-        m_scene->updateIntersection();
+            // Restore the Memory Locality of Liquid Particles
+            const int reorder_interval = m_scene->getLiquidInfo().particle_reorder_interval;
+            if (reorder_interval > 0 && num_substeps == 0 && m_current_step % reorder_interval == 0) {
+                m_scene->reorderLiquidParticles();
+            }
+
+            m_scene->resampleNodes();
+        }
 
-        // Advect Surface Tension Force
-        m_scene_stepper->advectSurfTension( *m_scene, dt );
+        {
+            profiler::ScopedTimer timer("computeWeightsAndFields");
 
-        // Here's the precomputation of some forces lay
-        m_scene->updateStartState();
+            // Update Particle-Node Weight
+            m_scene->computeWeights(sub_dt);
 
-        // Update the Distance Function for Kinematic Objects
-        m_scene->updateSolidPhi();
+            // Update Solid Stress
+            m_scene->computedEdFe();
 
-        // Update the Weight on Grid (see [Batty et al. 2007] for details) for Kinematic Objects
-        m_scene->updateSolidWeights();
+            m_scene->updateManifoldOperators();
 
-        // Save Current Velocity
-        m_scene->saveParticleVelocity();
+            // Update the Orientation Field
+            m_scene->updateOrientation();
 
-        t1 = timingutils::seconds();
-        timing_buffer[2] += t1 - t0; // Compute Weight, Solid Stress, and Distance Field (all above)
-        t0 = t1;
+            // Refit the Bounding Volumes of the Soft Elements
+            m_scene->updateElementBVH();
 
-        // Map the Liquid Particles and Elastic Vertices onto Grid
-        m_scene->mapParticleNodesAPIC();
+            // Update the Distance Function for Kinematic Objects
+            m_scene->updateSolidPhi();
 
-        // Save the Grid Velocity
-        m_scene->saveFluidVelocity();
+            // Update the Liquid Distance Field, or Carry the One of the Liquid Step
+            // onto the Resampled Grid, as the Pressure is
+            if (fluid_substep) {
+                m_scene->updateLiquidPhi(sub_dt);
+            } else {
+                m_scene->carryLiquidPhi();
+            }
 
-        // Update Saturation and Solid Volume Fraction on Grid
-        m_scene->mapParticleSaturationPsiNodes();
+            // Compute Cohesion Force
+            m_scene->updateIntersection();
 
-        // Compute the Pore Pressure on Grid
-        m_scene->updatePorePressureNodes();
+            // Advect Surface Tension Force
+            m_scene_stepper->advectSurfTension( *m_scene, dt );
 
-        t1 = timingutils::seconds();
-        timing_buffer[3] += t1 - t0; // APIC Mapping & Computing the Fields (all above)
-        t0 = t1;
+            // Here's the precomputation of some forces lay
+            m_scene->updateStartState();
+
+            // Update the Weight on Grid (see [Batty et al. 2007] for details) for Kinematic Objects
+            m_scene->updateSolidWeights();
+
+            // Save Current Velocity
+            m_scene->saveParticleVelocity();
+        }
+
+        {
+            profiler::ScopedTimer timer("particleToGrid");
+
+            // Map the Liquid Particles and Elastic Vertices onto Grid
+            m_scene->mapParticleNodesAPIC();
+
+            // Save the Grid Velocity
+            m_scene->saveFluidVelocity();
+
+            // Update Saturation and Solid Volume Fraction on Grid
+            m_scene->mapParticleSaturationPsiNodes();
+
+            // Compute the Pore Pressure on Grid
+            m_scene->updatePorePressureNodes();
+        }
 
         // Explicitly Integrate the Elastic and Liquid Velocity
         m_scene_stepper->stepVelocity( *m_scene, sub_dt );
-        t1 = timingutils::seconds();
-        timing_buffer[4] += t1 - t0; // Velocity Prediction
-        t0 = t1;
 
-        // Check Divergence if Necessary
-        if (m_scene->getLiquidInfo().check_divergence) {
-            m_info.m_initial_div_accu += m_scene_stepper->computeDivergence(*m_scene) / (scalar) num_substeps;
+        if (fluid_substep) {
+            // Check Divergence if Necessary
+            if (check_divergence) {
+                report.initial_divergence = m_scene_stepper->computeDivergence(*m_scene);
+            }
+
+            // Do Pressure Projection for the Mixture
+            m_scene_stepper->projectFine( *m_scene, sub_dt );
+            ++num_projections;
+
+            // Lengthen the Liquid Steps while the Pressure Barely Changes,
+            // and Cut the Current One Short Otherwise
+            if (max_subcycles > 1) {
+                if (m_scene_stepper->getPressureChange() > m_scene->getLiquidInfo().elasto_subcycle_tolerance) {
+                    m_elasto_subcycles = std::max(1, m_elasto_subcycles / 2);
+                    fluid_dt = sub_dt;
+                    subcycles_left = 1;
+                } else {
+                    m_elasto_subcycles = std::min(max_subcycles, m_elasto_subcycles * 2);
+                }
+            }
+        } else {
+            // Keep the Pressure of the Liquid Step
+            m_scene_stepper->reuseProjection( *m_scene, sub_dt );
         }
 
-        // Do Pressure Projection for the Mixture
-        m_scene_stepper->projectFine( *m_scene, sub_dt );
-        t1 = timingutils::seconds();
-        timing_buffer[5] += t1 - t0; // Pressure Projection
-        t0 = t1;
-
         if (m_scene->getLiquidInfo().solve_solid) {
             // Apply Pressure Gradient to Solid
             m_scene_stepper->applyPressureDragElasto(*m_scene, sub_dt);
-            t1 = timingutils::seconds();
-            timing_buffer[6] += t1 - t0; // Timing the Pressure Gradient Application
-            t0 = t1;
         }
 
         // Check Divergence if Necessary and Comparing with the Previously
         // Recorded Divergence to Measure the Error
-        if (m_scene->getLiquidInfo().check_divergence) {
+        if (m_scene->getLiquidInfo().check_divergence && fluid_substep) {
             m_scene_stepper->pushFluidVelocity();
             m_scene_stepper->applyPressureDragFluid(*m_scene, sub_dt);
-            scalar div = m_scene_stepper->computeDivergence(*m_scene) / (scalar) num_substeps;
+            scalar div = m_scene_stepper->computeDivergence(*m_scene) * fluid_dt / dt;
             m_info.m_explicit_div_accu += div;
             m_scene_stepper->popFluidVelocity();
         }
@@ -211,84 +380,145 @@ void WetClothCore::stepSystem(const scalar &dt) {
         if (m_scene->getLiquidInfo().solve_solid) {
             // Implicitly Integrate the Elastic Objects
             m_scene_stepper->stepImplicitElasto( *m_scene, sub_dt );
-            t1 = timingutils::seconds();
-            timing_buffer[6] += t1 - t0; // Solve solid velocity
-            t0 = t1;
         }
 
         // Apply Pressure Gradient to Liquid
         m_scene_stepper->applyPressureDragFluid(*m_scene, sub_dt);
-        t1 = timingutils::seconds();
-        timing_buffer[7] += t1 - t0; // Solve Fluid velocity
-        t0 = t1;
 
         // Update the Current Velocity with the Solved Ones
         m_scene_stepper->acceptVelocity(*m_scene);
 
-        if (m_scene->getLiquidInfo().check_divergence) {
-            m_info.m_implicit_div_accu += m_scene_stepper->computeDivergence(*m_scene) / (scalar) num_substeps;
+        if (check_divergence && fluid_substep) {
+            report.divergence = m_scene_stepper->computeDivergence(*m_scene);
+        }
+
+        {
+            profiler::ScopedTimer timer("particleCorrection");
+
+            // Kinematic Projection of the Liquid Velocity at the Boundary (as Fail-safe)
+            m_scene->constrainLiquidVelocity();
+
+            // Relax the Liquid Particles (see [Ando et al. 2011] for details)
+            if (fluid_substep) m_scene->correctLiquidParticles(fluid_dt);
+        }
+
+        {
+            profiler::ScopedTimer timer("gridToParticle");
+
+            // Transfer Velocity Back to Particles and Elastic Vertices
+            m_scene->mapNodeParticlesAPIC();
+        }
+
+        {
+            profiler::ScopedTimer timer("advection");
+
+            // Update the Multipliers applied on Geometric Stiffness
+            // (refer to the supplemental material of [Fei et al. 2017] for details)
+            m_scene->updateMultipliers( sub_dt );
+
+            // Advection of Liquid Particles and Elastic Vertices
+            m_scene_stepper->advectScene( *m_scene, sub_dt );
+
+            // Kinematic Projection of the Elastic Vertices at the Boundary (as Fail-safe)
+            m_scene->solidProjection( sub_dt );
         }
 
-        // Kinematic Projection of the Liquid Velocity at the Boundary (as Fail-safe)
-        m_scene->constrainLiquidVelocity();
-
-        // Relax the Liquid Particles (see [Ando et al. 2011] for details)
-        m_scene->correctLiquidParticles(sub_dt);
-        t1 = timingutils::seconds();
-        timing_buffer[8] += t1 - t0; // Particle Correction
-        t0 = t1;
-
-        // Transfer Velocity Back to Particles and Elastic Vertices
-        m_scene->mapNodeParticlesAPIC();
-        t1 = timingutils::seconds();
-        timing_buffer[9] += t1 - t0; // APIC Map Particle Back
-        t0 = t1;
-
-        // Update the Multipliers applied on Geometric Stiffness
-        // (refer to the supplemental material of [Fei et al. 2017] for details)
-        m_scene->updateMultipliers( sub_dt );
-
-        // Advection of Liquid Particles and Elastic Vertices
-        m_scene_stepper->advectScene( *m_scene, sub_dt );
-
-        // Kinematic Projection of the Elastic Vertices at the Boundary (as Fail-safe)
-        m_scene->solidProjection( sub_dt );
-        t1 = timingutils::seconds();
-        timing_buffer[10] += t1 - t0; // Particle Advection
-        t0 = t1;
-
-        // Distribute the Liquid Volume onto Elastic Vertices (Capturing)
-        m_scene->distributeFluidElasto(sub_dt);
-        t1 = timingutils::seconds();
-        timing_buffer[11] += t1 - t0; // Liquid Capturing
-        t0 = t1;
-
-        // Emit Liquid Particles for Overflowed Elastic Vertices (Dripping)
-        m_scene->distributeElastoFluid();
-        t1 = timingutils::seconds();
-        timing_buffer[12] += t1 - t0; // Liquid Dripping
-        t0 = t1;
-
-        // Update the Velocity Displacement
-        m_scene->updateVelocityDifference();
-
-        // Update the Acceleration of Liquid on Elastic Vertices
-        m_scene->updateGaussAccel();
-
-        // Solve the Quasi-Static Equation on Elastic Vertices
-        m_scene_stepper->manifoldPropagate( *m_scene, sub_dt );
-        t1 = timingutils::seconds();
-        timing_buffer[13] += t1 - t0; // Solve Quasi-Static Equations
-        t0 = t1;
-
-        // Update the Variables on Elements
-        // We denote elements as 'Gauss' since they are computed at the Gaussian Quadrature Point (1-Point).
-        std::cout << "[update gauss system and plasticity]" << std::endl;
-        m_scene->updateGaussSystem(sub_dt);
-        m_scene->updatePlasticity(sub_dt);
-        t1 = timingutils::seconds();
-        timing_buffer[14] += t1 - t0; // update Deformation Gradient
-        t0 = t1;
+        if (fluid_substep) {
+            // Distribute the Liquid Volume onto Elastic Vertices (Capturing)
+            m_scene->distributeFluidElasto(fluid_dt);
+
+            // Emit Liquid Particles for Overflowed Elastic Vertices (Dripping)
+            m_scene->distributeElastoFluid();
+        }
+
+        {
+            profiler::ScopedTimer timer("quasiStatic");
+
+            // Update the Velocity Displacement
+            m_scene->updateVelocityDifference();
+
+            // Update the Acceleration of Liquid on Elastic Vertices
+            m_scene->updateGaussAccel();
+
+            // Solve the Quasi-Static Equation on Elastic Vertices
+            m_scene_stepper->manifoldPropagate( *m_scene, sub_dt );
+        }
+
+        {
+            profiler::ScopedTimer timer("updateGaussSystem");
+
+            // Update the Variables on Elements
+            // We denote elements as 'Gauss' since they are computed at the Gaussian Quadrature Point (1-Point).
+            m_scene->updateGaussSystem(sub_dt);
+            m_scene->updatePlasticity(sub_dt);
+        }
+
+        prof.endSubstep();
+
+        if (needs_report) {
+            report.max_elasto_vel = m_scene->getMaxVelocity();
+            report.max_fluid_vel = m_scene->getMaxFluidVelocity();
+            report.finite = m_scene->getV().allFinite() && m_scene->getFluidV().allFinite();
+
+            for (const auto& s : prof.getSolvers()) {
+                int calls = s.second.calls;
+                int failures = s.second.failures;
+                long long iterations = s.second.total_iterations;
+
+                auto itr = solver_stats.find(s.first);
+                if (itr != solver_stats.end()) {
+                    calls -= itr->second.calls;
+                    failures -= itr->second.failures;
+                    iterations -= itr->second.total_iterations;
+                }
+
+                if (calls > 0) report.solver_iterations = std::max(report.solver_iterations, (scalar) iterations / (scalar) calls);
+                report.solver_failures += failures;
+            }
+
+            const MatrixXs& Fe = m_scene->getGaussFe();
+            if (Fe.rows() == old_Fe.rows()) {
+                const int num_gausses = (int) Fe.rows() / 3;
+                for (int i = 0; i < num_gausses; ++i) {
+                    // compare the strains F^T F, which leave out the rotation
+                    const Matrix3s C = Fe.block<3, 3>(i * 3, 0).transpose() * Fe.block<3, 3>(i * 3, 0);
+                    const Matrix3s old_C = old_Fe.block<3, 3>(i * 3, 0).transpose() * old_Fe.block<3, 3>(i * 3, 0);
+                    const scalar change = (C - old_C).norm() / std::max(1e-12, old_C.norm());
+                    report.deformation_change = std::max(report.deformation_change, change);
+                }
+            }
+        }
+
+        if (!controller.acceptSubstep(report, sub_dt)) {
+            if (needs_rollback) {
+                checkpoint::Reader reader;
+                if (reader.openBuffer(m_rollback_state) && readState(reader)) {
+                    ++num_rejected;
+                    subcycles_left = 0;
+                    continue;
+                }
+
+                // the scene is neither the rejected state nor the saved one
+                std::cerr << "Failed to roll back the rejected sub-step, aborting the step." << std::endl;
+                prof.endFrame();
+                return false;
+            }
+        }
+
+        if (m_scene->getLiquidInfo().check_divergence && fluid_substep) {
+            m_info.m_initial_div_accu += report.initial_divergence * fluid_dt / dt;
+            m_info.m_implicit_div_accu += report.divergence * fluid_dt / dt;
+        }
+
+        ++run_length;
+        ++num_substeps;
+        --subcycles_left;
+
+        if (last_substep) break;
+    }
+
+    if (needs_report || max_subcycles > 1) {
+        std::cout << "[# sub-step: (" << num_substeps << "), # rejected: (" << num_rejected << "), # projection: (" << num_projections << ")]" << std::endl;
     }
 
     // Summarize Divergence if Necessary
@@ -312,7 +542,11 @@ void WetClothCore::stepSystem(const scalar &dt) {
     m_scene->checkConsistency();
 #endif
 
+    prof.endFrame();
+
     ++m_current_step;
+
+    return true;
 }
 
 
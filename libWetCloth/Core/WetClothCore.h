@@ -12,6 +12,7 @@
 
 #include "TwoDScene.h"
 #include "SceneStepper.h"
+#include "TimestepController.h"
 
 class WetClothCore
 {
@@ -34,23 +35,46 @@ public:
     /////////////////////////////////////////////////////////////////////////////
     // Simulation Control Functions
 
-    virtual void stepSystem( const scalar& dt );
+    // false if a rejected sub-step could not be rolled back, which leaves the scene unusable
+    virtual bool stepSystem( const scalar& dt );
 
-    virtual const std::vector<scalar>& getTimingStatistics() const;
     virtual const std::shared_ptr<TwoDScene>& getScene() const;
     virtual const std::shared_ptr<SceneStepper>& getSceneStepper() const;
     virtual const Info& getInfo() const;
 
     virtual int getCurrentTime() const;
 
+    // Replaces the controller of the sub-step length, CFLTimestepController by default
+    virtual void setTimestepController( const std::shared_ptr<TimestepController>& controller );
+    virtual const std::shared_ptr<TimestepController>& getTimestepController() const;
+
+    /////////////////////////////////////////////////////////////////////////////
+    // Checkpoint Functions
+
+    // Writes the scene, the stepper and the step count; the file is replaced
+    // only once the checkpoint has been written completely
+    virtual bool saveCheckpoint( const std::string& filename ) const;
+
+    // Restores a checkpoint on top of the scene loaded from the same scene file
+    virtual bool loadCheckpoint( const std::string& filename );
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
+    void writeState( checkpoint::Writer& writer ) const;
+    bool readState( checkpoint::Reader& reader );
+
     std::shared_ptr<TwoDScene> m_scene;
     std::shared_ptr<SceneStepper> m_scene_stepper;
+    std::shared_ptr<TimestepController> m_timestep_controller;
+
+    // state at the start of the sub-step, to roll back a rejected one
+    std::string m_rollback_state;
 
     int m_current_step;
 
-    std::vector<scalar> timing_buffer;
+    // sub-cycles of the elastic objects per liquid step, adapted to how
+    // long the pressure of a projection stays valid
+    int m_elasto_subcycles;
 
     Info m_info;
 };
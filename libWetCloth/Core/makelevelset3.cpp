@@ -1,5 +1,8 @@
 #include "makelevelset3.h"
 #include "MathUtilities.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
 
 //
 // This file is part of the libWetCloth open source project
@@ -225,4 +228,151 @@ void make_level_set3(const std::vector<Vector3i> &tri, const std::vector<Vector3
         }
 }
 
+void make_level_set3_narrow_band(const std::vector<Vector3i> &tri, const std::vector<Vector3s> &x,
+                                 const Vector3s &origin, scalar dx, int ni, int nj, int nk,
+                                 NarrowBandLevelSet &phi, const int exact_band)
+{
+    const int T = NarrowBandLevelSet::tile_size;
+    // a band of at least one cell keeps every crossing of the rows inside a band tile,
+    // so that the tiles outside of it have a single sign
+    const int band = std::max(1, exact_band);
+    phi.resize(ni, nj, nk, band * dx);
+
+    // the far field comes from a coarse grid with a node at every tile corner
+    make_level_set3(tri, x, origin, dx * T, phi.nti + 1, phi.ntj + 1, phi.ntk + 1, phi.coarse);
+    for (scalar &c : phi.coarse.a) c = fabs(c);
 
+    const int num_tris = (int) tri.size();
+    // coordinates in grid, and the range of nodes within the band of each triangle
+    std::vector<Vector3s> fp(num_tris * 3);
+    std::vector<Vector3i> band_min(num_tris), band_max(num_tris);
+
+    threadutils::for_each(0, num_tris, [&] (int t) {
+        for (int r = 0; r < 3; ++r) fp[t * 3 + r] = (x[tri[t](r)] - origin) / dx;
+        const Vector3s fmin = fp[t * 3].cwiseMin(fp[t * 3 + 1]).cwiseMin(fp[t * 3 + 2]);
+        const Vector3s fmax = fp[t * 3].cwiseMax(fp[t * 3 + 1]).cwiseMax(fp[t * 3 + 2]);
+        const Vector3i nmax(ni - 1, nj - 1, nk - 1);
+        for (int r = 0; r < 3; ++r) {
+            band_min[t](r) = mathutils::clamp(int(fmin(r)) - band, 0, nmax(r));
+            band_max[t](r) = mathutils::clamp(int(fmax(r)) + band + 1, 0, nmax(r));
+        }
+    });
+
+    // bin the triangles into the tiles they reach, which make up the band
+    std::vector<int> band_tiles;
+    std::vector< std::vector<int> > tile_tris;
+    for (int t = 0; t < num_tris; ++t) {
+        const Vector3i tmin = band_min[t] / T;
+        const Vector3i tmax = band_max[t] / T;
+        for (int tk = tmin(2); tk <= tmax(2); ++tk) for (int tj = tmin(1); tj <= tmax(1); ++tj) for (int ti = tmin(0); ti <= tmax(0); ++ti) {
+                    const int tidx = phi.tileIndex(ti, tj, tk);
+                    if (phi.tiles[tidx] < 0) {
+                        phi.tiles[tidx] = (int) band_tiles.size();
+                        band_tiles.push_back(tidx);
+                        tile_tris.push_back(std::vector<int>());
+                    }
+                    tile_tris[phi.tiles[tidx]].push_back(t);
+                }
+    }
+
+    // exact unsigned distances within each band tile
+    const scalar far = (ni + nj + nk) * dx; // upper bound on distance
+    phi.values.assign(band_tiles.size() * NarrowBandLevelSet::tile_nodes, far);
+
+    threadutils::for_each(0, (int) band_tiles.size(), [&] (int b) {
+        const int tidx = band_tiles[b];
+        const Vector3i tile_min(tidx % phi.nti * T, tidx / phi.nti % phi.ntj * T, tidx / (phi.nti * phi.ntj) * T);
+        const Vector3i tile_max = tile_min + Vector3i::Constant(T - 1);
+        scalar* values = &phi.values[(size_t) b * NarrowBandLevelSet::tile_nodes];
+
+        for (int t : tile_tris[b]) {
+            const Vector3i& pqr = tri[t];
+            const Vector3i lo = band_min[t].cwiseMax(tile_min);
+            const Vector3i hi = band_max[t].cwiseMin(tile_max);
+            for (int k = lo(2); k <= hi(2); ++k) for (int j = lo(1); j <= hi(1); ++j) for (int i = lo(0); i <= hi(0); ++i) {
+                        Vector3s gx(i * dx + origin[0], j * dx + origin[1], k * dx + origin[2]);
+                        scalar d = point_triangle_distance(gx, x[pqr(0)], x[pqr(1)], x[pqr(2)]);
+                        scalar &v = values[NarrowBandLevelSet::tileOffset(i, j, k)];
+                        if (d < v) v = d;
+                    }
+        }
+    });
+
+    // bin the triangles into the columns of tiles along x their rows cross
+    const int num_columns = phi.ntj * phi.ntk;
+    std::vector< std::vector<int> > column_tris(num_columns);
+    std::vector<Vector2i> row_min(num_tris), row_max(num_tris);
+    for (int t = 0; t < num_tris; ++t) {
+        const scalar fjmin = std::min(std::min(fp[t * 3](1), fp[t * 3 + 1](1)), fp[t * 3 + 2](1));
+        const scalar fjmax = std::max(std::max(fp[t * 3](1), fp[t * 3 + 1](1)), fp[t * 3 + 2](1));
+        const scalar fkmin = std::min(std::min(fp[t * 3](2), fp[t * 3 + 1](2)), fp[t * 3 + 2](2));
+        const scalar fkmax = std::max(std::max(fp[t * 3](2), fp[t * 3 + 1](2)), fp[t * 3 + 2](2));
+        row_min[t] = Vector2i(mathutils::clamp((int)std::ceil(fjmin), 0, nj - 1), mathutils::clamp((int)std::ceil(fkmin), 0, nk - 1));
+        row_max[t] = Vector2i(mathutils::clamp((int)std::floor(fjmax), 0, nj - 1), mathutils::clamp((int)std::floor(fkmax), 0, nk - 1));
+        if (row_min[t](0) > row_max[t](0) || row_min[t](1) > row_max[t](1)) continue;
+        for (int tk = row_min[t](1) / T; tk <= row_max[t](1) / T; ++tk) for (int tj = row_min[t](0) / T; tj <= row_max[t](0) / T; ++tj) {
+                column_tris[tk * phi.ntj + tj].push_back(t);
+            }
+    }
+
+    // signs from the parity of the crossings along each row, a column at a time
+    threadutils::for_each(0, num_columns, [&] (int c) {
+        const int tj = c % phi.ntj, tk = c / phi.ntj;
+        const int j0 = tj * T, k0 = tk * T;
+        const int j1 = std::min(j0 + T, nj), k1 = std::min(k0 + T, nk);
+
+        // crossing[r] holds the intervals (i-1,i] of row r where the row crosses a triangle
+        std::vector< std::vector<int> > crossings(T * T);
+        for (int t : column_tris[c]) {
+            const Vector3s &p = fp[t * 3], &q = fp[t * 3 + 1], &r = fp[t * 3 + 2];
+            const int jmin = std::max(row_min[t](0), j0), jmax = std::min(row_max[t](0), j1 - 1);
+            const int kmin = std::max(row_min[t](1), k0), kmax = std::min(row_max[t](1), k1 - 1);
+            for (int k = kmin; k <= kmax; ++k) for (int j = jmin; j <= jmax; ++j) {
+                    scalar a, b, cc;
+                    if (point_in_triangle_2d(j, k, p(1), p(2), q(1), q(2), r(1), r(2), a, b, cc)) {
+                        scalar fi = a * p(0) + b * q(0) + cc * r(0); // intersection i coordinate
+                        int i_interval = std::max(0, int(std::ceil(fi)));
+                        if (i_interval < ni) crossings[(k - k0) * T + (j - j0)].push_back(i_interval);
+                    }
+                }
+        }
+
+        std::vector<int> next(T * T, 0);
+        std::vector<int> parity(T * T, 0);
+        for (std::vector<int> &row : crossings) std::sort(row.begin(), row.end());
+
+        for (int ti = 0; ti < phi.nti; ++ti) {
+            const int tidx = phi.tileIndex(ti, tj, tk);
+            const int i0 = ti * T, i1 = std::min(i0 + T, ni);
+            const int block = phi.tiles[tidx];
+
+            if (block < 0) {
+                // no triangle near the tile, so no row changes sign within it
+                for (int r = 0; r < T * T; ++r) {
+                    const std::vector<int> &row = crossings[r];
+                    while (next[r] < (int) row.size() && row[next[r]] <= i0) {
+                        ++next[r];
+                        parity[r] ^= 1;
+                    }
+                }
+                phi.signs[tidx] = parity[0] ? -1 : 1;
+                continue;
+            }
+
+            scalar* values = &phi.values[(size_t) block * NarrowBandLevelSet::tile_nodes];
+            for (int k = k0; k < k1; ++k) for (int j = j0; j < j1; ++j) {
+                    const int r = (k - k0) * T + (j - j0);
+                    const std::vector<int> &row = crossings[r];
+                    for (int i = i0; i < i1; ++i) {
+                        while (next[r] < (int) row.size() && row[next[r]] <= i) {
+                            ++next[r];
+                            parity[r] ^= 1;
+                        }
+                        scalar &v = values[NarrowBandLevelSet::tileOffset(i, j, k)];
+                        if (v >= phi.background) v = std::max(phi.background, phi.coarseValue(i, j, k));
+                        if (parity[r]) v = -v;
+                    }
+                }
+        }
+    });
+}
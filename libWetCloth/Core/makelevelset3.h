@@ -27,6 +27,7 @@
 
 #include "array3.h"
 #include "MathDefs.h"
+#include "NarrowBandLevelSet.h"
 
 // tri is a list of triangles in the mesh, and x is the positions of the vertices
 // absolute distances will be nearly correct for triangle soup, but a closed mesh is
@@ -37,4 +38,13 @@ void make_level_set3(const std::vector<Vector3i> &tri, const std::vector<Vector3
                      const Vector3s &origin, scalar dx, int nx, int ny, int nz,
                      Array3d &phi, const int exact_band = 1);
 
+// Same signed distance, built tile by tile in parallel and stored sparsely: the
+// triangles are binned into the tiles they come within exact_band cells of, each
+// of those tiles computes its distances exactly, and the signs come from parallel
+// ray parity along the rows. Distances below exact_band cells are exact; the
+// tiles further away hold only their sign over a coarse distance grid.
+void make_level_set3_narrow_band(const std::vector<Vector3i> &tri, const std::vector<Vector3s> &x,
+                                 const Vector3s &origin, scalar dx, int ni, int nj, int nk,
+                                 NarrowBandLevelSet &phi, const int exact_band = 3);
+
 #endif
@@ -54,6 +54,25 @@ inline void add_scaled(double alpha, const std::vector<double> &x, std::vector<d
 	size_t n = x.size() < y.size() ? x.size() : y.size();
 	Eigen::Map<Eigen::VectorXd>((double*) &y[0], n) += Eigen::Map<const Eigen::VectorXd>((const double*) &x[0], n) * alpha;
 }
+
+// single precision versions, for mixed-precision solves ====================
+
+inline double dot(const std::vector<float> &x, const std::vector<float> &y)
+{
+	size_t n = x.size() < y.size() ? x.size() : y.size();
+	return Eigen::Map<Eigen::VectorXf>((float*) &y[0], n).cast<double>().dot(Eigen::Map<Eigen::VectorXf>((float*) &x[0], n).cast<double>());
+}
+
+inline double abs_max(const std::vector<float> &x)
+{
+	return Eigen::Map<Eigen::VectorXf>((float*) &x[0], x.size()).cwiseAbs().maxCoeff();
+}
+
+inline void add_scaled(double alpha, const std::vector<float> &x, std::vector<float> &y)
+{
+	size_t n = x.size() < y.size() ? x.size() : y.size();
+	Eigen::Map<Eigen::VectorXf>((float*) &y[0], n) += Eigen::Map<const Eigen::VectorXf>((const float*) &x[0], n) * (float) alpha;
+}
 }
 }
 #endif
@@ -18,6 +18,7 @@
 // non-positive, and row sums are non-negative).
 
 #include <cmath>
+#include <tbb/parallel_for.h>
 #include "sparse_matrix.h"
 #include "blas_wrapper.h"
 
@@ -94,28 +95,32 @@ struct SparseColumnLowerFactor
 // problems in factorization: if a pivot is this much less than the diagonal
 // entry from the original matrix, the original matrix entry is used instead.
 
+// Factor of the diagonal block of rows and columns [begin, end), with the
+// couplings to the rest of the matrix dropped. The factor uses local indices.
 template<class T>
-void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseColumnLowerFactor<T> &factor,
+void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, unsigned int begin, unsigned int end, SparseColumnLowerFactor<T> &factor,
         T modification_parameter = 0.97, T min_diagonal_ratio = 0.25)
 {
+	const unsigned int n = end - begin;
 // first copy lower triangle of matrix into factor (Note: assuming A is symmetric of course!)
-	factor.resize(matrix.n);
+	factor.resize(n);
 	zero(factor.invdiag); // important: eliminate old values from previous solves!
 	factor.value.resize(0);
 	factor.rowindex.resize(0);
 	zero(factor.adiag);
-	for (unsigned int i = 0; i < matrix.n; ++i) {
+	for (unsigned int i = 0; i < n; ++i) {
+		const unsigned int gi = i + begin;
 		factor.colstart[i] = (unsigned int)factor.rowindex.size();
-		for (unsigned int j = 0; j < matrix.index[i].size(); ++j) {
-			if (matrix.index[i][j] > i) {
-				factor.rowindex.push_back(matrix.index[i][j]);
-				factor.value.push_back(matrix.value[i][j]);
-			} else if (matrix.index[i][j] == i) {
-				factor.invdiag[i] = factor.adiag[i] = matrix.value[i][j];
+		for (unsigned int j = 0; j < matrix.index[gi].size(); ++j) {
+			if (matrix.index[gi][j] > gi && matrix.index[gi][j] < end) {
+				factor.rowindex.push_back(matrix.index[gi][j] - begin);
+				factor.value.push_back(matrix.value[gi][j]);
+			} else if (matrix.index[gi][j] == gi) {
+				factor.invdiag[i] = factor.adiag[i] = matrix.value[gi][j];
 			}
 		}
 	}
-	factor.colstart[matrix.n] = (unsigned int)factor.rowindex.size();
+	factor.colstart[n] = (unsigned int)factor.rowindex.size();
 // now do the incomplete factorization (figure out numerical values)
 
 // MATLAB code:
@@ -134,7 +139,7 @@ void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseC
 //   end
 // end
 
-	for (unsigned int k = 0; k < matrix.n; ++k) {
+	for (unsigned int k = 0; k < n; ++k) {
 		if (factor.adiag[k] == 0) continue; // null row/column
 // figure out the final L(k,k) entry
 		if (factor.invdiag[k] < min_diagonal_ratio * factor.adiag[k])
@@ -148,6 +153,7 @@ void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseC
 // incompletely eliminate L(:,k) from future columns, modifying diagonals
 		for (unsigned int p = factor.colstart[k]; p < factor.colstart[k + 1]; ++p) {
 			unsigned int j = factor.rowindex[p]; // work on column j
+			const std::vector<unsigned int> &matrix_index_j = matrix.index[j + begin];
 			T multiplier = factor.value[p];
 			T missing = 0;
 			unsigned int a = factor.colstart[k];
@@ -155,10 +161,10 @@ void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseC
 			unsigned int b = 0;
 			while (a < factor.colstart[k + 1] && factor.rowindex[a] < j) {
 // look for factor.rowindex[a] in matrix.index[j] starting at b
-				while (b < matrix.index[j].size()) {
-					if (matrix.index[j][b] < factor.rowindex[a])
+				while (b < matrix_index_j.size()) {
+					if (matrix_index_j[b] < factor.rowindex[a] + begin)
 						++b;
-					else if (matrix.index[j][b] == factor.rowindex[a])
+					else if (matrix_index_j[b] == factor.rowindex[a] + begin)
 						break;
 					else {
 						missing += factor.value[a];
@@ -197,6 +203,13 @@ void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseC
 	}
 }
 
+template<class T>
+void factor_modified_incomplete_cholesky0(const SparseMatrix<T> &matrix, SparseColumnLowerFactor<T> &factor,
+        T modification_parameter = 0.97, T min_diagonal_ratio = 0.25)
+{
+	factor_modified_incomplete_cholesky0(matrix, 0, matrix.n, factor, modification_parameter, min_diagonal_ratio);
+}
+
 //============================================================================
 // Solution routines with lower triangular matrix.
 
@@ -239,6 +252,7 @@ template <class T>
 struct PCGSolver
 {
 	PCGSolver(void)
+		: num_blocks(1), reuse_factor(false), factor_valid(false), factor_iterations(0)
 	{
 		set_solver_parameters(1e-8, 500, 0.97, 0.25);
 	}
@@ -252,29 +266,75 @@ struct PCGSolver
 		min_diagonal_ratio = min_diagonal_ratio_;
 	}
 
-	bool solve(const SparseMatrix<T> &matrix, const std::vector<T> &rhs, std::vector<T> &result, T &residual_out, int &iterations_out)
+	// Split the unknowns into num_blocks_ contiguous blocks, each with its
+	// own MIC(0) factor, so that the preconditioner is built and applied in
+	// parallel (block Jacobi). A single block is the plain MIC(0).
+	// With reuse_factor_, the factor of an earlier matrix is kept while the
+	// sparsity pattern stays the same, until the iteration count doubles.
+	// Without it, every solve factors its matrix, as it always did.
+	void set_preconditioner(int num_blocks_, bool reuse_factor_)
+	{
+		if (num_blocks_ < 1) num_blocks_ = 1;
+		if (num_blocks_ != num_blocks) factor_valid = false;
+		num_blocks = num_blocks_;
+		reuse_factor = reuse_factor_;
+		if (!reuse_factor) {
+			cached_index.clear();
+			cached_value.clear();
+		}
+	}
+
+	// With use_initial_guess, result holds the starting iterate; the
+	// tolerance stays relative to the right-hand side.
+	bool solve(const SparseMatrix<T> &matrix, const std::vector<T> &rhs, std::vector<T> &result, T &residual_out, int &iterations_out, bool use_initial_guess = false)
 	{
 		unsigned int n = matrix.n;
 		if (m.size() != n) { m.resize(n); s.resize(n); z.resize(n); r.resize(n); }
-		zero(result);
 		r = rhs;
+		double tol = tolerance_factor * BLAS::abs_max(rhs);
+		if (use_initial_guess && result.size() == n) {
+			multiply_and_subtract(matrix, result, r);
+		} else {
+			result.resize(n);
+			zero(result);
+		}
 		residual_out = BLAS::abs_max(r);
-		if (residual_out < 1e-30) {
+		if (residual_out < 1e-30 || residual_out <= tol) {
 			iterations_out = 0;
 			return true;
 		}
-		double tol = tolerance_factor * residual_out;
 
-		form_preconditioner(matrix);
+		bool refactored = false;
+		if (!reuse_factor) {
+			// nothing is kept, not to copy and compare every matrix
+			form_preconditioner(matrix);
+			fixed_matrix.construct_from_matrix(matrix);
+			refactored = true;
+			factor_valid = false;
+		} else {
+			// an identical matrix, e.g. over sub-steps, is not even rebuilt
+			const bool same_pattern = factor_valid && cached_index == matrix.index;
+			const bool same_matrix = same_pattern && cached_value == matrix.value;
+			if (!same_matrix) {
+				if (!same_pattern) {
+					form_preconditioner(matrix);
+					refactored = true;
+				}
+				cached_index = matrix.index;
+				cached_value = matrix.value;
+				fixed_matrix.construct_from_matrix(matrix);
+				factor_valid = true;
+			}
+		}
 		apply_preconditioner(r, z);
 		double rho = BLAS::dot(z, r);
 		if (rho == 0 || rho != rho) {
 			iterations_out = 0;
+			factor_valid = false;
 			return false;
 		}
 
 		s = z;
-		fixed_matrix.construct_from_matrix(matrix);
 		int iteration;
 		for (iteration = 0; iteration < max_iterations; ++iteration) {
 			multiply(fixed_matrix, s, z);
@@ -284,6 +344,7 @@ struct PCGSolver
 			residual_out = BLAS::abs_max(r);
 			if (residual_out <= tol) {
 				iterations_out = iteration + 1;
+				check_factor(refactored, iterations_out);
 				return true;
 			}
 			apply_preconditioner(r, z);
@@ -293,6 +354,7 @@ struct PCGSolver
 			rho = rho_new;
 		}
 		iterations_out = iteration;
+		factor_valid = false;
 		return false;
 	}
 
@@ -300,9 +362,19 @@ protected:
 
 // internal structures
 	SparseColumnLowerFactor<T> ic_factor; // modified incomplete cholesky factor
+	std::vector< SparseColumnLowerFactor<T> > block_factors; // factors of the diagonal blocks, for num_blocks > 1
+	std::vector<unsigned int> block_start;
 	std::vector<T> m, z, s, r; // temporary vectors for PCG
 	FixedSparseMatrix<T> fixed_matrix; // used within loop
 
+// matrix the factor and fixed_matrix were built for
+	std::vector<std::vector<unsigned int> > cached_index;
+	std::vector<std::vector<T> > cached_value;
+	int num_blocks;
+	bool reuse_factor;
+	bool factor_valid;
+	int factor_iterations; // iterations of the first solve with the current factor
+
 // parameters
 	T tolerance_factor;
 	int max_iterations;
@@ -311,13 +383,61 @@ protected:
 
 	void form_preconditioner(const SparseMatrix<T>& matrix)
 	{
-		factor_modified_incomplete_cholesky0(matrix, ic_factor);
+		if (num_blocks <= 1) {
+			factor_modified_incomplete_cholesky0(matrix, ic_factor);
+			return;
+		}
+
+		block_start.resize(num_blocks + 1);
+		for (int b = 0; b <= num_blocks; ++b) {
+			block_start[b] = (unsigned int) ((unsigned long long) matrix.n * b / num_blocks);
+		}
+
+		block_factors.resize(num_blocks);
+		tbb::parallel_for(0, num_blocks, 1, [&](int b) {
+			factor_modified_incomplete_cholesky0(matrix, block_start[b], block_start[b + 1], block_factors[b]);
+		});
 	}
 
 	void apply_preconditioner(const std::vector<T> &x, std::vector<T> &result)
 	{
-		solve_lower(ic_factor, x, result);
-		solve_lower_transpose_in_place(ic_factor, result);
+		if (num_blocks <= 1) {
+			solve_lower(ic_factor, x, result);
+			solve_lower_transpose_in_place(ic_factor, result);
+			return;
+		}
+
+		result.resize(x.size());
+		tbb::parallel_for(0, num_blocks, 1, [&](int b) {
+			const SparseColumnLowerFactor<T> &factor = block_factors[b];
+			T* block_result = &result[0] + block_start[b];
+			const T* block_x = &x[0] + block_start[b];
+			if (factor.n == 0) return;
+
+			// solve L*result=x and L^T*result=result on the block
+			for (unsigned int i = 0; i < factor.n; ++i) block_result[i] = block_x[i];
+			for (unsigned int i = 0; i < factor.n; ++i) {
+				block_result[i] *= factor.invdiag[i];
+				for (unsigned int j = factor.colstart[i]; j < factor.colstart[i + 1]; ++j) {
+					block_result[factor.rowindex[j]] -= factor.value[j] * block_result[i];
+				}
+			}
+			unsigned int i = factor.n;
+			do {
+				--i;
+				for (unsigned int j = factor.colstart[i]; j < factor.colstart[i + 1]; ++j) {
+					block_result[i] -= factor.value[j] * block_result[factor.rowindex[j]];
+				}
+				block_result[i] *= factor.invdiag[i];
+			} while (i != 0);
+		});
+	}
+
+	// drop a reused factor once it needs twice the iterations it started with
+	void check_factor(bool refactored, int iterations)
+	{
+		if (refactored) factor_iterations = iterations;
+		else if (reuse_factor && iterations > 2 * factor_iterations + 1) factor_valid = false;
 	}
 };
 }
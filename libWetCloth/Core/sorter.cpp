@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <tbb/tbb.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -33,6 +34,122 @@ Sorter::~Sorter() {
 
 void Sorter::resize( int ni_, int nj_, int nk_ )
 {
+	// the buckets of the last sort are meaningless on another grid
+	if (ni_ != ni || nj_ != nj || nk_ != nk) particle_bucket.clear();
+
 	array_sup.resize(ni_ * nj_ * nk_);
 	ni = ni_; nj = nj_; nk = nk_;
 }
+
+void Sorter::counting_sort()
+{
+	const int np = (int) next_bucket.size();
+	const int nb = size();
+
+	array_idx.resize(np);
+
+	// each chunk of particles counts and scatters into its own slice of the
+	// buckets, which keeps the particles of a bucket in index order
+	const int max_chunks = std::max(1, (1 << 24) / std::max(1, nb));
+	const int num_chunks = std::max(1, std::min(std::min((int) threadutils::get_num_threads(), np / 4096), max_chunks));
+
+	bucket_counts.assign((size_t) num_chunks * nb, 0);
+
+	threadutils::for_each(0, num_chunks, [&] (int c) {
+		int* counts = &bucket_counts[(size_t) c * nb];
+		const int pend = (int) ((int64_t) np * (c + 1) / num_chunks);
+		for (int pidx = (int) ((int64_t) np * c / num_chunks); pidx < pend; ++pidx) {
+			++counts[next_bucket[pidx]];
+		}
+	});
+
+	int offset = 0;
+	for (int b = 0; b < nb; ++b) {
+		array_sup[b].first = offset;
+		for (int c = 0; c < num_chunks; ++c) {
+			int& count = bucket_counts[(size_t) c * nb + b];
+			const int n = count;
+			count = offset;
+			offset += n;
+		}
+		array_sup[b].second = offset;
+	}
+
+	threadutils::for_each(0, num_chunks, [&] (int c) {
+		int* pos = &bucket_counts[(size_t) c * nb];
+		const int pend = (int) ((int64_t) np * (c + 1) / num_chunks);
+		for (int pidx = (int) ((int64_t) np * c / num_chunks); pidx < pend; ++pidx) {
+			const int b = next_bucket[pidx];
+			array_idx[pos[b]++] = (uint64_t) b << 32UL | (uint64_t) pidx;
+		}
+	});
+}
+
+bool Sorter::update_movers()
+{
+	const int np = (int) next_bucket.size();
+	const int nb = size();
+
+	// past this, sorting from scratch is cheaper
+	const int max_movers = np / 8;
+
+	movers.clear();
+	for (int pidx = 0; pidx < np; ++pidx) {
+		if (next_bucket[pidx] == particle_bucket[pidx]) continue;
+		if ((int) movers.size() >= max_movers) return false;
+		movers.push_back((uint64_t) next_bucket[pidx] << 32UL | (uint64_t) pidx);
+	}
+
+	if (movers.empty()) return true;
+
+	std::sort(movers.begin(), movers.end());
+
+	bucket_counts.resize(nb);
+	threadutils::for_each(0, nb, [&] (int b) {
+		bucket_counts[b] = array_sup[b].second - array_sup[b].first;
+	});
+
+	for (uint64_t m : movers) {
+		const int pidx = (int) (m & 0xFFFFFFFFUL);
+		--bucket_counts[particle_bucket[pidx]];
+		++bucket_counts[next_bucket[pidx]];
+	}
+
+	next_array_sup.resize(nb);
+	int offset = 0;
+	for (int b = 0; b < nb; ++b) {
+		next_array_sup[b].first = offset;
+		offset += bucket_counts[b];
+		next_array_sup[b].second = offset;
+	}
+
+	next_array_idx.resize(np);
+
+	// merge the particles staying in each bucket with the ones arriving,
+	// both in index order
+	threadutils::for_each(0, nb, [&] (int b) {
+		std::vector<uint64_t>::const_iterator arrival = std::lower_bound(movers.cbegin(), movers.cend(), (uint64_t) b << 32UL);
+		std::vector<uint64_t>::const_iterator arrival_end = std::lower_bound(arrival, movers.cend(), (uint64_t) (b + 1) << 32UL);
+
+		const uint64_t high_part = (uint64_t) b << 32UL;
+		int out = next_array_sup[b].first;
+		for (int N_ID = array_sup[b].first; N_ID < array_sup[b].second; ++N_ID) {
+			const int pidx = (int) (array_idx[N_ID] & 0xFFFFFFFFUL);
+			if (next_bucket[pidx] != b) continue;
+
+			for (; arrival != arrival_end && (int) (*arrival & 0xFFFFFFFFUL) < pidx; ++arrival) {
+				next_array_idx[out++] = *arrival;
+			}
+			next_array_idx[out++] = high_part | (uint64_t) pidx;
+		}
+
+		for (; arrival != arrival_end; ++arrival) {
+			next_array_idx[out++] = *arrival;
+		}
+	});
+
+	array_idx.swap(next_array_idx);
+	array_sup.swap(next_array_sup);
+
+	return true;
+}
@@ -137,49 +137,31 @@ public:
 		return ni * nj * nk;
 	}
 
+	// Sorts the particles by bucket, and by index within a bucket. When the
+	// number of particles is unchanged, only the particles that changed
+	// bucket since the last sort are patched in; otherwise, or when too many
+	// of them moved, the particles are counting-sorted by bucket.
 	template<typename Callable>
 	void sort( size_t total_size, Callable func )
 	{
-		if (array_idx.size() != total_size) {
-			array_idx.resize(total_size);
-		}
-
-		memset(&array_sup[0], 0, array_sup.size() * sizeof(std::pair<int, int>));
-
 		const int np = (int) total_size;
 
+		next_bucket.resize(np);
+
 		threadutils::for_each(0, np, [&] (int pidx) {
 			int i, j, k;
 			func(pidx, i, j, k);
 			i = std::max(0, std::min(ni - 1, i));
 			j = std::max(0, std::min(nj - 1, j));
 			k = std::max(0, std::min(nk - 1, k));
-			array_idx[pidx] = hash(i, j, k, pidx);
-		});
-
-		tbb::parallel_sort(array_idx.begin(), array_idx.end());
-
-		threadutils::for_each(0, np, [&] (int pidx) {
-			int G_ID = pidx;
-			int G_ID_PREV = G_ID - 1;
-			int G_ID_NEXT = G_ID + 1;
-
-			unsigned int cell = (unsigned int) ( array_idx[G_ID] >> 32UL );
-			unsigned int cell_prev = G_ID_PREV < 0 ? -1U : (unsigned int) ( array_idx[G_ID_PREV] >> 32UL );
-			unsigned int cell_next = G_ID_NEXT >= np ? -1U : (unsigned int) ( array_idx[G_ID_NEXT] >> 32UL );
-			if (cell != cell_prev)
-			{
-				// I'm the start of a cell
-				array_sup[cell].first = G_ID;
-			}
-			if (cell != cell_next)
-			{
-				// I'm the end of a cell
-				array_sup[cell].second = G_ID + 1;
-			}
+			next_bucket[pidx] = bucket_index(i, j, k);
 		});
 
+		if (!(np > 0 && (int) particle_bucket.size() == np && (int) array_idx.size() == np && update_movers())) {
+			counting_sort();
+		}
 
+		particle_bucket.swap(next_bucket);
 	}
 
 	inline int get_bucket_size( int bucket_idx ) const
@@ -506,6 +488,23 @@ public:
 	int ni;
 	int nj;
 	int nk;
+
+private:
+	// rebuild array_idx and array_sup from next_bucket
+	void counting_sort();
+
+	// patch the particles that changed bucket into array_idx, false if there
+	// are too many of them
+	bool update_movers();
+
+	std::vector<int> particle_bucket; // bucket of each particle in array_idx
+	std::vector<int> next_bucket;
+
+	// buffers
+	std::vector<uint64_t> movers;
+	std::vector<uint64_t> next_array_idx;
+	std::vector< std::pair<int, int> > next_array_sup;
+	std::vector<int> bucket_counts;
 };
 
 #endif
@@ -0,0 +1,664 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Runs scenes without rendering or output for a fixed number of frames, at
+// one or more thread counts, and writes the per-phase times, the solver
+// iterations, the particle counts and the peak memory of every run as JSON.
+// Every run gets a process of its own where it can, for its own peak memory.
+// Given the JSON of an earlier run, it flags the phases, solvers and memory
+// that got worse and exits with 2 if any did.
+
+#include <Eigen/Core>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tbb/global_control.h>
+#include <tclap/CmdLine.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "MemUtilities.h"
+#include "ParticleSimulation.h"
+#include "Profiler.h"
+#include "StringUtilities.h"
+#include "TimingUtilities.h"
+#include "TwoDSceneXMLParser.h"
+
+struct SolverResult
+{
+	int calls;
+	int failures;
+	long long iterations;
+	int max_iterations;
+};
+
+struct RunResult
+{
+	std::string scene;
+	int threads;
+	int frames;
+	int substeps;
+	scalar load_time;
+	scalar wall_time;
+	int particles;
+	int fluid_particles;
+	int elements;
+	size_t peak_rss;
+	bool peak_rss_per_run; // false if it is the peak of the whole process so far
+	std::map< std::string, scalar > phases; // seconds per frame
+	std::map< std::string, SolverResult > solvers;
+};
+
+// Just enough of a JSON reader for the files written below.
+struct JSONValue
+{
+	enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+	JSONValue() : type(NUL), number(0.0) {}
+
+	const JSONValue* find( const std::string& key ) const
+	{
+		for (const auto& m : members) {
+			if (m.first == key) return &m.second;
+		}
+		return NULL;
+	}
+
+	scalar getNumber( const std::string& key, scalar fallback = 0.0 ) const
+	{
+		const JSONValue* v = find(key);
+		return (v && v->type == NUMBER) ? v->number : fallback;
+	}
+
+	std::string getString( const std::string& key ) const
+	{
+		const JSONValue* v = find(key);
+		return (v && v->type == STRING) ? v->string : std::string();
+	}
+
+	Type type;
+	scalar number;
+	std::string string;
+	std::vector< JSONValue > elements;
+	std::vector< std::pair< std::string, JSONValue > > members;
+};
+
+class JSONReader
+{
+public:
+	explicit JSONReader( const std::string& text ) : m_text(text), m_pos(0) {}
+
+	bool parse( JSONValue& value )
+	{
+		return parseValue(value) && (skipSpace(), m_pos == m_text.size());
+	}
+
+private:
+	void skipSpace()
+	{
+		while (m_pos < m_text.size() && isspace((unsigned char) m_text[m_pos])) ++m_pos;
+	}
+
+	bool consume( char c )
+	{
+		skipSpace();
+		if (m_pos < m_text.size() && m_text[m_pos] == c) {
+			++m_pos;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseString( std::string& str )
+	{
+		if (!consume('"')) return false;
+		str.clear();
+		while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+			char c = m_text[m_pos++];
+			if (c == '\\' && m_pos < m_text.size()) {
+				c = m_text[m_pos++];
+				if (c == 'n') c = '\n';
+				else if (c == 't') c = '\t';
+			}
+			str.push_back(c);
+		}
+		return consume('"');
+	}
+
+	bool parseValue( JSONValue& value )
+	{
+		skipSpace();
+		if (m_pos >= m_text.size()) return false;
+
+		const char c = m_text[m_pos];
+		if (c == '{') {
+			++m_pos;
+			value.type = JSONValue::OBJECT;
+			if (consume('}')) return true;
+			do {
+				std::pair< std::string, JSONValue > member;
+				if (!parseString(member.first) || !consume(':') || !parseValue(member.second)) return false;
+				value.members.push_back(member);
+			} while (consume(','));
+			return consume('}');
+		} else if (c == '[') {
+			++m_pos;
+			value.type = JSONValue::ARRAY;
+			if (consume(']')) return true;
+			do {
+				value.elements.push_back(JSONValue());
+				if (!parseValue(value.elements.back())) return false;
+			} while (consume(','));
+			return consume(']');
+		} else if (c == '"') {
+			value.type = JSONValue::STRING;
+			return parseString(value.string);
+		} else if (m_text.compare(m_pos, 4, "true") == 0 || m_text.compare(m_pos, 5, "false") == 0) {
+			value.type = JSONValue::BOOL;
+			value.number = (c == 't') ? 1.0 : 0.0;
+			m_pos += (c == 't') ? 4 : 5;
+			return true;
+		} else if (m_text.compare(m_pos, 4, "null") == 0) {
+			value.type = JSONValue::NUL;
+			m_pos += 4;
+			return true;
+		}
+
+		const char* begin = m_text.c_str() + m_pos;
+		char* end = NULL;
+		value.type = JSONValue::NUMBER;
+		value.number = strtod(begin, &end);
+		if (end == begin) return false;
+		m_pos += end - begin;
+		return true;
+	}
+
+	const std::string& m_text;
+	size_t m_pos;
+};
+
+static void writeString( std::ostream& os, const std::string& str )
+{
+	os << '"';
+	for (char c : str) {
+		if (c == '"' || c == '\\') os << '\\';
+		os << c;
+	}
+	os << '"';
+}
+
+// false if the simulation could not go on
+static bool runScene( const std::string& scene, int threads, int frames, int warmup, RunResult& result )
+{
+	tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, threads);
+	Eigen::setNbThreads(threads);
+
+	// the same seed as the simulator, for the same particles
+	mathutils::randomEngine().seed(0x0108170F);
+
+	profiler::Profiler& prof = profiler::Profiler::instance();
+	prof.reset();
+
+	result.scene = scene;
+	result.threads = threads;
+	result.frames = frames;
+
+	const double load_begin = timingutils::seconds();
+
+	std::shared_ptr<ParticleSimulation> execsim;
+	{
+		TwoDSceneXMLParser xml_scene_parser;
+		Camera cam;
+		renderingutils::Color bgcolor;
+		scalar max_time, steps_per_sec_cap;
+		std::string description, scenetag;
+		bool cam_inited;
+		scalar dt;
+
+		xml_scene_parser.loadExecutableSimulation( scene, false, execsim, cam, dt, max_time, steps_per_sec_cap, bgcolor, description, scenetag, cam_inited, "" );
+
+		result.load_time = timingutils::seconds() - load_begin;
+
+		const std::shared_ptr<WetClothCore>& core = execsim->getCore();
+
+		for (int i = 0; i < warmup; ++i) {
+			if (!core->stepSystem(dt)) return false;
+		}
+
+		prof.reset();
+
+		const double run_begin = timingutils::seconds();
+		for (int i = 0; i < frames; ++i) {
+			if (!core->stepSystem(dt)) return false;
+		}
+		result.wall_time = timingutils::seconds() - run_begin;
+
+		const std::shared_ptr<TwoDScene>& twodscene = core->getScene();
+		result.particles = twodscene->getNumParticles();
+		result.fluid_particles = twodscene->getNumFluidParticles();
+		result.elements = twodscene->getNumGausses();
+	}
+
+	result.substeps = prof.getNumSubsteps();
+	result.peak_rss = memutils::getPeakRSS();
+	result.peak_rss_per_run = false;
+
+	for (const auto& p : prof.getPhases()) {
+		result.phases[p.first] = p.second.total_time / (scalar) std::max(1, frames);
+	}
+
+	for (const auto& s : prof.getSolvers()) {
+		SolverResult& solver = result.solvers[s.first];
+		solver.calls = s.second.calls;
+		solver.failures = s.second.failures;
+		solver.iterations = s.second.total_iterations;
+		solver.max_iterations = s.second.max_iterations;
+	}
+
+	return true;
+}
+
+static void writeRun( std::ostream& os, const RunResult& r )
+{
+	os << "    {" << std::endl;
+	os << "      \"scene\": ";
+	writeString(os, r.scene);
+	os << "," << std::endl;
+	os << "      \"threads\": " << r.threads << "," << std::endl;
+	os << "      \"frames\": " << r.frames << "," << std::endl;
+	os << "      \"substeps\": " << r.substeps << "," << std::endl;
+	os << "      \"load_time\": " << r.load_time << "," << std::endl;
+	os << "      \"wall_time\": " << r.wall_time << "," << std::endl;
+	os << "      \"frame_time\": " << (r.wall_time / (scalar) std::max(1, r.frames)) << "," << std::endl;
+	os << "      \"particles\": " << r.particles << "," << std::endl;
+	os << "      \"fluid_particles\": " << r.fluid_particles << "," << std::endl;
+	os << "      \"elements\": " << r.elements << "," << std::endl;
+	os << "      \"peak_rss\": " << r.peak_rss << "," << std::endl;
+	os << "      \"peak_rss_per_run\": " << (r.peak_rss_per_run ? "true" : "false") << "," << std::endl;
+
+	os << "      \"phases\": {";
+	bool first = true;
+	for (const auto& p : r.phases) {
+		os << (first ? "" : ",") << std::endl << "        ";
+		writeString(os, p.first);
+		os << ": " << p.second;
+		first = false;
+	}
+	os << std::endl << "      }," << std::endl;
+
+	os << "      \"solvers\": {";
+	first = true;
+	for (const auto& s : r.solvers) {
+		os << (first ? "" : ",") << std::endl << "        ";
+		writeString(os, s.first);
+		os << ": {\"calls\": " << s.second.calls
+		   << ", \"failures\": " << s.second.failures
+		   << ", \"iterations\": " << s.second.iterations
+		   << ", \"max_iterations\": " << s.second.max_iterations << "}";
+		first = false;
+	}
+	os << std::endl << "      }" << std::endl;
+	os << "    }";
+}
+
+static void writeResults( std::ostream& os, const std::vector< RunResult >& results )
+{
+	os << std::setprecision(9);
+	os << "{" << std::endl;
+	os << "  \"version\": 1," << std::endl;
+	os << "  \"runs\": [";
+
+	bool first_run = true;
+	for (const RunResult& r : results) {
+		os << (first_run ? "" : ",") << std::endl;
+		writeRun(os, r);
+		first_run = false;
+	}
+
+	os << std::endl << "  ]" << std::endl;
+	os << "}" << std::endl;
+}
+
+// The inverse of writeRun.
+static bool readRun( const JSONValue& run, RunResult& result )
+{
+	if (run.type != JSONValue::OBJECT) return false;
+
+	const JSONValue* per_run = run.find("peak_rss_per_run");
+	result.scene = run.getString("scene");
+	result.threads = (int) run.getNumber("threads");
+	result.frames = (int) run.getNumber("frames");
+	result.substeps = (int) run.getNumber("substeps");
+	result.load_time = run.getNumber("load_time");
+	result.wall_time = run.getNumber("wall_time");
+	result.particles = (int) run.getNumber("particles");
+	result.fluid_particles = (int) run.getNumber("fluid_particles");
+	result.elements = (int) run.getNumber("elements");
+	result.peak_rss = (size_t) run.getNumber("peak_rss");
+	result.peak_rss_per_run = per_run && per_run->type == JSONValue::BOOL && per_run->number != 0.0;
+
+	if (const JSONValue* phases = run.find("phases")) {
+		for (const auto& p : phases->members) result.phases[p.first] = p.second.number;
+	}
+
+	if (const JSONValue* solvers = run.find("solvers")) {
+		for (const auto& s : solvers->members) {
+			SolverResult& solver = result.solvers[s.first];
+			solver.calls = (int) s.second.getNumber("calls");
+			solver.failures = (int) s.second.getNumber("failures");
+			solver.iterations = (long long) s.second.getNumber("iterations");
+			solver.max_iterations = (int) s.second.getNumber("max_iterations");
+		}
+	}
+
+	return true;
+}
+
+// Runs a scene in a child process, so that its peak memory is its own
+// rather than the largest of all the runs so far, which also keeps what
+// one scene leaves allocated out of the next. Falls back to running it
+// here where there is no fork.
+static bool runIsolated( const std::string& scene, int threads, int frames, int warmup, RunResult& result )
+{
+#ifdef _WIN32
+	// the progress of the solvers goes with the log, leaving the standard output to the JSON
+	std::streambuf* cout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+	const bool finished = runScene(scene, threads, frames, warmup, result);
+	std::cout.rdbuf(cout_buf);
+	if (finished) return true;
+
+	std::cerr << "error: the run of " << scene << " at " << threads << " threads did not finish" << std::endl;
+	return false;
+#else
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cerr << "error: cannot create a pipe for the run" << std::endl;
+		return false;
+	}
+
+	// not to have the child write out what is still buffered here again
+	std::cout.flush();
+	std::cerr.flush();
+
+	const pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "error: cannot fork for the run" << std::endl;
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+
+		// the progress of the solvers goes with the log, leaving the standard output to the JSON
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+
+		RunResult child_result;
+		if (!runScene(scene, threads, frames, warmup, child_result)) {
+			std::cout.flush();
+			std::cerr.flush();
+			_exit(1);
+		}
+		child_result.peak_rss_per_run = true;
+
+		std::ostringstream oss;
+		oss << std::setprecision(17);
+		writeRun(oss, child_result);
+		const std::string text = oss.str();
+
+		size_t written = 0;
+		while (written < text.size()) {
+			const ssize_t n = write(fds[1], text.c_str() + written, text.size() - written);
+			if (n <= 0) break;
+			written += (size_t) n;
+		}
+		close(fds[1]);
+
+		std::cout.flush();
+		std::cerr.flush();
+		_exit(written == text.size() ? 0 : 1);
+	}
+
+	close(fds[1]);
+
+	std::string text;
+	char buffer[4096];
+	ssize_t n;
+	while ((n = read(fds[0], buffer, sizeof(buffer))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		text.append(buffer, (size_t) n);
+	}
+	close(fds[0]);
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+	JSONValue run;
+	JSONReader reader(text);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !reader.parse(run) || !readRun(run, result)) {
+		std::cerr << "error: the run of " << scene << " at " << threads << " threads did not finish" << std::endl;
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+static bool readBaseline( const std::string& filename, JSONValue& baseline )
+{
+	std::ifstream ifs(filename.c_str());
+	if (!ifs.good()) {
+		std::cerr << "error: cannot open baseline " << filename << std::endl;
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+	const std::string text = ss.str();
+
+	JSONReader reader(text);
+	const JSONValue* runs = NULL;
+	if (!reader.parse(baseline) || !(runs = baseline.find("runs")) || runs->type != JSONValue::ARRAY) {
+		std::cerr << "error: " << filename << " is not the output of a benchmark" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Compares a quantity where larger is worse. Changes within the relative
+// tolerance, or below the absolute floor, are noise.
+static bool checkRegression( const std::string& what, scalar baseline, scalar current, scalar tolerance, scalar floor, const char* unit )
+{
+	if (current <= baseline * (1.0 + tolerance) || current - baseline <= floor) return false;
+
+	std::cerr << "  REGRESSION " << what << ": " << baseline << unit << " -> " << current << unit
+	          << " (+" << std::setprecision(3) << ((baseline > 0.0) ? (current / baseline - 1.0) * 100.0 : 100.0) << "%)" << std::setprecision(6) << std::endl;
+	return true;
+}
+
+static int compareBaseline( const JSONValue& baseline, const std::vector< RunResult >& results, scalar tolerance, scalar min_time )
+{
+	const JSONValue* runs = baseline.find("runs");
+	int num_regressions = 0;
+
+	for (const RunResult& r : results) {
+		const JSONValue* base = NULL;
+		for (const JSONValue& run : runs->elements) {
+			if (run.getString("scene") == r.scene && (int) run.getNumber("threads") == r.threads) {
+				base = &run;
+				break;
+			}
+		}
+
+		std::cerr << r.scene << " @ " << r.threads << " threads:" << std::endl;
+		if (!base) {
+			std::cerr << "  not in the baseline" << std::endl;
+			continue;
+		}
+
+		if ((int) base->getNumber("frames") != r.frames) {
+			std::cerr << "  note: the baseline ran " << (int) base->getNumber("frames") << " frames" << std::endl;
+		}
+
+		const int base_particles = (int) base->getNumber("particles");
+		if (base_particles != r.particles) {
+			std::cerr << "  note: particles " << base_particles << " -> " << r.particles << std::endl;
+		}
+
+		const int base_substeps = (int) base->getNumber("substeps");
+		if (base_substeps != r.substeps) {
+			std::cerr << "  note: substeps " << base_substeps << " -> " << r.substeps << std::endl;
+		}
+
+		int run_regressions = 0;
+
+		run_regressions += checkRegression("frame time", base->getNumber("frame_time"), r.wall_time / (scalar) std::max(1, r.frames), tolerance, min_time, "s");
+
+		if (const JSONValue* phases = base->find("phases")) {
+			for (const auto& p : r.phases) {
+				const JSONValue* bp = phases->find(p.first);
+				if (!bp || bp->type != JSONValue::NUMBER) continue;
+				run_regressions += checkRegression(p.first, bp->number, p.second, tolerance, min_time, "s");
+			}
+		}
+
+		if (const JSONValue* solvers = base->find("solvers")) {
+			for (const auto& s : r.solvers) {
+				const JSONValue* bs = solvers->find(s.first);
+				if (!bs) continue;
+
+				// iterations per solve, so that a change in the substeps alone does not count
+				const scalar base_calls = std::max(1.0, bs->getNumber("calls"));
+				const scalar cur_calls = std::max(1, s.second.calls);
+				run_regressions += checkRegression(s.first + " iterations per solve", bs->getNumber("iterations") / base_calls, (scalar) s.second.iterations / cur_calls, tolerance, 0.5, "");
+				run_regressions += checkRegression(s.first + " failures", bs->getNumber("failures"), s.second.failures, 0.0, 0.0, "");
+			}
+		}
+
+		// a process-wide peak depends on what ran before, so only compare the peaks of single runs
+		const JSONValue* base_per_run = base->find("peak_rss_per_run");
+		if (r.peak_rss_per_run && base_per_run && base_per_run->type == JSONValue::BOOL && base_per_run->number != 0.0) {
+			run_regressions += checkRegression("peak RSS", base->getNumber("peak_rss") / (1024.0 * 1024.0), (scalar) r.peak_rss / (1024.0 * 1024.0), tolerance, 1.0, "MB");
+		}
+
+		if (!run_regressions) std::cerr << "  ok" << std::endl;
+		num_regressions += run_regressions;
+	}
+
+	return num_regressions;
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<std::string> scenes;
+	std::vector<int> thread_counts;
+	int frames = 10;
+	int warmup = 0;
+	std::string output;
+	std::string baseline_file;
+	scalar tolerance = 0.1;
+	scalar min_time = 1e-3;
+
+	try
+	{
+		TCLAP::CmdLine cmd("Benchmarks libWetCloth scenes without rendering");
+
+		TCLAP::ValueArg<int> numframes("n", "frames", "Frames to time in every run", false, 10, "integer", cmd);
+		TCLAP::ValueArg<int> warmupframes("w", "warmup", "Frames to run before the timing starts", false, 0, "integer", cmd);
+		TCLAP::ValueArg<std::string> threads("t", "threads", "Comma-separated thread counts to run every scene at, all hardware threads if empty", false, "", "string", cmd);
+		TCLAP::ValueArg<std::string> outputfile("o", "output", "JSON file to write the results to, the standard output if empty", false, "", "string", cmd);
+		TCLAP::ValueArg<std::string> baselinefile("b", "baseline", "JSON results of an earlier run to flag regressions against", false, "", "string", cmd);
+		TCLAP::ValueArg<scalar> tol("", "tolerance", "Relative slowdown or growth over the baseline tolerated as noise", false, 0.1, "float", cmd);
+		TCLAP::ValueArg<scalar> mintime("", "mintime", "Seconds per frame a phase must slow down by to count as a regression", false, 1e-3, "float", cmd);
+		TCLAP::UnlabeledMultiArg<std::string> scenefiles("scenes", "XML scene files, e.g. assets/*/*.xml", true, "string", cmd);
+
+		cmd.parse(argc, argv);
+
+		scenes = scenefiles.getValue();
+		frames = numframes.getValue();
+		warmup = warmupframes.getValue();
+		output = outputfile.getValue();
+		baseline_file = baselinefile.getValue();
+		tolerance = tol.getValue();
+		min_time = mintime.getValue();
+
+		for (const std::string& t : stringutils::split(threads.getValue(), ',')) {
+			int n = 0;
+			if (t.empty()) continue;
+			if (!stringutils::extractFromString(t, n) || n <= 0) {
+				std::cerr << "error: invalid thread count " << t << std::endl;
+				return 1;
+			}
+			thread_counts.push_back(n);
+		}
+	}
+	catch (TCLAP::ArgException& e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	if (thread_counts.empty()) thread_counts.push_back((int) std::thread::hardware_concurrency());
+
+	// read the baseline first, not to find it broken after all the runs
+	JSONValue baseline;
+	if (!baseline_file.empty() && !readBaseline(baseline_file, baseline)) return 1;
+
+	Eigen::initParallel();
+
+	std::vector< RunResult > results;
+	for (const std::string& scene : scenes) {
+		for (int threads : thread_counts) {
+			std::cerr << "[" << scene << " @ " << threads << " threads]" << std::endl;
+			results.push_back(RunResult());
+			if (!runIsolated(scene, threads, frames, warmup, results.back())) return 1;
+
+			const RunResult& r = results.back();
+			std::cerr << "  " << (r.wall_time / (scalar) std::max(1, frames)) << " s per frame, " << r.substeps << " substeps, "
+			          << r.particles << " particles, peak RSS " << (r.peak_rss / (1024 * 1024)) << " MB" << (r.peak_rss_per_run ? "" : " (process-wide)") << std::endl;
+		}
+	}
+
+	if (output.empty()) {
+		writeResults(std::cout, results);
+	} else {
+		std::ofstream ofs(output.c_str());
+		if (!ofs.good()) {
+			std::cerr << "error: cannot write " << output << std::endl;
+			return 1;
+		}
+		writeResults(ofs, results);
+	}
+
+	if (baseline_file.empty()) return 0;
+
+	const int num_regressions = compareBaseline(baseline, results, tolerance, min_time);
+	std::cerr << num_regressions << " regression(s) against " << baseline_file << std::endl;
+
+	return num_regressions ? 2 : 0;
+}
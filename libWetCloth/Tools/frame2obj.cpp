@@ -0,0 +1,80 @@
+//
+// This file is part of the libWetCloth open source project
+//
+// Copyright 2018 Yun (Raymond) Fei, Christopher Batty, Eitan Grinspun, and Changxi Zheng
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Converts frames of the binary frame format back to the OBJ files the
+// simulator writes by default: frame00012.wcf becomes cloth00012.obj,
+// hair00012.obj, fluid00012.obj and so on, next to the frame or in the
+// given output directory.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <tclap/CmdLine.h>
+
+#include "FrameFile.h"
+
+static void splitFrameName( const std::string& filename, std::string& dir, std::string& number )
+{
+	const size_t slash = filename.find_last_of('/');
+	dir = slash == std::string::npos ? "." : filename.substr(0, slash);
+
+	std::string stem = slash == std::string::npos ? filename : filename.substr(slash + 1);
+	const size_t dot = stem.find_last_of('.');
+	if (dot != std::string::npos) stem = stem.substr(0, dot);
+
+	size_t first_digit = stem.size();
+	while (first_digit > 0 && isdigit((unsigned char) stem[first_digit - 1])) --first_digit;
+	number = stem.substr(first_digit);
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<std::string> filenames;
+	std::string output_dir;
+
+	try
+	{
+		TCLAP::CmdLine cmd("Converts binary frames of libWetCloth to OBJ files");
+
+		TCLAP::ValueArg<std::string> outputdir("o", "outputdir", "Directory to write the OBJ files to, the one of each frame if empty", false, "", "string", cmd);
+		TCLAP::UnlabeledMultiArg<std::string> frames("frames", "Binary frame files", true, "string", cmd);
+
+		cmd.parse(argc, argv);
+
+		filenames = frames.getValue();
+		output_dir = outputdir.getValue();
+	}
+	catch (TCLAP::ArgException& e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	int num_failed = 0;
+	std::vector<framefile::Record> records;
+
+	for (const std::string& filename : filenames) {
+		if (!framefile::read(filename, records)) {
+			++num_failed;
+			continue;
+		}
+
+		std::string dir, number;
+		splitFrameName(filename, dir, number);
+		if (!output_dir.empty()) dir = output_dir;
+
+		for (const framefile::Record& record : records) {
+			if (!framefile::writeOBJ(dir + "/" + record.name + number + ".obj", record)) ++num_failed;
+		}
+
+		std::cout << "[Frame " << filename << " converted]" << std::endl;
+	}
+
+	return num_failed ? 1 : 0;
+}